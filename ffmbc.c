@@ -42,6 +42,7 @@
 #include "libavutil/dict.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/imgutils.h"
 #include "libavutil/avstring.h"
 #include "libavutil/libm.h"
 #include "libavformat/os_support.h"
@@ -80,6 +81,10 @@
 #endif
 #include <time.h>
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "cmdutils.h"
 
 #include "libavutil/avassert.h"
@@ -239,6 +244,7 @@ static int using_stdin = 0;
 static int verbose = 1;
 static int run_as_daemon  = 0;
 static int thread_count= 1;
+static int pipeline_depth = 0;
 static int q_pressed = 0;
 static int64_t video_size = 0;
 static int64_t audio_size = 0;
@@ -261,6 +267,9 @@ static unsigned int allocated_audio_out_size, allocated_audio_buf_size, input_tm
 
 static short *samples;
 
+static int bit_buffer_size= 1024*256;
+static uint8_t *bit_buffer= NULL;
+
 static AVBitStreamFilterContext *video_bitstream_filters=NULL;
 static AVBitStreamFilterContext *audio_bitstream_filters=NULL;
 static AVBitStreamFilterContext *subtitle_bitstream_filters=NULL;
@@ -276,6 +285,7 @@ typedef struct {
     unsigned buf_index[MAX_AUDIO_CHANNEL_MAPS];
     unsigned sample_size; /* size of one sample */
     unsigned out_channels;
+    AVAudioShuffle *shuffle;
 } AudioMergeContext;
 
 typedef struct OutputStream {
@@ -342,6 +352,7 @@ typedef struct OutputStream {
 
    int sws_flags;
    AVDictionary *opts;
+   struct EncodeThread *encode_thread; /* set if the encoder runs in its own thread */
 } OutputStream;
 
 static OutputStream **output_streams_for_file[MAX_FILES] = { NULL };
@@ -353,6 +364,7 @@ typedef struct InputStream {
     int discard;             /* true if stream data should be discarded */
     int decoding_needed;     /* true if the packets must be decoded in 'raw_fifo' */
     AVCodec *dec;
+    AVCodecContext *dec_ctx; /* st->codec, or a copy if demuxing runs in its own thread */
 
     int64_t       start;     /* time when read started */
     int64_t       next_pts;  /* synthetic pts for cases where pkt.pts
@@ -366,6 +378,18 @@ typedef struct InputStream {
     AVDictionary *opts;
     uint8_t *pkt_data_to_free;
     AVRational frame_rate;
+#if CONFIG_AVFILTER
+    AVFilterContext *dr1_filter; ///< buffer source the decoder renders into
+#endif
+    /* decoded audio split into channels, shared by all channel mappings */
+    AVAudioShuffle *audio_shuffle;
+    uint8_t *audio_planes[MAX_AUDIO_CHANNEL_MAPS];
+    uint8_t *audio_planar_buf;
+    unsigned audio_planar_buf_size;
+    int64_t audio_frame_num;         ///< number of decoded audio frames
+    int64_t audio_planar_frame;      ///< audio_frame_num audio_planes were split from
+    const uint8_t *audio_planar_src; ///< samples audio_planes were split from
+    int audio_planar_samples;
 } InputStream;
 
 typedef struct InputFile {
@@ -374,6 +398,13 @@ typedef struct InputFile {
     int ist_index;        /* index of first stream in ist_table */
     int buffer_size;      /* current total buffer size */
     int64_t ts_offset;
+#if HAVE_PTHREADS
+    AVFifoBuffer *fifo;   /* packets read ahead by the demuxing thread */
+    pthread_t thread;
+    pthread_cond_t fifo_cond; /* signalled when the fifo has room */
+    int thread_ret;       /* error or EOF which ended the demuxing thread */
+    int thread_stop;
+#endif
 } InputFile;
 
 #if HAVE_TERMIOS_H
@@ -389,6 +420,91 @@ static int         nb_input_files   = 0;
 
 #if CONFIG_AVFILTER
 
+/**
+ * Let the decoder render directly into buffers of the link following the
+ * buffer source, decoded pictures are then fed to the filters by reference.
+ */
+static int filter_get_buffer(AVCodecContext *codec, AVFrame *pic)
+{
+    InputStream *ist = codec->opaque;
+    AVFilterLink *link = ist->dr1_filter->outputs[0];
+    AVFilterBufferRef *ref;
+    int perms = AV_PERM_WRITE;
+    int i, w, h, stride[4];
+    unsigned edge;
+    int pixel_size;
+
+    if (codec->width != link->w || codec->height != link->h ||
+        codec->pix_fmt != link->format)
+        return avcodec_default_get_buffer(codec, pic);
+    /* 8 bit dnxhd may decode an alpha coding unit into the extra plane
+       only the default allocator provides */
+    if (codec->codec_id == CODEC_ID_DNXHD && codec->pix_fmt == PIX_FMT_YUV422P)
+        return avcodec_default_get_buffer(codec, pic);
+
+    if (codec->codec->capabilities & CODEC_CAP_NEG_LINESIZES)
+        perms |= AV_PERM_NEG_LINESIZES;
+
+    if (pic->buffer_hints & FF_BUFFER_HINTS_VALID) {
+        if (pic->buffer_hints & FF_BUFFER_HINTS_READABLE) perms |= AV_PERM_READ;
+        if (pic->buffer_hints & FF_BUFFER_HINTS_PRESERVE) perms |= AV_PERM_PRESERVE;
+        if (pic->buffer_hints & FF_BUFFER_HINTS_REUSABLE) perms |= AV_PERM_REUSE2;
+    }
+    if (pic->reference) perms |= AV_PERM_READ | AV_PERM_PRESERVE;
+
+    w = codec->width;
+    h = codec->height;
+
+    if (av_image_check_size(w, h, 0, codec))
+        return -1;
+
+    avcodec_align_dimensions2(codec, &w, &h, stride);
+    edge = codec->flags & CODEC_FLAG_EMU_EDGE ? 0 : avcodec_get_edge_width();
+    w += edge << 1;
+    h += edge << 1;
+    /* one more line leaves room for aligning the planes past the edges */
+    if (edge)
+        h++;
+
+    /* the default allocator is used on purpose: filters with their own
+       get_video_buffer() do not expect the padded dimensions */
+    if (!(ref = avfilter_default_get_video_buffer(link, perms, w, h)))
+        return -1;
+
+    pixel_size = av_pix_fmt_descriptors[ref->format].comp[0].step_minus1+1;
+    ref->video->w = codec->width;
+    ref->video->h = codec->height;
+    for (i = 0; i < 4; i++) {
+        unsigned hshift = (i == 1 || i == 2) ? av_pix_fmt_descriptors[ref->format].log2_chroma_w : 0;
+        unsigned vshift = (i == 1 || i == 2) ? av_pix_fmt_descriptors[ref->format].log2_chroma_h : 0;
+
+        /* no edge if not planar YUV, like avcodec_default_get_buffer(), and
+           keep the 16 byte alignment of lavfi buffers for SIMD filters */
+        if (ref->data[i] && ref->data[2])
+            ref->data[i] += FFALIGN(((edge * ref->linesize[i]) >> vshift) +
+                                    ((edge * pixel_size) >> hshift), FFMAX(stride[i], 16));
+        pic->data[i]     = ref->data[i];
+        pic->linesize[i] = ref->linesize[i];
+    }
+    pic->opaque = ref;
+    pic->age    = INT_MAX;
+    pic->type   = FF_BUFFER_TYPE_USER;
+    pic->reordered_opaque = codec->reordered_opaque;
+    if (codec->pkt) pic->pkt_pts = codec->pkt->pts;
+    else            pic->pkt_pts = AV_NOPTS_VALUE;
+    return 0;
+}
+
+static void filter_release_buffer(AVCodecContext *codec, AVFrame *pic)
+{
+    if (pic->type != FF_BUFFER_TYPE_USER) {
+        avcodec_default_release_buffer(codec, pic);
+        return;
+    }
+    memset(pic->data, 0, sizeof(pic->data));
+    avfilter_unref_buffer(pic->opaque);
+}
+
 static int configure_video_filters(InputStream *ist, OutputStream *ost)
 {
     AVFilterContext *last_filter, *filter;
@@ -402,6 +518,7 @@ static int configure_video_filters(InputStream *ist, OutputStream *ost)
     int ret;
 
     ost->graph = avfilter_graph_alloc();
+    ost->graph->thread_count = thread_count;
 
     if (ist->st->sample_aspect_ratio.num)
         sample_aspect_ratio = ist->st->sample_aspect_ratio;
@@ -576,16 +693,23 @@ static int read_key(void)
     return -1;
 }
 
+/* set while waiting for the demuxing threads to end */
+static volatile int pipeline_abort = 0;
+
 static int decode_interrupt_cb(void)
 {
     q_pressed += read_key() == 'q';
-    return q_pressed > 1;
+    return q_pressed > 1 || pipeline_abort;
 }
 
+static void free_pipeline(void);
+
 static int ffmpeg_exit(int ret)
 {
     int i;
 
+    free_pipeline();
+
     /* close files */
     for(i=0;i<nb_output_files;i++) {
         AVFormatContext *s = output_files[i];
@@ -836,6 +960,505 @@ static void write_frame(AVFormatContext *s, AVPacket *pkt, AVCodecContext *avctx
     }
 }
 
+#if CONFIG_AVFILTER
+/* the filter buffer holding the data of frame, if it comes out of the graph */
+static AVFilterBufferRef *get_frame_picref(OutputStream *ost, const AVFrame *frame)
+{
+    if (ost->picref && ost->picref->data[0] == frame->data[0])
+        return ost->picref;
+    if (ost->prev_picref && ost->prev_picref->data[0] == frame->data[0])
+        return ost->prev_picref;
+    return NULL;
+}
+
+/* let frame threaded encoders keep filter buffers by reference */
+static int encoder_ref_picture(AVCodecContext *enc, AVFrame *pic)
+{
+    if (!pic->opaque || !(pic->opaque = avfilter_ref_buffer(pic->opaque, ~AV_PERM_WRITE)))
+        return -1;
+    return 0;
+}
+
+static void encoder_release_picture(AVCodecContext *enc, AVFrame *pic)
+{
+    avfilter_unref_buffer(pic->opaque);
+}
+#endif
+
+/*
+ * Threaded transcoding pipeline
+ *
+ * Every input file is demuxed by its own thread into a bounded packet fifo
+ * and every audio or video encoder runs in its own thread, fed by a bounded
+ * job queue. Decoding, filtering and A/V sync stay on the main thread, which
+ * also muxes: every packet goes through mux_queue in the order the
+ * sequential code would have written it, and the head of the queue is only
+ * written once its encoder is done with it.
+ */
+#if HAVE_PTHREADS
+
+typedef struct EncodeJob {
+    struct EncodeJob *next;        /* next job in muxing order */
+    struct EncodeJob *next_queued; /* next job in the encoder queue */
+    AVFormatContext *s;
+    OutputStream *ost;
+    int encode;                    /* pkt has to be encoded by the thread */
+    int done;                      /* pkt is ready to be written */
+    int ret;                       /* encoder return value */
+    AVPacket pkt;
+    AVFrame frame;                 /* video frame to encode */
+#if CONFIG_AVFILTER
+    AVFilterBufferRef *picref;     /* keeps the frame data alive */
+#endif
+    int free_frame;                /* frame data is a copy owned by the job */
+    uint8_t *samples;              /* audio samples to encode */
+    int buf_size;                  /* audio output buffer size */
+    AVFrame coded_frame;           /* encoder coded_frame after encoding */
+} EncodeJob;
+
+typedef struct EncodeThread {
+    struct EncodeThread *next;
+    OutputStream *ost;
+    pthread_t thread;
+    pthread_cond_t cond;           /* signalled when a job is queued */
+    EncodeJob *jobs, **jobs_tail;
+    int nb_jobs;                   /* queued and running jobs */
+    int stop;
+    uint8_t *buf;                  /* encoder output buffer */
+    unsigned int buf_size;
+    AVFrame coded_frame;           /* coded_frame of the last packet written */
+} EncodeThread;
+
+static pthread_mutex_t pipeline_lock = PTHREAD_MUTEX_INITIALIZER;
+/* signalled when a job is done or a demuxed packet is available */
+static pthread_cond_t pipeline_cond = PTHREAD_COND_INITIALIZER;
+static EncodeThread *encode_threads;
+static EncodeJob *mux_queue, **mux_queue_tail = &mux_queue;
+
+static void *input_thread(void *arg)
+{
+    InputFile *f = arg;
+    int stop;
+
+    do {
+        AVPacket pkt;
+        int ret = av_read_frame(f->ctx, &pkt);
+
+        if (ret == AVERROR(EAGAIN))
+            usleep(10000);
+        else if (ret >= 0 && (ret = av_dup_packet(&pkt)) < 0)
+            av_free_packet(&pkt);
+
+        pthread_mutex_lock(&pipeline_lock);
+        if (ret >= 0) {
+            while (!av_fifo_space(f->fifo) && !f->thread_stop)
+                pthread_cond_wait(&f->fifo_cond, &pipeline_lock);
+            if (f->thread_stop)
+                av_free_packet(&pkt);
+            else
+                av_fifo_generic_write(f->fifo, &pkt, sizeof(pkt), NULL);
+        } else if (ret != AVERROR(EAGAIN)) {
+            f->thread_ret = ret;
+        }
+        pthread_cond_signal(&pipeline_cond);
+        stop = f->thread_stop || f->thread_ret;
+        pthread_mutex_unlock(&pipeline_lock);
+    } while (!stop);
+
+    return NULL;
+}
+
+static void encode_job(EncodeThread *t, EncodeJob *job)
+{
+    OutputStream *ost = t->ost;
+    AVCodecContext *enc = ost->st->codec;
+    int size = enc->codec_type == AVMEDIA_TYPE_VIDEO ? bit_buffer_size : job->buf_size;
+
+    av_fast_malloc(&t->buf, &t->buf_size, size);
+    if (!t->buf) {
+        job->ret = AVERROR(ENOMEM);
+        return;
+    }
+
+    if (enc->codec_type == AVMEDIA_TYPE_VIDEO)
+        job->ret = avcodec_encode_video(enc, t->buf, size, &job->frame);
+    else
+        job->ret = avcodec_encode_audio(enc, t->buf, size, (short *)job->samples);
+    if (job->ret < 0)
+        return;
+
+    if (av_new_packet(&job->pkt, job->ret) < 0) {
+        job->ret = AVERROR(ENOMEM);
+        return;
+    }
+    memcpy(job->pkt.data, t->buf, job->ret);
+    job->pkt.stream_index = ost->index;
+    if (enc->coded_frame) {
+        job->coded_frame = *enc->coded_frame;
+        if (enc->coded_frame->pts != AV_NOPTS_VALUE)
+            job->pkt.pts = av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
+    }
+    if (enc->codec_type == AVMEDIA_TYPE_AUDIO || job->coded_frame.key_frame)
+        job->pkt.flags |= AV_PKT_FLAG_KEY;
+
+    if (enc->codec_type == AVMEDIA_TYPE_VIDEO && job->ret > 0 &&
+        ost->logfile && enc->stats_out)
+        fprintf(ost->logfile, "%s", enc->stats_out);
+}
+
+static void *encode_thread(void *arg)
+{
+    EncodeThread *t = arg;
+
+    pthread_mutex_lock(&pipeline_lock);
+    for (;;) {
+        EncodeJob *job;
+
+        while (!t->jobs && !t->stop)
+            pthread_cond_wait(&t->cond, &pipeline_lock);
+        if (t->stop)
+            break;
+        job = t->jobs;
+        pthread_mutex_unlock(&pipeline_lock);
+
+        encode_job(t, job);
+
+        pthread_mutex_lock(&pipeline_lock);
+        t->jobs = job->next_queued;
+        if (!t->jobs)
+            t->jobs_tail = &t->jobs;
+        t->nb_jobs--;
+        job->done = 1;
+        pthread_cond_signal(&pipeline_cond);
+    }
+    pthread_mutex_unlock(&pipeline_lock);
+
+    return NULL;
+}
+
+static void free_job(EncodeJob *job)
+{
+#if CONFIG_AVFILTER
+    if (job->picref)
+        avfilter_unref_buffer(job->picref);
+#endif
+    if (job->free_frame)
+        av_free(job->frame.data[0]);
+    av_free(job->samples);
+    av_free_packet(&job->pkt);
+    av_free(job);
+}
+
+/* append a job to the muxing queue, and to its encoder queue if needed */
+static void queue_job(EncodeJob *job)
+{
+    EncodeThread *t = job->ost->encode_thread;
+
+    pthread_mutex_lock(&pipeline_lock);
+    if (job->encode) {
+        while (t->nb_jobs >= pipeline_depth)
+            pthread_cond_wait(&pipeline_cond, &pipeline_lock);
+        *t->jobs_tail = job;
+        t->jobs_tail = &job->next_queued;
+        t->nb_jobs++;
+        pthread_cond_signal(&t->cond);
+    }
+    *mux_queue_tail = job;
+    mux_queue_tail = &job->next;
+    pthread_mutex_unlock(&pipeline_lock);
+}
+
+static void write_job(EncodeJob *job)
+{
+    OutputStream *ost = job->ost;
+    AVCodecContext *enc = ost->st->codec;
+
+    if (!job->encode) {
+        write_frame(job->s, &job->pkt, enc, ost->bitstream_filters);
+        return;
+    }
+
+    if (job->ret < 0) {
+        fprintf(stderr, "%s encoding failed\n",
+                enc->codec_type == AVMEDIA_TYPE_VIDEO ? "Video" : "Audio");
+        ffmpeg_exit(1);
+    }
+    ost->encode_thread->coded_frame = job->coded_frame;
+    if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
+        if (job->ret > 0) {
+            write_frame(job->s, &job->pkt, enc, ost->bitstream_filters);
+            video_size += job->ret;
+        }
+    } else {
+        audio_size += job->ret;
+        write_frame(job->s, &job->pkt, enc, ost->bitstream_filters);
+    }
+}
+#endif
+
+/**
+ * Write the packets at the head of the muxing queue whose encoding is done.
+ * @param wait if set, wait for the encoders to empty the whole queue
+ */
+static void write_queued_packets(int wait)
+{
+#if HAVE_PTHREADS
+    EncodeJob *job;
+
+    while ((job = mux_queue)) {
+        int done;
+
+        pthread_mutex_lock(&pipeline_lock);
+        while (wait && !job->done)
+            pthread_cond_wait(&pipeline_cond, &pipeline_lock);
+        done = job->done;
+        pthread_mutex_unlock(&pipeline_lock);
+        if (!done)
+            break;
+
+        mux_queue = job->next;
+        if (!mux_queue)
+            mux_queue_tail = &mux_queue;
+        write_job(job);
+        free_job(job);
+    }
+#endif
+}
+
+/* write a packet, after the packets that are still being encoded */
+static void output_frame(AVFormatContext *s, OutputStream *ost, AVPacket *pkt)
+{
+#if HAVE_PTHREADS
+    if (mux_queue) {
+        EncodeJob *job;
+
+        if (ost->st->codec->codec_type == AVMEDIA_TYPE_VIDEO &&
+            s->oformat->flags & AVFMT_RAWPICTURE) {
+            /* the AVPicture points to frame data about to be reused */
+            write_queued_packets(1);
+        } else {
+            job = av_mallocz(sizeof(*job));
+            if (job) {
+                job->pkt = *pkt;
+                job->pkt.destruct = NULL;
+            }
+            if (!job || av_dup_packet(&job->pkt) < 0) {
+                fprintf(stderr, "Could not queue packet\n");
+                ffmpeg_exit(1);
+            }
+            job->s    = s;
+            job->ost  = ost;
+            job->done = 1;
+            queue_job(job);
+            return;
+        }
+    }
+#endif
+    write_frame(s, pkt, ost->st->codec, ost->bitstream_filters);
+}
+
+#if HAVE_PTHREADS
+static void queue_video_frame(AVFormatContext *s, OutputStream *ost, AVFrame *frame)
+{
+    AVCodecContext *enc = ost->st->codec;
+    EncodeJob *job = av_mallocz(sizeof(*job));
+
+    if (!job)
+        goto fail;
+    job->s      = s;
+    job->ost    = ost;
+    job->encode = 1;
+    job->frame  = *frame;
+#if CONFIG_AVFILTER
+    /* frames coming out of the filter graph are kept by reference */
+    if (frame->opaque)
+        job->picref = job->frame.opaque = avfilter_ref_buffer(frame->opaque, ~0);
+    if (!job->picref)
+#endif
+    {
+        AVPicture pict;
+
+        if (avpicture_alloc(&pict, enc->pix_fmt, enc->width, enc->height) < 0) {
+            av_free(job);
+            goto fail;
+        }
+        av_picture_copy(&pict, (AVPicture *)frame, enc->pix_fmt, enc->width, enc->height);
+        memcpy(job->frame.data,     pict.data,     sizeof(pict.data));
+        memcpy(job->frame.linesize, pict.linesize, sizeof(pict.linesize));
+        job->free_frame = 1;
+    }
+
+    queue_job(job);
+    write_queued_packets(0);
+    return;
+fail:
+    fprintf(stderr, "Could not queue video frame\n");
+    ffmpeg_exit(1);
+}
+
+static void queue_audio_frame(AVFormatContext *s, OutputStream *ost,
+                              int frame_bytes, int buf_size)
+{
+    EncodeJob *job = av_mallocz(sizeof(*job));
+
+    if (!job || !(job->samples = av_malloc(frame_bytes))) {
+        fprintf(stderr, "Could not queue audio frame\n");
+        ffmpeg_exit(1);
+    }
+    av_fifo_generic_read(ost->fifo, job->samples, frame_bytes, NULL);
+    job->s        = s;
+    job->ost      = ost;
+    job->encode   = 1;
+    job->buf_size = buf_size;
+
+    queue_job(job);
+    write_queued_packets(0);
+}
+#endif
+
+/* read a packet from the demuxing thread of the file if it has one */
+static int get_input_packet(InputFile *f, AVPacket *pkt)
+{
+#if HAVE_PTHREADS
+    if (f->fifo) {
+        int ret = 0;
+
+        pthread_mutex_lock(&pipeline_lock);
+        while (!av_fifo_size(f->fifo) && !f->thread_ret)
+            pthread_cond_wait(&pipeline_cond, &pipeline_lock);
+        if (av_fifo_size(f->fifo)) {
+            av_fifo_generic_read(f->fifo, pkt, sizeof(*pkt), NULL);
+            pthread_cond_signal(&f->fifo_cond);
+        } else
+            ret = f->thread_ret;
+        pthread_mutex_unlock(&pipeline_lock);
+        return ret;
+    }
+#endif
+    return av_read_frame(f->ctx, pkt);
+}
+
+static void init_pipeline(OutputStream **ost_table, int nb_ostreams)
+{
+#if HAVE_PTHREADS
+    int i;
+
+    if (pipeline_depth <= 0)
+        return;
+
+    for (i = 0; i < nb_input_files; i++) {
+        InputFile *f = &input_files[i];
+
+        f->fifo = av_fifo_alloc(pipeline_depth * FFMAX(f->ctx->nb_streams, 1) * sizeof(AVPacket));
+        if (!f->fifo)
+            continue;
+        pthread_cond_init(&f->fifo_cond, NULL);
+        if (pthread_create(&f->thread, NULL, input_thread, f)) {
+            pthread_cond_destroy(&f->fifo_cond);
+            av_fifo_free(f->fifo);
+            f->fifo = NULL;
+        }
+    }
+
+    for (i = 0; i < nb_ostreams; i++) {
+        OutputStream *ost = ost_table[i];
+        AVCodecContext *enc = ost->st->codec;
+        EncodeThread *t;
+
+        if (!ost->encoding_needed)
+            continue;
+        /* raw pictures are muxed straight from the frame data, vstats
+           need the coded frame of the last packet and pcm is just a copy */
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
+            if (output_files[ost->file_index]->oformat->flags & AVFMT_RAWPICTURE ||
+                vstats_filename)
+                continue;
+        } else if (enc->codec_type != AVMEDIA_TYPE_AUDIO || enc->frame_size <= 1)
+            continue;
+
+        t = av_mallocz(sizeof(*t));
+        if (!t)
+            continue;
+        t->ost       = ost;
+        t->jobs_tail = &t->jobs;
+        pthread_cond_init(&t->cond, NULL);
+        if (pthread_create(&t->thread, NULL, encode_thread, t)) {
+            pthread_cond_destroy(&t->cond);
+            av_free(t);
+            continue;
+        }
+        t->next = encode_threads;
+        encode_threads = t;
+        ost->encode_thread = t;
+    }
+#endif
+}
+
+static void free_pipeline(void)
+{
+#if HAVE_PTHREADS
+    EncodeThread *t;
+    EncodeJob *job;
+    int i;
+
+    /* interrupt the reads the demuxing threads may be blocked in */
+    pipeline_abort = 1;
+    for (i = 0; i < nb_input_files; i++) {
+        InputFile *f = &input_files[i];
+        AVPacket pkt;
+
+        if (!f->fifo)
+            continue;
+        pthread_mutex_lock(&pipeline_lock);
+        f->thread_stop = 1;
+        pthread_cond_signal(&f->fifo_cond);
+        pthread_mutex_unlock(&pipeline_lock);
+        pthread_join(f->thread, NULL);
+
+        while (av_fifo_size(f->fifo)) {
+            av_fifo_generic_read(f->fifo, &pkt, sizeof(pkt), NULL);
+            av_free_packet(&pkt);
+        }
+        av_fifo_free(f->fifo);
+        f->fifo = NULL;
+        pthread_cond_destroy(&f->fifo_cond);
+    }
+    pipeline_abort = 0;
+
+    for (t = encode_threads; t; t = t->next) {
+        pthread_mutex_lock(&pipeline_lock);
+        t->stop = 1;
+        pthread_cond_signal(&t->cond);
+        pthread_mutex_unlock(&pipeline_lock);
+        pthread_join(t->thread, NULL);
+    }
+
+    while ((job = mux_queue)) {
+        mux_queue = job->next;
+        free_job(job);
+    }
+    mux_queue_tail = &mux_queue;
+
+    while ((t = encode_threads)) {
+        encode_threads = t->next;
+        t->ost->encode_thread = NULL;
+        pthread_cond_destroy(&t->cond);
+        av_free(t->buf);
+        av_free(t);
+    }
+#endif
+}
+
+/* coded frame of the last packet written for the stream */
+static AVFrame *get_coded_frame(OutputStream *ost)
+{
+#if HAVE_PTHREADS
+    if (ost->encode_thread)
+        return &ost->encode_thread->coded_frame;
+#endif
+    return ost->st->codec->coded_frame;
+}
+
 static int audiomerge_init(AudioMergeContext *a, int out_channels, int sample_size)
 {
     int i;
@@ -850,6 +1473,9 @@ static int audiomerge_init(AudioMergeContext *a, int out_channels, int sample_si
     a->buf = av_malloc(a->buf_size);
     if (!a->buf)
         return AVERROR(ENOMEM);
+    a->shuffle = av_audio_shuffle_alloc(sample_size);
+    if (!a->shuffle)
+        return AVERROR(ENOMEM);
 
     for (i = 0; i < out_channels; i++)
         a->buf_index[i] = i*sample_size;
@@ -857,42 +1483,95 @@ static int audiomerge_init(AudioMergeContext *a, int out_channels, int sample_si
     return 0;
 }
 
-static int audiomerge_add_channel(AudioMergeContext *a, uint8_t *input,
-                                  unsigned in_channel, unsigned out_channel,
-                                  unsigned in_channels, unsigned samples)
+/* split the decoded samples of ist into channels, once for all outputs */
+static int audiomerge_split_input(InputStream *ist, const uint8_t *input, unsigned samples)
 {
-    if (out_channel >= a->out_channels)
-        return -1;
+    AVCodecContext *dec = ist->dec_ctx;
+    int isize = av_get_bytes_per_sample(dec->sample_fmt);
+    int i;
 
-    //fprintf(stderr, "in channel %d out channel %d samples %d\n", in_channel, out_channel, samples);
-
-    if (a->buf_index[out_channel] +
-        (int64_t)samples*a->sample_size*a->out_channels >= a->buf_size) {
-        uint8_t *buf;
-        if (a->buf_size + (int64_t)samples*a->sample_size*a->out_channels >= UINT_MAX)
-            goto error;
-        a->buf_size += (int64_t)samples*a->sample_size*a->out_channels;
-        buf = av_realloc(a->buf, a->buf_size);
-        if (!buf) {
-        error:
-            fprintf(stderr, "error reallocating audiomerge buffer\n");
-            return -1;
-        }
-        a->buf = buf;
-    }
+    /* the sync code may pass each output a different part of the frame */
+    if (ist->audio_planar_frame == ist->audio_frame_num &&
+        ist->audio_planar_samples == samples && ist->audio_planar_src == input)
+        return 0;
 
-    input += a->sample_size*in_channel;
-    while (samples--) {
-        memcpy(a->buf + a->buf_index[out_channel], input, a->sample_size);
-        a->buf_index[out_channel] += a->sample_size*a->out_channels;
-        input += a->sample_size*in_channels;
+    if (dec->channels > MAX_AUDIO_CHANNEL_MAPS)
+        return -1;
+    if (!ist->audio_shuffle) {
+        ist->audio_shuffle = av_audio_shuffle_alloc(isize);
+        if (!ist->audio_shuffle)
+            return -1;
     }
+    av_fast_malloc(&ist->audio_planar_buf, &ist->audio_planar_buf_size,
+                   (int64_t)samples*isize*dec->channels);
+    if (!ist->audio_planar_buf)
+        return -1;
+    for (i = 0; i < dec->channels; i++)
+        ist->audio_planes[i] = ist->audio_planar_buf + i*samples*isize;
 
-    a->last_sample_pos = FFMAX(a->buf_index[out_channel], a->last_sample_pos);
+    av_audio_deinterleave(ist->audio_shuffle, ist->audio_planes, input,
+                          dec->channels, samples);
 
+    ist->audio_planar_frame   = ist->audio_frame_num;
+    ist->audio_planar_src     = input;
+    ist->audio_planar_samples = samples;
     return 0;
 }
 
+/**
+ * Add samples to the merge buffer, planes[i] is written to output channel i,
+ * NULL entries are not touched. planes is reset to NULL.
+ */
+static int audiomerge_add_channels(AudioMergeContext *a, const uint8_t **planes,
+                                   unsigned samples)
+{
+    const uint8_t *group[MAX_AUDIO_CHANNEL_MAPS];
+    unsigned frame_size = a->sample_size*a->out_channels;
+    int i;
+
+    /* channels filled up to the same sample are interleaved in one pass */
+    for (;;) {
+        unsigned pos = UINT_MAX;
+
+        for (i = 0; i < a->out_channels; i++) {
+            group[i] = NULL;
+            if (!planes[i])
+                continue;
+            if (pos == UINT_MAX)
+                pos = a->buf_index[i] / frame_size;
+            if (a->buf_index[i] / frame_size == pos) {
+                group[i]  = planes[i];
+                planes[i] = NULL;
+            }
+        }
+        if (pos == UINT_MAX)
+            return 0;
+
+        if ((int64_t)pos*frame_size + (int64_t)samples*frame_size >= a->buf_size) {
+            uint8_t *buf;
+            if (a->buf_size + (int64_t)samples*frame_size >= UINT_MAX)
+                goto error;
+            a->buf_size += (int64_t)samples*frame_size;
+            buf = av_realloc(a->buf, a->buf_size);
+            if (!buf) {
+            error:
+                fprintf(stderr, "error reallocating audiomerge buffer\n");
+                return -1;
+            }
+            a->buf = buf;
+        }
+
+        av_audio_interleave(a->shuffle, a->buf + pos*frame_size, group,
+                            a->out_channels, samples);
+
+        for (i = 0; i < a->out_channels; i++) {
+            if (!group[i])
+                continue;
+            a->buf_index[i] += samples*frame_size;
+            a->last_sample_pos = FFMAX(a->buf_index[i], a->last_sample_pos);
+        }
+    }
+}
 
 static unsigned audiomerge_complete_size(AudioMergeContext *a)
 {
@@ -948,7 +1627,7 @@ static void do_audio_out(AVFormatContext *s,
     int64_t audio_out_size, audio_buf_size;
     int size_out, frame_bytes, ret, resample_changed, i, in_channels;
     AVCodecContext *enc= ost->st->codec;
-    AVCodecContext *dec= ist->st->codec;
+    AVCodecContext *dec= ist->dec_ctx;
     int osize = av_get_bytes_per_sample(enc->sample_fmt);
     int isize = av_get_bytes_per_sample(dec->sample_fmt);
     const int coded_bps = av_get_bits_per_sample(enc->codec->id);
@@ -991,8 +1670,6 @@ static void do_audio_out(AVFormatContext *s,
             ost->audio_resample = 0;
         } else {
             ost->audio_resample = 1;
-            if (dec->sample_fmt != AV_SAMPLE_FMT_S16 && enc->sample_fmt != AV_SAMPLE_FMT_S16)
-                fprintf(stderr, "Warning, using s16 intermediate sample format for resampling\n");
             ost->resample = av_audio_resample_init(enc->channels,    in_channels,
                                                    enc->sample_rate, dec->sample_rate,
                                                    enc->sample_fmt,  dec->sample_fmt,
@@ -1047,7 +1724,7 @@ static void do_audio_out(AVFormatContext *s,
                     buf  -= byte_delta;
                     if(verbose > 0)
                         fprintf(stderr, "discarding %d audio samples in stream #%d.%d\n",
-                                -byte_delta/(isize*ist->st->codec->channels),
+                                -byte_delta/(isize*ist->dec_ctx->channels),
                                 ist->file_index, ist->st->index);
                     if(!size)
                         return;
@@ -1064,7 +1741,7 @@ static void do_audio_out(AVFormatContext *s,
                     size += byte_delta;
                     if(verbose > 0)
                         fprintf(stderr, "adding %d audio samples in stream #%d.%d\n",
-                                byte_delta/(isize*ist->st->codec->channels),
+                                byte_delta/(isize*ist->dec_ctx->channels),
                                 ist->file_index, ist->st->index);
                 }
             }else if(audio_sync_method>1){
@@ -1104,19 +1781,29 @@ static void do_audio_out(AVFormatContext *s,
     }
 
     if (ost->nb_audio_channel_maps > 0) {
+        const uint8_t *planes[MAX_AUDIO_CHANNEL_MAPS] = { NULL };
+        unsigned samples = size/(isize*dec->channels);
+
+        if (audiomerge_split_input(ist, buf, samples) < 0) {
+            fprintf(stderr, "audiomerge failed\n");
+            ffmpeg_exit(1);
+        }
         for (i = 0; i < ost->nb_audio_channel_maps; i++) {
-            if (ost->audio_channel_maps[i]->file_index == ist->file_index &&
-                ost->audio_channel_maps[i]->stream_index == ist->st->index) {
-                if (audiomerge_add_channel(&ost->audiomerge, buf,
-                                           ost->audio_channel_maps[i]->channel_index,
-                                           ost->audio_channel_maps[i]->out_channel_index,
-                                           dec->channels,
-                                           size/(isize*dec->channels)) < 0) {
+            AudioChannelMap *m = ost->audio_channel_maps[i];
+            if (m->file_index == ist->file_index &&
+                m->stream_index == ist->st->index) {
+                if (m->channel_index >= dec->channels ||
+                    m->out_channel_index >= ost->audiomerge.out_channels) {
                     fprintf(stderr, "audiomerge failed\n");
                     ffmpeg_exit(1);
                 }
+                planes[m->out_channel_index] = ist->audio_planes[m->channel_index];
             }
         }
+        if (audiomerge_add_channels(&ost->audiomerge, planes, samples) < 0) {
+            fprintf(stderr, "audiomerge failed\n");
+            ffmpeg_exit(1);
+        }
         buftmp = ost->audiomerge.buf;
         size_out = audiomerge_complete_size(&ost->audiomerge);
         if (!size_out)
@@ -1165,6 +1852,13 @@ static void do_audio_out(AVFormatContext *s,
             AVPacket pkt;
             av_init_packet(&pkt);
 
+#if HAVE_PTHREADS
+            if (ost->encode_thread) {
+                queue_audio_frame(s, ost, frame_bytes, audio_out_size);
+                ost->sync_opts += enc->frame_size;
+                continue;
+            }
+#endif
             av_fifo_generic_read(ost->fifo, audio_buf, frame_bytes, NULL);
 
             //FIXME pass ost->sync_opts as AVFrame.pts in avcodec_encode_audio()
@@ -1182,7 +1876,7 @@ static void do_audio_out(AVFormatContext *s,
             if(enc->coded_frame && enc->coded_frame->pts != AV_NOPTS_VALUE)
                 pkt.pts= av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
             pkt.flags |= AV_PKT_FLAG_KEY;
-            write_frame(s, &pkt, enc, ost->bitstream_filters);
+            output_frame(s, ost, &pkt);
 
             ost->sync_opts += enc->frame_size;
         }
@@ -1217,7 +1911,7 @@ static void do_audio_out(AVFormatContext *s,
         if(enc->coded_frame && enc->coded_frame->pts != AV_NOPTS_VALUE)
             pkt.pts= av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
         pkt.flags |= AV_PKT_FLAG_KEY;
-        write_frame(s, &pkt, enc, ost->bitstream_filters);
+        output_frame(s, ost, &pkt);
     }
 
     if (ost->nb_audio_channel_maps > 0)
@@ -1288,13 +1982,10 @@ static void do_subtitle_out(AVFormatContext *s,
             else
                 pkt.pts += 90 * sub->end_display_time;
         }
-        write_frame(s, &pkt, ost->st->codec, ost->bitstream_filters);
+        output_frame(s, ost, &pkt);
     }
 }
 
-static int bit_buffer_size= 1024*256;
-static uint8_t *bit_buffer= NULL;
-
 static void encode_frame(AVFormatContext *s,
                          OutputStream *ost, InputStream *ist, int nb_frames,
                          AVFrame *frame, int *frame_size, int quality)
@@ -1317,7 +2008,7 @@ static void encode_frame(AVFormatContext *s,
             pkt.pts = av_rescale_q(ost->sync_opts, enc->time_base, ost->st->time_base);
             pkt.flags |= AV_PKT_FLAG_KEY;
 
-            write_frame(s, &pkt, ost->st->codec, ost->bitstream_filters);
+            output_frame(s, ost, &pkt);
             video_size += avpicture_get_size(enc->pix_fmt, enc->width, enc->height);
         } else {
             /* handles sameq here. This is not correct because it may
@@ -1325,33 +2016,43 @@ static void encode_frame(AVFormatContext *s,
             frame->quality = quality;
             frame->pict_type = 0;
             frame->pts = ost->sync_opts;
+#if CONFIG_AVFILTER
+            frame->opaque = get_frame_picref(ost, frame);
+#endif
 
             if (ost->forced_kf_index < ost->forced_kf_count &&
                 frame->pts >= ost->forced_kf_pts[ost->forced_kf_index]) {
                 frame->pict_type = FF_I_TYPE;
                 ost->forced_kf_index++;
             }
-            ret = avcodec_encode_video(enc,
-                                       bit_buffer, bit_buffer_size,
-                                       frame);
-            if (ret < 0) {
-                fprintf(stderr, "Video encoding failed\n");
-                ffmpeg_exit(1);
-            }
+#if HAVE_PTHREADS
+            if (ost->encode_thread) {
+                queue_video_frame(s, ost, frame);
+            } else
+#endif
+            {
+                ret = avcodec_encode_video(enc,
+                                           bit_buffer, bit_buffer_size,
+                                           frame);
+                if (ret < 0) {
+                    fprintf(stderr, "Video encoding failed\n");
+                    ffmpeg_exit(1);
+                }
 
-            if (ret > 0) {
-                pkt.data = bit_buffer;
-                pkt.size = ret;
-                if (enc->coded_frame->pts != AV_NOPTS_VALUE)
-                    pkt.pts = av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
-
-                if (enc->coded_frame->key_frame)
-                    pkt.flags |= AV_PKT_FLAG_KEY;
-                write_frame(s, &pkt, ost->st->codec, ost->bitstream_filters);
-                *frame_size = ret;
-                video_size += ret;
-                if (ost->logfile && enc->stats_out) {
-                    fprintf(ost->logfile, "%s", enc->stats_out);
+                if (ret > 0) {
+                    pkt.data = bit_buffer;
+                    pkt.size = ret;
+                    if (enc->coded_frame->pts != AV_NOPTS_VALUE)
+                        pkt.pts = av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
+
+                    if (enc->coded_frame->key_frame)
+                        pkt.flags |= AV_PKT_FLAG_KEY;
+                    output_frame(s, ost, &pkt);
+                    *frame_size = ret;
+                    video_size += ret;
+                    if (ost->logfile && enc->stats_out) {
+                        fprintf(ost->logfile, "%s", enc->stats_out);
+                    }
                 }
             }
         }
@@ -1419,8 +2120,8 @@ static void do_video_out(AVFormatContext *s, OutputStream *ost, InputStream *ist
 
     if (vsync_method && vsync_method != 3) {
         double vdelta;
-        if (ist->dts_is_reordered_pts && ist->st->codec->has_b_frames > 0)
-            sync_ipts -= ist->st->codec->has_b_frames;
+        if (ist->dts_is_reordered_pts && ist->dec_ctx->has_b_frames > 0)
+            sync_ipts -= ist->dec_ctx->has_b_frames;
         vdelta = sync_ipts - ost->sync_opts;
         if (vdelta <= -0.6)
             nb_frames = 0;
@@ -1435,8 +2136,8 @@ static void do_video_out(AVFormatContext *s, OutputStream *ost, InputStream *ist
             fprintf(stderr, "vdelta:%f, ost->sync_opts:%"PRId64", ost->sync_ipts:%f nb_frames:%d\n",
                     vdelta, ost->sync_opts, get_sync_ipts(ost), nb_frames);
     } else if (!vsync_method) {
-        if (ist->dts_is_reordered_pts && ist->st->codec->has_b_frames > 0)
-            sync_ipts -= ist->st->codec->has_b_frames;
+        if (ist->dts_is_reordered_pts && ist->dec_ctx->has_b_frames > 0)
+            sync_ipts -= ist->dec_ctx->has_b_frames;
         ost->sync_opts= lrintf(sync_ipts);
     }
 
@@ -1521,7 +2222,7 @@ static void do_video_out(AVFormatContext *s, OutputStream *ost, InputStream *ist
     encode_frame(s, ost, ist, 1, &frame, &frame_size, quality);
     if (vstats_filename && frame_size)
         do_video_stats(ost, frame_size);
-    if (ist->st->codec->codec->capabilities & CODEC_CAP_DR1 || ost->picref) {
+    if (ist->dec_ctx->codec->capabilities & CODEC_CAP_DR1 || ost->picref) {
         ost->prev_frame = frame;
         if (ost->prev_picref)
             avfilter_unref_buffer(ost->prev_picref);
@@ -1539,6 +2240,7 @@ static void print_report(AVFormatContext **output_files,
     AVFormatContext *oc;
     int64_t total_size;
     AVCodecContext *enc;
+    AVFrame *coded_frame;
     int i, frame_diff;
     double bitrate;
     int64_t pts = INT64_MAX;
@@ -1576,9 +2278,10 @@ static void print_report(AVFormatContext **output_files,
         float q = -1;
         ost = ost_table[i];
         enc = ost->st->codec;
-        if (vst && enc->coded_frame && enc->codec_type == AVMEDIA_TYPE_VIDEO) {
+        coded_frame = get_coded_frame(ost);
+        if (vst && coded_frame && enc->codec_type == AVMEDIA_TYPE_VIDEO) {
             snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "q=%2.1f ",
-                     enc->coded_frame->quality/(float)FF_QP2LAMBDA);
+                     coded_frame->quality/(float)FF_QP2LAMBDA);
         }
         if (!vst && enc->codec_type == AVMEDIA_TYPE_VIDEO) {
             float t = elapsed_time / 1000000.0;
@@ -1587,9 +2290,9 @@ static void print_report(AVFormatContext **output_files,
             prev_frame_number = ost->frame_number;
             snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "frame=%5d fps=%3.0f ",
                      ost->frame_number, frame_diff / t);
-            if (enc->coded_frame) {
+            if (coded_frame) {
                 snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "q=%2.1f ",
-                         enc->coded_frame->quality/(float)FF_QP2LAMBDA);
+                         coded_frame->quality/(float)FF_QP2LAMBDA);
             }
             if(is_last_report)
                 snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "L");
@@ -1612,7 +2315,7 @@ static void print_report(AVFormatContext **output_files,
                         error= enc->error[j];
                         scale= enc->width*enc->height*255.0*255.0*ost->frame_number;
                     }else{
-                        error= enc->coded_frame->error[j];
+                        error= coded_frame->error[j];
                         scale= enc->width*enc->height*255.0*255.0;
                     }
                     if(j) scale/=4;
@@ -1717,7 +2420,7 @@ static int output_packet(InputStream *ist, int ist_index,
     float quality;
 
     AVPacket avpkt;
-    int bps = av_get_bytes_per_sample(ist->st->codec->sample_fmt);
+    int bps = av_get_bytes_per_sample(ist->dec_ctx->sample_fmt);
 
     if(ist->next_pts == AV_NOPTS_VALUE)
         ist->next_pts= ist->pts;
@@ -1760,7 +2463,7 @@ static int output_packet(InputStream *ist, int ist_index,
         data_size = avpkt.size;
         subtitle_to_free = NULL;
         if (ist->decoding_needed) {
-            switch(ist->st->codec->codec_type) {
+            switch(ist->dec_ctx->codec_type) {
             case AVMEDIA_TYPE_AUDIO:{
                 if(pkt && samples_size < FFMAX(pkt->size*sizeof(*samples), AVCODEC_MAX_AUDIO_FRAME_SIZE)) {
                     samples_size = FFMAX(pkt->size*sizeof(*samples), AVCODEC_MAX_AUDIO_FRAME_SIZE);
@@ -1770,7 +2473,7 @@ static int output_packet(InputStream *ist, int ist_index,
                 decoded_data_size= samples_size;
                     /* XXX: could avoid copy if PCM 16 bits with same
                        endianness as CPU */
-                ret = avcodec_decode_audio3(ist->st->codec, samples, &decoded_data_size,
+                ret = avcodec_decode_audio3(ist->dec_ctx, samples, &decoded_data_size,
                                             &avpkt);
                 if (ret < 0)
                     return ret;
@@ -1788,18 +2491,19 @@ static int output_packet(InputStream *ist, int ist_index,
                     continue;
                 }
                 decoded_data_buf = (uint8_t *)samples;
+                ist->audio_frame_num++;
                 ist->next_pts += ((int64_t)AV_TIME_BASE/bps * decoded_data_size) /
-                    (ist->st->codec->sample_rate * ist->st->codec->channels);
+                    (ist->dec_ctx->sample_rate * ist->dec_ctx->channels);
                 break;}
             case AVMEDIA_TYPE_VIDEO:
-                    decoded_data_size = (ist->st->codec->width * ist->st->codec->height * 3) / 2;
+                    decoded_data_size = (ist->dec_ctx->width * ist->dec_ctx->height * 3) / 2;
                     /* XXX: allocate picture correctly */
                     avcodec_get_frame_defaults(&picture);
                     avpkt.pts = pkt_pts;
                     avpkt.dts = ist->pts;
                     pkt_pts = AV_NOPTS_VALUE;
 
-                    ret = avcodec_decode_video2(ist->st->codec,
+                    ret = avcodec_decode_video2(ist->dec_ctx,
                                                 &picture, &got_output, &avpkt);
                     quality = same_quality ? picture.quality : 0;
                     if (ret < 0)
@@ -1809,11 +2513,11 @@ static int output_packet(InputStream *ist, int ist_index,
                         goto discard_packet;
                     }
                     ist->next_pts = ist->pts = picture.best_effort_timestamp;
-                    if (ist->st->codec->time_base.num != 0) {
-                        int ticks = ist->st->codec->ticks_per_frame;
+                    if (ist->dec_ctx->time_base.num != 0) {
+                        int ticks = ist->dec_ctx->ticks_per_frame;
                         ist->next_pts += ((int64_t)AV_TIME_BASE *
-                                          ist->st->codec->time_base.num * ticks) /
-                            ist->st->codec->time_base.den;
+                                          ist->dec_ctx->time_base.num * ticks) /
+                            ist->dec_ctx->time_base.den;
                     } else if (ist->st->avg_frame_rate.num) {
                         ist->next_pts += ((int64_t)AV_TIME_BASE * ist->st->avg_frame_rate.den) /
                             ist->st->avg_frame_rate.num;
@@ -1821,7 +2525,7 @@ static int output_packet(InputStream *ist, int ist_index,
                     avpkt.size = 0;
                     break;
             case AVMEDIA_TYPE_SUBTITLE:
-                ret = avcodec_decode_subtitle2(ist->st->codec,
+                ret = avcodec_decode_subtitle2(ist->dec_ctx,
                                                &subtitle, &got_output, &avpkt);
                 if (ret < 0)
                     return ret;
@@ -1835,19 +2539,19 @@ static int output_packet(InputStream *ist, int ist_index,
                 return -1;
             }
         } else {
-            switch(ist->st->codec->codec_type) {
+            switch(ist->dec_ctx->codec_type) {
             case AVMEDIA_TYPE_AUDIO:
-                ist->next_pts += ((int64_t)AV_TIME_BASE * ist->st->codec->frame_size) /
-                    ist->st->codec->sample_rate;
+                ist->next_pts += ((int64_t)AV_TIME_BASE * ist->dec_ctx->frame_size) /
+                    ist->dec_ctx->sample_rate;
                 break;
             case AVMEDIA_TYPE_VIDEO:
                 // offset dts by delay when stream copying
                 ist->pts += av_rescale_q(ist->st->start_time - ist->st->first_dts, ist->st->time_base, AV_TIME_BASE_Q);
-                if (ist->st->codec->time_base.num != 0) {
-                    int ticks = ist->st->codec->ticks_per_frame;
+                if (ist->dec_ctx->time_base.num != 0) {
+                    int ticks = ist->dec_ctx->ticks_per_frame;
                     ist->next_pts += ((int64_t)AV_TIME_BASE *
-                                      ist->st->codec->time_base.num * ticks) /
-                        ist->st->codec->time_base.den;
+                                      ist->dec_ctx->time_base.num * ticks) /
+                        ist->dec_ctx->time_base.den;
                 } else if (ist->st->avg_frame_rate.num) {
                     ist->next_pts += ((int64_t)AV_TIME_BASE * ist->st->avg_frame_rate.den) /
                         ist->st->avg_frame_rate.num;
@@ -1864,7 +2568,7 @@ static int output_packet(InputStream *ist, int ist_index,
         }
 
         // preprocess audio (volume)
-        if (ist->st->codec->codec_type == AVMEDIA_TYPE_AUDIO) {
+        if (ist->dec_ctx->codec_type == AVMEDIA_TYPE_AUDIO) {
             if (audio_volume != 256) {
                 short *volp;
                 volp = samples;
@@ -1898,16 +2602,29 @@ static int output_packet(InputStream *ist, int ist_index,
                 if (j == ost->nb_source_indexes)
                     continue;
 #if CONFIG_AVFILTER
-                if (ist->st->codec->codec_type == AVMEDIA_TYPE_VIDEO && ost->input_video_filter) {
+                if (ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO && ost->input_video_filter) {
                     // add it to be filtered
                     picture.pts = ist->pts;
-                    av_vsrc_buffer_add_frame(ost->input_video_filter, &picture, ist->pts);
+                    if (picture.type == FF_BUFFER_TYPE_USER && picture.opaque) {
+                        /* rendered into a filter buffer, pass it by reference;
+                           the decoder may still use the picture as reference */
+                        AVFilterBufferRef *picref = avfilter_ref_buffer(picture.opaque, ~AV_PERM_WRITE);
+                        if (picref) {
+                            avfilter_copy_frame_props(picref, &picture);
+                            av_vsrc_buffer_add_video_buffer_ref(ost->input_video_filter, picref,
+                                                                AV_VSRC_BUF_FLAG_NO_COPY |
+                                                                AV_VSRC_BUF_FLAG_OVERWRITE);
+                            avfilter_unref_buffer(picref);
+                        }
+                    } else
+                        av_vsrc_buffer_add_frame(ost->input_video_filter, &picture,
+                                                 AV_VSRC_BUF_FLAG_OVERWRITE);
                 }
 
-                frame_available = ist->st->codec->codec_type != AVMEDIA_TYPE_VIDEO ||
+                frame_available = ist->dec_ctx->codec_type != AVMEDIA_TYPE_VIDEO ||
                     !ost->output_video_filter || avfilter_poll_frame(ost->output_video_filter->inputs[0], 0);
                 while (frame_available) {
-                    if (ist->st->codec->codec_type == AVMEDIA_TYPE_VIDEO && ost->output_video_filter) {
+                    if (ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO && ost->output_video_filter) {
                         AVRational ist_pts_tb = ost->output_video_filter->inputs[0]->time_base;
                         if (av_vsink_buffer_get_video_buffer_ref(ost->output_video_filter, &ost->picref, 0) < 0)
                             goto cont;
@@ -1996,11 +2713,11 @@ static int output_packet(InputStream *ist, int ist_index,
 
                         opkt.duration = av_rescale_q(pkt->duration, ist->st->time_base, ost->st->time_base);
                         opkt.flags = pkt->flags;
-                        if (ist->dts_is_reordered_pts && ist->st->codec->has_b_frames > 0) {
+                        if (ist->dts_is_reordered_pts && ist->dec_ctx->has_b_frames > 0) {
                             if (opkt.pts != AV_NOPTS_VALUE)
-                                opkt.pts -= ist->st->codec->has_b_frames*opkt.duration;
+                                opkt.pts -= ist->dec_ctx->has_b_frames*opkt.duration;
                             if (opkt.dts != AV_NOPTS_VALUE)
-                                opkt.dts -= ist->st->codec->has_b_frames*opkt.duration;
+                                opkt.dts -= ist->dec_ctx->has_b_frames*opkt.duration;
                         }
 
                         //FIXME remove the following 2 lines they shall be replaced by the bitstream filters
@@ -2022,14 +2739,14 @@ static int output_packet(InputStream *ist, int ist_index,
                             opkt.size = sizeof(AVPicture);
                             opkt.flags |= AV_PKT_FLAG_KEY;
                         }
-                        write_frame(os, &opkt, ost->st->codec, ost->bitstream_filters);
+                        output_frame(os, ost, &opkt);
                         ost->st->codec->frame_number++;
                         ost->frame_number++;
                         av_free_packet(&opkt);
                     }
 #if CONFIG_AVFILTER
                     cont:
-                    frame_available = (ist->st->codec->codec_type == AVMEDIA_TYPE_VIDEO) &&
+                    frame_available = (ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO) &&
                         ost->output_video_filter && avfilter_poll_frame(ost->output_video_filter->inputs[0], 0);
                     avfilter_unref_buffer(ost->picref);
                 }
@@ -2095,6 +2812,8 @@ static int output_packet(InputStream *ist, int ist_index,
                     continue;
 
                 if (ost->encoding_needed) {
+                    /* the encoders are flushed from this thread */
+                    write_queued_packets(1);
                     for(;;) {
                         AVPacket pkt;
                         int fifo_bytes;
@@ -2965,6 +3684,8 @@ static int transcode(AVFormatContext **output_files,
                     fprintf(stderr, "Error opening filters!\n");
                     exit(1);
                 }
+                if (!ist->dr1_filter)
+                    ist->dr1_filter = ost->input_video_filter;
 #endif
                 if (ost->target)
                     validate_video_target(os, ost);
@@ -3041,6 +3762,12 @@ static int transcode(AVFormatContext **output_files,
                 memcpy(ost->st->codec->subtitle_header, dec->subtitle_header, dec->subtitle_header_size);
                 ost->st->codec->subtitle_header_size = dec->subtitle_header_size;
             }
+#if CONFIG_AVFILTER
+            if (ost->st->codec->codec_type == AVMEDIA_TYPE_VIDEO) {
+                ost->st->codec->ref_input_picture     = encoder_ref_picture;
+                ost->st->codec->release_input_picture = encoder_release_picture;
+            }
+#endif
             if (avcodec_open2(ost->st->codec, codec, &ost->opts) < 0) {
                 fprintf(stderr, "Error while opening encoder for output stream #%d.%d - maybe incorrect parameters such as bit_rate, rate, width or height\n",
                         ost->file_index, ost->index);
@@ -3077,16 +3804,37 @@ static int transcode(AVFormatContext **output_files,
                 ret = AVERROR(EINVAL);
                 goto fail;
             }
-            if (avcodec_open2(ist->st->codec, codec, &ist->opts) < 0) {
+#if HAVE_PTHREADS
+            /* parsers of the demuxing thread update st->codec, decode in a copy */
+            if (pipeline_depth > 0) {
+                ist->dec_ctx = avcodec_alloc_context3(NULL);
+                if (!ist->dec_ctx ||
+                    avcodec_copy_context(ist->dec_ctx, ist->st->codec) < 0) {
+                    fprintf(stderr, "Could not allocate decoder context for input stream #%d.%d\n",
+                            ist->file_index, ist->st->index);
+                    av_freep(&ist->dec_ctx);
+                    ret = AVERROR(ENOMEM);
+                    goto fail;
+                }
+            }
+#endif
+#if CONFIG_AVFILTER
+            if (ist->dr1_filter && codec->capabilities & CODEC_CAP_DR1) {
+                ist->dec_ctx->opaque         = ist;
+                ist->dec_ctx->get_buffer     = filter_get_buffer;
+                ist->dec_ctx->release_buffer = filter_release_buffer;
+            }
+#endif
+            if (avcodec_open2(ist->dec_ctx, codec, &ist->opts) < 0) {
                 fprintf(stderr, "Error while opening decoder for input stream #%d.%d\n",
                         ist->file_index, ist->st->index);
                 ret = AVERROR(EINVAL);
                 goto fail;
             }
-            assert_codec_experimental(ist->st->codec, 0);
+            assert_codec_experimental(ist->dec_ctx, 0);
             assert_avoptions(ost->opts);
-            //if (ist->st->codec->codec_type == AVMEDIA_TYPE_VIDEO)
-            //    ist->st->codec->flags |= CODEC_FLAG_REPEAT_FIELD;
+            //if (ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO)
+            //    ist->dec_ctx->flags |= CODEC_FLAG_REPEAT_FIELD;
         }
     }
 
@@ -3182,6 +3930,18 @@ static int transcode(AVFormatContext **output_files,
     /* open files and write file headers */
     for(i=0;i<nb_output_files;i++) {
         os = output_files[i];
+        /* let muxers preallocate their index for the expected duration */
+        if (!os->duration) {
+            if (recording_time != INT64_MAX) {
+                os->duration = recording_time;
+            } else {
+                for (j = 0; j < nb_input_files; j++) {
+                    AVFormatContext *is = input_files[j].ctx;
+                    if (is->duration > 0)
+                        os->duration = FFMAX(os->duration, is->duration - start_time);
+                }
+            }
+        }
         if (avformat_write_header(os, &output_opts[i]) < 0) {
             fprintf(stderr, "Could not write header for output file #%d\n", i);
             ret = AVERROR(EINVAL);
@@ -3239,6 +3999,8 @@ static int transcode(AVFormatContext **output_files,
 
     term_init();
 
+    init_pipeline(ost_table, nb_ostreams);
+
     timer_start = av_gettime();
 
     for(; received_sigterm == 0;) {
@@ -3274,14 +4036,14 @@ static int transcode(AVFormatContext **output_files,
             if (key == 'd' || key == 'D'){
                 int debug=0;
                 if(key == 'D') {
-                    debug = input_streams[0].st->codec->debug<<1;
+                    debug = input_streams[0].dec_ctx->debug<<1;
                     if(!debug) debug = 1;
                     while(debug & (FF_DEBUG_DCT_COEFF|FF_DEBUG_VIS_QP|FF_DEBUG_VIS_MB_TYPE)) //unsupported, would just crash
                         debug += debug;
                 }else
                     scanf("%d", &debug);
                 for(i=0;i<nb_input_streams;i++) {
-                    input_streams[i].st->codec->debug = debug;
+                    input_streams[i].dec_ctx->debug = debug;
                 }
                 for(i=0;i<nb_ostreams;i++) {
                     ost = ost_table[i];
@@ -3303,6 +4065,11 @@ static int transcode(AVFormatContext **output_files,
             }
         }
 
+        /* the choice between several inputs and the size limit depend
+           on what has been muxed so far */
+        if (nb_input_files > 1 || limit_filesize)
+            write_queued_packets(1);
+
         /* select the stream that we must read now by looking at the
            smallest output pts */
         file_index = -1;
@@ -3350,7 +4117,7 @@ static int transcode(AVFormatContext **output_files,
 
         /* read a frame from it and output it in the fifo */
         is = input_files[file_index].ctx;
-        ret= av_read_frame(is, &pkt);
+        ret= get_input_packet(&input_files[file_index], &pkt);
         if(ret == AVERROR(EAGAIN)){
             no_packet[file_index]=1;
             no_packet_count++;
@@ -3441,6 +4208,8 @@ static int transcode(AVFormatContext **output_files,
         }
         av_free_packet(&pkt);
 
+        write_queued_packets(0);
+
         /* dump report by using the output first video and audio streams */
         print_report(output_files, ost_table, nb_ostreams, 0, duration);
     }
@@ -3453,6 +4222,9 @@ static int transcode(AVFormatContext **output_files,
         }
     }
 
+    write_queued_packets(1);
+    free_pipeline();
+
     /* write the trailer if needed and close file */
     for(i=0;i<nb_output_files;i++) {
         os = output_files[i];
@@ -3480,8 +4252,14 @@ static int transcode(AVFormatContext **output_files,
     for (i = 0; i < nb_input_streams; i++) {
         ist = &input_streams[i];
         if (ist->decoding_needed) {
-            avcodec_close(ist->st->codec);
+            avcodec_close(ist->dec_ctx);
+            if (ist->dec_ctx != ist->st->codec) {
+                av_freep(&ist->dec_ctx->extradata);
+                av_freep(&ist->dec_ctx);
+            }
         }
+        av_audio_shuffle_free(ist->audio_shuffle);
+        av_freep(&ist->audio_planar_buf);
     }
 
     /* finished ! */
@@ -3511,6 +4289,7 @@ static int transcode(AVFormatContext **output_files,
                     av_free(ost->prev_frame.data[0]);
                 av_free(ost->forced_kf_pts);
                 av_free(ost->audiomerge.buf);
+                av_audio_shuffle_free(ost->audiomerge.shuffle);
                 if (ost->video_resample)
                     sws_freeContext(ost->img_resample_ctx);
                 if (ost->resample)
@@ -4165,6 +4944,7 @@ static int opt_input_file(const char *opt, const char *filename)
         input_streams = grow_array(input_streams, sizeof(*input_streams), &nb_input_streams, nb_input_streams + 1);
         ist = &input_streams[nb_input_streams - 1];
         ist->st = st;
+        ist->dec_ctx = st->codec;
         ist->file_index = nb_input_files;
         ist->discard = 1;
         ist->opts = filter_codec_opts(codec_opts, ist->st->codec->codec_id, 0);
@@ -5257,6 +6037,7 @@ static const OptionDef options[] = {
     { "v", HAS_ARG, {(void*)opt_verbose}, "set ffmpeg verbosity level", "number" },
     { "target", HAS_ARG, {(void*)opt_target}, "specify target file type (\"vcd\", \"svcd\", \"dvd\", \"dvcam\", \"dvcpro\", \"dvcpro50\", \"dvcprohd\", \"imx30\", \"imx50\", \"xdcamhd422\")", "type" },
     { "threads",  HAS_ARG | OPT_EXPERT, {(void*)opt_thread_count}, "thread count", "count" },
+    { "pipeline", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&pipeline_depth}, "number of packets and frames queued between the demuxing, encoding and muxing threads, 0 to disable them", "depth" },
     { "vsync", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&video_sync_method}, "video sync method", "" },
     { "async", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&audio_sync_method}, "audio sync method", "" },
     { "adrift_threshold", HAS_ARG | OPT_FLOAT | OPT_EXPERT, {(void*)&audio_drift_threshold}, "audio drift threshold", "threshold" },
@@ -116,4 +116,40 @@ int av_audio_convert(AVAudioConvert *ctx,
                            void * const out[6], const int out_stride[6],
                      const void * const  in[6], const int  in_stride[6], int len);
 
+struct AVAudioShuffle;
+typedef struct AVAudioShuffle AVAudioShuffle;
+
+/**
+ * Create a planar/interleaved sample shuffler context
+ * @param sample_size Size of one sample in bytes, 1, 2, 4 or 8
+ * @return NULL on error
+ */
+AVAudioShuffle *av_audio_shuffle_alloc(int sample_size);
+
+/**
+ * Free planar/interleaved sample shuffler context
+ */
+void av_audio_shuffle_free(AVAudioShuffle *ctx);
+
+/**
+ * Split interleaved samples into one buffer per channel
+ * @param[in] out array of channels output buffers, each len samples large
+ * @param[in] in interleaved input samples
+ * @param channels number of channels in the input
+ * @param len number of samples per channel
+ */
+void av_audio_deinterleave(AVAudioShuffle *ctx, uint8_t * const *out,
+                           const uint8_t *in, int channels, int len);
+
+/**
+ * Write one buffer per channel into interleaved samples
+ * @param[in] out interleaved output samples
+ * @param[in] in array of channels input buffers, in[i] is written to channel i of
+ *               the output. set to NULL to leave the given channel untouched.
+ * @param channels number of channels in the output
+ * @param len number of samples per channel
+ */
+void av_audio_interleave(AVAudioShuffle *ctx, uint8_t *out,
+                         const uint8_t * const *in, int channels, int len);
+
 #endif /* AVCODEC_AUDIOCONVERT_H */
@@ -0,0 +1,157 @@
+/*
+ * planar/interleaved audio sample shuffling
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * planar/interleaved audio sample shuffling
+ */
+
+#include "libavutil/mem.h"
+#include "avcodec.h"
+#include "audioconvert.h"
+#include "audioshuffle.h"
+
+struct AVAudioShuffle {
+    int sample_size;
+    AudioShuffleDSPContext dsp;
+};
+
+#define SHUFFLE_FUNCS(bits, type)                                       \
+static void deinterleave_ ## bits ## _c(uint8_t * const *dst, const uint8_t *src, \
+                                        int channels, int len)          \
+{                                                                       \
+    const type *s = (const type *)src;                                  \
+    int i, ch;                                                          \
+                                                                        \
+    for (i = 0; i < len; i++)                                           \
+        for (ch = 0; ch < channels; ch++)                               \
+            ((type *)dst[ch])[i] = *s++;                                \
+}                                                                       \
+                                                                        \
+static void interleave_ ## bits ## _c(uint8_t *dst, const uint8_t * const *src, \
+                                      int channels, int len)            \
+{                                                                       \
+    type *d = (type *)dst;                                              \
+    int i, ch;                                                          \
+                                                                        \
+    for (i = 0; i < len; i++)                                           \
+        for (ch = 0; ch < channels; ch++)                               \
+            *d++ = ((const type *)src[ch])[i];                          \
+}                                                                       \
+                                                                        \
+static void store_channel_ ## bits(uint8_t *dst, const uint8_t *src,    \
+                                   int channels, int len)               \
+{                                                                       \
+    type *d = (type *)dst;                                              \
+    const type *s = (const type *)src;                                  \
+    int i;                                                              \
+                                                                        \
+    for (i = 0; i < len; i++)                                           \
+        d[i*channels] = s[i];                                           \
+}
+
+SHUFFLE_FUNCS( 8, uint8_t)
+SHUFFLE_FUNCS(16, uint16_t)
+SHUFFLE_FUNCS(32, uint32_t)
+SHUFFLE_FUNCS(64, uint64_t)
+
+AVAudioShuffle *av_audio_shuffle_alloc(int sample_size)
+{
+    AVAudioShuffle *ctx;
+
+    if (sample_size != 1 && sample_size != 2 &&
+        sample_size != 4 && sample_size != 8)
+        return NULL;
+
+    ctx = av_mallocz(sizeof(AVAudioShuffle));
+    if (!ctx)
+        return NULL;
+
+    ctx->sample_size = sample_size;
+    switch (sample_size) {
+    case 1:
+        ctx->dsp.deinterleave = deinterleave_8_c;
+        ctx->dsp.interleave   = interleave_8_c;
+        break;
+    case 2:
+        ctx->dsp.deinterleave = deinterleave_16_c;
+        ctx->dsp.interleave   = interleave_16_c;
+        break;
+    case 4:
+        ctx->dsp.deinterleave = deinterleave_32_c;
+        ctx->dsp.interleave   = interleave_32_c;
+        break;
+    case 8:
+        ctx->dsp.deinterleave = deinterleave_64_c;
+        ctx->dsp.interleave   = interleave_64_c;
+        break;
+    }
+#if HAVE_MMX
+    ff_audio_shuffle_init_mmx(&ctx->dsp, sample_size);
+#endif
+
+    return ctx;
+}
+
+void av_audio_shuffle_free(AVAudioShuffle *ctx)
+{
+    av_free(ctx);
+}
+
+void av_audio_deinterleave(AVAudioShuffle *ctx, uint8_t * const *out,
+                           const uint8_t *in, int channels, int len)
+{
+    if (channels == 1)
+        memcpy(out[0], in, len * ctx->sample_size);
+    else
+        ctx->dsp.deinterleave(out, in, channels, len);
+}
+
+void av_audio_interleave(AVAudioShuffle *ctx, uint8_t *out,
+                         const uint8_t * const *in, int channels, int len)
+{
+    int ch;
+
+    for (ch = 0; ch < channels; ch++)
+        if (!in[ch])
+            break;
+
+    if (ch == channels) {
+        if (channels == 1)
+            memcpy(out, in[0], len * ctx->sample_size);
+        else
+            ctx->dsp.interleave(out, in, channels, len);
+        return;
+    }
+
+    /* some channels are left untouched, store the others one by one */
+    for (ch = 0; ch < channels; ch++) {
+        uint8_t *dst = out + ch * ctx->sample_size;
+
+        if (!in[ch])
+            continue;
+        switch (ctx->sample_size) {
+        case 1: store_channel_8 (dst, in[ch], channels, len); break;
+        case 2: store_channel_16(dst, in[ch], channels, len); break;
+        case 4: store_channel_32(dst, in[ch], channels, len); break;
+        case 8: store_channel_64(dst, in[ch], channels, len); break;
+        }
+    }
+}
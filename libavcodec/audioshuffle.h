@@ -0,0 +1,37 @@
+/*
+ * planar/interleaved audio sample shuffling
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_AUDIOSHUFFLE_H
+#define AVCODEC_AUDIOSHUFFLE_H
+
+#include <stdint.h>
+
+/**
+ * Sample size specific kernels, all channels of dst respectively src
+ * are valid, buffers need not be aligned.
+ */
+typedef struct AudioShuffleDSPContext {
+    void (*deinterleave)(uint8_t * const *dst, const uint8_t *src, int channels, int len);
+    void (*interleave)(uint8_t *dst, const uint8_t * const *src, int channels, int len);
+} AudioShuffleDSPContext;
+
+void ff_audio_shuffle_init_mmx(AudioShuffleDSPContext *c, int sample_size);
+
+#endif /* AVCODEC_AUDIOSHUFFLE_H */
@@ -2949,6 +2949,28 @@ typedef struct AVCodecContext {
      * - decoding: Set by libavcodec.
      */
     AVDictionary *metadata;
+
+    /**
+     * Called by frame threaded encoders to keep the data of the picture
+     * passed to avcodec_encode_video() until it is encoded, instead of
+     * copying it. pic is the copy of the AVFrame kept by libavcodec, the
+     * callback may change its opaque field to identify the reference.
+     * The picture data must not be modified until release_input_picture()
+     * is called.
+     * @return 0 if a reference was taken, a negative value to have the
+     *         picture copied
+     * - encoding: Set by user, may be NULL.
+     * - decoding: unused
+     */
+    int (*ref_input_picture)(struct AVCodecContext *c, AVFrame *pic);
+
+    /**
+     * Called to release a picture referenced with ref_input_picture(),
+     * from the thread calling avcodec_encode_video() or avcodec_close().
+     * - encoding: Set by user, may be NULL.
+     * - decoding: unused
+     */
+    void (*release_input_picture)(struct AVCodecContext *c, AVFrame *pic);
 } AVCodecContext;
 
 /**
@@ -3354,6 +3376,16 @@ struct AVResampleContext *av_resample_init(int out_rate, int in_rate, int filter
  */
 int av_resample(struct AVResampleContext *c, short *dst, short *src, int *consumed, int src_size, int dst_size, int update_ctx);
 
+/**
+ * Same as av_resample() but for float samples, no clipping is done.
+ */
+int av_resample_flt(struct AVResampleContext *c, float *dst, float *src, int *consumed, int src_size, int dst_size, int update_ctx);
+
+/**
+ * Same as av_resample() but for signed 32 bit samples.
+ */
+int av_resample_s32(struct AVResampleContext *c, int32_t *dst, int32_t *src, int *consumed, int src_size, int dst_size, int update_ctx);
+
 
 /**
  * Compensate samplerate/timestamp drift. The compensation is done by changing
@@ -32,33 +32,45 @@
 #include "dsputil.h"
 #include "thread.h"
 
+/**
+ * Macroblock row decoding state, one per slice thread.
+ */
+typedef struct RowContext {
+    DECLARE_ALIGNED(16, DCTELEM, blocks)[8][64];
+    GetBitContext gb;
+    int last_dc[3];
+    int last_qscale;
+    int luma_scale[64];
+    int chroma_scale[64];
+} RowContext;
+
 typedef struct DNXHDContext {
     AVCodecContext *avctx;
     AVFrame picture;
-    GetBitContext gb;
     int cid;                            ///< compression id
     unsigned int width, height;
     unsigned int mb_width, mb_height;
     uint32_t mb_scan_index[68];         /* max for 1080p */
     int cur_field;                      ///< current interlaced field
     VLC ac_vlc, dc_vlc, run_vlc;
-    int last_dc[3];
     DSPContext dsp;
-    DECLARE_ALIGNED(16, DCTELEM, blocks)[8][64];
     uint8_t scan[64];
     const CIDEntry *cid_table;
-    void (*decode_dct_block)(struct DNXHDContext *ctx, DCTELEM *block,
-                             int n, int qscale);
-    int last_qscale;
-    int luma_scale[64];
-    int chroma_scale[64];
+    void (*decode_dct_block)(struct DNXHDContext *ctx, RowContext *row,
+                             DCTELEM *block, int n, int qscale);
+    RowContext *rows;                   ///< one per slice thread
+    int rows_count;
+    const uint8_t *buf;                 ///< coding unit data being decoded
+    int buf_size;
 } DNXHDContext;
 
 #define DNXHD_VLC_BITS 9
 #define DNXHD_DC_VLC_BITS 7
 
-static void dnxhd_decode_dct_block_8(DNXHDContext *ctx, DCTELEM *block, int n, int qscale);
-static void dnxhd_decode_dct_block_10(DNXHDContext *ctx, DCTELEM *block, int n, int qscale);
+static void dnxhd_decode_dct_block_8(DNXHDContext *ctx, RowContext *row,
+                                     DCTELEM *block, int n, int qscale);
+static void dnxhd_decode_dct_block_10(DNXHDContext *ctx, RowContext *row,
+                                      DCTELEM *block, int n, int qscale);
 
 static void permute(uint8_t *dst, const uint8_t *src, const uint8_t permutation[64])
 {
@@ -185,6 +197,7 @@ static int dnxhd_decode_header(DNXHDContext *ctx, const uint8_t *buf, int buf_si
 }
 
 static av_always_inline void dnxhd_decode_dct_block(DNXHDContext *ctx,
+                                                    RowContext *row,
                                                     DCTELEM *block, int n,
                                                     int qscale,
                                                     int index_bits,
@@ -198,51 +211,51 @@ static av_always_inline void dnxhd_decode_dct_block(DNXHDContext *ctx,
     const uint8_t *ac_level = ctx->cid_table->ac_level;
     const uint8_t *ac_flags = ctx->cid_table->ac_flags;
     const int eob_index     = ctx->cid_table->eob_index;
-    OPEN_READER(bs, &ctx->gb);
+    OPEN_READER(bs, &row->gb);
 
     if (n&2) {
         component = 1 + (n&1);
-        scale = ctx->chroma_scale;
+        scale = row->chroma_scale;
         weight_matrix = ctx->cid_table->chroma_weight;
     } else {
         component = 0;
-        scale = ctx->luma_scale;
+        scale = row->luma_scale;
         weight_matrix = ctx->cid_table->luma_weight;
     }
 
-    UPDATE_CACHE(bs, &ctx->gb);
-    GET_VLC(len, bs, &ctx->gb, ctx->dc_vlc.table, DNXHD_DC_VLC_BITS, 1);
+    UPDATE_CACHE(bs, &row->gb);
+    GET_VLC(len, bs, &row->gb, ctx->dc_vlc.table, DNXHD_DC_VLC_BITS, 1);
     if (len) {
-        level = GET_CACHE(bs, &ctx->gb);
-        LAST_SKIP_BITS(bs, &ctx->gb, len);
+        level = GET_CACHE(bs, &row->gb);
+        LAST_SKIP_BITS(bs, &row->gb, len);
         sign  = ~level >> 31;
         level = (NEG_USR32(sign ^ level, len) ^ sign) - sign;
-        ctx->last_dc[component] += level;
+        row->last_dc[component] += level;
     }
-    block[0] = ctx->last_dc[component];
+    block[0] = row->last_dc[component];
     //av_log(ctx->avctx, AV_LOG_DEBUG, "dc %d\n", block[0]);
 
     i = 0;
 
-    UPDATE_CACHE(bs, &ctx->gb);
-    GET_VLC(index1, bs, &ctx->gb, ctx->ac_vlc.table,
+    UPDATE_CACHE(bs, &row->gb);
+    GET_VLC(index1, bs, &row->gb, ctx->ac_vlc.table,
             DNXHD_VLC_BITS, 2);
 
     while (index1 != eob_index) {
         level = ac_level[index1];
         flags = ac_flags[index1];
 
-        sign = SHOW_SBITS(bs, &ctx->gb, 1);
-        SKIP_BITS(bs, &ctx->gb, 1);
+        sign = SHOW_SBITS(bs, &row->gb, 1);
+        SKIP_BITS(bs, &row->gb, 1);
 
         if (flags & 1) {
-            level += SHOW_UBITS(bs, &ctx->gb, index_bits) << 7;
-            SKIP_BITS(bs, &ctx->gb, index_bits);
+            level += SHOW_UBITS(bs, &row->gb, index_bits) << 7;
+            SKIP_BITS(bs, &row->gb, index_bits);
         }
 
         if (flags & 2) {
-            UPDATE_CACHE(bs, &ctx->gb);
-            GET_VLC(index2, bs, &ctx->gb, ctx->run_vlc.table,
+            UPDATE_CACHE(bs, &row->gb);
+            GET_VLC(index2, bs, &row->gb, ctx->run_vlc.table,
                     DNXHD_VLC_BITS, 2);
             i += ctx->cid_table->run[index2];
         }
@@ -263,27 +276,28 @@ static av_always_inline void dnxhd_decode_dct_block(DNXHDContext *ctx,
         //av_log(NULL, AV_LOG_DEBUG, "i %d, j %d, end level %d\n", i, j, level);
         block[ctx->scan[i]] = (level^sign) - sign;
 
-        UPDATE_CACHE(bs, &ctx->gb);
-        GET_VLC(index1, bs, &ctx->gb, ctx->ac_vlc.table,
+        UPDATE_CACHE(bs, &row->gb);
+        GET_VLC(index1, bs, &row->gb, ctx->ac_vlc.table,
                 DNXHD_VLC_BITS, 2);
     }
 
-    CLOSE_READER(bs, &ctx->gb);
+    CLOSE_READER(bs, &row->gb);
 }
 
-static void dnxhd_decode_dct_block_8(DNXHDContext *ctx, DCTELEM *block,
-                                     int n, int qscale)
+static void dnxhd_decode_dct_block_8(DNXHDContext *ctx, RowContext *row,
+                                     DCTELEM *block, int n, int qscale)
 {
-    dnxhd_decode_dct_block(ctx, block, n, qscale, 4, 32, 6);
+    dnxhd_decode_dct_block(ctx, row, block, n, qscale, 4, 32, 6);
 }
 
-static void dnxhd_decode_dct_block_10(DNXHDContext *ctx, DCTELEM *block,
-                                      int n, int qscale)
+static void dnxhd_decode_dct_block_10(DNXHDContext *ctx, RowContext *row,
+                                      DCTELEM *block, int n, int qscale)
 {
-    dnxhd_decode_dct_block(ctx, block, n, qscale, 6, 8, 4);
+    dnxhd_decode_dct_block(ctx, row, block, n, qscale, 6, 8, 4);
 }
 
-static int dnxhd_decode_macroblock(DNXHDContext *ctx, int x, int y)
+static int dnxhd_decode_macroblock(DNXHDContext *ctx, RowContext *row,
+                                   int x, int y)
 {
     int shift1 = ctx->cid_table->bit_depth == 10;
     int dct_linesize_luma   = ctx->picture.linesize[0];
@@ -292,21 +306,21 @@ static int dnxhd_decode_macroblock(DNXHDContext *ctx, int x, int y)
     int dct_y_offset, dct_x_offset;
     int qscale, i;
 
-    qscale = get_bits(&ctx->gb, 11);
-    skip_bits1(&ctx->gb);
+    qscale = get_bits(&row->gb, 11);
+    skip_bits1(&row->gb);
     //av_log(ctx->avctx, AV_LOG_DEBUG, "qscale %d\n", qscale);
 
-    if (qscale != ctx->last_qscale) {
+    if (qscale != row->last_qscale) {
         for (i = 0; i < 64; i++) {
-            ctx->luma_scale[i]   = qscale * ctx->cid_table->luma_weight[i];
-            ctx->chroma_scale[i] = qscale * ctx->cid_table->chroma_weight[i];
+            row->luma_scale[i]   = qscale * ctx->cid_table->luma_weight[i];
+            row->chroma_scale[i] = qscale * ctx->cid_table->chroma_weight[i];
         }
-        ctx->last_qscale = qscale;
+        row->last_qscale = qscale;
     }
 
     for (i = 0; i < 8; i++) {
-        ctx->dsp.clear_block(ctx->blocks[i]);
-        ctx->decode_dct_block(ctx, ctx->blocks[i], i, qscale);
+        ctx->dsp.clear_block(row->blocks[i]);
+        ctx->decode_dct_block(ctx, row, row->blocks[i], i, qscale);
     }
 
     if (ctx->picture.interlaced_frame) {
@@ -326,36 +340,60 @@ static int dnxhd_decode_macroblock(DNXHDContext *ctx, int x, int y)
 
     dct_y_offset = dct_linesize_luma << 3;
     dct_x_offset = 8 << shift1;
-    ctx->dsp.idct_put(dest_y,                               dct_linesize_luma, ctx->blocks[0]);
-    ctx->dsp.idct_put(dest_y + dct_x_offset,                dct_linesize_luma, ctx->blocks[1]);
-    ctx->dsp.idct_put(dest_y + dct_y_offset,                dct_linesize_luma, ctx->blocks[4]);
-    ctx->dsp.idct_put(dest_y + dct_y_offset + dct_x_offset, dct_linesize_luma, ctx->blocks[5]);
+    ctx->dsp.idct_put(dest_y,                               dct_linesize_luma, row->blocks[0]);
+    ctx->dsp.idct_put(dest_y + dct_x_offset,                dct_linesize_luma, row->blocks[1]);
+    ctx->dsp.idct_put(dest_y + dct_y_offset,                dct_linesize_luma, row->blocks[4]);
+    ctx->dsp.idct_put(dest_y + dct_y_offset + dct_x_offset, dct_linesize_luma, row->blocks[5]);
 
     if (!(ctx->avctx->flags & CODEC_FLAG_GRAY)) {
         dct_y_offset = dct_linesize_chroma << 3;
-        ctx->dsp.idct_put(dest_u,                dct_linesize_chroma, ctx->blocks[2]);
-        ctx->dsp.idct_put(dest_v,                dct_linesize_chroma, ctx->blocks[3]);
-        ctx->dsp.idct_put(dest_u + dct_y_offset, dct_linesize_chroma, ctx->blocks[6]);
-        ctx->dsp.idct_put(dest_v + dct_y_offset, dct_linesize_chroma, ctx->blocks[7]);
+        ctx->dsp.idct_put(dest_u,                dct_linesize_chroma, row->blocks[2]);
+        ctx->dsp.idct_put(dest_v,                dct_linesize_chroma, row->blocks[3]);
+        ctx->dsp.idct_put(dest_u + dct_y_offset, dct_linesize_chroma, row->blocks[6]);
+        ctx->dsp.idct_put(dest_v + dct_y_offset, dct_linesize_chroma, row->blocks[7]);
     }
 
     return 0;
 }
 
+static int dnxhd_decode_row(AVCodecContext *avctx, void *arg, int y, int threadnr)
+{
+    DNXHDContext *ctx = avctx->priv_data;
+    RowContext *row = &ctx->rows[threadnr];
+    int x;
+
+    row->last_dc[0] =
+    row->last_dc[1] =
+    row->last_dc[2] = 1 << (ctx->cid_table->bit_depth + 2); // for levels +2^(bitdepth-1)
+    init_get_bits(&row->gb, ctx->buf + ctx->mb_scan_index[y],
+                  (ctx->buf_size - ctx->mb_scan_index[y]) << 3);
+    for (x = 0; x < ctx->mb_width; x++) {
+        //START_TIMER;
+        dnxhd_decode_macroblock(ctx, row, x, y);
+        //STOP_TIMER("decode macroblock");
+    }
+    return 0;
+}
+
 static int dnxhd_decode_macroblocks(DNXHDContext *ctx, const uint8_t *buf, int buf_size)
 {
-    int x, y;
-    for (y = 0; y < ctx->mb_height; y++) {
-        ctx->last_dc[0] =
-        ctx->last_dc[1] =
-        ctx->last_dc[2] = 1 << (ctx->cid_table->bit_depth + 2); // for levels +2^(bitdepth-1)
-        init_get_bits(&ctx->gb, buf + ctx->mb_scan_index[y], (buf_size - ctx->mb_scan_index[y]) << 3);
-        for (x = 0; x < ctx->mb_width; x++) {
-            //START_TIMER;
-            dnxhd_decode_macroblock(ctx, x, y);
-            //STOP_TIMER("decode macroblock");
-        }
+    AVCodecContext *avctx = ctx->avctx;
+    int i, count = FFMAX(avctx->thread_count, 1);
+
+    if (ctx->rows_count != count) {
+        av_freep(&ctx->rows);
+        ctx->rows_count = 0;
+        ctx->rows = av_malloc(count * sizeof(*ctx->rows));
+        if (!ctx->rows)
+            return AVERROR(ENOMEM);
+        ctx->rows_count = count;
     }
+    for (i = 0; i < count; i++)
+        ctx->rows[i].last_qscale = -1;
+
+    ctx->buf      = buf;
+    ctx->buf_size = buf_size;
+    avctx->execute2(avctx, dnxhd_decode_row, NULL, NULL, ctx->mb_height);
     return 0;
 }
 
@@ -400,9 +438,10 @@ static int dnxhd_decode_frame(AVCodecContext *avctx, void *data, int *data_size,
         }
     }
 
-    dnxhd_decode_macroblocks(ctx, buf + 0x280, buf_size - 0x280);
-        buf      += ctx->cid_table->coding_unit_size;
-        buf_size -= ctx->cid_table->coding_unit_size;
+    if ((ret = dnxhd_decode_macroblocks(ctx, buf + 0x280, buf_size - 0x280)) < 0)
+        return ret;
+    buf      += ctx->cid_table->coding_unit_size;
+    buf_size -= ctx->cid_table->coding_unit_size;
 
     if (first_field&0x01 && ctx->picture.interlaced_frame) {
         first_field = 0;
@@ -454,6 +493,7 @@ static av_cold int dnxhd_decode_close(AVCodecContext *avctx)
     free_vlc(&ctx->ac_vlc);
     free_vlc(&ctx->dc_vlc);
     free_vlc(&ctx->run_vlc);
+    av_freep(&ctx->rows);
     return 0;
 }
 
@@ -466,6 +506,6 @@ AVCodec ff_dnxhd_decoder = {
     NULL,
     dnxhd_decode_close,
     dnxhd_decode_frame,
-    CODEC_CAP_DR1 | CODEC_CAP_FRAME_THREADS,
+    CODEC_CAP_DR1 | CODEC_CAP_FRAME_THREADS | CODEC_CAP_SLICE_THREADS,
     .long_name = NULL_IF_CONFIG_SMALL("VC3/DNxHD"),
 };
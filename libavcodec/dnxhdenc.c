@@ -960,14 +960,27 @@ static int dnxhd_encode_picture(AVCodecContext *avctx, unsigned char *buf, int b
  encode_coding_unit:
     if(alphaPresent)
     {
+        /* the input picture may be shared, code the chroma from a grey
+           plane instead of overwriting it */
+        int rows = FFMAX(ctx->mb_height << (4 + ctx->interlaced), avctx->height);
+        unsigned size = ctx->frame.linesize[1]*rows;
+        if (size > ctx->alpha_chroma_size) {
+            av_free(ctx->alpha_chroma);
+            if (!(ctx->alpha_chroma = av_malloc(size))) {
+                ctx->alpha_chroma_size = 0;
+                return AVERROR(ENOMEM);
+            }
+            memset(ctx->alpha_chroma, 128, size);
+            ctx->alpha_chroma_size = size;
+        }
         ctx->src[0] = ctx->frame.data[3];
-        memset(ctx->src[1], 128, ctx->frame.linesize[1]*avctx->height);
-        memset(ctx->src[2], 128, ctx->frame.linesize[2]*avctx->height);
+        ctx->src[1] = ctx->alpha_chroma;
+        ctx->src[2] = ctx->alpha_chroma;
         if (ctx->interlaced && ctx->cur_field)
         {
             ctx->src[0] += ctx->frame.linesize[3];
             ctx->src[1] += ctx->frame.linesize[1];
-            ctx->src[2] += ctx->frame.linesize[2];
+            ctx->src[2] += ctx->frame.linesize[1];
         }
     }
     else
@@ -1056,6 +1069,7 @@ static int dnxhd_encode_end(AVCodecContext *avctx)
     av_freep(&ctx->qmatrix_l);
     av_freep(&ctx->qmatrix_c16);
     av_freep(&ctx->qmatrix_l16);
+    av_freep(&ctx->alpha_chroma);
 
     for (i = 1; i < avctx->thread_count; i++)
         av_freep(&ctx->thread[i]);
@@ -1071,7 +1085,7 @@ AVCodec ff_dnxhd_encoder = {
     dnxhd_encode_init,
     dnxhd_encode_picture,
     dnxhd_encode_end,
-    .capabilities = CODEC_CAP_SLICE_THREADS,
+    .capabilities = CODEC_CAP_SLICE_THREADS | CODEC_CAP_FRAME_THREADS,
     .pix_fmts = (const enum PixelFormat[]){PIX_FMT_YUV422P, PIX_FMT_YUVA422P, PIX_FMT_YUV422P10, PIX_FMT_NONE},
     .long_name = NULL_IF_CONFIG_SMALL("VC3/DNxHD"),
     .priv_class = &class,
@@ -86,6 +86,8 @@ typedef struct DNXHDEncContext {
 
     unsigned frame_bits;
     uint8_t *src[3];
+    uint8_t *alpha_chroma;      ///< grey chroma plane coded with the alpha coding unit
+    unsigned alpha_chroma_size;
 
     uint32_t *vlc_codes;
     uint8_t  *vlc_bits;
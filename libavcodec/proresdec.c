@@ -48,13 +48,9 @@ typedef struct {
 typedef struct {
     AVFrame frame;
     DSPContext dsp;
-    GetBitContext gb;
     int frame_type;              ///< 0 = progressive, 1 = tff, 2 = bff
     uint8_t qmat_luma[64];
     uint8_t qmat_chroma[64];
-    int last_qscale;
-    int luma_scale[64];
-    int chroma_scale[64];
     SliceContext *slices;
     int slice_count;             ///< number of slices in the current picture
     unsigned mb_width;           ///< width of the current picture in mb
@@ -63,7 +59,6 @@ typedef struct {
     uint8_t interlaced_scan[64];
     const uint8_t *scan;
     int first_field;
-    DECLARE_ALIGNED(16, DCTELEM, blocks)[8*4*64], *block;
 } ProresContext;
 
 static void permute(uint8_t *dst, const uint8_t *src, const uint8_t permutation[64])
@@ -400,21 +395,23 @@ static av_always_inline void decode_ac_coeffs(AVCodecContext *avctx, GetBitConte
 
 static void decode_slice_luma(AVCodecContext *avctx, SliceContext *slice,
                               uint8_t *dst, int dst_stride,
-                              const uint8_t *buf, unsigned buf_size)
+                              const uint8_t *buf, unsigned buf_size,
+                              DCTELEM *blocks, const int *qmat)
 {
     ProresContext *ctx = avctx->priv_data;
+    GetBitContext gb;
     int i, blocks_per_slice = slice->mb_count<<2;
     DCTELEM *block;
 
     for (i = 0; i < blocks_per_slice; i++)
-        ctx->dsp.clear_block(ctx->blocks+(i<<6));
+        ctx->dsp.clear_block(blocks+(i<<6));
 
-    init_get_bits(&ctx->gb, buf, buf_size << 3);
+    init_get_bits(&gb, buf, buf_size << 3);
 
-    decode_dc_coeffs(&ctx->gb, ctx->blocks, blocks_per_slice, ctx->luma_scale);
-    decode_ac_coeffs(avctx, &ctx->gb, ctx->blocks, blocks_per_slice, ctx->luma_scale);
+    decode_dc_coeffs(&gb, blocks, blocks_per_slice, qmat);
+    decode_ac_coeffs(avctx, &gb, blocks, blocks_per_slice, qmat);
 
-    block = ctx->blocks;
+    block = blocks;
     for (i = 0; i < slice->mb_count; i++) {
         ctx->dsp.idct_put(dst, dst_stride, block+(0<<6));
         ctx->dsp.idct_put(dst+16, dst_stride, block+(1<<6));
@@ -428,21 +425,23 @@ static void decode_slice_luma(AVCodecContext *avctx, SliceContext *slice,
 static void decode_slice_chroma(AVCodecContext *avctx, SliceContext *slice,
                                 uint8_t *dst, int dst_stride,
                                 const uint8_t *buf, unsigned buf_size,
-                                int log2_blocks_per_mb)
+                                int log2_blocks_per_mb,
+                                DCTELEM *blocks, const int *qmat)
 {
     ProresContext *ctx = avctx->priv_data;
+    GetBitContext gb;
     int i, j, blocks_per_slice = slice->mb_count<<log2_blocks_per_mb;
     DCTELEM *block;
 
     for (i = 0; i < blocks_per_slice; i++)
-        ctx->dsp.clear_block(ctx->blocks+(i<<6));
+        ctx->dsp.clear_block(blocks+(i<<6));
 
-    init_get_bits(&ctx->gb, buf, buf_size << 3);
+    init_get_bits(&gb, buf, buf_size << 3);
 
-    decode_dc_coeffs(&ctx->gb, ctx->blocks, blocks_per_slice, ctx->chroma_scale);
-    decode_ac_coeffs(avctx, &ctx->gb, ctx->blocks, blocks_per_slice, ctx->chroma_scale);
+    decode_dc_coeffs(&gb, blocks, blocks_per_slice, qmat);
+    decode_ac_coeffs(avctx, &gb, blocks, blocks_per_slice, qmat);
 
-    block = ctx->blocks;
+    block = blocks;
     for (i = 0; i < slice->mb_count; i++) {
         for (j = 0; j < log2_blocks_per_mb; j++) {
             ctx->dsp.idct_put(dst,              dst_stride, block+(0<<6));
@@ -453,9 +452,10 @@ static void decode_slice_chroma(AVCodecContext *avctx, SliceContext *slice,
     }
 }
 
-static int decode_slice(AVCodecContext *avctx, SliceContext *slice)
+static int decode_slice_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
 {
     ProresContext *ctx = avctx->priv_data;
+    SliceContext *slice = &ctx->slices[jobnr];
     const uint8_t *buf = slice->data;
     AVFrame *pic = &ctx->frame;
     int i, hdr_size, qscale, log2_chroma_blocks_per_mb;
@@ -463,6 +463,9 @@ static int decode_slice(AVCodecContext *avctx, SliceContext *slice)
     int y_data_size, u_data_size, v_data_size;
     uint8_t *dest_y, *dest_u, *dest_v;
     int mb_x_shift;
+    int luma_scale[64];
+    int chroma_scale[64];
+    LOCAL_ALIGNED_16(DCTELEM, blocks, [8*4*64]);
 
     //av_log(avctx, AV_LOG_INFO, "slice mb width %d mb x %d y %d\n",
     //       slice->mb_count, slice->mb_x, slice->mb_y);
@@ -486,12 +489,9 @@ static int decode_slice(AVCodecContext *avctx, SliceContext *slice)
 
     buf += hdr_size;
 
-    if (qscale != ctx->last_qscale) {
-        for (i = 0; i < 64; i++) {
-            ctx->luma_scale[i]   = ctx->qmat_luma[i] * qscale;
-            ctx->chroma_scale[i] = ctx->qmat_chroma[i] * qscale;
-        }
-        ctx->last_qscale = qscale;
+    for (i = 0; i < 64; i++) {
+        luma_scale[i]   = ctx->qmat_luma[i] * qscale;
+        chroma_scale[i] = ctx->qmat_chroma[i] * qscale;
     }
 
     if (ctx->frame_type == 0) {
@@ -520,15 +520,16 @@ static int decode_slice(AVCodecContext *avctx, SliceContext *slice)
         dest_v += pic->linesize[2];
     }
 
-    decode_slice_luma(avctx, slice, dest_y, luma_stride, buf, y_data_size);
+    decode_slice_luma(avctx, slice, dest_y, luma_stride, buf, y_data_size,
+                      blocks, luma_scale);
 
     if (!(avctx->flags & CODEC_FLAG_GRAY)) {
         decode_slice_chroma(avctx, slice, dest_u, chroma_stride,
                             buf + y_data_size, u_data_size,
-                            log2_chroma_blocks_per_mb);
+                            log2_chroma_blocks_per_mb, blocks, chroma_scale);
         decode_slice_chroma(avctx, slice, dest_v, chroma_stride,
                             buf + y_data_size + u_data_size, v_data_size,
-                            log2_chroma_blocks_per_mb);
+                            log2_chroma_blocks_per_mb, blocks, chroma_scale);
     }
 
     return 0;
@@ -537,12 +538,13 @@ static int decode_slice(AVCodecContext *avctx, SliceContext *slice)
 static int decode_picture(AVCodecContext *avctx)
 {
     ProresContext *ctx = avctx->priv_data;
-    int i;
+    int i, threads_ret[ctx->slice_count];
 
-    for (i = 0; i < ctx->slice_count; i++) {
-        if (decode_slice(avctx, &ctx->slices[i]) < 0)
-            return -1;
-    }
+    avctx->execute2(avctx, decode_slice_thread, NULL, threads_ret, ctx->slice_count);
+
+    for (i = 0; i < ctx->slice_count; i++)
+        if (threads_ret[i] < 0)
+            return threads_ret[i];
     return 0;
 }
 
@@ -625,5 +627,5 @@ AVCodec ff_prores_decoder = {
     .close          = decode_close,
     .decode         = decode_frame,
     .long_name      = NULL_IF_CONFIG_SMALL("ProRes"),
-    .capabilities   = CODEC_CAP_FRAME_THREADS | CODEC_CAP_DR1,
+    .capabilities   = CODEC_CAP_SLICE_THREADS | CODEC_CAP_FRAME_THREADS | CODEC_CAP_DR1,
 };
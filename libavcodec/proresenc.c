@@ -27,59 +27,12 @@
 #include "bytestream.h"
 #include "libavutil/opt.h"
 #include "libavutil/x86_cpu.h"
+#include "proresenc.h"
 
-typedef struct {
-    uint8_t *buf;
-    unsigned buf_size;
-    unsigned mb_x;
-    unsigned mb_y;
-    unsigned mb_count;
-    int data_size;
-    unsigned h;
-    unsigned last_mb_w;
-    uint8_t *edge_buf;
-    int edge_stride;
-    unsigned qp;
-    int over_qp;
-    int loaded;
-    DECLARE_ALIGNED(16, DCTELEM, blocks)[8*12*64];
-} SliceContext;
-
-typedef struct {
-    const AVClass *class;
-    AVFrame coded_frame;
-    const AVFrame *frame;
-    DSPContext dsp;
-    int frame_type;              ///< 0 = progressive, 1 = tff, 2 = bff
-    SliceContext *slices;
-    int slice_count;             ///< number of slices in the current picture
-    unsigned width, height;
-    unsigned mb_width;           ///< width of the current picture in mb
-    unsigned mb_height;          ///< height of the current picture in mb
-    unsigned mb_count;
-    uint8_t progressive_scan[64];
-    uint8_t interlaced_scan[64];
-    int16_t qmat_luma[225][64];
-    int16_t qmat_chroma[225][64];
-    uint8_t qmat[2][64];         ///< quantization matrix
-    const uint8_t *scan;
-    int first_field;
-    uint8_t *buf;
-    unsigned qp;
-    uint64_t bitrate;
-    int frame_size;
-    int picture_size;
-    int left_size;
-    float bt;
-    char *profile;
-    unsigned mb_size;
-    int qmax;
-    unsigned rc_qp;
-    int quant_bias;
-} ProresEncContext;
-
-#define QMAT_SHIFT 16
-#define QUANT_BIAS_SHIFT 8
+enum {
+    RC_FRAME,                    ///< bisect a single qp for the whole frame
+    RC_SLICE,                    ///< choose qp per slice from cached sizes
+};
 
 static const uint8_t progressive_scan[64] = {
      0,  1,  8,  9,  2,  3, 10, 11,
@@ -212,6 +165,51 @@ static int compute_slice_mb_width(int mb_width)
     return (mb_width >> 3) + count;
 }
 
+static av_always_inline int quantize(DCTELEM val, int qscale, int quant_bias)
+{
+    int bias = quant_bias << (QMAT_SHIFT - QUANT_BIAS_SHIFT);
+    unsigned threshold1 = (1 << QMAT_SHIFT) - bias - 1;
+    unsigned threshold2 = threshold1 << 1;
+    int level = val * qscale;
+    int ret;
+
+    if (((unsigned)(level + threshold1)) > threshold2) {
+        if (level < 0)
+            ret = -((bias - level) >> QMAT_SHIFT);
+        else
+            ret = (bias + level) >> QMAT_SHIFT;
+    } else {
+        ret = 0;
+    }
+
+    return ret;
+}
+
+static void quantize_c(int16_t *levels, const DCTELEM *coeffs, const int16_t *qmat,
+                       int quant_bias, int blocks_per_slice)
+{
+    int i, j;
+
+    coeffs += blocks_per_slice;
+    for (i = 1; i < 64; i++)
+        for (j = 0; j < blocks_per_slice; j++)
+            *levels++ = quantize(*coeffs++, qmat[i], quant_bias);
+}
+
+static int find_runs_c(uint16_t *runs, int16_t *levels, const int16_t *src, int count)
+{
+    int i, n = 0, last = -1;
+
+    for (i = 0; i < count; i++) {
+        if (src[i]) {
+            runs[n] = i - last - 1;
+            levels[n++] = src[i];
+            last = i;
+        }
+    }
+    return n;
+}
+
 static int prores_encode_init(AVCodecContext *avctx)
 {
     ProresEncContext *ctx = avctx->priv_data;
@@ -342,6 +340,12 @@ static int prores_encode_init(AVCodecContext *avctx)
     ctx->buf = av_malloc(ctx->slice_count * (8 + 8 * 12 * 64 * 2));
     if (!ctx->buf)
         return AVERROR(ENOMEM);
+
+    if (ctx->rc_mode == RC_SLICE) {
+        ctx->rc_cand = av_malloc(ctx->slice_count * sizeof(*ctx->rc_cand));
+        if (!ctx->rc_cand)
+            return AVERROR(ENOMEM);
+    }
     buf = ctx->buf;
 
     slice_mb_count = 8;
@@ -394,13 +398,35 @@ static int prores_encode_init(AVCodecContext *avctx)
     for (q = 1; q <= 224; q++) {
         int qscale = q > 128 ? q - 96 << 2 : q;
         for (i = 0; i < 64; i++) {
-            ctx->qmat_luma[q][i] = (1 << QMAT_SHIFT) / (qscale * ctx->qmat[0][i]);
-            ctx->qmat_chroma[q][i] = (1 << QMAT_SHIFT) / (qscale * ctx->qmat[1][i]);
+            ctx->qmat_luma[q][i] = (1 << QMAT_SHIFT) / (qscale * ctx->qmat[0][ctx->scan[i]]);
+            ctx->qmat_chroma[q][i] = (1 << QMAT_SHIFT) / (qscale * ctx->qmat[1][ctx->scan[i]]);
         }
     }
 
+    ctx->quantize  = quantize_c;
+    ctx->find_runs = find_runs_c;
+
+#if HAVE_MMX
+    // the simd quantizer multiplies unsigned 16 bit magnitudes
+    for (i = 0; i < 64; i++)
+        if (ctx->qmat[0][i] < 3 || ctx->qmat[1][i] < 3)
+            break;
+    if (i == 64 && ctx->quant_bias >= 0 && ctx->quant_bias < 1 << QUANT_BIAS_SHIFT)
+        ff_prores_init_mmx(ctx);
+#endif
+
     ctx->rc_qp = 1;
 
+    for (i = 0, q = 1; i < MAX_RC_QPS - 1; q += FFMAX(1, q >> 3)) {
+        int qp = q <= 128 ? q : 96 + (q + 3 >> 2);
+        if (qp >= ctx->qmax)
+            break;
+        if (!i || ctx->rc_qps[i-1] != qp)
+            ctx->rc_qps[i++] = qp;
+    }
+    ctx->rc_qps[i++] = ctx->qmax;
+    ctx->rc_qps_count = i;
+
     return 0;
 }
 
@@ -421,30 +447,24 @@ static av_always_inline void encode_codeword(PutBitContext *pb, unsigned val, ui
     }
 }
 
-static av_always_inline int quantize(DCTELEM val, int qscale, int quant_bias)
+static av_always_inline int codeword_bits(unsigned val, uint8_t codebook)
 {
-    int bias = quant_bias << (QMAT_SHIFT - QUANT_BIAS_SHIFT);
-    unsigned threshold1 = (1 << QMAT_SHIFT) - bias - 1;
-    unsigned threshold2 = threshold1 << 1;
-    int level = val * qscale;
-    int ret;
+    unsigned switch_bits = codebook & 3;
+    unsigned rice_order = codebook >> 5;
 
-    if (((unsigned)(level + threshold1)) > threshold2) {
-        if (level < 0)
-            ret = -((bias - level) >> QMAT_SHIFT);
-        else
-            ret = (bias + level) >> QMAT_SHIFT;
+    if (val >> rice_order > switch_bits) {
+        unsigned exp_order = (codebook >> 2) & 7;
+        val += (1 << exp_order) - ((switch_bits + 1) << rice_order);
+        return ((av_log2(val)+1)<<1) - exp_order + switch_bits;
     } else {
-        ret = 0;
+        return (val >> rice_order) + 1 + rice_order;
     }
-
-    return ret;
 }
 
 static const uint8_t dc_codebook[7] = { 0x04, 0x28, 0x28, 0x4D, 0x4D, 0x70, 0x70};
 
 static void encode_dc_coeffs(AVCodecContext *avctx, PutBitContext *pb,
-                             const int16_t *qmat, DCTELEM *blocks,
+                             const int16_t *qmat, const DCTELEM *coeffs,
                              int blocks_per_slice)
 {
     ProresEncContext *ctx = avctx->priv_data;
@@ -453,18 +473,16 @@ static void encode_dc_coeffs(AVCodecContext *avctx, PutBitContext *pb,
     int prev_sign, prev_code;
     int i;
 
-    level = quantize(*blocks - 16384, qmat[0], ctx->quant_bias);
+    level = quantize(coeffs[0] - 16384, qmat[0], ctx->quant_bias);
     prev_dc = level;
     MASK_ABS(sign, level);
     encode_codeword(pb, (level<<1) - (sign&1), 0xB8);
 
-    blocks += 64;
-
     prev_code = 5;
     prev_sign = 0;
 
-    for (i = 1; i < blocks_per_slice; i++, blocks += 64) {
-        level = quantize(*blocks - 16384, qmat[0], ctx->quant_bias) - prev_dc;
+    for (i = 1; i < blocks_per_slice; i++) {
+        level = quantize(coeffs[i] - 16384, qmat[0], ctx->quant_bias) - prev_dc;
         prev_dc += level;
         MASK_ABS(sign, level);
         if (!level)
@@ -480,41 +498,23 @@ static void encode_dc_coeffs(AVCodecContext *avctx, PutBitContext *pb,
 static const uint8_t run_to_cb[16] = { 0x06, 0x06, 0x05, 0x05, 0x04, 0x29, 0x29, 0x29, 0x29, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x4C };
 static const uint8_t lev_to_cb[10] = { 0x04, 0x0A, 0x05, 0x06, 0x04, 0x28, 0x28, 0x28, 0x28, 0x4C };
 
-static void encode_ac_coeffs(AVCodecContext *avctx, PutBitContext *pb,
-                             const int16_t *qmat, DCTELEM *blocks,
-                             int blocks_per_slice)
+static void encode_ac_coeffs(PutBitContext *pb, const uint16_t *runs,
+                             const int16_t *levels, int count)
 {
-    ProresEncContext *ctx = avctx->priv_data;
-    int block_mask, sign;
-    unsigned pos, run;
     unsigned prev_run, prev_level;
-    int level;
-    int max_coeffs, i;
-    int log2_block_count = av_log2(blocks_per_slice);
-    int last_non_zero;
+    int level, sign, i;
 
     prev_run   = 4;
     prev_level = 2;
 
-    max_coeffs = 64 << log2_block_count;
-    block_mask = blocks_per_slice - 1;
-
-    pos = blocks_per_slice;
-    last_non_zero = pos - 1;
-
-    for (; pos < max_coeffs; pos++) {
-        i = ctx->scan[pos >> log2_block_count];
-        level = quantize(blocks[((pos & block_mask) << 6) + i], qmat[i], ctx->quant_bias);
-        if (level) {
-            run = pos - last_non_zero - 1;
-            encode_codeword(pb, run, run_to_cb[FFMIN(prev_run,  15)]);
-            prev_run = run;
-            MASK_ABS(sign, level);
-            encode_codeword(pb, level - 1, lev_to_cb[FFMIN(prev_level, 9)]);
-            put_bits(pb, 1, sign&1);
-            prev_level = level;
-            last_non_zero = pos;
-        }
+    for (i = 0; i < count; i++) {
+        encode_codeword(pb, runs[i], run_to_cb[FFMIN(prev_run,  15)]);
+        prev_run = runs[i];
+        level = levels[i];
+        MASK_ABS(sign, level);
+        encode_codeword(pb, level - 1, lev_to_cb[FFMIN(prev_level, 9)]);
+        put_bits(pb, 1, sign&1);
+        prev_level = level;
     }
 }
 
@@ -594,34 +594,114 @@ static void read_slice_chroma(AVCodecContext *avctx, SliceContext *slice,
     }
 }
 
+static void reorder_slice_plane(ProresEncContext *ctx, DCTELEM *dst,
+                                const DCTELEM *blocks, int blocks_per_slice)
+{
+    int i, j;
+
+    for (i = 0; i < 64; i++) {
+        const DCTELEM *src = blocks + ctx->scan[i];
+        for (j = 0; j < blocks_per_slice; j++)
+            *dst++ = src[j << 6];
+    }
+}
+
+/**
+ * Quantize the ac coefficients of one slice plane and collect its nonzero
+ * levels with their runs in slice->levels and slice->runs.
+ * @return number of nonzero levels
+ */
+static int quantize_slice_plane(ProresEncContext *ctx, SliceContext *slice,
+                                const DCTELEM *coeffs, int blocks_per_slice,
+                                const int16_t *qmat)
+{
+    int count = 63 * blocks_per_slice;
+
+    if (blocks_per_slice & 7) {
+        quantize_c(slice->levels, coeffs, qmat, ctx->quant_bias, blocks_per_slice);
+        return find_runs_c(slice->runs, slice->levels, slice->levels, count);
+    }
+    ctx->quantize(slice->levels, coeffs, qmat, ctx->quant_bias, blocks_per_slice);
+    return ctx->find_runs(slice->runs, slice->levels, slice->levels, count);
+}
+
 static int encode_slice(AVCodecContext *avctx, SliceContext *slice,
-                        DCTELEM *blocks, int log2_blocks_per_mb,
+                        const DCTELEM *coeffs, int log2_blocks_per_mb,
                         const int16_t *qmat, uint8_t *buf, int buf_size)
 {
+    ProresEncContext *ctx = avctx->priv_data;
     int blocks_per_slice = slice->mb_count << log2_blocks_per_mb;
+    int count = quantize_slice_plane(ctx, slice, coeffs, blocks_per_slice, qmat);
     PutBitContext pb;
 
     init_put_bits(&pb, buf, buf_size<<3);
 
-    encode_dc_coeffs(avctx, &pb, qmat, blocks, blocks_per_slice);
-    encode_ac_coeffs(avctx, &pb, qmat, blocks, blocks_per_slice);
+    encode_dc_coeffs(avctx, &pb, qmat, coeffs, blocks_per_slice);
+    encode_ac_coeffs(&pb, slice->runs, slice->levels, count);
     align_put_bits(&pb);
     flush_put_bits(&pb);
 
     return put_bits_count(&pb)>>3;
 }
 
-static int encode_slice_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+/**
+ * Compute the exact coded size of one slice plane without writing any bits,
+ * working on the coefficients already in scan order.
+ */
+static int estimate_slice_plane(ProresEncContext *ctx, SliceContext *slice,
+                                const DCTELEM *coeffs, int blocks_per_slice,
+                                const int16_t *qmat)
+{
+    int prev_dc, prev_sign, prev_code;
+    unsigned prev_run, prev_level;
+    int code, sign, level;
+    int i, j, bits, count;
+
+    level = quantize(coeffs[0] - 16384, qmat[0], ctx->quant_bias);
+    prev_dc = level;
+    MASK_ABS(sign, level);
+    bits = codeword_bits((level<<1) - (sign&1), 0xB8);
+
+    prev_code = 5;
+    prev_sign = 0;
+
+    for (j = 1; j < blocks_per_slice; j++) {
+        level = quantize(coeffs[j] - 16384, qmat[0], ctx->quant_bias) - prev_dc;
+        prev_dc += level;
+        MASK_ABS(sign, level);
+        if (!level)
+            prev_sign = 0;
+        code = (level<<1) + (prev_sign ^ sign);
+        bits += codeword_bits(code, dc_codebook[FFMIN(prev_code, 6)]);
+        prev_code = code;
+        prev_sign = sign;
+    }
+
+    count = quantize_slice_plane(ctx, slice, coeffs, blocks_per_slice, qmat);
+
+    prev_run   = 4;
+    prev_level = 2;
+
+    for (i = 0; i < count; i++) {
+        bits += codeword_bits(slice->runs[i], run_to_cb[FFMIN(prev_run, 15)]);
+        prev_run = slice->runs[i];
+        level = slice->levels[i];
+        MASK_ABS(sign, level);
+        bits += codeword_bits(level - 1, lev_to_cb[FFMIN(prev_level, 9)]) + 1;
+        prev_level = level;
+    }
+
+    return (bits + 7) >> 3;
+}
+
+static void load_slice(AVCodecContext *avctx, SliceContext *slice)
 {
     ProresEncContext *ctx = avctx->priv_data;
-    SliceContext *slice = &ctx->slices[jobnr];
-    int y_data_size, u_data_size, v_data_size;
     const uint8_t *src_y, *src_u, *src_v;
     const AVFrame *pic = ctx->frame;
-    int log2_chroma_blocks_per_mb;
+    int log2_chroma_blocks_per_mb, chroma_blocks;
     int luma_stride, chroma_stride;
-    int mb_x_shift, buf_size;
-    uint8_t *buf;
+    int mb_x_shift;
 
     if (avctx->pix_fmt == PIX_FMT_YUV444P10) {
         mb_x_shift = 5;
@@ -631,40 +711,61 @@ static int encode_slice_thread(AVCodecContext *avctx, void *arg, int jobnr, int
         log2_chroma_blocks_per_mb = 1;
     }
 
-    if (!slice->loaded) {
-        if (ctx->frame_type == 0) {
-            luma_stride   = pic->linesize[0];
-            chroma_stride = pic->linesize[1];
-        } else {
-            luma_stride   = pic->linesize[0] << 1;
-            chroma_stride = pic->linesize[1] << 1;
-        }
+    if (ctx->frame_type == 0) {
+        luma_stride   = pic->linesize[0];
+        chroma_stride = pic->linesize[1];
+    } else {
+        luma_stride   = pic->linesize[0] << 1;
+        chroma_stride = pic->linesize[1] << 1;
+    }
 
-        src_y = pic->data[0] + (slice->mb_y << 4) * luma_stride + (slice->mb_x << 5);
-        src_u = pic->data[1] + (slice->mb_y << 4) * chroma_stride + (slice->mb_x << mb_x_shift);
-        src_v = pic->data[2] + (slice->mb_y << 4) * chroma_stride + (slice->mb_x << mb_x_shift);
+    src_y = pic->data[0] + (slice->mb_y << 4) * luma_stride + (slice->mb_x << 5);
+    src_u = pic->data[1] + (slice->mb_y << 4) * chroma_stride + (slice->mb_x << mb_x_shift);
+    src_v = pic->data[2] + (slice->mb_y << 4) * chroma_stride + (slice->mb_x << mb_x_shift);
 
-        if (ctx->frame_type && ctx->first_field ^ pic->top_field_first) {
-            src_y += pic->linesize[0];
-            src_u += pic->linesize[1];
-            src_v += pic->linesize[2];
-        }
+    if (ctx->frame_type && ctx->first_field ^ pic->top_field_first) {
+        src_y += pic->linesize[0];
+        src_u += pic->linesize[1];
+        src_v += pic->linesize[2];
+    }
 
-        read_slice_luma(avctx, slice, slice->blocks, src_y, luma_stride);
-        read_slice_chroma(avctx, slice, slice->blocks + 8*4*64, src_u, chroma_stride,
-                          log2_chroma_blocks_per_mb);
-        read_slice_chroma(avctx, slice, slice->blocks + 8*8*64, src_v, chroma_stride,
-                          log2_chroma_blocks_per_mb);
+    read_slice_luma(avctx, slice, slice->blocks, src_y, luma_stride);
+    read_slice_chroma(avctx, slice, slice->blocks + 8*4*64, src_u, chroma_stride,
+                      log2_chroma_blocks_per_mb);
+    read_slice_chroma(avctx, slice, slice->blocks + 8*8*64, src_v, chroma_stride,
+                      log2_chroma_blocks_per_mb);
+
+    // reorder once, rate control quantizes the slice at several qps
+    chroma_blocks = slice->mb_count << log2_chroma_blocks_per_mb;
+    reorder_slice_plane(ctx, slice->coeffs, slice->blocks, slice->mb_count << 2);
+    reorder_slice_plane(ctx, slice->coeffs + 8*4*64, slice->blocks + 8*4*64,
+                        chroma_blocks);
+    reorder_slice_plane(ctx, slice->coeffs + 8*8*64, slice->blocks + 8*8*64,
+                        chroma_blocks);
+
+    slice->loaded = 1;
+}
 
-        slice->loaded = 1;
-    }
+static int encode_slice_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    ProresEncContext *ctx = avctx->priv_data;
+    SliceContext *slice = &ctx->slices[jobnr];
+    int y_data_size, u_data_size, v_data_size;
+    int log2_chroma_blocks_per_mb;
+    int buf_size;
+    uint8_t *buf;
+
+    log2_chroma_blocks_per_mb = avctx->pix_fmt == PIX_FMT_YUV444P10 ? 2 : 1;
+
+    if (!slice->loaded)
+        load_slice(avctx, slice);
 
     buf = slice->buf;
     buf[0] = 8 << 3; // slice header size
     buf[1] = slice->qp;
     buf += 8;
     buf_size = slice->buf_size - 8;
-    y_data_size = encode_slice(avctx, slice, slice->blocks, 2,
+    y_data_size = encode_slice(avctx, slice, slice->coeffs, 2,
                                ctx->qmat_luma[slice->qp], buf, buf_size);
     AV_WB16(slice->buf + 2, y_data_size);
     buf += y_data_size;
@@ -673,7 +774,7 @@ static int encode_slice_thread(AVCodecContext *avctx, void *arg, int jobnr, int
     if (buf_size < 0)
         return -1;
 
-    u_data_size = encode_slice(avctx, slice, slice->blocks + 8*4*64,
+    u_data_size = encode_slice(avctx, slice, slice->coeffs + 8*4*64,
                                log2_chroma_blocks_per_mb,
                                ctx->qmat_chroma[slice->qp], buf, buf_size);
     AV_WB16(slice->buf + 4, u_data_size);
@@ -683,7 +784,7 @@ static int encode_slice_thread(AVCodecContext *avctx, void *arg, int jobnr, int
     if (buf_size < 0)
         return -1;
 
-    v_data_size = encode_slice(avctx, slice, slice->blocks + 8*8*64,
+    v_data_size = encode_slice(avctx, slice, slice->coeffs + 8*8*64,
                                log2_chroma_blocks_per_mb,
                                ctx->qmat_chroma[slice->qp], buf, buf_size);
     AV_WB16(slice->buf + 6, v_data_size);
@@ -758,6 +859,132 @@ static int prores_find_qp(AVCodecContext *avctx)
     return qp;
 }
 
+static int slice_rc_size_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    ProresEncContext *ctx = avctx->priv_data;
+    SliceContext *slice = &ctx->slices[jobnr];
+    int chroma_blocks, idx = *(int *)arg;
+    int qp = ctx->rc_qps[idx];
+
+    if (slice->rc_sizes[idx])
+        return 0;
+
+    if (!slice->loaded)
+        load_slice(avctx, slice);
+
+    chroma_blocks = slice->mb_count << (avctx->pix_fmt == PIX_FMT_YUV444P10 ? 2 : 1);
+    slice->rc_sizes[idx] = 8 +
+        estimate_slice_plane(ctx, slice, slice->coeffs,
+                             slice->mb_count << 2, ctx->qmat_luma[qp]) +
+        estimate_slice_plane(ctx, slice, slice->coeffs + 8*4*64,
+                             chroma_blocks, ctx->qmat_chroma[qp]) +
+        estimate_slice_plane(ctx, slice, slice->coeffs + 8*8*64,
+                             chroma_blocks, ctx->qmat_chroma[qp]);
+    return 0;
+}
+
+static int picture_rc_size(AVCodecContext *avctx, int idx)
+{
+    ProresEncContext *ctx = avctx->priv_data;
+    int i, size = 0;
+
+    avctx->execute2(avctx, slice_rc_size_thread, &idx, NULL, ctx->slice_count);
+
+    for (i = 0; i < ctx->slice_count; i++) {
+        SliceContext *slice = &ctx->slices[i];
+        if (slice->rc_sizes[idx] > slice->buf_size)
+            return INT_MAX;
+        size += slice->rc_sizes[idx];
+    }
+    return size;
+}
+
+static int cmp_rc_candidate(const void *a, const void *b)
+{
+    const RCCandidate *ca = a, *cb = b;
+    return ca->cost != cb->cost ? ca->cost - cb->cost : ca->slice - cb->slice;
+}
+
+/**
+ * Slice rate control: slices are quantized and sized once per candidate qp
+ * from their cached DCT, the picture qp is searched on the summed sizes, and
+ * the bytes left under the budget are then spent lowering the qp of the
+ * slices for which it is cheapest. Only the final qps are entropy coded.
+ */
+static int prores_slice_rc(AVCodecContext *avctx)
+{
+    ProresEncContext *ctx = avctx->priv_data;
+    int budget = ctx->picture_size - 8 - ctx->slice_count * 2;
+    int last = ctx->rc_qps_count - 1;
+    RCCandidate *cand = ctx->rc_cand;
+    int lo, hi, mid, step = 1;
+    int i, n, size;
+
+    for (i = 0; i < ctx->slice_count; i++)
+        memset(ctx->slices[i].rc_sizes, 0, sizeof(ctx->slices[i].rc_sizes));
+
+    // lo never fits (-1 meaning below the ladder), hi always fits
+    if (picture_rc_size(avctx, ctx->rc_idx) <= budget) {
+        hi = ctx->rc_idx;
+        lo = hi - 1;
+        while (lo >= 0 && picture_rc_size(avctx, lo) <= budget) {
+            hi = lo;
+            step <<= 1;
+            lo = hi - step;
+        }
+        lo = FFMAX(lo, -1);
+    } else {
+        lo = ctx->rc_idx;
+        hi = FFMIN(lo + 1, last);
+        while (hi < last && picture_rc_size(avctx, hi) > budget) {
+            lo = hi;
+            step <<= 1;
+            hi = FFMIN(lo + step, last);
+        }
+        if (lo == last || picture_rc_size(avctx, hi) > budget)
+            lo = hi = last;
+    }
+
+    while (hi - lo > 1) {
+        mid = (lo + hi) >> 1;
+        if (picture_rc_size(avctx, mid) <= budget)
+            hi = mid;
+        else
+            lo = mid;
+    }
+
+    ctx->rc_idx = hi;
+    size = picture_rc_size(avctx, hi);
+    if (size > budget)
+        av_log(avctx, AV_LOG_WARNING, "warning, maximum quantizer reached\n");
+
+    for (i = 0; i < ctx->slice_count; i++)
+        ctx->slices[i].qp = ctx->rc_qps[hi];
+
+    if (hi == 0 || size >= budget)
+        return 0;
+
+    picture_rc_size(avctx, hi - 1);
+
+    for (i = n = 0; i < ctx->slice_count; i++) {
+        SliceContext *slice = &ctx->slices[i];
+        if (slice->rc_sizes[hi - 1] <= slice->buf_size) {
+            cand[n].cost  = slice->rc_sizes[hi - 1] - slice->rc_sizes[hi];
+            cand[n].slice = i;
+            n++;
+        }
+    }
+
+    qsort(cand, n, sizeof(*cand), cmp_rc_candidate);
+
+    for (i = 0; i < n && size + cand[i].cost <= budget; i++) {
+        size += cand[i].cost;
+        ctx->slices[cand[i].slice].qp = ctx->rc_qps[hi - 1];
+    }
+
+    return 0;
+}
+
 static int prores_encode_picture(AVCodecContext *avctx)
 {
     ProresEncContext *ctx = avctx->priv_data;
@@ -769,10 +996,14 @@ static int prores_encode_picture(AVCodecContext *avctx)
         threads_ret[i] = 0;
     }
 
-    if (ctx->qp)
+    if (ctx->qp) {
         avctx->execute2(avctx, encode_slice_thread, NULL, threads_ret, ctx->slice_count);
-    else
+    } else if (ctx->rc_mode == RC_SLICE) {
+        prores_slice_rc(avctx);
+        avctx->execute2(avctx, encode_slice_thread, NULL, threads_ret, ctx->slice_count);
+    } else {
         prores_find_qp(avctx);
+    }
 
     for (i = 0; i < ctx->slice_count; i++)
         if (threads_ret[i] < 0)
@@ -912,6 +1143,7 @@ static int prores_encode_end(AVCodecContext *avctx)
 
     av_freep(&ctx->slices);
     av_freep(&ctx->buf);
+    av_freep(&ctx->rc_cand);
     return 0;
 }
 
@@ -924,6 +1156,9 @@ static const AVOption options[] = {
     {"b", "Set bit rate in (bits/s)", OFFSET(bitrate), FF_OPT_TYPE_INT64, {.dbl=0}, 0, INT_MAX, VE},
     {"ratetol", "Set bit rate tolerance in %", OFFSET(bt), FF_OPT_TYPE_FLOAT, {.dbl=5}, 0, INT_MAX, VE},
     {"profile", "Set encoding profile: proxy,lt,std,hq", OFFSET(profile), FF_OPT_TYPE_STRING, {.str=0}, 0, CHAR_MAX, VE},
+    {"rc", "Set rate control mode", OFFSET(rc_mode), FF_OPT_TYPE_INT, {.dbl=RC_FRAME}, RC_FRAME, RC_SLICE, VE, "rc"},
+    {"frame", "Single quantizer per frame", 0, FF_OPT_TYPE_CONST, {.dbl=RC_FRAME}, INT_MIN, INT_MAX, VE, "rc"},
+    {"slice", "Quantizer chosen per slice", 0, FF_OPT_TYPE_CONST, {.dbl=RC_SLICE}, INT_MIN, INT_MAX, VE, "rc"},
     { NULL }
 };
 
@@ -937,7 +1172,7 @@ AVCodec ff_prores_encoder = {
     .init           = prores_encode_init,
     .encode         = prores_encode_frame,
     .close          = prores_encode_end,
-    .capabilities = CODEC_CAP_SLICE_THREADS,
+    .capabilities = CODEC_CAP_SLICE_THREADS | CODEC_CAP_FRAME_THREADS,
     .pix_fmts = (const enum PixelFormat[]){PIX_FMT_YUV422P10, PIX_FMT_YUV444P10, PIX_FMT_NONE},
     .long_name = NULL_IF_CONFIG_SMALL("ProRes"),
     .priv_class     = &class,
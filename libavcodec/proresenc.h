@@ -0,0 +1,113 @@
+/*
+ * Apple ProRes encoder structure definitions and prototypes
+ * Copyright (c) 2011 Michael Jackson
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_PRORESENC_H
+#define AVCODEC_PRORESENC_H
+
+#include <stdint.h>
+#include "avcodec.h"
+#include "dsputil.h"
+
+#define MAX_RC_QPS 64
+
+#define QMAT_SHIFT 16
+#define QUANT_BIAS_SHIFT 8
+
+typedef struct {
+    uint8_t *buf;
+    unsigned buf_size;
+    unsigned mb_x;
+    unsigned mb_y;
+    unsigned mb_count;
+    int data_size;
+    unsigned h;
+    unsigned last_mb_w;
+    uint8_t *edge_buf;
+    int edge_stride;
+    unsigned qp;
+    int over_qp;
+    int loaded;
+    int rc_sizes[MAX_RC_QPS];    ///< slice sizes per ladder qp, 0 if not computed yet
+    DECLARE_ALIGNED(16, DCTELEM, blocks)[8*12*64];
+    DECLARE_ALIGNED(16, DCTELEM, coeffs)[8*12*64]; ///< blocks in bitstream scan order
+    DECLARE_ALIGNED(16, int16_t, levels)[8*4*64];  ///< quantized ac levels of one plane
+    uint16_t runs[8*4*64];       ///< zero runs preceding each nonzero level
+} SliceContext;
+
+typedef struct {
+    int cost;                    ///< extra bytes needed to lower the qp one step
+    int slice;
+} RCCandidate;
+
+typedef struct ProresEncContext {
+    const AVClass *class;
+    AVFrame coded_frame;
+    const AVFrame *frame;
+    DSPContext dsp;
+    int frame_type;              ///< 0 = progressive, 1 = tff, 2 = bff
+    SliceContext *slices;
+    int slice_count;             ///< number of slices in the current picture
+    unsigned width, height;
+    unsigned mb_width;           ///< width of the current picture in mb
+    unsigned mb_height;          ///< height of the current picture in mb
+    unsigned mb_count;
+    uint8_t progressive_scan[64];
+    uint8_t interlaced_scan[64];
+    int16_t qmat_luma[225][64];  ///< in scan order
+    int16_t qmat_chroma[225][64];
+    uint8_t qmat[2][64];         ///< quantization matrix
+    const uint8_t *scan;
+    int first_field;
+    uint8_t *buf;
+    unsigned qp;
+    uint64_t bitrate;
+    int frame_size;
+    int picture_size;
+    int left_size;
+    float bt;
+    char *profile;
+    unsigned mb_size;
+    int qmax;
+    unsigned rc_qp;
+    int quant_bias;
+    int rc_mode;
+    uint8_t rc_qps[MAX_RC_QPS];  ///< candidate qps for slice rate control
+    int rc_qps_count;
+    int rc_idx;                  ///< ladder index chosen for the previous picture
+    RCCandidate *rc_cand;        ///< slice rate control candidates, one per slice
+
+    /**
+     * Quantize scan positions 1 to 63 of a slice plane in scan order,
+     * blocks_per_slice is a multiple of 8.
+     */
+    void (*quantize)(int16_t *levels, const DCTELEM *coeffs, const int16_t *qmat,
+                     int quant_bias, int blocks_per_slice);
+    /**
+     * Pack the nonzero values of src into levels with their preceding zero
+     * runs, levels may be src, count is a multiple of 8.
+     * @return number of nonzero values
+     */
+    int (*find_runs)(uint16_t *runs, int16_t *levels, const int16_t *src, int count);
+} ProresEncContext;
+
+void ff_prores_init_mmx(ProresEncContext *ctx);
+
+#endif /* AVCODEC_PRORESENC_H */
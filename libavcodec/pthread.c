@@ -77,6 +77,8 @@ typedef struct PerThreadContext {
     int            allocated_buf_size; ///< Size allocated for avpkt.data
 
     AVFrame frame;                  ///< Output frame (for decoding) or input (for encoding).
+    AVPicture input_copy;           ///< Copy of the input picture when it cannot be referenced (encoding).
+    int     input_ref;              ///< Set if frame holds a reference taken with ref_input_picture().
     int     got_frame;              ///< The output of got_picture_ptr from the last avcodec_decode_video() call.
     int     result;                 ///< The result of the last codec decode/encode() call.
 
@@ -123,6 +125,8 @@ typedef struct FrameThreadContext {
                                     * While it is set, ff_thread_en/decode_frame won't return any results.
                                     */
 
+    AVFrame coded_frame;           ///< Copy of the coded_frame of the last returned packet (encoding).
+
     int die;                       ///< Set when threads should exit.
 } FrameThreadContext;
 
@@ -296,9 +300,14 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
             ff_thread_finish_setup(avctx);
 
         pthread_mutex_lock(&p->mutex);
-        avcodec_get_frame_defaults(&p->frame);
-        p->got_frame = 0;
-        p->result = codec->decode(avctx, &p->frame, &p->got_frame, &p->avpkt);
+        if (codec->encode) {
+            p->result = codec->encode(avctx, p->avpkt.data, p->avpkt.size, &p->frame);
+            p->got_frame = p->result > 0;
+        } else {
+            avcodec_get_frame_defaults(&p->frame);
+            p->got_frame = 0;
+            p->result = codec->decode(avctx, &p->frame, &p->got_frame, &p->avpkt);
+        }
 
         if (p->state == STATE_SETTING_UP) ff_thread_finish_setup(avctx);
 
@@ -363,6 +372,44 @@ static int update_context_from_thread(AVCodecContext *dst, AVCodecContext *src,
     return err;
 }
 
+/**
+ * Update the user's AVCodecContext with the values an encoder sets in init().
+ *
+ * @param dst The user's context.
+ * @param src The context of the first encoding thread.
+ */
+static int update_context_from_encoder(AVCodecContext *dst, AVCodecContext *src)
+{
+    dst->codec_tag           = src->codec_tag;
+    dst->bit_rate            = src->bit_rate;
+    dst->global_quality      = src->global_quality;
+    dst->bits_per_raw_sample = src->bits_per_raw_sample;
+    dst->sample_aspect_ratio = src->sample_aspect_ratio;
+    dst->color_primaries     = src->color_primaries;
+    dst->color_transfer      = src->color_transfer;
+    dst->color_matrix        = src->color_matrix;
+    dst->profile             = src->profile;
+    dst->level               = src->level;
+    dst->has_b_frames        = src->has_b_frames;
+    dst->ticks_per_frame     = src->ticks_per_frame;
+
+    /* the thread contexts are freed with their extradata, keep a copy */
+    if (src->extradata != dst->extradata) {
+        av_freep(&dst->extradata);
+        dst->extradata_size = 0;
+        if (src->extradata) {
+            dst->extradata = av_malloc(src->extradata_size + FF_INPUT_BUFFER_PADDING_SIZE);
+            if (!dst->extradata)
+                return AVERROR(ENOMEM);
+            memcpy(dst->extradata, src->extradata, src->extradata_size);
+            memset(dst->extradata + src->extradata_size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+            dst->extradata_size = src->extradata_size;
+        }
+    }
+
+    return 0;
+}
+
 /**
  * Update the next thread's AVCodecContext with values set by the user.
  *
@@ -378,6 +425,9 @@ static void update_context_from_user(AVCodecContext *dst, AVCodecContext *src)
     dst->get_buffer     = src->get_buffer;
     dst->release_buffer = src->release_buffer;
 
+    dst->ref_input_picture     = src->ref_input_picture;
+    dst->release_input_picture = src->release_input_picture;
+
     dst->opaque   = src->opaque;
     dst->dsp_mask = src->dsp_mask;
     dst->debug    = src->debug;
@@ -557,6 +607,128 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
     return p->result;
 }
 
+/// Drops the reference to the input picture of an idle encoding thread, if any.
+static void release_input_picture(PerThreadContext *p)
+{
+    if (p->input_ref) {
+        p->avctx->release_input_picture(p->avctx, &p->frame);
+        p->input_ref = 0;
+    }
+}
+
+static int submit_frame(PerThreadContext *p, const AVFrame *pict, int buf_size)
+{
+    AVCodecContext *avctx = p->avctx;
+
+    pthread_mutex_lock(&p->mutex);
+
+    release_input_picture(p);
+
+    av_fast_malloc(&p->avpkt.data, &p->allocated_buf_size, buf_size);
+    if (!p->avpkt.data) {
+        pthread_mutex_unlock(&p->mutex);
+        return AVERROR(ENOMEM);
+    }
+    p->avpkt.size = buf_size;
+
+    p->frame = *pict;
+    if (avctx->ref_input_picture && avctx->release_input_picture &&
+        !avctx->ref_input_picture(avctx, &p->frame)) {
+        p->input_ref = 1;
+    } else {
+        if (!p->input_copy.data[0] &&
+            avpicture_alloc(&p->input_copy, avctx->pix_fmt,
+                            avctx->width, avctx->height) < 0) {
+            pthread_mutex_unlock(&p->mutex);
+            return AVERROR(ENOMEM);
+        }
+        p->frame = *pict;
+        memcpy(p->frame.data,     p->input_copy.data,     sizeof(p->frame.data));
+        memcpy(p->frame.linesize, p->input_copy.linesize, sizeof(p->frame.linesize));
+        av_picture_copy((AVPicture *)&p->frame, (const AVPicture *)pict,
+                        avctx->pix_fmt, avctx->width, avctx->height);
+    }
+
+    p->state = STATE_SETTING_UP;
+    pthread_cond_signal(&p->input_cond);
+    pthread_mutex_unlock(&p->mutex);
+
+    return 0;
+}
+
+int ff_thread_encode_frame(AVCodecContext *avctx, uint8_t *buf, int buf_size,
+                           const AVFrame *pict)
+{
+    FrameThreadContext *fctx = avctx->thread_opaque;
+    int finished = fctx->next_finished;
+    PerThreadContext *p;
+    int got_packet, err;
+
+    /*
+     * Submit the picture to the next encoding thread.
+     * The thread keeps a reference to it or its own copy so the caller can
+     * reuse pict.
+     */
+
+    if (pict) {
+        p = &fctx->threads[fctx->next_decoding];
+        update_context_from_user(p->avctx, avctx);
+        err = submit_frame(p, pict, buf_size);
+        if (err) return err;
+
+        fctx->next_decoding++;
+
+        if (fctx->delaying) {
+            if (fctx->next_decoding >= (avctx->thread_count-1)) fctx->delaying = 0;
+            return 0;
+        }
+    }
+
+    /*
+     * Return the packet of the oldest thread. When flushing, skip the
+     * threads that have nothing left to output or to report.
+     */
+
+    do {
+        p = &fctx->threads[finished++];
+
+        if (p->state != STATE_INPUT_READY) {
+            pthread_mutex_lock(&p->progress_mutex);
+            while (p->state != STATE_INPUT_READY)
+                pthread_cond_wait(&p->output_cond, &p->progress_mutex);
+            pthread_mutex_unlock(&p->progress_mutex);
+        }
+
+        got_packet = p->got_frame;
+        p->got_frame = 0;
+        release_input_picture(p);
+
+        if (finished >= avctx->thread_count) finished = 0;
+    } while (!pict && !got_packet && p->result >= 0 && finished != fctx->next_finished);
+
+    if (fctx->next_decoding >= avctx->thread_count) fctx->next_decoding = 0;
+
+    fctx->next_finished = finished;
+
+    if (!got_packet) {
+        err = FFMIN(p->result, 0);
+        /* report an error only once */
+        p->result = 0;
+        return err;
+    }
+
+    if (p->result > buf_size) {
+        av_log(avctx, AV_LOG_ERROR, "output buffer is too small for the encoded frame\n");
+        return -1;
+    }
+
+    memcpy(buf, p->avpkt.data, p->result);
+    if (p->avctx->coded_frame)
+        fctx->coded_frame = *p->avctx->coded_frame;
+
+    return p->result;
+}
+
 void ff_thread_report_progress(AVFrame *f, int n, int field)
 {
     PerThreadContext *p;
@@ -656,6 +828,13 @@ static void frame_thread_free(AVCodecContext *avctx, int thread_count)
 
         avcodec_default_free_buffers(p->avctx);
 
+        if (codec->encode) {
+            release_input_picture(p);
+            avpicture_free(&p->input_copy);
+            if (p->avctx->extradata != avctx->extradata)
+                av_freep(&p->avctx->extradata);
+        }
+
         pthread_mutex_destroy(&p->mutex);
         pthread_mutex_destroy(&p->progress_mutex);
         pthread_cond_destroy(&p->input_cond);
@@ -669,6 +848,10 @@ static void frame_thread_free(AVCodecContext *avctx, int thread_count)
         av_freep(&p->avctx);
     }
 
+    /* avcodec_close() does not see the codec anymore */
+    if (codec->encode)
+        av_freep(&avctx->extradata);
+
     av_freep(&fctx->threads);
     pthread_mutex_destroy(&fctx->buffer_mutex);
     av_freep(&avctx->thread_opaque);
@@ -680,6 +863,7 @@ static int frame_thread_init(AVCodecContext *avctx)
     AVCodec *codec = avctx->codec;
     AVCodecContext *src = avctx;
     FrameThreadContext *fctx;
+    void *priv_data = NULL;
     int i, err = 0;
 
     if (thread_count <= 1) {
@@ -687,6 +871,14 @@ static int frame_thread_init(AVCodecContext *avctx)
         return 0;
     }
 
+    if (codec->encode && codec->priv_data_size) {
+        /* every encoding thread runs its own init() on the options set by the user */
+        priv_data = av_malloc(codec->priv_data_size);
+        if (!priv_data)
+            return AVERROR(ENOMEM);
+        memcpy(priv_data, avctx->priv_data, codec->priv_data_size);
+    }
+
     avctx->thread_opaque = fctx = av_mallocz(sizeof(FrameThreadContext));
 
     fctx->threads = av_mallocz(sizeof(PerThreadContext) * thread_count);
@@ -710,7 +902,25 @@ static int frame_thread_init(AVCodecContext *avctx)
         copy->thread_opaque = p;
         copy->pkt = &p->avpkt;
 
-        if (!i) {
+        if (codec->encode) {
+            /* each thread runs a plain single-threaded encoder */
+            copy->thread_count = 1;
+            copy->active_thread_type = 0;
+            if (i && priv_data) {
+                copy->priv_data = av_malloc(codec->priv_data_size);
+                memcpy(copy->priv_data, priv_data, codec->priv_data_size);
+            }
+
+            if (codec->init)
+                err = codec->init(copy);
+
+            if (!i && !err) {
+                err = update_context_from_encoder(avctx, copy);
+                if (copy->coded_frame)
+                    fctx->coded_frame = *copy->coded_frame;
+                avctx->coded_frame = &fctx->coded_frame;
+            }
+        } else if (!i) {
             src = copy;
 
             if (codec->init)
@@ -731,10 +941,12 @@ static int frame_thread_init(AVCodecContext *avctx)
         pthread_create(&p->thread, NULL, frame_worker_thread, p);
     }
 
+    av_free(priv_data);
     return 0;
 
 error:
     frame_thread_free(avctx, i+1);
+    av_free(priv_data);
 
     return err;
 }
@@ -877,6 +1089,11 @@ static void validate_thread_parameters(AVCodecContext *avctx)
                                 && !(avctx->flags & CODEC_FLAG_TRUNCATED)
                                 && !(avctx->flags & CODEC_FLAG_LOW_DELAY)
                                 && !(avctx->flags2 & CODEC_FLAG2_CHUNKS);
+    /* frame threading adds thread_count-1 frames of latency to encoders,
+       only use it instead of slice threading when asked for explicitly */
+    if (avctx->codec->encode && avctx->codec->capabilities & CODEC_CAP_SLICE_THREADS &&
+        avctx->thread_type & FF_THREAD_SLICE)
+        frame_threading_supported = 0;
     if (avctx->thread_count == 1) {
         avctx->active_thread_type = 0;
     } else if (frame_threading_supported && (avctx->thread_type & FF_THREAD_FRAME)) {
@@ -45,7 +45,7 @@ static const AVClass audioresample_context_class = {
 
 struct ReSampleContext {
     struct AVResampleContext *resample_context;
-    short *temp[MAX_CHANNELS];
+    void *temp[MAX_CHANNELS];
     int temp_len;
     float ratio;
     /* channel convert */
@@ -53,132 +53,47 @@ struct ReSampleContext {
     AVAudioConvert *convert_ctx[2];
     enum AVSampleFormat sample_fmt[2]; ///< input and output sample format
     unsigned sample_size[2];           ///< size of one sample in sample_fmt
-    short *buffer[2];                  ///< buffers used for conversion to S16
+    enum AVSampleFormat filter_fmt;    ///< sample format used for mixing and filtering
+    unsigned filter_size;              ///< size of one sample in filter_fmt
+    void *buffer[2];                   ///< buffers used for conversion to filter_fmt
     unsigned buffer_size[2];           ///< sizes of allocated buffers
 };
 
-/* n1: number of samples */
-static void stereo_to_mono(short *output, short *input, int n1)
-{
-    short *p, *q;
-    int n = n1;
-
-    p = input;
-    q = output;
-    while (n >= 4) {
-        q[0] = (p[0] + p[1]) >> 1;
-        q[1] = (p[2] + p[3]) >> 1;
-        q[2] = (p[4] + p[5]) >> 1;
-        q[3] = (p[6] + p[7]) >> 1;
-        q += 4;
-        p += 8;
-        n -= 4;
-    }
-    while (n > 0) {
-        q[0] = (p[0] + p[1]) >> 1;
-        q++;
-        p += 2;
-        n--;
-    }
-}
-
-/* n1: number of samples */
-static void mono_to_stereo(short *output, short *input, int n1)
-{
-    short *p, *q;
-    int n = n1;
-    int v;
-
-    p = input;
-    q = output;
-    while (n >= 4) {
-        v = p[0]; q[0] = v; q[1] = v;
-        v = p[1]; q[2] = v; q[3] = v;
-        v = p[2]; q[4] = v; q[5] = v;
-        v = p[3]; q[6] = v; q[7] = v;
-        q += 8;
-        p += 4;
-        n -= 4;
-    }
-    while (n > 0) {
-        v = p[0]; q[0] = v; q[1] = v;
-        q += 2;
-        p += 1;
-        n--;
-    }
-}
-
-/*
-5.1 to stereo input: [fl, fr, c, lfe, rl, rr]
-- Left = front_left + rear_gain * rear_left + center_gain * center
-- Right = front_right + rear_gain * rear_right + center_gain * center
-Where rear_gain is usually around 0.5-1.0 and
-      center_gain is almost always 0.7 (-3 dB)
-*/
-static void surround_to_stereo(short **output, short *input, int channels, int samples)
-{
-    int i;
-    short l, r;
-
-    for (i = 0; i < samples; i++) {
-        int fl,fr,c,rl,rr,lfe;
-        fl = input[0];
-        fr = input[1];
-        c = input[2];
-        lfe = input[3];
-        rl = input[4];
-        rr = input[5];
-
-        l = av_clip_int16(fl + (0.5 * rl) + (0.7 * c));
-        r = av_clip_int16(fr + (0.5 * rr) + (0.7 * c));
-
-        /* output l & r. */
-        *output[0]++ = l;
-        *output[1]++ = r;
-
-        /* increment input. */
-        input += channels;
-    }
-}
-
-static void deinterleave(short **output, short *input, int channels, int samples)
-{
-    int i, j;
-
-    for (i = 0; i < samples; i++) {
-        for (j = 0; j < channels; j++) {
-            *output[j]++ = *input++;
-        }
-    }
-}
-
-static void interleave(short *output, short **input, int channels, int samples)
-{
-    int i, j;
-
-    for (i = 0; i < samples; i++) {
-        for (j = 0; j < channels; j++) {
-            *output++ = *input[j]++;
-        }
-    }
-}
-
-static void ac3_5p1_mux(short *output, short *input1, short *input2, int n)
-{
-    int i;
-    short l, r;
-
-    for (i = 0; i < n; i++) {
-        l = *input1++;
-        r = *input2++;
-        *output++ = l;                  /* left */
-        *output++ = (l / 2) + (r / 2);  /* center */
-        *output++ = r;                  /* right */
-        *output++ = 0;                  /* left surround */
-        *output++ = 0;                  /* right surroud */
-        *output++ = 0;                  /* low freq */
-    }
-}
+#define RENAME(name) name ## _s16
+#define SAMPLE short
+#define AVG2(a, b) (((a) + (b)) >> 1)
+#define HALF(a) ((a) / 2)
+#define CLIP(x) av_clip_int16(x)
+#define RESAMPLE av_resample
+#include "resample_template.c"
+#undef RENAME
+#undef SAMPLE
+#undef AVG2
+#undef HALF
+#undef CLIP
+#undef RESAMPLE
+
+#define RENAME(name) name ## _s32
+#define SAMPLE int32_t
+#define AVG2(a, b) (((int64_t)(a) + (b)) >> 1)
+#define HALF(a) ((a) / 2)
+#define CLIP(x) av_clipl_int32(x)
+#define RESAMPLE av_resample_s32
+#include "resample_template.c"
+#undef RENAME
+#undef SAMPLE
+#undef AVG2
+#undef HALF
+#undef CLIP
+#undef RESAMPLE
+
+#define RENAME(name) name ## _flt
+#define SAMPLE float
+#define AVG2(a, b) (((a) + (b)) * 0.5f)
+#define HALF(a) ((a) * 0.5f)
+#define CLIP(x) (x)
+#define RESAMPLE av_resample_flt
+#include "resample_template.c"
 
 #define SUPPORT_RESAMPLE(ch1, ch2, ch3, ch4, ch5, ch6, ch7, ch8) \
     ch8<<7 | ch7<<6 | ch6<<5 | ch5<<4 | ch4<<3 | ch3<<2 | ch2<<1 | ch1<<0
@@ -242,22 +157,33 @@ ReSampleContext *av_audio_resample_init(int output_channels, int input_channels,
     s->sample_size[0] = av_get_bytes_per_sample(s->sample_fmt[0]);
     s->sample_size[1] = av_get_bytes_per_sample(s->sample_fmt[1]);
 
-    if (s->sample_fmt[0] != AV_SAMPLE_FMT_S16) {
-        if (!(s->convert_ctx[0] = av_audio_convert_alloc(AV_SAMPLE_FMT_S16, 1,
+    /* keep the precision of deeper input formats through the filter */
+    switch (s->sample_fmt[0]) {
+    case AV_SAMPLE_FMT_S32: s->filter_fmt = AV_SAMPLE_FMT_S32; break;
+    case AV_SAMPLE_FMT_FLT:
+    case AV_SAMPLE_FMT_DBL: s->filter_fmt = AV_SAMPLE_FMT_FLT; break;
+    default:                s->filter_fmt = AV_SAMPLE_FMT_S16; break;
+    }
+    s->filter_size = av_get_bytes_per_sample(s->filter_fmt);
+
+    if (s->sample_fmt[0] != s->filter_fmt) {
+        if (!(s->convert_ctx[0] = av_audio_convert_alloc(s->filter_fmt, 1,
                                                          s->sample_fmt[0], 1, NULL, 0))) {
             av_log(s, AV_LOG_ERROR,
-                   "Cannot convert %s sample format to s16 sample format\n",
-                   av_get_sample_fmt_name(s->sample_fmt[0]));
+                   "Cannot convert %s sample format to %s sample format\n",
+                   av_get_sample_fmt_name(s->sample_fmt[0]),
+                   av_get_sample_fmt_name(s->filter_fmt));
             av_free(s);
             return NULL;
         }
     }
 
-    if (s->sample_fmt[1] != AV_SAMPLE_FMT_S16) {
+    if (s->sample_fmt[1] != s->filter_fmt) {
         if (!(s->convert_ctx[1] = av_audio_convert_alloc(s->sample_fmt[1], 1,
-                                                         AV_SAMPLE_FMT_S16, 1, NULL, 0))) {
+                                                         s->filter_fmt, 1, NULL, 0))) {
             av_log(s, AV_LOG_ERROR,
-                   "Cannot convert s16 sample format to %s sample format\n",
+                   "Cannot convert %s sample format to %s sample format\n",
+                   av_get_sample_fmt_name(s->filter_fmt),
                    av_get_sample_fmt_name(s->sample_fmt[1]));
             av_audio_convert_free(s->convert_ctx[0]);
             av_free(s);
@@ -279,11 +205,8 @@ ReSampleContext *av_audio_resample_init(int output_channels, int input_channels,
 /* XXX: optimize it ! */
 int audio_resample(ReSampleContext *s, short *output, short *input, int nb_samples)
 {
-    int i, nb_samples1;
-    short *bufin[MAX_CHANNELS];
-    short *bufout[MAX_CHANNELS];
-    short *buftmp2[MAX_CHANNELS], *buftmp3[MAX_CHANNELS];
-    short *output_bak = NULL;
+    void *filter_in = input, *filter_out = output;
+    int nb_samples1;
     int lenout;
 
     if (s->input_channels == s->output_channels && s->ratio == 1.0 && 0) {
@@ -292,12 +215,12 @@ int audio_resample(ReSampleContext *s, short *output, short *input, int nb_sampl
         return nb_samples;
     }
 
-    if (s->sample_fmt[0] != AV_SAMPLE_FMT_S16) {
+    if (s->sample_fmt[0] != s->filter_fmt) {
         int istride[1] = { s->sample_size[0] };
-        int ostride[1] = { 2 };
+        int ostride[1] = { s->filter_size };
         const void *ibuf[1] = { input };
         void       *obuf[1];
-        unsigned input_size = nb_samples * s->input_channels * 2;
+        unsigned input_size = nb_samples * s->input_channels * s->filter_size;
 
         if (!s->buffer_size[0] || s->buffer_size[0] < input_size) {
             av_free(s->buffer[0]);
@@ -318,17 +241,17 @@ int audio_resample(ReSampleContext *s, short *output, short *input, int nb_sampl
             return 0;
         }
 
-        input = s->buffer[0];
+        filter_in = s->buffer[0];
     }
 
     lenout= 2*s->output_channels*nb_samples * s->ratio + 16;
 
-    if (s->sample_fmt[1] != AV_SAMPLE_FMT_S16) {
-        output_bak = output;
+    if (s->sample_fmt[1] != s->filter_fmt) {
+        unsigned output_size = lenout * s->filter_size;
 
-        if (!s->buffer_size[1] || s->buffer_size[1] < lenout) {
+        if (!s->buffer_size[1] || s->buffer_size[1] < output_size) {
             av_free(s->buffer[1]);
-            s->buffer_size[1] = lenout;
+            s->buffer_size[1] = output_size;
             s->buffer[1] = av_malloc(s->buffer_size[1]);
             if (!s->buffer[1]) {
                 av_log(s->resample_context, AV_LOG_ERROR, "Could not allocate buffer\n");
@@ -336,66 +259,26 @@ int audio_resample(ReSampleContext *s, short *output, short *input, int nb_sampl
             }
         }
 
-        output = s->buffer[1];
+        filter_out = s->buffer[1];
     }
 
-    /* XXX: move those malloc to resample init code */
-    for (i = 0; i < s->filter_channels; i++) {
-        bufin[i] = av_malloc((nb_samples + s->temp_len) * sizeof(short));
-        memcpy(bufin[i], s->temp[i], s->temp_len * sizeof(short));
-        buftmp2[i] = bufin[i] + s->temp_len;
-        bufout[i] = av_malloc(lenout * sizeof(short));
+    switch (s->filter_fmt) {
+    case AV_SAMPLE_FMT_S32:
+        nb_samples1 = resample_channels_s32(s, filter_out, filter_in, nb_samples, lenout);
+        break;
+    case AV_SAMPLE_FMT_FLT:
+        nb_samples1 = resample_channels_flt(s, filter_out, filter_in, nb_samples, lenout);
+        break;
+    default:
+        nb_samples1 = resample_channels_s16(s, filter_out, filter_in, nb_samples, lenout);
+        break;
     }
 
-    if (s->input_channels == 2 && s->output_channels == 1) {
-        buftmp3[0] = output;
-        stereo_to_mono(buftmp2[0], input, nb_samples);
-    } else if (s->output_channels >= 2 && s->input_channels == 1) {
-        buftmp3[0] = bufout[0];
-        memcpy(buftmp2[0], input, nb_samples * sizeof(short));
-    } else if (s->input_channels == 6 && s->output_channels ==2) {
-        buftmp3[0] = bufout[0];
-        buftmp3[1] = bufout[1];
-        surround_to_stereo(buftmp2, input, s->input_channels, nb_samples);
-    } else if (s->output_channels >= s->input_channels && s->input_channels >= 2) {
-        for (i = 0; i < s->input_channels; i++) {
-            buftmp3[i] = bufout[i];
-        }
-        deinterleave(buftmp2, input, s->input_channels, nb_samples);
-    } else {
-        buftmp3[0] = output;
-        memcpy(buftmp2[0], input, nb_samples * sizeof(short));
-    }
-
-    nb_samples += s->temp_len;
-
-    /* resample each channel */
-    nb_samples1 = 0; /* avoid warning */
-    for (i = 0; i < s->filter_channels; i++) {
-        int consumed;
-        int is_last = i + 1 == s->filter_channels;
-
-        nb_samples1 = av_resample(s->resample_context, buftmp3[i], bufin[i],
-                                  &consumed, nb_samples, lenout, is_last);
-        s->temp_len = nb_samples - consumed;
-        s->temp[i] = av_realloc(s->temp[i], s->temp_len * sizeof(short));
-        memcpy(s->temp[i], bufin[i] + consumed, s->temp_len * sizeof(short));
-    }
-
-    if (s->output_channels == 2 && s->input_channels == 1) {
-        mono_to_stereo(output, buftmp3[0], nb_samples1);
-    } else if (s->output_channels == 6 && s->input_channels == 2) {
-        ac3_5p1_mux(output, buftmp3[0], buftmp3[1], nb_samples1);
-    } else if ((s->output_channels == s->input_channels && s->input_channels >= 2) ||
-               (s->output_channels == 2 && s->input_channels == 6)) {
-        interleave(output, buftmp3, s->output_channels, nb_samples1);
-    }
-
-    if (s->sample_fmt[1] != AV_SAMPLE_FMT_S16) {
-        int istride[1] = { 2 };
+    if (s->sample_fmt[1] != s->filter_fmt) {
+        int istride[1] = { s->filter_size };
         int ostride[1] = { s->sample_size[1] };
-        const void *ibuf[1] = { output };
-        void       *obuf[1] = { output_bak };
+        const void *ibuf[1] = { filter_out };
+        void       *obuf[1] = { output };
 
         if (av_audio_convert(s->convert_ctx[1], obuf, ostride,
                              ibuf, istride, nb_samples1 * s->output_channels) < 0) {
@@ -405,11 +288,6 @@ int audio_resample(ReSampleContext *s, short *output, short *input, int nb_sampl
         }
     }
 
-    for (i = 0; i < s->filter_channels; i++) {
-        av_free(bufin[i]);
-        av_free(bufout[i]);
-    }
-
     return nb_samples1;
 }
 
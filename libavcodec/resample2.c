@@ -27,6 +27,7 @@
 
 #include "avcodec.h"
 #include "dsputil.h"
+#include "resample2.h"
 
 #ifndef CONFIG_RESAMPLE_HP
 #define FILTER_SHIFT 15
@@ -55,10 +56,15 @@
 #define WINDOW_TYPE 24
 #endif
 
+/* window of the float and 32 bit filter banks */
+#define WINDOW_TYPE_HP 12
 
 typedef struct AVResampleContext{
     const AVClass *av_class;
     FELEM *filter_bank;
+    float  *filter_bank_flt;  ///< built on first use by av_resample_flt()
+    double *filter_bank_dbl;  ///< built on first use by av_resample_s32()
+    double factor;
     int filter_length;
     int ideal_dst_incr;
     int dst_incr;
@@ -69,6 +75,7 @@ typedef struct AVResampleContext{
     int phase_shift;
     int phase_mask;
     int linear;
+    ResampleDSPContext dsp;
 }AVResampleContext;
 
 /**
@@ -91,12 +98,13 @@ static double bessel(double x){
 
 /**
  * builds a polyphase filterbank.
+ * @param filter_dbl if not NULL, also store the normalized coefficients there
  * @param factor resampling factor
  * @param scale wanted sum of coefficients for each filter
  * @param type 0->cubic, 1->blackman nuttall windowed sinc, 2..16->kaiser windowed sinc beta=2..16
  * @return 0 on success, negative on error
  */
-static int build_filter(FELEM *filter, double factor, int tap_count, int phase_count, int scale, int type){
+static int build_filter(FELEM *filter, double *filter_dbl, double factor, int tap_count, int phase_count, int scale, int type){
     int ph, i;
     double x, y, w;
     double *tab = av_malloc(tap_count * sizeof(*tab));
@@ -138,6 +146,10 @@ static int build_filter(FELEM *filter, double factor, int tap_count, int phase_c
 
         /* normalize so that an uniform color remains the same */
         for(i=0;i<tap_count;i++) {
+            if (filter_dbl)
+                filter_dbl[ph * tap_count + i] = tab[i] / norm;
+            if (!filter)
+                continue;
 #ifdef CONFIG_RESAMPLE_AUDIOPHILE_KIDDY_MODE
             filter[ph * tap_count + i] = tab[i] / norm;
 #else
@@ -186,6 +198,77 @@ static int build_filter(FELEM *filter, double factor, int tap_count, int phase_c
     return 0;
 }
 
+static float dot_flt_c(const float *src, const float *filter, int len){
+    float sum=0;
+    int i;
+
+    for(i=0; i<len; i++)
+        sum += src[i] * filter[i];
+    return sum;
+}
+
+static double dot_s32_c(const int32_t *src, const double *filter, int len){
+    double sum=0;
+    int i;
+
+    for(i=0; i<len; i++)
+        sum += src[i] * filter[i];
+    return sum;
+}
+
+static av_always_inline FELEM2 dot_s16(const short *src, const FELEM *filter, int len){
+    FELEM2 sum=0;
+    int i;
+
+    for(i=0; i<len; i++)
+        sum += src[i] * (FELEM2)filter[i];
+    return sum;
+}
+
+/**
+ * Return the double precision filter bank, build it on first use.
+ */
+static const double *get_filter_bank_dbl(AVResampleContext *c){
+    int phase_count= c->phase_mask+1;
+    double *bank;
+
+    if (c->filter_bank_dbl)
+        return c->filter_bank_dbl;
+
+    bank= av_malloc(c->filter_length*(phase_count+1)*sizeof(*bank));
+    if (!bank)
+        return NULL;
+    if (build_filter(NULL, bank, c->factor, c->filter_length, phase_count, 1, WINDOW_TYPE_HP)) {
+        av_free(bank);
+        return NULL;
+    }
+    memcpy(&bank[c->filter_length*phase_count+1], bank, (c->filter_length-1)*sizeof(*bank));
+    bank[c->filter_length*phase_count]= bank[c->filter_length - 1];
+
+    return c->filter_bank_dbl= bank;
+}
+
+/**
+ * Return the single precision filter bank, build it on first use.
+ */
+static const float *get_filter_bank_flt(AVResampleContext *c){
+    int i, size= c->filter_length*(c->phase_mask+2);
+    const double *bank_dbl;
+
+    if (c->filter_bank_flt)
+        return c->filter_bank_flt;
+
+    if (!(bank_dbl= get_filter_bank_dbl(c)))
+        return NULL;
+    c->filter_bank_flt= av_malloc(size*sizeof(*c->filter_bank_flt));
+    if (!c->filter_bank_flt)
+        return NULL;
+    for(i=0; i<size; i++)
+        c->filter_bank_flt[i]= bank_dbl[i];
+
+    return c->filter_bank_flt;
+}
+
 AVResampleContext *av_resample_init(int out_rate, int in_rate, int filter_size, int phase_shift, int linear, double cutoff){
     AVResampleContext *c= av_mallocz(sizeof(AVResampleContext));
     double factor= FFMIN(out_rate * cutoff / in_rate, 1.0);
@@ -197,12 +280,13 @@ AVResampleContext *av_resample_init(int out_rate, int in_rate, int filter_size,
     c->phase_shift= phase_shift;
     c->phase_mask= phase_count-1;
     c->linear= linear;
+    c->factor= factor;
 
     c->filter_length= FFMAX((int)ceil(filter_size/factor), 1);
     c->filter_bank= av_mallocz(c->filter_length*(phase_count+1)*sizeof(FELEM));
     if (!c->filter_bank)
         goto error;
-    if (build_filter(c->filter_bank, factor, c->filter_length, phase_count, 1<<FILTER_SHIFT, WINDOW_TYPE))
+    if (build_filter(c->filter_bank, NULL, factor, c->filter_length, phase_count, 1<<FILTER_SHIFT, WINDOW_TYPE))
         goto error;
     memcpy(&c->filter_bank[c->filter_length*phase_count+1], c->filter_bank, (c->filter_length-1)*sizeof(FELEM));
     c->filter_bank[c->filter_length*phase_count]= c->filter_bank[c->filter_length - 1];
@@ -211,6 +295,12 @@ AVResampleContext *av_resample_init(int out_rate, int in_rate, int filter_size,
     c->ideal_dst_incr= c->dst_incr= in_rate * phase_count;
     c->index= -phase_count*((c->filter_length-1)/2);
 
+    c->dsp.dot_flt= dot_flt_c;
+    c->dsp.dot_s32= dot_s32_c;
+#if HAVE_MMX
+    ff_resample_dsp_init_mmx(&c->dsp);
+#endif
+
     return c;
 error:
     av_free(c->filter_bank);
@@ -220,6 +310,8 @@ error:
 
 void av_resample_close(AVResampleContext *c){
     av_freep(&c->filter_bank);
+    av_freep(&c->filter_bank_flt);
+    av_freep(&c->filter_bank_dbl);
     av_freep(&c);
 }
 
@@ -229,92 +321,55 @@ void av_resample_compensate(AVResampleContext *c, int sample_delta, int compensa
     c->dst_incr = c->ideal_dst_incr - c->ideal_dst_incr * (int64_t)sample_delta / compensation_distance;
 }
 
-int av_resample(AVResampleContext *c, short *dst, short *src, int *consumed, int src_size, int dst_size, int update_ctx){
-    int dst_index, i;
-    int index= c->index;
-    int frac= c->frac;
-    int dst_incr_frac= c->dst_incr % c->src_incr;
-    int dst_incr=      c->dst_incr / c->src_incr;
-    int compensation_distance= c->compensation_distance;
-
-  if(compensation_distance == 0 && c->filter_length == 1 && c->phase_shift==0){
-        int64_t index2= ((int64_t)index)<<32;
-        int64_t incr= (1LL<<32) * c->dst_incr / c->src_incr;
-        dst_size= FFMIN(dst_size, (src_size-1-index) * (int64_t)c->src_incr / c->dst_incr);
-
-        for(dst_index=0; dst_index < dst_size; dst_index++){
-            dst[dst_index] = src[index2>>32];
-            index2 += incr;
-        }
-        frac += dst_index * dst_incr_frac;
-        index += dst_index * dst_incr;
-        index += frac / c->src_incr;
-        frac %= c->src_incr;
-  }else{
-    for(dst_index=0; dst_index < dst_size; dst_index++){
-        FELEM *filter= c->filter_bank + c->filter_length*(index & c->phase_mask);
-        int sample_index= index >> c->phase_shift;
-        FELEM2 val=0;
-
-        if(sample_index < 0){
-            for(i=0; i<c->filter_length; i++)
-                val += src[FFABS(sample_index + i) % src_size] * filter[i];
-        }else if(sample_index + c->filter_length > src_size){
-            break;
-        }else if(c->linear){
-            FELEM2 v2=0;
-            for(i=0; i<c->filter_length; i++){
-                val += src[sample_index + i] * (FELEM2)filter[i];
-                v2  += src[sample_index + i] * (FELEM2)filter[i + c->filter_length];
-            }
-            val+=(v2-val)*(FELEML)frac / c->src_incr;
-        }else{
-            for(i=0; i<c->filter_length; i++){
-                val += src[sample_index + i] * (FELEM2)filter[i];
-            }
-        }
-
+#define RENAME(name) name
+#define SAMPLE short
+#define TAP FELEM
+#define ACC FELEM2
+#define ACCL FELEML
+#define BANK(c) (c)->filter_bank
+#define DOT(c, s, f) dot_s16(s, f, (c)->filter_length)
 #ifdef CONFIG_RESAMPLE_AUDIOPHILE_KIDDY_MODE
-        dst[dst_index] = av_clip_int16(lrintf(val));
+#define OUTPUT(d, v) d = av_clip_int16(lrintf(v))
 #else
-        val = (val + (1<<(FILTER_SHIFT-1)))>>FILTER_SHIFT;
-        dst[dst_index] = (unsigned)(val + 32768) > 65535 ? (val>>31) ^ 32767 : val;
+#define OUTPUT(d, v) do {                                           \
+        v = (v + (1<<(FILTER_SHIFT-1)))>>FILTER_SHIFT;              \
+        d = (unsigned)(v + 32768) > 65535 ? (v>>31) ^ 32767 : v;    \
+    } while (0)
 #endif
-
-        frac += dst_incr_frac;
-        index += dst_incr;
-        if(frac >= c->src_incr){
-            frac -= c->src_incr;
-            index++;
-        }
-
-        if(dst_index + 1 == compensation_distance){
-            compensation_distance= 0;
-            dst_incr_frac= c->ideal_dst_incr % c->src_incr;
-            dst_incr=      c->ideal_dst_incr / c->src_incr;
-        }
-    }
-  }
-    *consumed= FFMAX(index, 0) >> c->phase_shift;
-    if(index>=0) index &= c->phase_mask;
-
-    if(compensation_distance){
-        compensation_distance -= dst_index;
-        assert(compensation_distance > 0);
-    }
-    if(update_ctx){
-        c->frac= frac;
-        c->index= index;
-        c->dst_incr= dst_incr_frac + c->src_incr*dst_incr;
-        c->compensation_distance= compensation_distance;
-    }
-#if 0
-    if(update_ctx && !c->compensation_distance){
-#undef rand
-        av_resample_compensate(c, rand() % (8000*2) - 8000, 8000*2);
-av_log(NULL, AV_LOG_DEBUG, "%d %d %d\n", c->dst_incr, c->ideal_dst_incr, c->compensation_distance);
-    }
-#endif
-
-    return dst_index;
-}
+#include "resample2_template.c"
+#undef RENAME
+#undef SAMPLE
+#undef TAP
+#undef ACC
+#undef ACCL
+#undef BANK
+#undef DOT
+#undef OUTPUT
+
+#define RENAME(name) name ## _flt
+#define SAMPLE float
+#define TAP float
+#define ACC float
+#define ACCL double
+#define BANK(c) get_filter_bank_flt(c)
+#define DOT(c, s, f) (c)->dsp.dot_flt(s, f, (c)->filter_length)
+#define OUTPUT(d, v) d = v
+#include "resample2_template.c"
+#undef RENAME
+#undef SAMPLE
+#undef TAP
+#undef ACC
+#undef ACCL
+#undef BANK
+#undef DOT
+#undef OUTPUT
+
+#define RENAME(name) name ## _s32
+#define SAMPLE int32_t
+#define TAP double
+#define ACC double
+#define ACCL double
+#define BANK(c) get_filter_bank_dbl(c)
+#define DOT(c, s, f) (c)->dsp.dot_s32(s, f, (c)->filter_length)
+#define OUTPUT(d, v) d = av_clipl_int32(llrint(v))
+#include "resample2_template.c"
@@ -0,0 +1,37 @@
+/*
+ * audio resampling
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_RESAMPLE2_H
+#define AVCODEC_RESAMPLE2_H
+
+#include <stdint.h>
+
+/**
+ * Polyphase filter kernels of the float and 32 bit resamplers,
+ * len is the number of taps, src and filter need not be aligned.
+ */
+typedef struct ResampleDSPContext {
+    float  (*dot_flt)(const float   *src, const float  *filter, int len);
+    double (*dot_s32)(const int32_t *src, const double *filter, int len);
+} ResampleDSPContext;
+
+void ff_resample_dsp_init_mmx(ResampleDSPContext *c);
+
+#endif /* AVCODEC_RESAMPLE2_H */
@@ -0,0 +1,229 @@
+/*
+ * samplerate conversion for both audio and video
+ * Copyright (c) 2000 Fabrice Bellard
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * channel mixing and resampling, sample format dependent part
+ *
+ * The including file defines:
+ * RENAME(name)  name of the instantiated function
+ * SAMPLE        sample type
+ * AVG2(a, b)    mean of two samples
+ * HALF(a)       half of a sample
+ * CLIP(x)       converts a double to a sample, clipping if needed
+ * RESAMPLE      av_resample() flavour working on SAMPLE
+ */
+
+/* n1: number of samples */
+static void RENAME(stereo_to_mono)(SAMPLE *output, SAMPLE *input, int n1)
+{
+    SAMPLE *p, *q;
+    int n = n1;
+
+    p = input;
+    q = output;
+    while (n >= 4) {
+        q[0] = AVG2(p[0], p[1]);
+        q[1] = AVG2(p[2], p[3]);
+        q[2] = AVG2(p[4], p[5]);
+        q[3] = AVG2(p[6], p[7]);
+        q += 4;
+        p += 8;
+        n -= 4;
+    }
+    while (n > 0) {
+        q[0] = AVG2(p[0], p[1]);
+        q++;
+        p += 2;
+        n--;
+    }
+}
+
+/* n1: number of samples */
+static void RENAME(mono_to_stereo)(SAMPLE *output, SAMPLE *input, int n1)
+{
+    SAMPLE *p, *q;
+    int n = n1;
+    SAMPLE v;
+
+    p = input;
+    q = output;
+    while (n >= 4) {
+        v = p[0]; q[0] = v; q[1] = v;
+        v = p[1]; q[2] = v; q[3] = v;
+        v = p[2]; q[4] = v; q[5] = v;
+        v = p[3]; q[6] = v; q[7] = v;
+        q += 8;
+        p += 4;
+        n -= 4;
+    }
+    while (n > 0) {
+        v = p[0]; q[0] = v; q[1] = v;
+        q += 2;
+        p += 1;
+        n--;
+    }
+}
+
+/*
+5.1 to stereo input: [fl, fr, c, lfe, rl, rr]
+- Left = front_left + rear_gain * rear_left + center_gain * center
+- Right = front_right + rear_gain * rear_right + center_gain * center
+Where rear_gain is usually around 0.5-1.0 and
+      center_gain is almost always 0.7 (-3 dB)
+*/
+static void RENAME(surround_to_stereo)(SAMPLE **output, SAMPLE *input, int channels, int samples)
+{
+    int i;
+    SAMPLE l, r;
+
+    for (i = 0; i < samples; i++) {
+        SAMPLE fl,fr,c,rl,rr;
+        fl = input[0];
+        fr = input[1];
+        c = input[2];
+        rl = input[4];
+        rr = input[5];
+
+        l = CLIP(fl + (0.5 * rl) + (0.7 * c));
+        r = CLIP(fr + (0.5 * rr) + (0.7 * c));
+
+        /* output l & r. */
+        *output[0]++ = l;
+        *output[1]++ = r;
+
+        /* increment input. */
+        input += channels;
+    }
+}
+
+static void RENAME(deinterleave)(SAMPLE **output, SAMPLE *input, int channels, int samples)
+{
+    int i, j;
+
+    for (i = 0; i < samples; i++) {
+        for (j = 0; j < channels; j++) {
+            *output[j]++ = *input++;
+        }
+    }
+}
+
+static void RENAME(interleave)(SAMPLE *output, SAMPLE **input, int channels, int samples)
+{
+    int i, j;
+
+    for (i = 0; i < samples; i++) {
+        for (j = 0; j < channels; j++) {
+            *output++ = *input[j]++;
+        }
+    }
+}
+
+static void RENAME(ac3_5p1_mux)(SAMPLE *output, SAMPLE *input1, SAMPLE *input2, int n)
+{
+    int i;
+    SAMPLE l, r;
+
+    for (i = 0; i < n; i++) {
+        l = *input1++;
+        r = *input2++;
+        *output++ = l;                  /* left */
+        *output++ = HALF(l) + HALF(r);  /* center */
+        *output++ = r;                  /* right */
+        *output++ = 0;                  /* left surround */
+        *output++ = 0;                  /* right surroud */
+        *output++ = 0;                  /* low freq */
+    }
+}
+
+/* output and input are interleaved, lenout is the space per channel */
+static int RENAME(resample_channels)(ReSampleContext *s, SAMPLE *output, SAMPLE *input,
+                                     int nb_samples, int lenout)
+{
+    int i, nb_samples1;
+    SAMPLE *bufin[MAX_CHANNELS];
+    SAMPLE *bufout[MAX_CHANNELS];
+    SAMPLE *buftmp2[MAX_CHANNELS], *buftmp3[MAX_CHANNELS];
+
+    /* XXX: move those malloc to resample init code */
+    for (i = 0; i < s->filter_channels; i++) {
+        bufin[i] = av_malloc((nb_samples + s->temp_len) * sizeof(SAMPLE));
+        memcpy(bufin[i], s->temp[i], s->temp_len * sizeof(SAMPLE));
+        buftmp2[i] = bufin[i] + s->temp_len;
+        bufout[i] = av_malloc(lenout * sizeof(SAMPLE));
+    }
+
+    if (s->input_channels == 2 && s->output_channels == 1) {
+        buftmp3[0] = output;
+        RENAME(stereo_to_mono)(buftmp2[0], input, nb_samples);
+    } else if (s->output_channels >= 2 && s->input_channels == 1) {
+        buftmp3[0] = bufout[0];
+        memcpy(buftmp2[0], input, nb_samples * sizeof(SAMPLE));
+    } else if (s->input_channels == 6 && s->output_channels ==2) {
+        buftmp3[0] = bufout[0];
+        buftmp3[1] = bufout[1];
+        RENAME(surround_to_stereo)(buftmp2, input, s->input_channels, nb_samples);
+    } else if (s->output_channels >= s->input_channels && s->input_channels >= 2) {
+        for (i = 0; i < s->input_channels; i++) {
+            buftmp3[i] = bufout[i];
+        }
+        RENAME(deinterleave)(buftmp2, input, s->input_channels, nb_samples);
+    } else {
+        buftmp3[0] = output;
+        memcpy(buftmp2[0], input, nb_samples * sizeof(SAMPLE));
+    }
+
+    nb_samples += s->temp_len;
+
+    /* resample each channel */
+    nb_samples1 = 0; /* avoid warning */
+    for (i = 0; i < s->filter_channels; i++) {
+        int consumed;
+        int is_last = i + 1 == s->filter_channels;
+
+        nb_samples1 = RESAMPLE(s->resample_context, buftmp3[i], bufin[i],
+                               &consumed, nb_samples, lenout, is_last);
+        if (nb_samples1 < 0) {
+            av_log(s->resample_context, AV_LOG_ERROR, "Could not allocate filter bank\n");
+            nb_samples1 = 0;
+            break;
+        }
+        s->temp_len = nb_samples - consumed;
+        s->temp[i] = av_realloc(s->temp[i], s->temp_len * sizeof(SAMPLE));
+        memcpy(s->temp[i], bufin[i] + consumed, s->temp_len * sizeof(SAMPLE));
+    }
+
+    if (s->output_channels == 2 && s->input_channels == 1) {
+        RENAME(mono_to_stereo)(output, buftmp3[0], nb_samples1);
+    } else if (s->output_channels == 6 && s->input_channels == 2) {
+        RENAME(ac3_5p1_mux)(output, buftmp3[0], buftmp3[1], nb_samples1);
+    } else if ((s->output_channels == s->input_channels && s->input_channels >= 2) ||
+               (s->output_channels == 2 && s->input_channels == 6)) {
+        RENAME(interleave)(output, buftmp3, s->output_channels, nb_samples1);
+    }
+
+    for (i = 0; i < s->filter_channels; i++) {
+        av_free(bufin[i]);
+        av_free(bufout[i]);
+    }
+
+    return nb_samples1;
+}
@@ -48,6 +48,16 @@ void ff_thread_flush(AVCodecContext *avctx);
 int ff_thread_decode_frame(AVCodecContext *avctx, AVFrame *picture,
                            int *got_picture_ptr, AVPacket *avpkt);
 
+/**
+ * Submits a new picture to an encoding thread.
+ * Returns the size of the next available packet written to buf,
+ * or 0 if none is available yet. Pass a NULL pict to flush.
+ *
+ * Parameters are the same as avcodec_encode_video().
+ */
+int ff_thread_encode_frame(AVCodecContext *avctx, uint8_t *buf, int buf_size,
+                           const AVFrame *pict);
+
 /**
  * If the codec defines update_thread_context(), call this
  * when they are ready for the next thread to start decoding
@@ -701,8 +701,13 @@ int attribute_align_arg avcodec_encode_video(AVCodecContext *avctx, uint8_t *buf
     }
     if(av_image_check_size(avctx->width, avctx->height, 0, avctx))
         return -1;
-    if((avctx->codec->capabilities & CODEC_CAP_DELAY) || pict){
-        int ret = avctx->codec->encode(avctx, buf, buf_size, pict);
+    if((avctx->codec->capabilities & CODEC_CAP_DELAY) || pict ||
+       (avctx->active_thread_type&FF_THREAD_FRAME)){
+        int ret;
+        if (HAVE_PTHREADS && avctx->active_thread_type&FF_THREAD_FRAME)
+            ret = ff_thread_encode_frame(avctx, buf, buf_size, pict);
+        else
+            ret = avctx->codec->encode(avctx, buf, buf_size, pict);
         avctx->frame_number++;
         emms_c(); //needed to avoid an emms_c() call before every return;
 
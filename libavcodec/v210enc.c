@@ -23,9 +23,34 @@
 
 #include "avcodec.h"
 #include "bytestream.h"
+#include "v210enc.h"
+
+#define CLIP(v) av_clip(v, 4, 1019)
+
+#define WRITE_PIXELS(a, b, c)           \
+    do {                                \
+        val =   CLIP(*a++);             \
+        val |= (CLIP(*b++) << 10) |     \
+               (CLIP(*c++) << 20);      \
+        bytestream_put_le32(&p, val);   \
+    } while (0)
+
+static void v210_planar_pack_c(const uint16_t *y, const uint16_t *u, const uint16_t *v, uint8_t *p, int width)
+{
+    uint32_t val;
+    int i;
+
+    for (i = 0; i < width - 5; i += 6) {
+        WRITE_PIXELS(u, y, v);
+        WRITE_PIXELS(y, u, y);
+        WRITE_PIXELS(v, y, u);
+        WRITE_PIXELS(y, v, y);
+    }
+}
 
 static av_cold int encode_init(AVCodecContext *avctx)
 {
+    V210EncContext *s = avctx->priv_data;
     int aligned_width = ((avctx->width + 47) / 48) * 48;
     int stride = aligned_width * 8 / 3;
 
@@ -41,6 +66,11 @@ static av_cold int encode_init(AVCodecContext *avctx)
 
     avctx->coded_frame = avcodec_alloc_frame();
 
+    s->pack_line = v210_planar_pack_c;
+
+    if (HAVE_MMX)
+        v210enc_x86_init(s);
+
     avctx->coded_frame->key_frame = 1;
     avctx->coded_frame->pict_type = AV_PICTURE_TYPE_I;
 
@@ -53,6 +83,7 @@ static av_cold int encode_init(AVCodecContext *avctx)
 static int encode_frame(AVCodecContext *avctx, unsigned char *buf,
                         int buf_size, void *data)
 {
+    V210EncContext *s = avctx->priv_data;
     const AVFrame *pic = data;
     int aligned_width = ((avctx->width + 47) / 48) * 48;
     int stride = aligned_width * 8 / 3;
@@ -68,24 +99,18 @@ static int encode_frame(AVCodecContext *avctx, unsigned char *buf,
         return -1;
     }
 
-#define CLIP(v) av_clip(v, 4, 1019)
+    for (h = 0; h < avctx->height; h++) {
+        uint32_t val = 0;
 
-#define WRITE_PIXELS(a, b, c)           \
-    do {                                \
-        val =   CLIP(*a++);             \
-        val |= (CLIP(*b++) << 10) |     \
-               (CLIP(*c++) << 20);      \
-        bytestream_put_le32(&p, val);   \
-    } while (0)
+        w = (avctx->width / 6) * 6;
+        if (w)
+            s->pack_line(y, u, v, p, w);
+
+        y += w;
+        u += w >> 1;
+        v += w >> 1;
+        p += (w << 3) / 3;
 
-    for (h = 0; h < avctx->height; h++) {
-        uint32_t val;
-        for (w = 0; w < avctx->width - 5; w += 6) {
-            WRITE_PIXELS(u, y, v);
-            WRITE_PIXELS(y, u, y);
-            WRITE_PIXELS(v, y, u);
-            WRITE_PIXELS(y, v, y);
-        }
         if (w < avctx->width - 1) {
             WRITE_PIXELS(u, y, v);
 
@@ -123,10 +148,11 @@ AVCodec ff_v210_encoder = {
     "v210",
     AVMEDIA_TYPE_VIDEO,
     CODEC_ID_V210,
-    0,
+    sizeof(V210EncContext),
     encode_init,
     encode_frame,
     encode_close,
+    .capabilities = CODEC_CAP_FRAME_THREADS,
     .pix_fmts = (const enum PixelFormat[]){PIX_FMT_YUV422P10, PIX_FMT_NONE},
     .long_name = NULL_IF_CONFIG_SMALL("Uncompressed 4:2:2 10-bit"),
 };
@@ -0,0 +1,261 @@
+/*
+ * planar/interleaved audio sample shuffling SIMD functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/audioshuffle.h"
+
+#if HAVE_SSE
+/* load the channel pointer at offset off of the array in %4, then access
+ * the sample at byte offset %0 in it */
+#define PLANE(op, a, b, off)                        \
+    "mov         "off"(%4), %2          \n\t"       \
+    op"          "a", "b"               \n\t"
+
+#define PTR_OPERANDS                                                    \
+    "i"(0*sizeof(uint8_t*)), "i"(1*sizeof(uint8_t*)),                   \
+    "i"(2*sizeof(uint8_t*)), "i"(3*sizeof(uint8_t*)),                   \
+    "i"(4*sizeof(uint8_t*)), "i"(5*sizeof(uint8_t*)),                   \
+    "i"(6*sizeof(uint8_t*)), "i"(7*sizeof(uint8_t*))
+
+/* frames of 8 channels are transposed 4 samples at a time */
+static void deinterleave_16_sse2(uint8_t * const *dst, const uint8_t *src,
+                                 int channels, int len)
+{
+    int simd_len = len & ~3;
+    int i, ch;
+
+    for (ch = 0; ch + 8 <= channels && simd_len; ch += 8) {
+        const uint8_t *s = src + 2*ch;
+        x86_reg pos = 0, end = 2*simd_len, tmp;
+
+        __asm__ volatile(
+            "1:                                 \n\t"
+            "movdqu          (%1), %%xmm0       \n\t"
+            "movdqu       (%1,%3), %%xmm1       \n\t"
+            "lea        (%1,%3,2), %1           \n\t"
+            "movdqu          (%1), %%xmm2       \n\t"
+            "movdqu       (%1,%3), %%xmm3       \n\t"
+            "lea        (%1,%3,2), %1           \n\t"
+            "movdqa       %%xmm0, %%xmm4        \n\t"
+            "punpcklwd    %%xmm1, %%xmm4        \n\t"
+            "punpckhwd    %%xmm1, %%xmm0        \n\t"
+            "movdqa       %%xmm2, %%xmm5        \n\t"
+            "punpcklwd    %%xmm3, %%xmm5        \n\t"
+            "punpckhwd    %%xmm3, %%xmm2        \n\t"
+            "movdqa       %%xmm4, %%xmm6        \n\t"
+            "punpckldq    %%xmm5, %%xmm6        \n\t"
+            "punpckhdq    %%xmm5, %%xmm4        \n\t"
+            "movdqa       %%xmm0, %%xmm7        \n\t"
+            "punpckldq    %%xmm2, %%xmm7        \n\t"
+            "punpckhdq    %%xmm2, %%xmm0        \n\t"
+            PLANE("movq",   "%%xmm6", "(%2,%0)", "%c6")
+            PLANE("movhps", "%%xmm6", "(%2,%0)", "%c7")
+            PLANE("movq",   "%%xmm4", "(%2,%0)", "%c8")
+            PLANE("movhps", "%%xmm4", "(%2,%0)", "%c9")
+            PLANE("movq",   "%%xmm7", "(%2,%0)", "%c10")
+            PLANE("movhps", "%%xmm7", "(%2,%0)", "%c11")
+            PLANE("movq",   "%%xmm0", "(%2,%0)", "%c12")
+            PLANE("movhps", "%%xmm0", "(%2,%0)", "%c13")
+            "add             $8, %0             \n\t"
+            "cmp             %5, %0             \n\t"
+            "jl              1b                 \n\t"
+            : "+r"(pos), "+r"(s), "=&r"(tmp)
+            : "r"((x86_reg)2*channels), "r"(dst + ch), "m"(end), PTR_OPERANDS
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                           "%xmm4", "%xmm5", "%xmm6", "%xmm7",) "memory"
+        );
+    }
+
+    for (i = 0; i < len; i++)
+        for (ch = i < simd_len ? channels & ~7 : 0; ch < channels; ch++)
+            ((uint16_t *)dst[ch])[i] = ((const uint16_t *)src)[i*channels + ch];
+}
+
+static void interleave_16_sse2(uint8_t *dst, const uint8_t * const *src,
+                               int channels, int len)
+{
+    int simd_len = len & ~3;
+    int i, ch;
+
+    for (ch = 0; ch + 8 <= channels && simd_len; ch += 8) {
+        uint8_t *d = dst + 2*ch;
+        x86_reg pos = 0, end = 2*simd_len, tmp;
+
+        __asm__ volatile(
+            "1:                                 \n\t"
+            PLANE("movq",   "(%2,%0)", "%%xmm0", "%c6")
+            PLANE("movhps", "(%2,%0)", "%%xmm0", "%c7")
+            PLANE("movq",   "(%2,%0)", "%%xmm1", "%c8")
+            PLANE("movhps", "(%2,%0)", "%%xmm1", "%c9")
+            PLANE("movq",   "(%2,%0)", "%%xmm2", "%c10")
+            PLANE("movhps", "(%2,%0)", "%%xmm2", "%c11")
+            PLANE("movq",   "(%2,%0)", "%%xmm3", "%c12")
+            PLANE("movhps", "(%2,%0)", "%%xmm3", "%c13")
+            "pshufd $0x4E, %%xmm0, %%xmm4       \n\t"
+            "punpcklwd    %%xmm4, %%xmm0        \n\t"
+            "pshufd $0x4E, %%xmm1, %%xmm4       \n\t"
+            "punpcklwd    %%xmm4, %%xmm1        \n\t"
+            "pshufd $0x4E, %%xmm2, %%xmm4       \n\t"
+            "punpcklwd    %%xmm4, %%xmm2        \n\t"
+            "pshufd $0x4E, %%xmm3, %%xmm4       \n\t"
+            "punpcklwd    %%xmm4, %%xmm3        \n\t"
+            "movdqa       %%xmm0, %%xmm4        \n\t"
+            "punpckldq    %%xmm1, %%xmm0        \n\t"
+            "punpckhdq    %%xmm1, %%xmm4        \n\t"
+            "movdqa       %%xmm2, %%xmm5        \n\t"
+            "punpckldq    %%xmm3, %%xmm2        \n\t"
+            "punpckhdq    %%xmm3, %%xmm5        \n\t"
+            "movdqa       %%xmm0, %%xmm1        \n\t"
+            "punpcklqdq   %%xmm2, %%xmm0        \n\t"
+            "punpckhqdq   %%xmm2, %%xmm1        \n\t"
+            "movdqa       %%xmm4, %%xmm3        \n\t"
+            "punpcklqdq   %%xmm5, %%xmm4        \n\t"
+            "punpckhqdq   %%xmm5, %%xmm3        \n\t"
+            "movdqu       %%xmm0, (%1)          \n\t"
+            "movdqu       %%xmm1, (%1,%3)       \n\t"
+            "lea        (%1,%3,2), %1           \n\t"
+            "movdqu       %%xmm4, (%1)          \n\t"
+            "movdqu       %%xmm3, (%1,%3)       \n\t"
+            "lea        (%1,%3,2), %1           \n\t"
+            "add             $8, %0             \n\t"
+            "cmp             %5, %0             \n\t"
+            "jl              1b                 \n\t"
+            : "+r"(pos), "+r"(d), "=&r"(tmp)
+            : "r"((x86_reg)2*channels), "r"(src + ch), "m"(end), PTR_OPERANDS
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                           "%xmm4", "%xmm5",) "memory"
+        );
+    }
+
+    for (i = 0; i < len; i++)
+        for (ch = i < simd_len ? channels & ~7 : 0; ch < channels; ch++)
+            ((uint16_t *)dst)[i*channels + ch] = ((const uint16_t *)src[ch])[i];
+}
+
+/* transposes the 4x4 block of dwords in xmm0-xmm3 into xmm6, xmm4, xmm7, xmm0 */
+#define TRANSPOSE4x4                            \
+    "movdqa       %%xmm0, %%xmm4        \n\t"   \
+    "punpckldq    %%xmm1, %%xmm4        \n\t"   \
+    "punpckhdq    %%xmm1, %%xmm0        \n\t"   \
+    "movdqa       %%xmm2, %%xmm5        \n\t"   \
+    "punpckldq    %%xmm3, %%xmm5        \n\t"   \
+    "punpckhdq    %%xmm3, %%xmm2        \n\t"   \
+    "movdqa       %%xmm4, %%xmm6        \n\t"   \
+    "punpcklqdq   %%xmm5, %%xmm6        \n\t"   \
+    "punpckhqdq   %%xmm5, %%xmm4        \n\t"   \
+    "movdqa       %%xmm0, %%xmm7        \n\t"   \
+    "punpcklqdq   %%xmm2, %%xmm7        \n\t"   \
+    "punpckhqdq   %%xmm2, %%xmm0        \n\t"
+
+/* frames of 4 channels are transposed 4 samples at a time */
+static void deinterleave_32_sse2(uint8_t * const *dst, const uint8_t *src,
+                                 int channels, int len)
+{
+    int simd_len = len & ~3;
+    int i, ch;
+
+    for (ch = 0; ch + 4 <= channels && simd_len; ch += 4) {
+        const uint8_t *s = src + 4*ch;
+        x86_reg pos = 0, end = 4*simd_len, tmp;
+
+        __asm__ volatile(
+            "1:                                 \n\t"
+            "movdqu          (%1), %%xmm0       \n\t"
+            "movdqu       (%1,%3), %%xmm1       \n\t"
+            "lea        (%1,%3,2), %1           \n\t"
+            "movdqu          (%1), %%xmm2       \n\t"
+            "movdqu       (%1,%3), %%xmm3       \n\t"
+            "lea        (%1,%3,2), %1           \n\t"
+            TRANSPOSE4x4
+            PLANE("movdqu", "%%xmm6", "(%2,%0)", "%c6")
+            PLANE("movdqu", "%%xmm4", "(%2,%0)", "%c7")
+            PLANE("movdqu", "%%xmm7", "(%2,%0)", "%c8")
+            PLANE("movdqu", "%%xmm0", "(%2,%0)", "%c9")
+            "add            $16, %0             \n\t"
+            "cmp             %5, %0             \n\t"
+            "jl              1b                 \n\t"
+            : "+r"(pos), "+r"(s), "=&r"(tmp)
+            : "r"((x86_reg)4*channels), "r"(dst + ch), "m"(end), PTR_OPERANDS
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                           "%xmm4", "%xmm5", "%xmm6", "%xmm7",) "memory"
+        );
+    }
+
+    for (i = 0; i < len; i++)
+        for (ch = i < simd_len ? channels & ~3 : 0; ch < channels; ch++)
+            ((uint32_t *)dst[ch])[i] = ((const uint32_t *)src)[i*channels + ch];
+}
+
+static void interleave_32_sse2(uint8_t *dst, const uint8_t * const *src,
+                               int channels, int len)
+{
+    int simd_len = len & ~3;
+    int i, ch;
+
+    for (ch = 0; ch + 4 <= channels && simd_len; ch += 4) {
+        uint8_t *d = dst + 4*ch;
+        x86_reg pos = 0, end = 4*simd_len, tmp;
+
+        __asm__ volatile(
+            "1:                                 \n\t"
+            PLANE("movdqu", "(%2,%0)", "%%xmm0", "%c6")
+            PLANE("movdqu", "(%2,%0)", "%%xmm1", "%c7")
+            PLANE("movdqu", "(%2,%0)", "%%xmm2", "%c8")
+            PLANE("movdqu", "(%2,%0)", "%%xmm3", "%c9")
+            TRANSPOSE4x4
+            "movdqu       %%xmm6, (%1)          \n\t"
+            "movdqu       %%xmm4, (%1,%3)       \n\t"
+            "lea        (%1,%3,2), %1           \n\t"
+            "movdqu       %%xmm7, (%1)          \n\t"
+            "movdqu       %%xmm0, (%1,%3)       \n\t"
+            "lea        (%1,%3,2), %1           \n\t"
+            "add            $16, %0             \n\t"
+            "cmp             %5, %0             \n\t"
+            "jl              1b                 \n\t"
+            : "+r"(pos), "+r"(d), "=&r"(tmp)
+            : "r"((x86_reg)4*channels), "r"(src + ch), "m"(end), PTR_OPERANDS
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                           "%xmm4", "%xmm5", "%xmm6", "%xmm7",) "memory"
+        );
+    }
+
+    for (i = 0; i < len; i++)
+        for (ch = i < simd_len ? channels & ~3 : 0; ch < channels; ch++)
+            ((uint32_t *)dst)[i*channels + ch] = ((const uint32_t *)src[ch])[i];
+}
+#endif
+
+void ff_audio_shuffle_init_mmx(AudioShuffleDSPContext *c, int sample_size)
+{
+#if HAVE_SSE
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE2) {
+        if (sample_size == 2) {
+            c->deinterleave = deinterleave_16_sse2;
+            c->interleave   = interleave_16_sse2;
+        } else if (sample_size == 4) {
+            c->deinterleave = deinterleave_32_sse2;
+            c->interleave   = interleave_32_sse2;
+        }
+    }
+#endif
+}
@@ -0,0 +1,135 @@
+/*
+ * Apple ProRes encoder SIMD functions
+ * Copyright (c) 2011 Michael Jackson
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/proresenc.h"
+
+#define SAVE_SIGN_SSE2                  \
+    "pxor    %%xmm1, %%xmm1     \n\t"   \
+    "pcmpgtw %%xmm0, %%xmm1     \n\t"   \
+    "pxor    %%xmm1, %%xmm0     \n\t"   \
+    "psubw   %%xmm1, %%xmm0     \n\t"
+#define RESTORE_SIGN_SSE2               \
+    "pxor    %%xmm1, %%xmm0     \n\t"   \
+    "psubw   %%xmm1, %%xmm0     \n\t"
+
+#define SAVE_SIGN_SSSE3                 \
+    "movdqa  %%xmm0, %%xmm1     \n\t"   \
+    "pabsw   %%xmm0, %%xmm0     \n\t"
+#define RESTORE_SIGN_SSSE3              \
+    "psignw  %%xmm1, %%xmm0     \n\t"
+
+/**
+ * (|coeff| * q + bias) >> 16 with the sign of coeff restored, eight
+ * coefficients of one scan position at a time.
+ */
+#define QUANTIZE(name, SAVE_SIGN, RESTORE_SIGN)                                \
+static void name(int16_t *levels, const DCTELEM *coeffs, const int16_t *qmat,  \
+                 int quant_bias, int blocks_per_slice)                         \
+{                                                                              \
+    int bias = quant_bias << (QMAT_SHIFT - QUANT_BIAS_SHIFT);                  \
+    x86_reg size = blocks_per_slice * 2;                                       \
+    int i;                                                                     \
+                                                                               \
+    coeffs += blocks_per_slice;                                                \
+    for (i = 1; i < 64; i++) {                                                 \
+        x86_reg idx = -size;                                                   \
+        coeffs += blocks_per_slice;                                            \
+        levels += blocks_per_slice;                                            \
+        __asm__ volatile(                                                      \
+            "movd       %3, %%xmm5          \n\t"                              \
+            "pshuflw    $0, %%xmm5, %%xmm5  \n\t"                              \
+            "punpcklqdq %%xmm5, %%xmm5      \n\t"                              \
+            "movd       %4, %%xmm6          \n\t"                              \
+            "pshufd     $0, %%xmm6, %%xmm6  \n\t"                              \
+            "1:                             \n\t"                              \
+            "movdqa     (%1, %0), %%xmm0    \n\t"                              \
+            SAVE_SIGN                                                          \
+            "movdqa     %%xmm0, %%xmm2      \n\t"                              \
+            "pmullw     %%xmm5, %%xmm0      \n\t"                              \
+            "pmulhuw    %%xmm5, %%xmm2      \n\t"                              \
+            "movdqa     %%xmm0, %%xmm3      \n\t"                              \
+            "punpcklwd  %%xmm2, %%xmm0      \n\t"                              \
+            "punpckhwd  %%xmm2, %%xmm3      \n\t"                              \
+            "paddd      %%xmm6, %%xmm0      \n\t"                              \
+            "paddd      %%xmm6, %%xmm3      \n\t"                              \
+            "psrld      $16, %%xmm0         \n\t"                              \
+            "psrld      $16, %%xmm3         \n\t"                              \
+            "packssdw   %%xmm3, %%xmm0      \n\t"                              \
+            RESTORE_SIGN                                                       \
+            "movdqa     %%xmm0, (%2, %0)    \n\t"                              \
+            "add        $16, %0             \n\t"                              \
+            "jl 1b                          \n\t"                              \
+            : "+r" (idx)                                                       \
+            : "r" (coeffs), "r" (levels), "r" ((int)qmat[i]), "r" (bias)       \
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",                 \
+                           "%xmm5", "%xmm6",) "memory"                         \
+        );                                                                     \
+    }                                                                          \
+}
+
+QUANTIZE(quantize_sse2, SAVE_SIGN_SSE2, RESTORE_SIGN_SSE2)
+#if HAVE_SSSE3
+QUANTIZE(quantize_ssse3, SAVE_SIGN_SSSE3, RESTORE_SIGN_SSSE3)
+#endif
+
+static int find_runs_sse2(uint16_t *runs, int16_t *levels, const int16_t *src, int count)
+{
+    int i, n = 0, last = -1;
+
+    for (i = 0; i < count; i += 16) {
+        int mask;
+        __asm__ volatile(
+            "movdqa     (%1), %%xmm0        \n\t"
+            "packsswb 16(%1), %%xmm0        \n\t"
+            "pxor     %%xmm1, %%xmm1        \n\t"
+            "pcmpeqb  %%xmm1, %%xmm0        \n\t"
+            "pmovmskb %%xmm0, %0            \n\t"
+            : "=r" (mask)
+            : "r" (src + i)
+            : XMM_CLOBBERS("%xmm0", "%xmm1",) "memory"
+        );
+        mask = ~mask & (count - i < 16 ? 0xFF : 0xFFFF);
+        while (mask) {
+            int pos = i + av_log2(mask & -mask);
+            runs[n] = pos - last - 1;
+            levels[n++] = src[pos];
+            last = pos;
+            mask &= mask - 1;
+        }
+    }
+    return n;
+}
+
+void ff_prores_init_mmx(ProresEncContext *ctx)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE2) {
+        ctx->quantize  = quantize_sse2;
+        ctx->find_runs = find_runs_sse2;
+    }
+#if HAVE_SSSE3
+    if (mm_flags & AV_CPU_FLAG_SSSE3)
+        ctx->quantize  = quantize_ssse3;
+#endif
+}
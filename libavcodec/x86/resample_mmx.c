@@ -0,0 +1,117 @@
+/*
+ * audio resampling SIMD functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/resample2.h"
+
+#if HAVE_SSE
+/* eight taps per iteration in two accumulators, the remaining ones in C */
+static float dot_flt_sse(const float *src, const float *filter, int len)
+{
+    int simd_len = len & ~7;
+    x86_reg i = -simd_len;
+    float sum = 0;
+
+    if (simd_len) {
+        __asm__ volatile(
+            "xorps        %%xmm0, %%xmm0    \n\t"
+            "xorps        %%xmm1, %%xmm1    \n\t"
+            "1:                             \n\t"
+            "movups     (%2,%0,4), %%xmm2   \n\t"
+            "movups   16(%2,%0,4), %%xmm3   \n\t"
+            "movups     (%3,%0,4), %%xmm4   \n\t"
+            "movups   16(%3,%0,4), %%xmm5   \n\t"
+            "mulps        %%xmm4, %%xmm2    \n\t"
+            "mulps        %%xmm5, %%xmm3    \n\t"
+            "addps        %%xmm2, %%xmm0    \n\t"
+            "addps        %%xmm3, %%xmm1    \n\t"
+            "add             $8, %0         \n\t"
+            "js              1b             \n\t"
+            "addps        %%xmm1, %%xmm0    \n\t"
+            "movhlps      %%xmm0, %%xmm1    \n\t"
+            "addps        %%xmm1, %%xmm0    \n\t"
+            "movaps       %%xmm0, %%xmm1    \n\t"
+            "shufps   $1, %%xmm1, %%xmm1    \n\t"
+            "addss        %%xmm1, %%xmm0    \n\t"
+            "movss        %%xmm0, %1        \n\t"
+            : "+r"(i), "=m"(sum)
+            : "r"(src + simd_len), "r"(filter + simd_len)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                           "%xmm4", "%xmm5",) "memory"
+        );
+    }
+    for (; simd_len < len; simd_len++)
+        sum += src[simd_len] * filter[simd_len];
+    return sum;
+}
+
+/* samples are converted to double, four taps per iteration */
+static double dot_s32_sse2(const int32_t *src, const double *filter, int len)
+{
+    int simd_len = len & ~3;
+    x86_reg i = -simd_len;
+    double sum = 0;
+
+    if (simd_len) {
+        __asm__ volatile(
+            "xorpd        %%xmm0, %%xmm0    \n\t"
+            "xorpd        %%xmm1, %%xmm1    \n\t"
+            "1:                             \n\t"
+            "movq       (%2,%0,4), %%xmm2   \n\t"
+            "movq      8(%2,%0,4), %%xmm3   \n\t"
+            "cvtdq2pd     %%xmm2, %%xmm2    \n\t"
+            "cvtdq2pd     %%xmm3, %%xmm3    \n\t"
+            "movupd     (%3,%0,8), %%xmm4   \n\t"
+            "movupd   16(%3,%0,8), %%xmm5   \n\t"
+            "mulpd        %%xmm4, %%xmm2    \n\t"
+            "mulpd        %%xmm5, %%xmm3    \n\t"
+            "addpd        %%xmm2, %%xmm0    \n\t"
+            "addpd        %%xmm3, %%xmm1    \n\t"
+            "add             $4, %0         \n\t"
+            "js              1b             \n\t"
+            "addpd        %%xmm1, %%xmm0    \n\t"
+            "movapd       %%xmm0, %%xmm1    \n\t"
+            "unpckhpd     %%xmm1, %%xmm1    \n\t"
+            "addsd        %%xmm1, %%xmm0    \n\t"
+            "movsd        %%xmm0, %1        \n\t"
+            : "+r"(i), "=m"(sum)
+            : "r"(src + simd_len), "r"(filter + simd_len)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                           "%xmm4", "%xmm5",) "memory"
+        );
+    }
+    for (; simd_len < len; simd_len++)
+        sum += src[simd_len] * filter[simd_len];
+    return sum;
+}
+#endif
+
+void ff_resample_dsp_init_mmx(ResampleDSPContext *c)
+{
+#if HAVE_SSE
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE)
+        c->dot_flt = dot_flt_sse;
+    if (mm_flags & AV_CPU_FLAG_SSE2)
+        c->dot_s32 = dot_s32_sse2;
+#endif
+}
@@ -0,0 +1,38 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavcodec/v210enc.h"
+
+extern void ff_v210_planar_pack_ssse3(const uint16_t *y, const uint16_t *u, const uint16_t *v, uint8_t *dst, int width);
+extern void ff_v210_planar_pack_avx(const uint16_t *y, const uint16_t *u, const uint16_t *v, uint8_t *dst, int width);
+
+av_cold void v210enc_x86_init(V210EncContext *s)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+#if HAVE_YASM
+    if (cpu_flags & AV_CPU_FLAG_SSSE3)
+        s->pack_line = ff_v210_planar_pack_ssse3;
+
+    if (cpu_flags & AV_CPU_FLAG_AVX)
+        s->pack_line = ff_v210_planar_pack_avx;
+#endif
+}
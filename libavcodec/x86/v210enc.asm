@@ -0,0 +1,79 @@
+;******************************************************************************
+;* V210 SIMD pack
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU General Public
+;* License as published by the Free Software Foundation;
+;* version 2 of the License.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* General Public License for more details.
+;*
+;* You should have received a copy of the GNU General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavcodec/x86/x86inc.asm"
+%include "libavcodec/x86/x86util.asm"
+
+SECTION_RODATA
+
+cextern pw_4
+%define v210_enc_min pw_4
+v210_enc_max: times 8 dw 0x3fb
+
+v210_enc_luma_mult: dw 4,1,16,4,1,16,0,0
+v210_enc_luma_shuf: db -1,0,1,-1,2,3,4,5,-1,6,7,-1,8,9,10,11
+
+v210_enc_chroma_mult: dw 1,4,16,0,16,1,4,0
+v210_enc_chroma_shuf: db 0,1,8,9,-1,2,3,-1,10,11,4,5,-1,12,13,-1
+
+SECTION .text
+
+%macro v210_planar_pack 1
+
+; v210_planar_pack(const uint16_t *y, const uint16_t *u, const uint16_t *v, uint8_t *dst, int width)
+cglobal v210_planar_pack_%1, 5, 5
+    movsxdifnidn r4, r4d
+    lea    r0, [r0+2*r4]
+    add    r1, r4
+    add    r2, r4
+    neg    r4
+
+    mova   m2, [v210_enc_min]
+    mova   m3, [v210_enc_max]
+    mova   m4, [v210_enc_luma_mult]
+    mova   m5, [v210_enc_chroma_mult]
+.loop
+    movu   m0, [r0+2*r4] ; y0 y1 y2 y3 y4 y5 __ __
+    CLIPW  m0, m2, m3
+
+    movq   m1, [r1+r4]   ; u0 u1 u2 __
+    movhps m1, [r2+r4]   ; u0 u1 u2 __ v0 v1 v2 __
+    CLIPW  m1, m2, m3
+
+    pmullw m0, m4
+    pshufb m0, [v210_enc_luma_shuf]
+
+    pmullw m1, m5
+    pshufb m1, [v210_enc_chroma_shuf]
+
+    por    m0, m1
+    movu   [r3], m0
+
+    add r3, mmsize
+    add r4, 6
+    jl  .loop
+
+    REP_RET
+%endmacro
+
+INIT_XMM
+v210_planar_pack ssse3
+INIT_AVX
+v210_planar_pack avx
@@ -44,74 +44,261 @@ const char *avfilter_license(void)
     return LICENSE_PREFIX FFMPEG_LICENSE + sizeof(LICENSE_PREFIX) - 1;
 }
 
+#if HAVE_PTHREADS
+#define POOL_LOCK(pool)   pthread_mutex_lock(&(pool)->mutex)
+#define POOL_UNLOCK(pool) pthread_mutex_unlock(&(pool)->mutex)
+#else
+#define POOL_LOCK(pool)
+#define POOL_UNLOCK(pool)
+#endif
+
+/** the pool of buf, NULL if it does not come from a pool */
+static AVFilterPool *buffer_pool(AVFilterBuffer *buf)
+{
+    return buf->free ? NULL : buf->priv;
+}
+
 AVFilterBufferRef *avfilter_ref_buffer(AVFilterBufferRef *ref, int pmask)
 {
-    AVFilterBufferRef *ret = av_malloc(sizeof(AVFilterBufferRef));
-    if (!ret)
-        return NULL;
-    *ret = *ref;
-    if (ref->type == AVMEDIA_TYPE_VIDEO) {
-        ret->video = av_malloc(sizeof(AVFilterBufferRefVideoProps));
-        if (!ret->video) {
-            av_free(ret);
-            return NULL;
-        }
+    AVFilterPool *pool = buffer_pool(ref->buf);
+    AVFilterBufferRef *ret = NULL;
+
+    if (pool && ref->type == AVMEDIA_TYPE_VIDEO) {
+        POOL_LOCK(pool);
+        if (pool->nb_refs)
+            ret = pool->refs[--pool->nb_refs];
+        POOL_UNLOCK(pool);
+    }
+
+    if (ret) {
+        AVFilterBufferRefVideoProps *video = ret->video;
+        *ret = *ref;
+        ret->video = video;
         *ret->video = *ref->video;
-    } else if (ref->type == AVMEDIA_TYPE_AUDIO) {
-        ret->audio = av_malloc(sizeof(AVFilterBufferRefAudioProps));
-        if (!ret->audio) {
-            av_free(ret);
+    } else {
+        ret = av_malloc(sizeof(AVFilterBufferRef));
+        if (!ret)
             return NULL;
+        *ret = *ref;
+        if (ref->type == AVMEDIA_TYPE_VIDEO) {
+            ret->video = av_malloc(sizeof(AVFilterBufferRefVideoProps));
+            if (!ret->video) {
+                av_free(ret);
+                return NULL;
+            }
+            *ret->video = *ref->video;
+        } else if (ref->type == AVMEDIA_TYPE_AUDIO) {
+            ret->audio = av_malloc(sizeof(AVFilterBufferRefAudioProps));
+            if (!ret->audio) {
+                av_free(ret);
+                return NULL;
+            }
+            *ret->audio = *ref->audio;
         }
-        *ret->audio = *ref->audio;
     }
     ret->perms &= pmask;
-    ret->buf->refcount ++;
+
+    if (pool) {
+        POOL_LOCK(pool);
+        ret->buf->refcount++;
+        POOL_UNLOCK(pool);
+    } else
+        ret->buf->refcount++;
     return ret;
 }
 
-static void store_in_pool(AVFilterBufferRef *ref)
+static void free_ref(AVFilterBufferRef *ref)
+{
+    av_freep(&ref->video);
+    av_freep(&ref->audio);
+    av_free(ref);
+}
+
+/** free a buffer of a pool along with its last reference */
+static void free_pool_buffer(AVFilterBufferRef *ref)
+{
+    av_freep(&ref->buf->data[0]);
+    av_freep(&ref->buf);
+    free_ref(ref);
+}
+
+static void pool_free(AVFilterPool *pool)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_destroy(&pool->mutex);
+#endif
+    av_free(pool);
+}
+
+static AVFilterPoolBucket *find_bucket(AVFilterPool *pool, int w, int h, int format)
+{
+    int i;
+
+    for (i = 0; i < POOL_BUCKETS; i++) {
+        AVFilterPoolBucket *bucket = &pool->bucket[i];
+        if (bucket->w == w && bucket->h == h && bucket->format == format)
+            return bucket;
+    }
+    return NULL;
+}
+
+/**
+ * Keep the last reference to a buffer and the buffer in the pool, must be
+ * called with the pool locked.
+ *
+ * @return 0 if the pool has no room left for the buffer
+ */
+static int store_in_pool(AVFilterPool *pool, AVFilterBufferRef *ref)
 {
+    AVFilterBuffer *pic = ref->buf;
+    AVFilterPoolBucket *bucket = find_bucket(pool, pic->w, pic->h, pic->format);
     int i;
-    AVFilterPool *pool= ref->buf->priv;
-
-    av_assert0(ref->buf->data[0]);
-
-    if (pool->count == POOL_SIZE) {
-        AVFilterBufferRef *ref1 = pool->pic[0];
-        av_freep(&ref1->video);
-        av_freep(&ref1->audio);
-        av_freep(&ref1->buf->data[0]);
-        av_freep(&ref1->buf);
-        av_free(ref1);
-        memmove(&pool->pic[0], &pool->pic[1], sizeof(void*)*(POOL_SIZE-1));
-        pool->count--;
-        pool->pic[POOL_SIZE-1] = NULL;
+
+    av_assert0(pic->data[0]);
+
+    if (!bucket) {
+        // reuse the bucket of dimensions no longer in use
+        for (i = 0; i < POOL_BUCKETS && pool->bucket[i].count; i++);
+        if (i == POOL_BUCKETS)
+            return 0;
+        bucket = &pool->bucket[i];
+        bucket->w      = pic->w;
+        bucket->h      = pic->h;
+        bucket->format = pic->format;
     }
+    if (bucket->count == POOL_SIZE)
+        return 0;
+
+    bucket->pic[bucket->count++] = ref;
+    pool->outstanding--;
+    return 1;
+}
+
+static void unref_pool_buffer(AVFilterPool *pool, AVFilterBufferRef *ref)
+{
+    AVFilterBufferRef *last_ref = NULL;
+    int free_pool = 0;
 
-    for (i = 0; i < POOL_SIZE; i++) {
-        if (!pool->pic[i]) {
-            pool->pic[i] = ref;
-            pool->count++;
-            break;
+    POOL_LOCK(pool);
+    if (!--ref->buf->refcount) {
+        // the last reference goes back to the pool along with the buffer
+        if (pool->draining || !store_in_pool(pool, ref)) {
+            last_ref  = ref;
+            free_pool = !--pool->outstanding && pool->draining;
         }
+        ref = NULL;
+    } else if (ref->type == AVMEDIA_TYPE_VIDEO && !pool->draining &&
+               pool->nb_refs < POOL_REFS) {
+        pool->refs[pool->nb_refs++] = ref;
+        ref = NULL;
+    }
+    POOL_UNLOCK(pool);
+
+    if (ref)
+        free_ref(ref);
+    if (last_ref)
+        free_pool_buffer(last_ref);
+    if (free_pool)
+        pool_free(pool);
+}
+
+AVFilterPool *ff_pool_alloc(void)
+{
+    AVFilterPool *pool = av_mallocz(sizeof(AVFilterPool));
+
+    if (!pool)
+        return NULL;
+#if HAVE_PTHREADS
+    pthread_mutex_init(&pool->mutex, NULL);
+#endif
+    return pool;
+}
+
+AVFilterBufferRef *ff_pool_get_video_buffer(AVFilterPool *pool, int perms,
+                                            int w, int h, int format)
+{
+    AVFilterPoolBucket *bucket;
+    AVFilterBufferRef *picref = NULL;
+    AVFilterBuffer *pic;
+
+    POOL_LOCK(pool);
+    bucket = find_bucket(pool, w, h, format);
+    if (bucket && bucket->count) {
+        picref = bucket->pic[--bucket->count];
+        pool->outstanding++;
+        pool->hits++;
+    } else
+        pool->misses++;
+    POOL_UNLOCK(pool);
+
+    if (!picref)
+        return NULL;
+
+    pic = picref->buf;
+    picref->video->w = w;
+    picref->video->h = h;
+    picref->perms = perms | AV_PERM_READ;
+    picref->format = format;
+    pic->refcount = 1;
+    memcpy(picref->data,     pic->data,     sizeof(picref->data));
+    memcpy(picref->linesize, pic->linesize, sizeof(picref->linesize));
+    return picref;
+}
+
+void ff_pool_add_buffer(AVFilterPool *pool, AVFilterBufferRef *picref)
+{
+    picref->buf->priv = pool;
+    picref->buf->free = NULL;
+
+    POOL_LOCK(pool);
+    pool->outstanding++;
+    POOL_UNLOCK(pool);
+}
+
+void ff_pool_uninit(AVFilterPool **ppool, void *log_ctx)
+{
+    AVFilterPool *pool = *ppool;
+    int i, j, free_pool;
+
+    if (!pool)
+        return;
+    *ppool = NULL;
+
+    av_log(log_ctx, AV_LOG_DEBUG, "buffer pool: %u hits, %u misses\n",
+           pool->hits, pool->misses);
+
+    POOL_LOCK(pool);
+    for (i = 0; i < POOL_BUCKETS; i++) {
+        AVFilterPoolBucket *bucket = &pool->bucket[i];
+        for (j = 0; j < bucket->count; j++)
+            free_pool_buffer(bucket->pic[j]);
+        bucket->count = 0;
     }
+    for (i = 0; i < pool->nb_refs; i++)
+        free_ref(pool->refs[i]);
+    pool->nb_refs = 0;
+    // buffers still referenced elsewhere free the pool with the last of them
+    pool->draining = 1;
+    free_pool = !pool->outstanding;
+    POOL_UNLOCK(pool);
+
+    if (free_pool)
+        pool_free(pool);
 }
 
 void avfilter_unref_buffer(AVFilterBufferRef *ref)
 {
+    AVFilterPool *pool;
+
     if (!ref)
         return;
-    if (!(--ref->buf->refcount)) {
-        if (!ref->buf->free) {
-            store_in_pool(ref);
-            return;
-        }
-        ref->buf->free(ref->buf);
+    if ((pool = buffer_pool(ref->buf))) {
+        unref_pool_buffer(pool, ref);
+        return;
     }
-    av_freep(&ref->video);
-    av_freep(&ref->audio);
-    av_free(ref);
+    if (!(--ref->buf->refcount))
+        ref->buf->free(ref->buf);
+    free_ref(ref);
 }
 
 void avfilter_insert_pad(unsigned idx, unsigned *count, size_t padidx_off,
@@ -170,24 +357,7 @@ void avfilter_link_free(AVFilterLink **link)
     if (!*link)
         return;
 
-    if ((*link)->pool) {
-        int i;
-        for (i = 0; i < POOL_SIZE; i++) {
-            if ((*link)->pool->pic[i]) {
-                AVFilterBufferRef *picref = (*link)->pool->pic[i];
-                /* free buffer: picrefs stored in the pool are not
-                 * supposed to contain a free callback */
-                av_freep(&picref->buf->data[0]);
-                av_freep(&picref->buf);
-
-                av_freep(&picref->audio);
-                av_freep(&picref->video);
-                av_freep(&(*link)->pool->pic[i]);
-            }
-        }
-        (*link)->pool->count = 0;
-//        av_freep(&(*link)->pool);
-    }
+    ff_pool_uninit(&(*link)->pool, (*link)->dst);
     av_freep(link);
 }
 
@@ -395,8 +565,8 @@ avfilter_get_video_buffer_ref_from_arrays(uint8_t * const data[4], const int lin
     picref->type = AVMEDIA_TYPE_VIDEO;
     pic->format = picref->format = format;
 
-    memcpy(pic->data,        data,          sizeof(pic->data));
-    memcpy(pic->linesize,    linesize,      sizeof(pic->linesize));
+    memcpy(pic->data,        data,          4*sizeof(data[0]));
+    memcpy(pic->linesize,    linesize,      4*sizeof(linesize[0]));
     memcpy(picref->data,     pic->data,     sizeof(picref->data));
     memcpy(picref->linesize, pic->linesize, sizeof(picref->linesize));
 
@@ -702,6 +872,8 @@ int avfilter_open(AVFilterContext **filter_ctx, AVFilter *filter, const char *in
     ret->av_class = &avfilter_class;
     ret->filter   = filter;
     ret->name     = inst_name ? av_strdup(inst_name) : NULL;
+    ret->execute      = avfilter_default_execute;
+    ret->thread_count = 1;
     if (filter->priv_size) {
         ret->priv     = av_mallocz(filter->priv_size);
         if (!ret->priv)
@@ -29,8 +29,8 @@
 #include "libavutil/rational.h"
 
 #define LIBAVFILTER_VERSION_MAJOR  2
-#define LIBAVFILTER_VERSION_MINOR 27
-#define LIBAVFILTER_VERSION_MICRO  3
+#define LIBAVFILTER_VERSION_MINOR 29
+#define LIBAVFILTER_VERSION_MICRO  0
 
 #define LIBAVFILTER_VERSION_INT AV_VERSION_INT(LIBAVFILTER_VERSION_MAJOR, \
                                                LIBAVFILTER_VERSION_MINOR, \
@@ -62,6 +62,14 @@ typedef struct AVFilterContext AVFilterContext;
 typedef struct AVFilterLink    AVFilterLink;
 typedef struct AVFilterPad     AVFilterPad;
 
+/**
+ * Function run by AVFilterContext.execute() for each job.
+ *
+ * @param jobnr   index of the job, from 0 to nb_jobs - 1
+ * @param nb_jobs total number of jobs passed to execute()
+ */
+typedef int (avfilter_action_func)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
+
 /**
  * A reference-counted buffer data type used by the filter system. Filters
  * should not store pointers to this structure directly, but instead use the
@@ -492,6 +500,10 @@ void avfilter_set_common_packing_formats(AVFilterContext *ctx, AVFilterFormats *
 /** Default handler for query_formats() */
 int avfilter_default_query_formats(AVFilterContext *ctx);
 
+/** Default execute(), runs all the jobs on the calling thread */
+int avfilter_default_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                             void *arg, int *ret, int nb_jobs);
+
 /** start_frame() handler for filters which simply pass video along */
 void avfilter_null_start_frame(AVFilterLink *link, AVFilterBufferRef *picref);
 
@@ -574,6 +586,20 @@ struct AVFilterContext {
     AVFilterLink **outputs;         ///< array of pointers to output links
 
     void *priv;                     ///< private data for use by the filter
+
+    /**
+     * Run func nb_jobs times, possibly in parallel on the threads of the
+     * filter graph. Returns once all the jobs are done.
+     * Set by the filter graph, filters should only call it.
+     *
+     * @param ret if non-NULL, array of nb_jobs return values of func
+     * @return 0
+     */
+    int (*execute)(AVFilterContext *ctx, avfilter_action_func *func,
+                   void *arg, int *ret, int nb_jobs);
+
+    int thread_count;               ///< number of threads execute() runs jobs on
+    void *thread_opaque;            ///< thread pool of the filter graph
 };
 
 enum AVFilterPacking {
@@ -23,6 +23,7 @@
 #include <ctype.h>
 #include <string.h>
 
+#include "config.h"
 #include "avfilter.h"
 #include "avfiltergraph.h"
 #include "internal.h"
@@ -51,6 +52,9 @@ void avfilter_graph_free(AVFilterGraph **graph)
         return;
     for (; (*graph)->filter_count > 0; (*graph)->filter_count--)
         avfilter_free((*graph)->filters[(*graph)->filter_count - 1]);
+#if HAVE_PTHREADS
+    ff_graph_thread_free(*graph);
+#endif
     av_freep(&(*graph)->scale_sws_opts);
     av_freep(&(*graph)->filters);
     av_freep(graph);
@@ -261,6 +265,31 @@ int ff_avfilter_graph_config_formats(AVFilterGraph *graph)
     return 0;
 }
 
+int ff_avfilter_graph_config_threads(AVFilterGraph *graph)
+{
+#if HAVE_PTHREADS
+    AVFilterContext *filt;
+    int i, ret;
+
+    if (graph->thread_count > 1 && !graph->thread_opaque)
+        if ((ret = ff_graph_thread_init(graph)) < 0)
+            return ret;
+    if (!graph->thread_opaque)
+        return 0;
+
+    for (i = 0; i < graph->filter_count; i++) {
+        filt = graph->filters[i];
+        if (!filt)
+            continue;
+        filt->execute       = ff_graph_thread_execute;
+        filt->thread_count  = graph->thread_count;
+        filt->thread_opaque = graph->thread_opaque;
+    }
+#endif
+
+    return 0;
+}
+
 int avfilter_graph_config(AVFilterGraph *graph)
 {
     int ret;
@@ -269,6 +298,8 @@ int avfilter_graph_config(AVFilterGraph *graph)
         return ret;
     if ((ret = ff_avfilter_graph_config_formats(graph)))
         return ret;
+    if ((ret = ff_avfilter_graph_config_threads(graph)))
+        return ret;
     if ((ret = ff_avfilter_graph_config_links(graph)))
         return ret;
 
@@ -30,6 +30,13 @@ typedef struct AVFilterGraph {
     AVFilterContext **filters;
     int log_level_offset;
     char *scale_sws_opts; ///< sws options to use for the auto-inserted scale filters
+
+    /**
+     * Number of threads the filters may split their work on.
+     * Must be set before avfilter_graph_config(), 0 or 1 disables threading.
+     */
+    int thread_count;
+    void *thread_opaque;  ///< thread pool, private to the graph
 } AVFilterGraph;
 
 /**
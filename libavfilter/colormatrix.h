@@ -0,0 +1,49 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef AVFILTER_COLORMATRIX_H
+#define AVFILTER_COLORMATRIX_H
+
+#include <stdint.h>
+
+/**
+ * Coefficients used by the line functions, 16 bytes aligned.
+ * Rows 0 to 2 hold the (u, v) coefficient pairs of the y, u and v
+ * corrections, scaled by 65536, row 3 the chroma offset, row 4 the
+ * maximum sample value and row 5 the rounding constant as 4 dwords.
+ */
+#define COLORMATRIX_COEFF_ROWS 6
+
+/**
+ * The line functions convert a line in place, width is the number of
+ * chroma samples. For planar formats, each chroma sample covers 2 samples
+ * of y0 and, for 4:2:0, of y1 too; y1 is NULL otherwise.
+ */
+void ff_colormatrix_line_planar_c(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                                  int width, const int16_t (*coeffs)[8]);
+void ff_colormatrix_line_planar_10_c(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                                     int width, const int16_t (*coeffs)[8]);
+void ff_colormatrix_line_uyvy_c(uint8_t *line, int width, const int16_t (*coeffs)[8]);
+
+void ff_colormatrix_line_planar_sse2(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                                     int width, const int16_t (*coeffs)[8]);
+void ff_colormatrix_line_planar_10_sse2(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                                        int width, const int16_t (*coeffs)[8]);
+void ff_colormatrix_line_uyvy_sse2(uint8_t *line, int width, const int16_t (*coeffs)[8]);
+
+#endif /* AVFILTER_COLORMATRIX_H */
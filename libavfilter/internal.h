@@ -24,15 +24,71 @@
  * internal API functions
  */
 
+#include "config.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 #include "avfilter.h"
 #include "avfiltergraph.h"
 
-#define POOL_SIZE 32
-typedef struct AVFilterPool {
-    AVFilterBufferRef *pic[POOL_SIZE];
+#define POOL_SIZE    32         ///< free buffers kept per bucket
+#define POOL_BUCKETS 4          ///< buffer dimensions and formats kept per pool
+#define POOL_REFS    64         ///< free video references kept per pool
+
+/**
+ * Free buffers of the same dimensions and format. The most recently
+ * released buffer is reused first, its memory is the most likely to still
+ * be in the caches.
+ */
+typedef struct AVFilterPoolBucket {
+    int w, h, format;
+    AVFilterBufferRef *pic[POOL_SIZE]; ///< free buffers, with their last reference
     int count;
+} AVFilterPoolBucket;
+
+/**
+ * Video buffer pool of a link. Buffers from the pool have a NULL free
+ * callback and the pool as priv, they return to it instead of being freed
+ * and so do the references to them, with their video properties.
+ *
+ * Buffers may be referenced and unreferenced from any thread, the pool and
+ * the reference count of its buffers are protected by mutex.
+ */
+typedef struct AVFilterPool {
+    AVFilterPoolBucket bucket[POOL_BUCKETS];
+    AVFilterBufferRef *refs[POOL_REFS];
+    int nb_refs;
+    int outstanding;            ///< buffers allocated for the pool and in use
+    int draining;               ///< set when the link is freed, the pool goes with its last buffer
+    unsigned hits, misses;      ///< requests served from the pool and allocated
+#if HAVE_PTHREADS
+    pthread_mutex_t mutex;
+#endif
 } AVFilterPool;
 
+/** Allocate an empty buffer pool. */
+AVFilterPool *ff_pool_alloc(void);
+
+/**
+ * Get a free buffer of the given dimensions and format from pool.
+ *
+ * @return a new reference to the buffer, NULL if none is available
+ */
+AVFilterBufferRef *ff_pool_get_video_buffer(AVFilterPool *pool, int perms,
+                                            int w, int h, int format);
+
+/**
+ * Make the newly allocated picref, with its data in a single av_malloc()ed
+ * block, return to pool once unreferenced.
+ */
+void ff_pool_add_buffer(AVFilterPool *pool, AVFilterBufferRef *picref);
+
+/**
+ * Free the buffers kept in the pool and the pool itself once the buffers
+ * still in use are released. The hit rate is logged to log_ctx.
+ */
+void ff_pool_uninit(AVFilterPool **pool, void *log_ctx);
+
 /**
  * Check for the validity of graph.
  *
@@ -55,6 +111,25 @@ int ff_avfilter_graph_config_links(AVFilterGraph *graph);
  */
 int ff_avfilter_graph_config_formats(AVFilterGraph *graph);
 
+/**
+ * Start the thread pool of graph and make all its filters use it.
+ *
+ * @return 0 in case of success, a negative value otherwise
+ */
+int ff_avfilter_graph_config_threads(AVFilterGraph *graph);
+
+/**
+ * Create graph->thread_count worker threads, stored in graph->thread_opaque.
+ */
+int ff_graph_thread_init(AVFilterGraph *graph);
+
+/** Stop and free the worker threads of graph, if any. */
+void ff_graph_thread_free(AVFilterGraph *graph);
+
+/** AVFilterContext.execute() running the jobs on the graph thread pool */
+int ff_graph_thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                            void *arg, int *ret, int nb_jobs);
+
 /** default handler for freeing audio/video buffer when there are no references left */
 void ff_avfilter_default_free_buffer(AVFilterBuffer *buf);
 
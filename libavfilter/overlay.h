@@ -0,0 +1,35 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef AVFILTER_OVERLAY_H
+#define AVFILTER_OVERLAY_H
+
+#include <stdint.h>
+
+/**
+ * Blend width overlay samples src on dst, with the 8 bit straight alpha
+ * values of alpha: dst = (dst * (255 - alpha) + src * alpha) / 255.
+ * For the 10 bit versions dst holds 16 bit samples, src is scaled up.
+ */
+void ff_overlay_blend_line_c(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width);
+void ff_overlay_blend_line_10_c(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width);
+
+void ff_overlay_blend_line_sse2(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width);
+void ff_overlay_blend_line_10_sse2(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width);
+
+#endif /* AVFILTER_OVERLAY_H */
@@ -0,0 +1,171 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Filter graph thread pool, used by the filters to split the work on a
+ * frame into jobs run in parallel.
+ */
+
+#include <pthread.h>
+
+#include "libavutil/internal.h"
+#include "avfilter.h"
+#include "internal.h"
+
+typedef struct ThreadContext {
+    pthread_t *workers;
+    int nb_workers;
+
+    AVFilterContext *ctx;
+    avfilter_action_func *func;
+    void *arg;
+    int *rets;
+    int nb_jobs;
+    int next_job;                 ///< index of the next job to be picked up
+    int done_jobs;                ///< number of jobs finished
+
+    pthread_mutex_t mutex;
+    pthread_cond_t job_cond;      ///< signaled when jobs are available
+    pthread_cond_t done_cond;     ///< signaled when the last job is finished
+    int done;                     ///< set when the workers should exit
+} ThreadContext;
+
+/**
+ * Run jobs until none is left, must be called with the mutex locked.
+ */
+static void run_jobs(ThreadContext *c)
+{
+    while (c->next_job < c->nb_jobs) {
+        int jobnr = c->next_job++;
+        int ret;
+
+        pthread_mutex_unlock(&c->mutex);
+        ret = c->func(c->ctx, c->arg, jobnr, c->nb_jobs);
+        pthread_mutex_lock(&c->mutex);
+
+        if (c->rets)
+            c->rets[jobnr] = ret;
+        if (++c->done_jobs == c->nb_jobs)
+            pthread_cond_signal(&c->done_cond);
+    }
+}
+
+static void* attribute_align_arg worker(void *v)
+{
+    ThreadContext *c = v;
+
+    pthread_mutex_lock(&c->mutex);
+    for (;;) {
+        while (!c->done && c->next_job >= c->nb_jobs)
+            pthread_cond_wait(&c->job_cond, &c->mutex);
+        if (c->done)
+            break;
+        run_jobs(c);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
+
+int ff_graph_thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                            void *arg, int *ret, int nb_jobs)
+{
+    ThreadContext *c = ctx->thread_opaque;
+
+    if (nb_jobs <= 1)
+        return avfilter_default_execute(ctx, func, arg, ret, nb_jobs);
+
+    pthread_mutex_lock(&c->mutex);
+    c->ctx       = ctx;
+    c->func      = func;
+    c->arg       = arg;
+    c->rets      = ret;
+    c->nb_jobs   = nb_jobs;
+    c->next_job  = 0;
+    c->done_jobs = 0;
+    pthread_cond_broadcast(&c->job_cond);
+
+    // the calling thread takes its share of the jobs too
+    run_jobs(c);
+    while (c->done_jobs < c->nb_jobs)
+        pthread_cond_wait(&c->done_cond, &c->mutex);
+    pthread_mutex_unlock(&c->mutex);
+
+    return 0;
+}
+
+void ff_graph_thread_free(AVFilterGraph *graph)
+{
+    ThreadContext *c = graph->thread_opaque;
+    int i;
+
+    if (!c)
+        return;
+
+    pthread_mutex_lock(&c->mutex);
+    c->done = 1;
+    pthread_cond_broadcast(&c->job_cond);
+    pthread_mutex_unlock(&c->mutex);
+
+    for (i = 0; i < c->nb_workers; i++)
+        pthread_join(c->workers[i], NULL);
+
+    pthread_mutex_destroy(&c->mutex);
+    pthread_cond_destroy(&c->job_cond);
+    pthread_cond_destroy(&c->done_cond);
+    av_freep(&c->workers);
+    av_freep(&graph->thread_opaque);
+}
+
+int ff_graph_thread_init(AVFilterGraph *graph)
+{
+    ThreadContext *c;
+    int i;
+
+    c = av_mallocz(sizeof(ThreadContext));
+    if (!c)
+        return AVERROR(ENOMEM);
+
+    // the thread calling execute() is one of the threads
+    c->workers = av_mallocz(sizeof(*c->workers) * (graph->thread_count - 1));
+    if (!c->workers) {
+        av_free(c);
+        return AVERROR(ENOMEM);
+    }
+
+    pthread_mutex_init(&c->mutex, NULL);
+    pthread_cond_init(&c->job_cond, NULL);
+    pthread_cond_init(&c->done_cond, NULL);
+    graph->thread_opaque = c;
+
+    for (i = 0; i < graph->thread_count - 1; i++) {
+        if (pthread_create(&c->workers[i], NULL, worker, c)) {
+            av_log(graph, AV_LOG_WARNING,
+                   "Could only create %d of %d threads\n", i + 1, graph->thread_count);
+            graph->thread_count = i + 1;
+            break;
+        }
+        c->nb_workers++;
+    }
+
+    if (graph->thread_count <= 1)
+        ff_graph_thread_free(graph);
+
+    return 0;
+}
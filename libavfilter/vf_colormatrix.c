@@ -28,6 +28,9 @@
 #include <strings.h>
 #include <float.h>
 #include "avfilter.h"
+#include "colormatrix.h"
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
 #include "libavutil/pixdesc.h"
 
 #define NS(n) n < 0 ? (int)(n*65536.0-0.5+DBL_EPSILON) : (int)(n*65536.0+0.5)
@@ -55,6 +58,10 @@ typedef struct {
     char src[256];
     char dst[256];
     int hsub, vsub;
+    DECLARE_ALIGNED(16, int16_t, coeffs)[COLORMATRIX_COEFF_ROWS][8];
+    void (*process_line_planar)(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                                int width, const int16_t (*coeffs)[8]);
+    void (*process_line_uyvy)(uint8_t *line, int width, const int16_t (*coeffs)[8]);
 } ColorMatrixContext;
 
 #define ma m[0][0]
@@ -196,126 +203,105 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
     return 0;
 }
 
-static void process_frame_uyvy422(ColorMatrixContext *color,
-                                  AVFilterBufferRef *dst, AVFilterBufferRef *src)
+void ff_colormatrix_line_planar_c(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                                  int width, const int16_t (*coeffs)[8])
 {
-    const unsigned char *srcp = src->data[0];
-    const int src_pitch = src->linesize[0];
-    const int height = src->video->h;
-    const int width = src->video->w*2;
-    unsigned char *dstp = dst->data[0];
-    const int dst_pitch = dst->linesize[0];
-    const int c2 = color->yuv_convert[color->mode][0][1];
-    const int c3 = color->yuv_convert[color->mode][0][2];
-    const int c4 = color->yuv_convert[color->mode][1][1];
-    const int c5 = color->yuv_convert[color->mode][1][2];
-    const int c6 = color->yuv_convert[color->mode][2][1];
-    const int c7 = color->yuv_convert[color->mode][2][2];
-    int x, y;
-
-    for (y = 0; y < height; ++y) {
-        for (x = 0; x < width; x += 4) {
-            const int u = srcp[x + 0] - 128;
-            const int v = srcp[x + 2] - 128;
-            const int uvval = c2 * u + c3 * v + 1081344;
-            dstp[x + 0] = CB((c4 * u + c5 * v + 8421376) >> 16);
-            dstp[x + 1] = CB((65536 * (srcp[x + 1] - 16) + uvval) >> 16);
-            dstp[x + 2] = CB((c6 * u + c7 * v + 8421376) >> 16);
-            dstp[x + 3] = CB((65536 * (srcp[x + 3] - 16) + uvval) >> 16);
+    int x;
+
+    for (x = 0; x < width; x++) {
+        const int cu = u[x] - 128;
+        const int cv = v[x] - 128;
+        const int dy = (coeffs[0][0] * cu + coeffs[0][1] * cv + 32768) >> 16;
+        y0[2*x  ] = CB(y0[2*x  ] + dy);
+        y0[2*x+1] = CB(y0[2*x+1] + dy);
+        if (y1) {
+            y1[2*x  ] = CB(y1[2*x  ] + dy);
+            y1[2*x+1] = CB(y1[2*x+1] + dy);
         }
-        srcp += src_pitch;
-        dstp += dst_pitch;
+        u[x] = CB(u[x] + ((coeffs[1][0] * cu + coeffs[1][1] * cv + 32768) >> 16));
+        v[x] = CB(v[x] + ((coeffs[2][0] * cu + coeffs[2][1] * cv + 32768) >> 16));
     }
 }
 
-static void process_frame_yuv422p(ColorMatrixContext *color,
-                                  AVFilterBufferRef *dst, AVFilterBufferRef *src)
+void ff_colormatrix_line_planar_10_c(uint8_t *_y0, uint8_t *_y1, uint8_t *_u, uint8_t *_v,
+                                     int width, const int16_t (*coeffs)[8])
 {
-    const unsigned char *srcpU = src->data[1];
-    const unsigned char *srcpV = src->data[2];
-    const unsigned char *srcpY = src->data[0];
-    const int src_pitchY  = src->linesize[0];
-    const int src_pitchUV = src->linesize[1];
-    const int height = src->video->h;
-    const int width = src->video->w;
-    unsigned char *dstpU = dst->data[1];
-    unsigned char *dstpV = dst->data[2];
-    unsigned char *dstpY = dst->data[0];
-    const int dst_pitchY  = dst->linesize[0];
-    const int dst_pitchUV = dst->linesize[1];
-    const int c2 = color->yuv_convert[color->mode][0][1];
-    const int c3 = color->yuv_convert[color->mode][0][2];
-    const int c4 = color->yuv_convert[color->mode][1][1];
-    const int c5 = color->yuv_convert[color->mode][1][2];
-    const int c6 = color->yuv_convert[color->mode][2][1];
-    const int c7 = color->yuv_convert[color->mode][2][2];
-    int x, y;
-
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x += 2) {
-            const int u = srcpU[x >> 1] - 128;
-            const int v = srcpV[x >> 1] - 128;
-            const int uvval = c2 * u + c3 * v + 1081344;
-            dstpY[x + 0] = CB((65536 * (srcpY[x + 0] - 16) + uvval) >> 16);
-            dstpY[x + 1] = CB((65536 * (srcpY[x + 1] - 16) + uvval) >> 16);
-            dstpU[x >> 1] = CB((c4 * u + c5 * v + 8421376) >> 16);
-            dstpV[x >> 1] = CB((c6 * u + c7 * v + 8421376) >> 16);
+    uint16_t *y0 = (uint16_t *)_y0, *y1 = (uint16_t *)_y1;
+    uint16_t *u  = (uint16_t *)_u,  *v  = (uint16_t *)_v;
+    const int bias = coeffs[3][0], max = coeffs[4][0];
+    int x;
+
+    for (x = 0; x < width; x++) {
+        const int cu = u[x] - bias;
+        const int cv = v[x] - bias;
+        const int dy = (coeffs[0][0] * cu + coeffs[0][1] * cv + 32768) >> 16;
+        y0[2*x  ] = av_clip(y0[2*x  ] + dy, 0, max);
+        y0[2*x+1] = av_clip(y0[2*x+1] + dy, 0, max);
+        if (y1) {
+            y1[2*x  ] = av_clip(y1[2*x  ] + dy, 0, max);
+            y1[2*x+1] = av_clip(y1[2*x+1] + dy, 0, max);
         }
-        srcpY += src_pitchY;
-        dstpY += dst_pitchY;
-        srcpU += src_pitchUV;
-        srcpV += src_pitchUV;
-        dstpU += dst_pitchUV;
-        dstpV += dst_pitchUV;
+        u[x] = av_clip(u[x] + ((coeffs[1][0] * cu + coeffs[1][1] * cv + 32768) >> 16), 0, max);
+        v[x] = av_clip(v[x] + ((coeffs[2][0] * cu + coeffs[2][1] * cv + 32768) >> 16), 0, max);
     }
 }
 
-static void process_frame_yuv420p(ColorMatrixContext *color,
-                                  AVFilterBufferRef *dst, AVFilterBufferRef *src)
+void ff_colormatrix_line_uyvy_c(uint8_t *line, int width, const int16_t (*coeffs)[8])
 {
-    const unsigned char *srcpU = src->data[1];
-    const unsigned char *srcpV = src->data[2];
-    const unsigned char *srcpY = src->data[0];
-    const unsigned char *srcpN = src->data[0] + src->linesize[0];
-    const int src_pitchY  = src->linesize[0];
-    const int src_pitchUV = src->linesize[1];
-    const int height = src->video->h;
-    const int width = src->video->w;
-    unsigned char *dstpU = dst->data[1];
-    unsigned char *dstpV = dst->data[2];
-    unsigned char *dstpY = dst->data[0];
-    unsigned char *dstpN = dst->data[0] + dst->linesize[0];
-    const int dst_pitchY  = dst->linesize[0];
-    const int dst_pitchUV = dst->linesize[1];
-    const int c2 = color->yuv_convert[color->mode][0][1];
-    const int c3 = color->yuv_convert[color->mode][0][2];
-    const int c4 = color->yuv_convert[color->mode][1][1];
-    const int c5 = color->yuv_convert[color->mode][1][2];
-    const int c6 = color->yuv_convert[color->mode][2][1];
-    const int c7 = color->yuv_convert[color->mode][2][2];
-    int x, y;
-
-    for (y = 0; y < height; y += 2) {
-        for (x = 0; x < width; x += 2) {
-            const int u = srcpU[x >> 1] - 128;
-            const int v = srcpV[x >> 1] - 128;
-            const int uvval = c2 * u + c3 * v + 1081344;
-            dstpY[x + 0] = CB((65536 * (srcpY[x + 0] - 16) + uvval) >> 16);
-            dstpY[x + 1] = CB((65536 * (srcpY[x + 1] - 16) + uvval) >> 16);
-            dstpN[x + 0] = CB((65536 * (srcpN[x + 0] - 16) + uvval) >> 16);
-            dstpN[x + 1] = CB((65536 * (srcpN[x + 1] - 16) + uvval) >> 16);
-            dstpU[x >> 1] = CB((c4 * u + c5 * v + 8421376) >> 16);
-            dstpV[x >> 1] = CB((c6 * u + c7 * v + 8421376) >> 16);
-        }
-        srcpY += src_pitchY << 1;
-        dstpY += dst_pitchY << 1;
-        srcpN += src_pitchY << 1;
-        dstpN += dst_pitchY << 1;
-        srcpU += src_pitchUV;
-        srcpV += src_pitchUV;
-        dstpU += dst_pitchUV;
-        dstpV += dst_pitchUV;
+    int x;
+
+    for (x = 0; x < 4*width; x += 4) {
+        const int cu = line[x + 0] - 128;
+        const int cv = line[x + 2] - 128;
+        const int dy = (coeffs[0][0] * cu + coeffs[0][1] * cv + 32768) >> 16;
+        line[x + 0] = CB(line[x + 0] + ((coeffs[1][0] * cu + coeffs[1][1] * cv + 32768) >> 16));
+        line[x + 1] = CB(line[x + 1] + dy);
+        line[x + 2] = CB(line[x + 2] + ((coeffs[2][0] * cu + coeffs[2][1] * cv + 32768) >> 16));
+        line[x + 3] = CB(line[x + 3] + dy);
+    }
+}
+
+static int process_slice_uyvy422(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ColorMatrixContext *color = ctx->priv;
+    AVFilterBufferRef *dst = arg;
+    const int slice_start = (dst->video->h *  jobnr   ) / nb_jobs;
+    const int slice_end   = (dst->video->h * (jobnr+1)) / nb_jobs;
+    const int pitch = dst->linesize[0];
+    const int width = (dst->video->w + 1) >> 1;
+    uint8_t *p = dst->data[0] + slice_start * pitch;
+    int y;
+
+    for (y = slice_start; y < slice_end; y++) {
+        color->process_line_uyvy(p, width, color->coeffs);
+        p += pitch;
+    }
+    return 0;
+}
+
+static int process_slice_planar(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ColorMatrixContext *color = ctx->priv;
+    AVFilterBufferRef *dst = arg;
+    // with 4:2:0, split on pairs of luma lines, which share a chroma line
+    const int slice_start = ((dst->video->h >> color->vsub) *  jobnr   ) / nb_jobs;
+    const int slice_end   = ((dst->video->h >> color->vsub) * (jobnr+1)) / nb_jobs;
+    const int pitchY  = dst->linesize[0];
+    const int pitchUV = dst->linesize[1];
+    const int width = (dst->video->w + 1) >> 1;
+    uint8_t *pY = dst->data[0] + (slice_start << color->vsub) * pitchY;
+    uint8_t *pU = dst->data[1] + slice_start * pitchUV;
+    uint8_t *pV = dst->data[2] + slice_start * pitchUV;
+    int y;
+
+    for (y = slice_start; y < slice_end; y++) {
+        color->process_line_planar(pY, color->vsub ? pY + pitchY : NULL, pU, pV,
+                                   width, color->coeffs);
+        pY += pitchY << color->vsub;
+        pU += pitchUV;
+        pV += pitchUV;
     }
+    return 0;
 }
 
 static int config_input(AVFilterLink *inlink)
@@ -323,10 +309,39 @@ static int config_input(AVFilterLink *inlink)
     AVFilterContext *ctx = inlink->dst;
     ColorMatrixContext *color = ctx->priv;
     const AVPixFmtDescriptor *pix_desc = &av_pix_fmt_descriptors[inlink->format];
+    const int depth = pix_desc->comp[0].depth_minus1 + 1;
+    const int (*m)[3] = color->yuv_convert[color->mode];
+    const int16_t pairs[3][2] = { { m[0][1],         m[0][2]         },
+                                  { m[1][1] - 65536, m[1][2]         },
+                                  { m[2][1],         m[2][2] - 65536 } };
+    av_unused int cpu_flags = av_get_cpu_flags();
+    int i;
 
     color->hsub = pix_desc->log2_chroma_w;
     color->vsub = pix_desc->log2_chroma_h;
 
+    for (i = 0; i < 8; i++) {
+        color->coeffs[0][i] = pairs[0][i & 1];
+        color->coeffs[1][i] = pairs[1][i & 1];
+        color->coeffs[2][i] = pairs[2][i & 1];
+        color->coeffs[3][i] = 1 << (depth - 1);
+        color->coeffs[4][i] = (1 << depth) - 1;
+        color->coeffs[5][i] = i & 1 ? 0 : -32768;
+    }
+
+    if (depth > 8) {
+        color->process_line_planar = ff_colormatrix_line_planar_10_c;
+        if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2)
+            color->process_line_planar = ff_colormatrix_line_planar_10_sse2;
+    } else {
+        color->process_line_planar = ff_colormatrix_line_planar_c;
+        color->process_line_uyvy   = ff_colormatrix_line_uyvy_c;
+        if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2) {
+            color->process_line_planar = ff_colormatrix_line_planar_sse2;
+            color->process_line_uyvy   = ff_colormatrix_line_uyvy_sse2;
+        }
+    }
+
     av_log(ctx, AV_LOG_INFO, "%s -> %s\n", color->src, color->dst);
 
     return 0;
@@ -338,6 +353,8 @@ static int query_formats(AVFilterContext *ctx)
         PIX_FMT_YUV422P,
         PIX_FMT_YUV420P,
         PIX_FMT_UYVY422,
+        PIX_FMT_YUV422P10,
+        PIX_FMT_YUV420P10,
         PIX_FMT_NONE
     };
 
@@ -366,14 +383,14 @@ static void end_frame(AVFilterLink *link)
 {
     AVFilterContext *ctx = link->dst;
     ColorMatrixContext *color = ctx->priv;
-    AVFilterBufferRef *out = link->dst->outputs[0]->out_buf;
+    AVFilterBufferRef *out = ctx->outputs[0]->out_buf;
+    int nb_jobs = FFMIN(link->h >> color->vsub, ctx->thread_count);
 
-    if (link->cur_buf->format == PIX_FMT_YUV422P)
-        process_frame_yuv422p(color, out, link->cur_buf);
-    else if (link->cur_buf->format == PIX_FMT_YUV420P)
-        process_frame_yuv420p(color, out, link->cur_buf);
+    // the output shares the input buffer, lines are converted in place
+    if (link->cur_buf->format == PIX_FMT_UYVY422)
+        ctx->execute(ctx, process_slice_uyvy422, out, NULL, nb_jobs);
     else
-        process_frame_uyvy422(color, out, link->cur_buf);
+        ctx->execute(ctx, process_slice_planar, out, NULL, nb_jobs);
 
     avfilter_draw_slice(ctx->outputs[0], 0, link->dst->outputs[0]->h, 1);
     avfilter_end_frame(ctx->outputs[0]);
@@ -396,7 +413,9 @@ AVFilter avfilter_vf_colormatrix = {
                                     .start_frame      = start_frame,
                                     .get_video_buffer = get_video_buffer,
                                     .draw_slice       = null_draw_slice,
-                                    .end_frame        = end_frame, },
+                                    .end_frame        = end_frame,
+                                    .min_perms        = AV_PERM_READ|AV_PERM_WRITE,
+                                    .rej_perms        = AV_PERM_PRESERVE, },
                                   { .name = NULL}},
 
     .outputs   = (AVFilterPad[]) {{ .name             = "default",
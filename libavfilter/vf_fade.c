@@ -136,21 +136,45 @@ static int config_props(AVFilterLink *inlink)
     return 0;
 }
 
+typedef struct ThreadData {
+    AVFilterBufferRef *picref;
+    int y, h;
+} ThreadData;
+
+static int fade_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    FadeContext *fade = ctx->priv;
+    ThreadData *td = arg;
+    AVFilterBufferRef *picref = td->picref;
+    // keep chroma lines whole so that no two jobs blend the same line
+    int align = 1 << fade->dc.vsub_max;
+    int start = FFMIN(FFALIGN(td->h *  jobnr    / nb_jobs, align), td->h);
+    int end   = FFMIN(FFALIGN(td->h * (jobnr+1) / nb_jobs, align), td->h);
+
+    if (end > start)
+        ff_blend_rectangle(&fade->dc, &fade->color,
+                           picref->data, picref->linesize,
+                           picref->video->w, picref->video->h,
+                           0, td->y + start, picref->video->w, end - start);
+    return 0;
+}
+
 static void draw_slice(AVFilterLink *inlink, int y, int h, int slice_dir)
 {
-    FadeContext *fade = inlink->dst->priv;
+    AVFilterContext *ctx = inlink->dst;
+    FadeContext *fade = ctx->priv;
     AVFilterBufferRef *picref = inlink->cur_buf;
 
     if (fade->factor > 0) {
+        ThreadData td = { .picref = picref, .y = y, .h = h };
+
         fade->color.rgba[3] = lrint(fade->factor);
         ff_draw_color(&fade->dc, &fade->color, fade->color.rgba);
-        ff_blend_rectangle(&fade->dc, &fade->color,
-                           picref->data, picref->linesize,
-                           picref->video->w, picref->video->h,
-                           0, y, picref->video->w, h);
+        ctx->execute(ctx, fade_slice, &td, NULL,
+                     FFMAX(1, FFMIN(h >> fade->dc.vsub_max, ctx->thread_count)));
     }
 
-    avfilter_draw_slice(inlink->dst->outputs[0], y, h, slice_dir);
+    avfilter_draw_slice(ctx->outputs[0], y, h, slice_dir);
 }
 
 static void end_frame(AVFilterLink *inlink)
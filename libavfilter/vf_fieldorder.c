@@ -225,7 +225,7 @@ AVFilter avfilter_vf_fieldorder = {
                                         .get_video_buffer = get_video_buffer,
                                         .draw_slice       = draw_slice,
                                         .end_frame        = end_frame,
-                                        .min_perms        = AV_PERM_READ,
+                                        .min_perms        = AV_PERM_READ|AV_PERM_WRITE,
                                         .rej_perms        = AV_PERM_REUSE2|AV_PERM_PRESERVE,},
                                       { .name = NULL}},
     .outputs       = (AVFilterPad[]) {{ .name             = "default",
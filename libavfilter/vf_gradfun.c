@@ -74,13 +74,13 @@ void ff_gradfun_blur_line_c(uint16_t *dc, uint16_t *buf, const uint16_t *buf1, c
     }
 }
 
-static void filter(GradFunContext *ctx, uint8_t *dst, const uint8_t *src, int width, int height, int dst_linesize, int src_linesize, int r)
+static void filter(GradFunContext *ctx, uint16_t *plane_buf, uint8_t *dst, const uint8_t *src, int width, int height, int dst_linesize, int src_linesize, int r)
 {
     int bstride = FFALIGN(width, 16) / 2;
     int y;
     uint32_t dc_factor = (1 << 21) / (r * r);
-    uint16_t *dc = ctx->buf + 16;
-    uint16_t *buf = ctx->buf + bstride + 32;
+    uint16_t *dc = plane_buf + 16;
+    uint16_t *buf = plane_buf + bstride + 32;
     int thresh = ctx->thresh;
 
     memset(dc, 0, (bstride + 16) * sizeof(*buf));
@@ -171,7 +171,9 @@ static int config_input(AVFilterLink *inlink)
     int hsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_w;
     int vsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_h;
 
-    gf->buf = av_mallocz((FFALIGN(inlink->w, 16) * (gf->radius + 1) / 2 + 32) * sizeof(uint16_t));
+    gf->buf_size = FFALIGN(inlink->w, 16) * (gf->radius + 1) / 2 + 32;
+    av_free(gf->buf);
+    gf->buf = av_mallocz(4 * gf->buf_size * sizeof(uint16_t));
     if (!gf->buf)
         return AVERROR(ENOMEM);
 
@@ -187,7 +189,7 @@ static void start_frame(AVFilterLink *inlink, AVFilterBufferRef *inpicref)
     AVFilterLink *outlink = inlink->dst->outputs[0];
     AVFilterBufferRef *outpicref;
 
-    if (inpicref->perms & AV_PERM_PRESERVE) {
+    if (inpicref->perms & AV_PERM_PRESERVE || !(inpicref->perms & AV_PERM_WRITE)) {
         outpicref = avfilter_get_video_buffer(outlink, AV_PERM_WRITE, outlink->w, outlink->h);
         avfilter_copy_buffer_ref_props(outpicref, inpicref);
         outpicref->video->w = outlink->w;
@@ -201,29 +203,50 @@ static void start_frame(AVFilterLink *inlink, AVFilterBufferRef *inpicref)
 
 static void null_draw_slice(AVFilterLink *link, int y, int h, int slice_dir) { }
 
+typedef struct ThreadData {
+    AVFilterBufferRef *inpic, *outpic;
+} ThreadData;
+
+/**
+ * Filter one plane. The blur is computed incrementally down the plane,
+ * so the planes rather than bands of lines are run in parallel.
+ */
+static int filter_plane(AVFilterContext *ctx, void *arg, int p, int nb_jobs)
+{
+    GradFunContext *gf = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    ThreadData *td = arg;
+    AVFilterBufferRef *inpic  = td->inpic;
+    AVFilterBufferRef *outpic = td->outpic;
+    int w = inlink->w;
+    int h = inlink->h;
+    int r = gf->radius;
+
+    if (p) {
+        w = gf->chroma_w;
+        h = gf->chroma_h;
+        r = gf->chroma_r;
+    }
+
+    if (FFMIN(w, h) > 2 * r)
+        filter(gf, gf->buf + p * gf->buf_size, outpic->data[p], inpic->data[p], w, h, outpic->linesize[p], inpic->linesize[p], r);
+    else if (outpic->data[p] != inpic->data[p])
+        av_image_copy_plane(outpic->data[p], outpic->linesize[p], inpic->data[p], inpic->linesize[p], w, h);
+    return 0;
+}
+
 static void end_frame(AVFilterLink *inlink)
 {
-    GradFunContext *gf = inlink->dst->priv;
+    AVFilterContext *ctx = inlink->dst;
     AVFilterBufferRef *inpic = inlink->cur_buf;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
+    AVFilterLink *outlink = ctx->outputs[0];
     AVFilterBufferRef *outpic = outlink->out_buf;
-    int p;
-
-    for (p = 0; p < 4 && inpic->data[p]; p++) {
-        int w = inlink->w;
-        int h = inlink->h;
-        int r = gf->radius;
-        if (p) {
-            w = gf->chroma_w;
-            h = gf->chroma_h;
-            r = gf->chroma_r;
-        }
+    ThreadData td = { .inpic = inpic, .outpic = outpic };
+    int nb_planes;
 
-        if (FFMIN(w, h) > 2 * r)
-            filter(gf, outpic->data[p], inpic->data[p], w, h, outpic->linesize[p], inpic->linesize[p], r);
-        else if (outpic->data[p] != inpic->data[p])
-            av_image_copy_plane(outpic->data[p], outpic->linesize[p], inpic->data[p], inpic->linesize[p], w, h);
-    }
+    for (nb_planes = 0; nb_planes < 4 && inpic->data[nb_planes]; nb_planes++)
+        ;
+    ctx->execute(ctx, filter_plane, &td, NULL, nb_planes);
 
     avfilter_draw_slice(outlink, 0, inlink->h, 1);
     avfilter_end_frame(outlink);
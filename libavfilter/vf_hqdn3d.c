@@ -29,7 +29,7 @@
 
 typedef struct {
     int Coefs[4][512*16];
-    unsigned int *Line;
+    unsigned int *Line[3];    ///< one line buffer per plane, planes are denoised in parallel
     unsigned short *Frame[3];
     int hsub, vsub;
 } HQDN3DContext;
@@ -255,7 +255,9 @@ static void uninit(AVFilterContext *ctx)
 {
     HQDN3DContext *hqdn3d = ctx->priv;
 
-    av_freep(&hqdn3d->Line);
+    av_freep(&hqdn3d->Line[0]);
+    av_freep(&hqdn3d->Line[1]);
+    av_freep(&hqdn3d->Line[2]);
     av_freep(&hqdn3d->Frame[0]);
     av_freep(&hqdn3d->Frame[1]);
     av_freep(&hqdn3d->Frame[2]);
@@ -275,46 +277,63 @@ static int query_formats(AVFilterContext *ctx)
 static int config_input(AVFilterLink *inlink)
 {
     HQDN3DContext *hqdn3d = inlink->dst->priv;
+    int i;
 
     hqdn3d->hsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_w;
     hqdn3d->vsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_h;
 
-    hqdn3d->Line = av_malloc(inlink->w * sizeof(*hqdn3d->Line));
-    if (!hqdn3d->Line)
-        return AVERROR(ENOMEM);
+    for (i = 0; i < 3; i++) {
+        hqdn3d->Line[i] = av_malloc(inlink->w * sizeof(*hqdn3d->Line[i]));
+        if (!hqdn3d->Line[i])
+            return AVERROR(ENOMEM);
+    }
 
     return 0;
 }
 
 static void null_draw_slice(AVFilterLink *link, int y, int h, int slice_dir) { }
 
+typedef struct ThreadData {
+    AVFilterBufferRef *inpic, *outpic;
+} ThreadData;
+
+/**
+ * Denoise one plane. The filter is recursive in both directions, so the
+ * planes rather than bands of lines are run in parallel.
+ */
+static int denoise_plane(AVFilterContext *ctx, void *arg, int plane, int nb_jobs)
+{
+    HQDN3DContext *hqdn3d = ctx->priv;
+    ThreadData *td = arg;
+    AVFilterBufferRef *inpic  = td->inpic;
+    AVFilterBufferRef *outpic = td->outpic;
+    int w = inpic->video->w;
+    int h = inpic->video->h;
+    int c = plane ? 2 : 0;
+
+    if (plane) {
+        w >>= hqdn3d->hsub;
+        h >>= hqdn3d->vsub;
+    }
+
+    deNoise(inpic->data[plane], outpic->data[plane],
+            hqdn3d->Line[plane], &hqdn3d->Frame[plane], w, h,
+            inpic->linesize[plane], outpic->linesize[plane],
+            hqdn3d->Coefs[c],
+            hqdn3d->Coefs[c],
+            hqdn3d->Coefs[c+1]);
+    return 0;
+}
+
 static void end_frame(AVFilterLink *inlink)
 {
-    HQDN3DContext *hqdn3d = inlink->dst->priv;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
+    AVFilterContext *ctx = inlink->dst;
+    AVFilterLink *outlink = ctx->outputs[0];
     AVFilterBufferRef *inpic  = inlink ->cur_buf;
     AVFilterBufferRef *outpic = outlink->out_buf;
-    int cw = inpic->video->w >> hqdn3d->hsub;
-    int ch = inpic->video->h >> hqdn3d->vsub;
-
-    deNoise(inpic->data[0], outpic->data[0],
-            hqdn3d->Line, &hqdn3d->Frame[0], inpic->video->w, inpic->video->h,
-            inpic->linesize[0], outpic->linesize[0],
-            hqdn3d->Coefs[0],
-            hqdn3d->Coefs[0],
-            hqdn3d->Coefs[1]);
-    deNoise(inpic->data[1], outpic->data[1],
-            hqdn3d->Line, &hqdn3d->Frame[1], cw, ch,
-            inpic->linesize[1], outpic->linesize[1],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[3]);
-    deNoise(inpic->data[2], outpic->data[2],
-            hqdn3d->Line, &hqdn3d->Frame[2], cw, ch,
-            inpic->linesize[2], outpic->linesize[2],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[3]);
+    ThreadData td = { .inpic = inpic, .outpic = outpic };
+
+    ctx->execute(ctx, denoise_plane, &td, NULL, 3);
 
     avfilter_draw_slice(outlink, 0, inpic->video->h, 1);
     avfilter_end_frame(outlink);
@@ -27,6 +27,8 @@
  */
 
 #include "avfilter.h"
+#include "overlay.h"
+#include "libavutil/cpu.h"
 #include "libavutil/eval.h"
 #include "libavutil/avstring.h"
 #include "libavutil/pixdesc.h"
@@ -82,6 +84,9 @@ typedef struct {
     int main_pix_step[4];       ///< steps per pixel for each plane of the main output
     int overlay_pix_step[4];    ///< steps per pixel for each plane of the overlay
     int hsub, vsub;             ///< chroma subsampling values
+    int overlay_vsub;           ///< vertical chroma subsampling of the overlay
+
+    void (*blend_line)(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width);
 
     char x_expr[256], y_expr[256], rgb_expr[256];
 } OverlayContext;
@@ -124,8 +129,13 @@ static int query_formats(AVFilterContext *ctx)
     OverlayContext *over = ctx->priv;
 
     /* overlay formats contains alpha, for avoiding conversion with alpha information loss */
-    const enum PixelFormat main_pix_fmts_yuv[] = { PIX_FMT_YUV420P, PIX_FMT_YUVA420P, PIX_FMT_NONE };
-    const enum PixelFormat overlay_pix_fmts_yuv[] = { PIX_FMT_YUVA420P, PIX_FMT_NONE };
+    const enum PixelFormat main_pix_fmts_yuv[] = {
+        PIX_FMT_YUV420P,   PIX_FMT_YUVA420P,
+        PIX_FMT_YUV422P,   PIX_FMT_YUVA422P,
+        PIX_FMT_YUV420P10, PIX_FMT_YUV422P10,
+        PIX_FMT_NONE
+    };
+    const enum PixelFormat overlay_pix_fmts_yuv[] = { PIX_FMT_YUVA420P, PIX_FMT_YUVA422P, PIX_FMT_NONE };
     const enum PixelFormat main_pix_fmts_rgb[] = {
         PIX_FMT_ARGB,  PIX_FMT_RGBA,
         PIX_FMT_ABGR,  PIX_FMT_BGRA,
@@ -161,7 +171,7 @@ static int query_formats(AVFilterContext *ctx)
 }
 
 static const enum PixelFormat alpha_pix_fmts[] = {
-    PIX_FMT_YUVA420P, PIX_FMT_ARGB, PIX_FMT_ABGR, PIX_FMT_RGBA,
+    PIX_FMT_YUVA420P, PIX_FMT_YUVA422P, PIX_FMT_ARGB, PIX_FMT_ABGR, PIX_FMT_RGBA,
     PIX_FMT_BGRA, PIX_FMT_NONE
 };
 
@@ -170,6 +180,7 @@ static int config_input_main(AVFilterLink *inlink)
     AVFilterContext *ctx = inlink->dst;
     OverlayContext *over = inlink->dst->priv;
     const AVPixFmtDescriptor *pix_desc = &av_pix_fmt_descriptors[inlink->format];
+    av_unused int cpu_flags = av_get_cpu_flags();
 
 #ifdef DEBUG
     av_log(ctx, AV_LOG_DEBUG, "config_input_main()\n");
@@ -184,6 +195,16 @@ static int config_input_main(AVFilterLink *inlink)
         ff_fill_rgba_map(over->main_rgba_map, inlink->format) >= 0;
     over->main_has_alpha = ff_fmt_is_in(inlink->format, alpha_pix_fmts);
 
+    if (pix_desc->comp[0].depth_minus1 > 7) {
+        over->blend_line = ff_overlay_blend_line_10_c;
+        if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2)
+            over->blend_line = ff_overlay_blend_line_10_sse2;
+    } else {
+        over->blend_line = ff_overlay_blend_line_c;
+        if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2)
+            over->blend_line = ff_overlay_blend_line_sse2;
+    }
+
     return 0;
 }
 
@@ -201,6 +222,7 @@ static int config_input_overlay(AVFilterLink *inlink)
 #endif
 
     av_image_fill_max_pixsteps(over->overlay_pix_step, NULL, pix_desc);
+    over->overlay_vsub = pix_desc->log2_chroma_h;
 
     /* Finish the configuration by evaluating the expressions
        now when both inputs are configured. */
@@ -315,6 +337,66 @@ static void start_frame_overlay(AVFilterLink *inlink, AVFilterBufferRef *inpicre
 // ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)) is a faster version of: 255 * (x + y)
 #define UNPREMULTIPLY_ALPHA(x, y) ((((x) << 16) - ((x) << 9) + (x)) / ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)))
 
+void ff_overlay_blend_line_c(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width)
+{
+    int k;
+
+    for (k = 0; k < width; k++) {
+        switch (alpha[k]) {
+        case 0:
+            break;
+        case 255:
+            dst[k] = src[k];
+            break;
+        default:
+            dst[k] = FAST_DIV255(dst[k] * (255 - alpha[k]) + src[k] * alpha[k]);
+        }
+    }
+}
+
+void ff_overlay_blend_line_10_c(uint8_t *_dst, const uint8_t *src, const uint8_t *alpha, int width)
+{
+    uint16_t *dst = (uint16_t *)_dst;
+    int k;
+
+    for (k = 0; k < width; k++) {
+        switch (alpha[k]) {
+        case 0:
+            break;
+        case 255:
+            dst[k] = src[k] << 2;
+            break;
+        default:
+            dst[k] = FAST_DIV255(dst[k] * (255 - alpha[k]) + (src[k] << 2) * alpha[k]);
+        }
+    }
+}
+
+#define ALPHA_CHUNK 512
+
+/**
+ * Average the overlay alpha covered by the chroma samples start to
+ * start+n-1 of a line of wp samples, improves quality.
+ */
+static void chroma_alpha_line(uint8_t *dst, const uint8_t *a, int linesize,
+                              int start, int n, int wp, int hsub, int vsub, int next_line)
+{
+    int k;
+
+    for (k = start; k < start + n; k++) {
+        const uint8_t *p = a + (k << hsub);
+        uint8_t alpha_v, alpha_h;
+        if (hsub && vsub && next_line && k+1 < wp) {
+            *dst++ = (p[0] + p[linesize] + p[1] + p[linesize+1]) >> 2;
+        } else if (hsub || vsub) {
+            alpha_h = hsub && k+1 < wp ? (p[0] + p[1]) >> 1 : p[0];
+            alpha_v = vsub && next_line ? (p[0] + p[linesize]) >> 1 : p[0];
+            *dst++ = (alpha_v + alpha_h) >> 1;
+        } else
+            *dst++ = p[0];
+    }
+}
+
 static void blend_slice(AVFilterContext *ctx,
                         AVFilterBufferRef *dst, AVFilterBufferRef *src,
                         int x, int y, int w, int h,
@@ -432,63 +514,104 @@ static void blend_slice(AVFilterContext *ctx,
         for (i = 0; i < 3; i++) {
             int hsub = i ? over->hsub : 0;
             int vsub = i ? over->vsub : 0;
-            uint8_t *dp = dst->data[i] + (x >> hsub) +
+            int ovsub = i ? over->overlay_vsub : 0;
+            uint8_t *dp = dst->data[i] + (x >> hsub) * over->main_pix_step[i] +
                 (start_y >> vsub) * dst->linesize[i];
-            uint8_t *sp = src->data[i];
             uint8_t *ap = src->data[3];
+            int sy = 0;
             int wp = FFALIGN(width, 1<<hsub) >> hsub;
             int hp = FFALIGN(height, 1<<vsub) >> vsub;
+            // rows left until the bottom of the blended area, which may span several slices
+            int hp_end = FFALIGN(FFMIN(overlay_end_y, dst->video->h) - start_y, 1<<vsub) >> vsub;
             if (slice_y > y) {
-                sp += ((slice_y - y) >> vsub) * src->linesize[i];
+                sy  = (slice_y - y) >> vsub;
                 ap += (slice_y - y) * src->linesize[3];
             }
             for (j = 0; j < hp; j++) {
+                // the overlay may have a different vertical chroma subsampling
+                uint8_t *sp = src->data[i] + (((sy + j) << vsub) >> ovsub) * src->linesize[i];
                 uint8_t *d = dp, *s = sp, *a = ap;
-                for (k = 0; k < wp; k++) {
-                    // average alpha for color components, improve quality
-                    uint8_t alpha_v, alpha_h, alpha;
-                    if (hsub && vsub && j+1 < hp && k+1 < wp) {
-                        alpha = (a[0] + a[src->linesize[3]] +
-                                 a[1] + a[src->linesize[3]+1]) >> 2;
-                    } else if (hsub || vsub) {
-                        alpha_h = hsub && k+1 < wp ?
-                            (a[0] + a[1]) >> 1 : a[0];
-                        alpha_v = vsub && j+1 < hp ?
-                            (a[0] + a[src->linesize[3]]) >> 1 : a[0];
-                        alpha = (alpha_v + alpha_h) >> 1;
-                    } else
-                        alpha = a[0];
-                    // if the main channel has an alpha channel, alpha has to be calculated
-                    // to create an un-premultiplied (straight) alpha value
-                    if (main_has_alpha && alpha != 0 && alpha != 255) {
+                if (!main_has_alpha) {
+                    if (!i) {
+                        over->blend_line(dp, sp, ap, wp);
+                    } else {
+                        uint8_t alpha[ALPHA_CHUNK];
+                        for (k = 0; k < wp; k += ALPHA_CHUNK) {
+                            int n = FFMIN(wp - k, ALPHA_CHUNK);
+                            chroma_alpha_line(alpha, ap, src->linesize[3], k, n, wp,
+                                              hsub, vsub, j+1 < hp_end);
+                            over->blend_line(dp + k * over->main_pix_step[i], sp + k, alpha, n);
+                        }
+                    }
+                } else {
+                    for (k = 0; k < wp; k++) {
                         // average alpha for color components, improve quality
-                        uint8_t alpha_d;
-                        if (hsub && vsub && j+1 < hp && k+1 < wp) {
-                            alpha_d = (d[0] + d[src->linesize[3]] +
-                                       d[1] + d[src->linesize[3]+1]) >> 2;
+                        uint8_t alpha_v, alpha_h, alpha;
+                        if (hsub && vsub && j+1 < hp_end && k+1 < wp) {
+                            alpha = (a[0] + a[src->linesize[3]] +
+                                     a[1] + a[src->linesize[3]+1]) >> 2;
                         } else if (hsub || vsub) {
                             alpha_h = hsub && k+1 < wp ?
-                                (d[0] + d[1]) >> 1 : d[0];
-                            alpha_v = vsub && j+1 < hp ?
-                                (d[0] + d[src->linesize[3]]) >> 1 : d[0];
-                            alpha_d = (alpha_v + alpha_h) >> 1;
+                                (a[0] + a[1]) >> 1 : a[0];
+                            alpha_v = vsub && j+1 < hp_end ?
+                                (a[0] + a[src->linesize[3]]) >> 1 : a[0];
+                            alpha = (alpha_v + alpha_h) >> 1;
                         } else
-                            alpha_d = d[0];
-                        alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);
+                            alpha = a[0];
+                        // if the main channel has an alpha channel, alpha has to be calculated
+                        // to create an un-premultiplied (straight) alpha value
+                        if (main_has_alpha && alpha != 0 && alpha != 255) {
+                            // average alpha for color components, improve quality
+                            uint8_t alpha_d;
+                            if (hsub && vsub && j+1 < hp_end && k+1 < wp) {
+                                alpha_d = (d[0] + d[src->linesize[3]] +
+                                           d[1] + d[src->linesize[3]+1]) >> 2;
+                            } else if (hsub || vsub) {
+                                alpha_h = hsub && k+1 < wp ?
+                                    (d[0] + d[1]) >> 1 : d[0];
+                                alpha_v = vsub && j+1 < hp_end ?
+                                    (d[0] + d[src->linesize[3]]) >> 1 : d[0];
+                                alpha_d = (alpha_v + alpha_h) >> 1;
+                            } else
+                                alpha_d = d[0];
+                            alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);
+                        }
+                        *d = FAST_DIV255(*d * (255 - alpha) + *s * alpha);
+                        s++;
+                        d++;
+                        a += 1 << hsub;
                     }
-                    *d = FAST_DIV255(*d * (255 - alpha) + *s * alpha);
-                    s++;
-                    d++;
-                    a += 1 << hsub;
                 }
                 dp += dst->linesize[i];
-                sp += src->linesize[i];
                 ap += (1 << vsub) * src->linesize[3];
             }
         }
     }
 }
 
+typedef struct ThreadData {
+    AVFilterBufferRef *dst;
+    int y, h;
+} ThreadData;
+
+static int blend_slice_job(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    OverlayContext *over = ctx->priv;
+    ThreadData *td = arg;
+    AVFilterBufferRef *overpicref = over->overpicref;
+    int align = 1 << over->vsub;
+    int start = FFMIN(FFALIGN(td->h *  jobnr    / nb_jobs, align), td->h);
+    int end   = FFMIN(FFALIGN(td->h * (jobnr+1) / nb_jobs, align), td->h);
+    int y = td->y + start;
+    int h = end - start;
+
+    if (h > 0 && !(y+h < over->y || y >= over->y + overpicref->video->h))
+        blend_slice(ctx, td->dst, overpicref, over->x, over->y,
+                    overpicref->video->w, overpicref->video->h,
+                    y, td->dst->video->w, h);
+    return 0;
+}
+
 static void draw_slice(AVFilterLink *inlink, int y, int h, int slice_dir)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -499,9 +622,14 @@ static void draw_slice(AVFilterLink *inlink, int y, int h, int slice_dir)
     if (over->overpicref &&
         !(over->x >= outpicref->video->w || over->y >= outpicref->video->h ||
           y+h < over->y || y >= over->y + over->overpicref->video->h)) {
-        blend_slice(ctx, outpicref, over->overpicref, over->x, over->y,
-                    over->overpicref->video->w, over->overpicref->video->h,
-                    y, outpicref->video->w, h);
+        ThreadData td = { .dst = outpicref, .y = y, .h = h };
+        int nb_jobs = FFMIN(h >> over->vsub, ctx->thread_count);
+
+        // the chroma blending of a planar main picture with alpha reads
+        // the next line, which may belong to another job
+        if (over->main_has_alpha && !over->main_is_packed_rgb)
+            nb_jobs = 1;
+        ctx->execute(ctx, blend_slice_job, &td, NULL, FFMAX(nb_jobs, 1));
     }
     avfilter_draw_slice(outlink, y, h, slice_dir);
 }
@@ -534,7 +662,7 @@ AVFilter avfilter_vf_overlay = {
                                     .config_props    = config_input_main,
                                     .draw_slice      = draw_slice,
                                     .end_frame       = end_frame,
-                                    .min_perms       = AV_PERM_READ,
+                                    .min_perms       = AV_PERM_READ|AV_PERM_WRITE,
                                     .rej_perms       = AV_PERM_REUSE2|AV_PERM_PRESERVE, },
                                   { .name            = "overlay",
                                     .type            = AVMEDIA_TYPE_VIDEO,
@@ -302,18 +302,38 @@ static int scale_slice(AVFilterLink *link, struct SwsContext *sws, int y, int h,
                          out,out_stride);
 }
 
+typedef struct ThreadData {
+    AVFilterLink *link;
+    int y, h;
+} ThreadData;
+
+/**
+ * Scale one field. Each field has its own scaler context, so both fields
+ * of a slice are scaled in parallel.
+ */
+static int scale_field(AVFilterContext *ctx, void *arg, int field, int nb_jobs)
+{
+    ScaleContext *scale = ctx->priv;
+    ThreadData *td = arg;
+
+    return scale_slice(td->link, scale->isws[field], td->y, (td->h + !field) / 2, 2, field);
+}
+
 static void draw_slice(AVFilterLink *link, int y, int h, int slice_dir)
 {
-    ScaleContext *scale = link->dst->priv;
+    AVFilterContext *ctx = link->dst;
+    ScaleContext *scale = ctx->priv;
     int out_h;
 
     if (scale->slice_y == 0 && slice_dir == -1)
         scale->slice_y = link->dst->outputs[0]->h;
 
     if(scale->interlaced>0 || (scale->interlaced<0 && link->cur_buf->video->interlaced)){
+        ThreadData td = { .link = link, .y = y, .h = h };
+        int field_h[2];
         av_assert0(y%4 == 0);
-        out_h = scale_slice(link, scale->isws[0], y, (h+1)/2, 2, 0);
-        out_h+= scale_slice(link, scale->isws[1], y,  h   /2, 2, 1);
+        ctx->execute(ctx, scale_field, &td, field_h, 2);
+        out_h = field_h[0] + field_h[1];
     }else{
         out_h = scale_slice(link, scale->sws, y, h, 1, 0);
     }
@@ -55,7 +55,8 @@ typedef struct FilterParam {
     int steps_y;                             ///< vertical step count
     int scalebits;                           ///< bits to shift pixel
     int32_t halfscale;                       ///< amount to add to pixel
-    uint32_t *sc[(MAX_SIZE * MAX_SIZE) - 1]; ///< finite state machine storage
+    uint32_t *sc;                            ///< finite state machine storage, 2 * steps_y lines per thread
+    int sc_size;                             ///< number of elements in each line of sc
 } FilterParam;
 
 typedef struct {
@@ -63,30 +64,42 @@ typedef struct {
     FilterParam chroma; ///< chroma parameters (width, height, amount)
 } UnsharpContext;
 
-static void unsharpen(uint8_t *dst, const uint8_t *src, int dst_stride, int src_stride, int width, int height, FilterParam *fp)
+/**
+ * Filter lines slice_start to slice_end - 1 of a plane. Lines outside of
+ * the slice are read to fill the vertical window, so slices are
+ * independent and give the same result as filtering the plane at once.
+ */
+static void unsharpen(uint8_t *dst, const uint8_t *src, int dst_stride, int src_stride, int width, int height,
+                      FilterParam *fp, uint32_t *sc_buf, int slice_start, int slice_end)
 {
-    uint32_t **sc = fp->sc;
+    uint32_t *sc[(MAX_SIZE * MAX_SIZE) - 1];
     uint32_t sr[(MAX_SIZE * MAX_SIZE) - 1], tmp1, tmp2;
 
     int32_t res;
     int x, y, z;
 
     if (!fp->amount) {
+        src += slice_start * src_stride;
+        dst += slice_start * dst_stride;
         if (dst_stride == src_stride)
-            memcpy(dst, src, src_stride * height);
+            memcpy(dst, src, src_stride * (slice_end - slice_start));
         else
-            for (y = 0; y < height; y++, dst += dst_stride, src += src_stride)
+            for (y = slice_start; y < slice_end; y++, dst += dst_stride, src += src_stride)
                 memcpy(dst, src, width);
         return;
     }
 
-    for (y = 0; y < 2 * fp->steps_y; y++)
+    for (y = 0; y < 2 * fp->steps_y; y++) {
+        sc[y] = sc_buf + y * fp->sc_size;
         memset(sc[y], 0, sizeof(sc[y][0]) * (width + 2 * fp->steps_x));
+    }
+
+    for (y = slice_start - fp->steps_y; y < slice_end + fp->steps_y; y++) {
+        const uint8_t *srl = src + FFMAX(y, 0) * src_stride;
 
-    for (y = -fp->steps_y; y < height + fp->steps_y; y++) {
         memset(sr, 0, sizeof(sr[0]) * (2 * fp->steps_x - 1));
         for (x = -fp->steps_x; x < width + fp->steps_x; x++) {
-            tmp1 = x <= 0 ? src[0] : x >= width ? src[width-1] : src[x];
+            tmp1 = x <= 0 ? srl[0] : x >= width ? srl[width-1] : srl[x];
             for (z = 0; z < fp->steps_x * 2; z += 2) {
                 tmp2 = sr[z + 0] + tmp1; sr[z + 0] = tmp1;
                 tmp1 = sr[z + 1] + tmp2; sr[z + 1] = tmp2;
@@ -95,18 +108,14 @@ static void unsharpen(uint8_t *dst, const uint8_t *src, int dst_stride, int src_
                 tmp2 = sc[z + 0][x + fp->steps_x] + tmp1; sc[z + 0][x + fp->steps_x] = tmp1;
                 tmp1 = sc[z + 1][x + fp->steps_x] + tmp2; sc[z + 1][x + fp->steps_x] = tmp2;
             }
-            if (x >= fp->steps_x && y >= fp->steps_y) {
-                const uint8_t* srx = src - fp->steps_y * src_stride + x - fp->steps_x;
-                uint8_t* dsx = dst - fp->steps_y * dst_stride + x - fp->steps_x;
+            if (x >= fp->steps_x && y >= slice_start + fp->steps_y) {
+                const uint8_t* srx = src + (y - fp->steps_y) * src_stride + x - fp->steps_x;
+                uint8_t* dsx = dst + (y - fp->steps_y) * dst_stride + x - fp->steps_x;
 
                 res = (int32_t)*srx + ((((int32_t) * srx - (int32_t)((tmp1 + fp->halfscale) >> fp->scalebits)) * fp->amount) >> 16);
                 *dsx = av_clip_uint8(res);
             }
         }
-        if (y >= 0) {
-            dst += dst_stride;
-            src += src_stride;
-        }
     }
 }
 
@@ -160,9 +169,8 @@ static int query_formats(AVFilterContext *ctx)
     return 0;
 }
 
-static void init_filter_param(AVFilterContext *ctx, FilterParam *fp, const char *effect_type, int width)
+static int init_filter_param(AVFilterContext *ctx, FilterParam *fp, const char *effect_type, int width)
 {
-    int z;
     const char *effect;
 
     effect = fp->amount == 0 ? "none" : fp->amount < 0 ? "blur" : "sharpen";
@@ -170,26 +178,30 @@ static void init_filter_param(AVFilterContext *ctx, FilterParam *fp, const char
     av_log(ctx, AV_LOG_INFO, "effect:%s type:%s msize_x:%d msize_y:%d amount:%0.2f\n",
            effect, effect_type, fp->msize_x, fp->msize_y, fp->amount / 65535.0);
 
-    for (z = 0; z < 2 * fp->steps_y; z++)
-        fp->sc[z] = av_malloc(sizeof(*(fp->sc[z])) * (width + 2 * fp->steps_x));
+    fp->sc_size = width + 2 * fp->steps_x;
+    av_free(fp->sc);
+    fp->sc = av_malloc(sizeof(*fp->sc) * fp->sc_size * 2 * fp->steps_y * ctx->thread_count);
+    if (!fp->sc && fp->steps_y)
+        return AVERROR(ENOMEM);
+    return 0;
 }
 
 static int config_props(AVFilterLink *link)
 {
     UnsharpContext *unsharp = link->dst->priv;
+    int ret;
 
-    init_filter_param(link->dst, &unsharp->luma,   "luma",   link->w);
-    init_filter_param(link->dst, &unsharp->chroma, "chroma", CHROMA_WIDTH(link));
+    if ((ret = init_filter_param(link->dst, &unsharp->luma,   "luma",   link->w)) < 0)
+        return ret;
+    if ((ret = init_filter_param(link->dst, &unsharp->chroma, "chroma", CHROMA_WIDTH(link))) < 0)
+        return ret;
 
     return 0;
 }
 
 static void free_filter_param(FilterParam *fp)
 {
-    int z;
-
-    for (z = 0; z < 2 * fp->steps_y; z++)
-        av_free(fp->sc[z]);
+    av_freep(&fp->sc);
 }
 
 static av_cold void uninit(AVFilterContext *ctx)
@@ -200,20 +212,44 @@ static av_cold void uninit(AVFilterContext *ctx)
     free_filter_param(&unsharp->chroma);
 }
 
-static void end_frame(AVFilterLink *link)
-{
-    UnsharpContext *unsharp = link->dst->priv;
-    AVFilterBufferRef *in  = link->cur_buf;
-    AVFilterBufferRef *out = link->dst->outputs[0]->out_buf;
+typedef struct ThreadData {
+    AVFilterBufferRef *in, *out;
+} ThreadData;
 
-    unsharpen(out->data[0], in->data[0], out->linesize[0], in->linesize[0], link->w,            link->h,             &unsharp->luma);
-    unsharpen(out->data[1], in->data[1], out->linesize[1], in->linesize[1], CHROMA_WIDTH(link), CHROMA_HEIGHT(link), &unsharp->chroma);
-    unsharpen(out->data[2], in->data[2], out->linesize[2], in->linesize[2], CHROMA_WIDTH(link), CHROMA_HEIGHT(link), &unsharp->chroma);
+static int unsharp_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    UnsharpContext *unsharp = ctx->priv;
+    AVFilterLink *link = ctx->inputs[0];
+    ThreadData *td = arg;
+    AVFilterBufferRef *in  = td->in;
+    AVFilterBufferRef *out = td->out;
+    int cw = CHROMA_WIDTH(link), ch = CHROMA_HEIGHT(link);
+    uint32_t *luma_sc   = unsharp->luma.sc   + jobnr * 2 * unsharp->luma.steps_y   * unsharp->luma.sc_size;
+    uint32_t *chroma_sc = unsharp->chroma.sc + jobnr * 2 * unsharp->chroma.steps_y * unsharp->chroma.sc_size;
+
+    unsharpen(out->data[0], in->data[0], out->linesize[0], in->linesize[0], link->w, link->h, &unsharp->luma,
+              luma_sc,   (link->h *  jobnr   ) / nb_jobs, (link->h * (jobnr+1)) / nb_jobs);
+    unsharpen(out->data[1], in->data[1], out->linesize[1], in->linesize[1], cw,      ch,      &unsharp->chroma,
+              chroma_sc, (ch      *  jobnr   ) / nb_jobs, (ch      * (jobnr+1)) / nb_jobs);
+    unsharpen(out->data[2], in->data[2], out->linesize[2], in->linesize[2], cw,      ch,      &unsharp->chroma,
+              chroma_sc, (ch      *  jobnr   ) / nb_jobs, (ch      * (jobnr+1)) / nb_jobs);
+    return 0;
+}
 
-    avfilter_unref_buffer(in);
-    avfilter_draw_slice(link->dst->outputs[0], 0, link->h, 1);
-    avfilter_end_frame(link->dst->outputs[0]);
-    avfilter_unref_buffer(out);
+static void end_frame(AVFilterLink *link)
+{
+    AVFilterContext *ctx = link->dst;
+    ThreadData td;
+
+    td.in  = link->cur_buf;
+    td.out = ctx->outputs[0]->out_buf;
+    ctx->execute(ctx, unsharp_slice, &td, NULL,
+                 FFMIN(CHROMA_HEIGHT(link), ctx->thread_count));
+
+    avfilter_unref_buffer(td.in);
+    avfilter_draw_slice(ctx->outputs[0], 0, link->h, 1);
+    avfilter_end_frame(ctx->outputs[0]);
+    avfilter_unref_buffer(td.out);
 }
 
 static void draw_slice(AVFilterLink *link, int y, int h, int slice_dir)
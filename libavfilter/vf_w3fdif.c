@@ -24,6 +24,7 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/pixdesc.h"
 #include "avfilter.h"
+#include "w3fdif.h"
 
 /* #define DEBUG */
 
@@ -31,7 +32,9 @@
 #include <assert.h>
 
 typedef struct {
-    int line_size[4];     ///< bytes of pixel data per line for each plane
+    int line_size[4];     ///< number of samples per line for each plane
+    int plane_height[4];  ///< number of lines of each plane
+    int depth;            ///< bits per sample
     int pending;          ///< how many fields are still waiting to be sent to next filter
     int field;            ///< which field are we on, 0 or 1
     int flush;            ///< are we flushing final frames
@@ -40,40 +43,133 @@ typedef struct {
 
     AVFilterBufferRef *prev, *crnt, *next;  ///< previous, current, next frames
     AVFilterBufferRef *work;                ///< frame we are working on
-    int32_t* work_line;   ///< line we are calculating
+    int32_t* work_line;   ///< line we are calculating, one per job
+    int work_line_size;   ///< number of int32_t in each of the work lines
 
+    W3FDIFDSPContext dsp;
 } W3FDIFContext;
 
 /** Martin Weston deinterlace filter */
 
-/** filter coefficients from PH-2071, scaled by 256*256
+/** filter coefficients from PH-2071, scaled by 256*128
  *
  *  each set of coefficients have a sets for low-frequencies and high-frequencies
  *  n_coef_lf[] and n_coef_hf[] are the number of coefs for simple and more-complex
  *  it is important for later that n_coef_lf[] is even and n_coef_hf[] is odd
  *  coef_lf[][] and coef_hf[][] are the coefficients for low-frequencies and high-
- *                              frequencies for simple and more-complex mode */
+ *                              frequencies for simple and more-complex mode
+ *  the coefficients are symmetric, the SIMD line filters rely on it */
 static const int     n_coef_lf[2]    = {2, 4};
-static const int32_t   coef_lf[2][4] = {{ 32768, 32768,     0,      0},
-                                        { -1704, 34472, 34472,  -1704}};
+static const int16_t   coef_lf[2][4] = {{ 16384, 16384,     0,      0},
+                                        {  -852, 17236, 17236,   -852}};
 static const int     n_coef_hf[2]    = {3, 5};
-static const int32_t   coef_hf[2][5] = {{ -4096,  8192, -4096,     0,     0},
-                                        {  2032, -7602, 11140, -7602,  2032}};
+static const int16_t   coef_hf[2][5] = {{ -2048,  4096, -2048,     0,     0},
+                                        {  1016, -3801,  5570, -3801,  1016}};
+
+#define DEFINE_LINE_FILTERS(suffix, pixel)                                     \
+static void filter_simple_low ## suffix(int32_t *work_line,                    \
+                                        uint8_t *in_lines_cur8[2],             \
+                                        const int16_t *coef, int linesize)     \
+{                                                                              \
+    const pixel *in_lines_cur[2] = { (pixel *)in_lines_cur8[0],                \
+                                     (pixel *)in_lines_cur8[1] };              \
+    int i;                                                                     \
+                                                                               \
+    for (i = 0; i < linesize; i++)                                             \
+        work_line[i] = in_lines_cur[0][i] * coef[0] +                          \
+                       in_lines_cur[1][i] * coef[1];                           \
+}                                                                              \
+                                                                               \
+static void filter_complex_low ## suffix(int32_t *work_line,                   \
+                                         uint8_t *in_lines_cur8[4],            \
+                                         const int16_t *coef, int linesize)    \
+{                                                                              \
+    const pixel *in_lines_cur[4] = { (pixel *)in_lines_cur8[0],                \
+                                     (pixel *)in_lines_cur8[1],                \
+                                     (pixel *)in_lines_cur8[2],                \
+                                     (pixel *)in_lines_cur8[3] };              \
+    int i;                                                                     \
+                                                                               \
+    for (i = 0; i < linesize; i++)                                             \
+        work_line[i] = in_lines_cur[0][i] * coef[0] +                          \
+                       in_lines_cur[1][i] * coef[1] +                          \
+                       in_lines_cur[2][i] * coef[2] +                          \
+                       in_lines_cur[3][i] * coef[3];                           \
+}                                                                              \
+                                                                               \
+static void filter_simple_high ## suffix(int32_t *work_line,                   \
+                                         uint8_t *in_lines_cur8[3],            \
+                                         uint8_t *in_lines_adj8[3],            \
+                                         const int16_t *coef, int linesize)    \
+{                                                                              \
+    const pixel *in_lines_cur[3] = { (pixel *)in_lines_cur8[0],                \
+                                     (pixel *)in_lines_cur8[1],                \
+                                     (pixel *)in_lines_cur8[2] };              \
+    const pixel *in_lines_adj[3] = { (pixel *)in_lines_adj8[0],                \
+                                     (pixel *)in_lines_adj8[1],                \
+                                     (pixel *)in_lines_adj8[2] };              \
+    int i;                                                                     \
+                                                                               \
+    for (i = 0; i < linesize; i++)                                             \
+        work_line[i] += (in_lines_cur[0][i] + in_lines_adj[0][i]) * coef[0] +  \
+                        (in_lines_cur[1][i] + in_lines_adj[1][i]) * coef[1] +  \
+                        (in_lines_cur[2][i] + in_lines_adj[2][i]) * coef[2];   \
+}                                                                              \
+                                                                               \
+static void filter_complex_high ## suffix(int32_t *work_line,                  \
+                                          uint8_t *in_lines_cur8[5],           \
+                                          uint8_t *in_lines_adj8[5],           \
+                                          const int16_t *coef, int linesize)   \
+{                                                                              \
+    const pixel *in_lines_cur[5] = { (pixel *)in_lines_cur8[0],                \
+                                     (pixel *)in_lines_cur8[1],                \
+                                     (pixel *)in_lines_cur8[2],                \
+                                     (pixel *)in_lines_cur8[3],                \
+                                     (pixel *)in_lines_cur8[4] };              \
+    const pixel *in_lines_adj[5] = { (pixel *)in_lines_adj8[0],                \
+                                     (pixel *)in_lines_adj8[1],                \
+                                     (pixel *)in_lines_adj8[2],                \
+                                     (pixel *)in_lines_adj8[3],                \
+                                     (pixel *)in_lines_adj8[4] };              \
+    int i;                                                                     \
+                                                                               \
+    for (i = 0; i < linesize; i++)                                             \
+        work_line[i] += (in_lines_cur[0][i] + in_lines_adj[0][i]) * coef[0] +  \
+                        (in_lines_cur[1][i] + in_lines_adj[1][i]) * coef[1] +  \
+                        (in_lines_cur[2][i] + in_lines_adj[2][i]) * coef[2] +  \
+                        (in_lines_cur[3][i] + in_lines_adj[3][i]) * coef[3] +  \
+                        (in_lines_cur[4][i] + in_lines_adj[4][i]) * coef[4];   \
+}                                                                              \
+                                                                               \
+static void filter_scale ## suffix(uint8_t *out_pixel8,                        \
+                                   const int32_t *work_pixel,                  \
+                                   int linesize, int max)                      \
+{                                                                              \
+    pixel *out_pixel = (pixel *)out_pixel8;                                    \
+    int i;                                                                     \
+                                                                               \
+    for (i = 0; i < linesize; i++)                                             \
+        out_pixel[i] = av_clip(work_pixel[i] >> 15, 0, max);                   \
+}
+
+DEFINE_LINE_FILTERS(,    uint8_t)
+DEFINE_LINE_FILTERS(_16, uint16_t)
 
 static int deinterlace_component(AVFilterContext *ctx,
         const AVFilterBufferRef *cur, const AVFilterBufferRef *adj,
-        const int filter, const int plane)
+        const int filter, const int plane, int32_t *work_buf,
+        const int slice_start, const int slice_end)
 {
     W3FDIFContext *w3fdif = ctx->priv;
+    W3FDIFDSPContext *dsp = &w3fdif->dsp;
 
     uint8_t *in_line, *out_line;
     uint8_t *in_lines_cur[5];
     uint8_t *in_lines_adj[5];
-    uint8_t *out_pixel;
-    int32_t* work_line;
-    int32_t *work_pixel;
     int j, y_in, y_out;
-    int cur_line_stride, adj_line_stride, dst_line_stride, line_size;
+    int cur_line_stride, adj_line_stride, dst_line_stride, line_size, height;
+    int max = (1 << w3fdif->depth) - 1;
+    int bps = (w3fdif->depth + 7) >> 3;
     uint8_t *cur_data, *adj_data, *dst_data;
 
     cur_line_stride = cur->linesize[plane];
@@ -81,10 +177,11 @@ static int deinterlace_component(AVFilterContext *ctx,
     dst_line_stride = w3fdif->work->linesize[plane];
 
     cur_data = cur->data[plane];
-    adj_data = cur->data[plane];
+    adj_data = adj->data[plane];
     dst_data = w3fdif->work->data[plane];
 
     line_size = w3fdif->line_size[plane];
+    height    = w3fdif->plane_height[plane];
 
     /** copy unchanged the lines of the field */
     if (w3fdif->field != cur->video->top_field_first) {
@@ -92,12 +189,13 @@ static int deinterlace_component(AVFilterContext *ctx,
     } else {
         y_out = 1;
     }
+    y_out = slice_start + ((slice_start ^ y_out) & 1);
 
     in_line  = cur_data + (y_out * cur_line_stride);
     out_line = dst_data + (y_out * dst_line_stride);
 
-    while (y_out < cur->video->h) {
-        memcpy(out_line, in_line, line_size);
+    while (y_out < slice_end) {
+        memcpy(out_line, in_line, line_size * bps);
         y_out += 2;
         in_line  += cur_line_stride * 2;
         out_line += dst_line_stride * 2;
@@ -109,118 +207,39 @@ static int deinterlace_component(AVFilterContext *ctx,
     } else {
         y_out = 1;
     }
+    y_out = slice_start + ((slice_start ^ y_out) & 1);
 
     out_line = dst_data + (y_out * dst_line_stride);
 
-    while (y_out < w3fdif->crnt->video->h) {
-        /** clear workspace */
-        memset(w3fdif->work_line, 0, sizeof(uint32_t) * line_size);
+    while (y_out < slice_end) {
         /** get low vertical frequencies from current field */
         for (j = 0; j < n_coef_lf[filter]; j++) {
             y_in = (y_out + 1) + (j * 2) - n_coef_lf[filter];
             while (y_in < 0) y_in += 2;
-            while (y_in >= cur->video->h) y_in -= 2;
+            while (y_in >= height) y_in -= 2;
             in_lines_cur[j] = cur_data + (y_in * cur_line_stride);
         }
-        work_line = w3fdif->work_line;
-        // TODO: set pixel stride for in
-        // these have been unrolled from an function with loops for speed
-        switch (n_coef_lf[filter]) {
-        case 5:
-            for (int i = 0; i < line_size; i++) {
-                *work_line   += *in_lines_cur[0]++ * coef_lf[filter][0];
-                *work_line   += *in_lines_cur[1]++ * coef_lf[filter][1];
-                *work_line   += *in_lines_cur[2]++ * coef_lf[filter][2];
-                *work_line   += *in_lines_cur[3]++ * coef_lf[filter][3];
-                *work_line++ += *in_lines_cur[4]++ * coef_lf[filter][4];
-            }
-            break;
-        case 4:
-            for (int i = 0; i < line_size; i++) {
-                *work_line   += *in_lines_cur[0]++ * coef_lf[filter][0];
-                *work_line   += *in_lines_cur[1]++ * coef_lf[filter][1];
-                *work_line   += *in_lines_cur[2]++ * coef_lf[filter][2];
-                *work_line++ += *in_lines_cur[3]++ * coef_lf[filter][3];
-            }
-            break;
-        case 3:
-            for (int i = 0; i < line_size; i++) {
-                *work_line   += *in_lines_cur[0]++ * coef_lf[filter][0];
-                *work_line   += *in_lines_cur[1]++ * coef_lf[filter][1];
-                *work_line++ += *in_lines_cur[2]++ * coef_lf[filter][2];
-            }
-            break;
-        case 2:
-            for (int i = 0; i < line_size; i++) {
-                *work_line   += *in_lines_cur[0]++ * coef_lf[filter][0];
-                *work_line++ += *in_lines_cur[1]++ * coef_lf[filter][1];
-            }
-        }
+        if (filter)
+            dsp->filter_complex_low(work_buf, in_lines_cur, coef_lf[filter], line_size);
+        else
+            dsp->filter_simple_low(work_buf, in_lines_cur, coef_lf[filter], line_size);
+
         /** get high vertical frequencies from adjacent fields */
         for (j = 0; j < n_coef_hf[filter]; j++) {
             y_in = (y_out + 1) + (j * 2) - n_coef_hf[filter];
             while (y_in < 0) y_in += 2;
-            while (y_in >= cur->video->h) y_in -= 2;
+            while (y_in >= height) y_in -= 2;
             in_lines_cur[j] = cur_data + (y_in * cur_line_stride);
             in_lines_adj[j] = adj_data + (y_in * adj_line_stride);
         }
-        work_line = w3fdif->work_line;
-        // TODO: set pixel stride for in
-        // these have been unrolled from an function with loops for speed
-        switch (n_coef_hf[filter]) {
-        case 5:
-            for (int i = 0; i < line_size; i++) {
-                *work_line   += *in_lines_cur[0]++ * coef_hf[filter][0];
-                *work_line   += *in_lines_adj[0]++ * coef_hf[filter][0];
-                *work_line   += *in_lines_cur[1]++ * coef_hf[filter][1];
-                *work_line   += *in_lines_adj[1]++ * coef_hf[filter][1];
-                *work_line   += *in_lines_cur[2]++ * coef_hf[filter][2];
-                *work_line   += *in_lines_adj[2]++ * coef_hf[filter][2];
-                *work_line   += *in_lines_cur[3]++ * coef_hf[filter][3];
-                *work_line   += *in_lines_adj[3]++ * coef_hf[filter][3];
-                *work_line   += *in_lines_cur[4]++ * coef_hf[filter][4];
-                *work_line++ += *in_lines_adj[4]++ * coef_hf[filter][4];
-            }
-            break;
-        case 4:
-            for (int i = 0; i < line_size; i++) {
-                *work_line   += *in_lines_cur[0]++ * coef_hf[filter][0];
-                *work_line   += *in_lines_adj[0]++ * coef_hf[filter][0];
-                *work_line   += *in_lines_cur[1]++ * coef_hf[filter][1];
-                *work_line   += *in_lines_adj[1]++ * coef_hf[filter][1];
-                *work_line   += *in_lines_cur[2]++ * coef_hf[filter][2];
-                *work_line   += *in_lines_adj[2]++ * coef_hf[filter][2];
-                *work_line   += *in_lines_cur[3]++ * coef_hf[filter][3];
-                *work_line++ += *in_lines_adj[3]++ * coef_hf[filter][3];
-            }
-            break;
-        case 3:
-            for (int i = 0; i < line_size; i++) {
-                *work_line   += *in_lines_cur[0]++ * coef_hf[filter][0];
-                *work_line   += *in_lines_adj[0]++ * coef_hf[filter][0];
-                *work_line   += *in_lines_cur[1]++ * coef_hf[filter][1];
-                *work_line   += *in_lines_adj[1]++ * coef_hf[filter][1];
-                *work_line   += *in_lines_cur[2]++ * coef_hf[filter][2];
-                *work_line++ += *in_lines_adj[2]++ * coef_hf[filter][2];
-            }
-            break;
-        case 2:
-            for (int i = 0; i < line_size; i++) {
-                *work_line   += *in_lines_cur[0]++ * coef_hf[filter][0];
-                *work_line   += *in_lines_adj[0]++ * coef_hf[filter][0];
-                *work_line   += *in_lines_cur[1]++ * coef_hf[filter][1];
-                *work_line++ += *in_lines_adj[1]++ * coef_hf[filter][1];
-            }
-        }
-        /** save scaled result to the output frame, scaling down by 256 * 256 */
-        //TODO: set pixel stride for out
-        work_pixel = w3fdif->work_line;
-        out_pixel = out_line;
-        for (j = 0; j < line_size; j++) {
-            *out_pixel =  (*work_pixel>(255*256*256)?(255*256*256):(*work_pixel<0?0:*work_pixel))>>16;
-            out_pixel++;
-            work_pixel++;
-        }
+        if (filter)
+            dsp->filter_complex_high(work_buf, in_lines_cur, in_lines_adj, coef_hf[filter], line_size);
+        else
+            dsp->filter_simple_high(work_buf, in_lines_cur, in_lines_adj, coef_hf[filter], line_size);
+
+        /** save scaled result to the output frame, scaling down by 256 * 128 */
+        dsp->filter_scale(out_line, work_buf, line_size, max);
+
         /** move on to next line */
         y_out += 2;
         out_line += dst_line_stride * 2;
@@ -228,6 +247,28 @@ static int deinterlace_component(AVFilterContext *ctx,
     return 0;
 }
 
+typedef struct ThreadData {
+    const AVFilterBufferRef *cur, *adj;
+} ThreadData;
+
+static int deinterlace_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    W3FDIFContext *w3fdif = ctx->priv;
+    ThreadData *td = arg;
+    int32_t *work_buf = w3fdif->work_line + jobnr * w3fdif->work_line_size;
+    int plane;
+
+    for (plane = 0; plane < 4 && td->cur->data[plane]; plane++) {
+        int height      = w3fdif->plane_height[plane];
+        int slice_start = (height *  jobnr   ) / nb_jobs;
+        int slice_end   = (height * (jobnr+1)) / nb_jobs;
+
+        deinterlace_component(ctx, td->cur, td->adj, w3fdif->filter, plane,
+                              work_buf, slice_start, slice_end);
+    }
+    return 0;
+}
+
 /** FFmpeg filter integration */
 
 static void set_frame_pts(AVFilterContext *ctx)
@@ -255,16 +296,13 @@ static void set_frame_pts(AVFilterContext *ctx)
 static void process_frame(AVFilterContext *ctx)
 {
     W3FDIFContext *w3fdif = ctx->priv;
-
-    int plane;
-
-    w3fdif->work_line = av_malloc(w3fdif->crnt->linesize[0] * sizeof(uint32_t));
+    ThreadData td = { .cur = w3fdif->crnt };
+    int nb_jobs = FFMIN(w3fdif->plane_height[1], ctx->thread_count);
 
     if (!w3fdif->field) {
         /** do the deinterlacing for field 0 */
-        for (plane = 0; plane < 4 && w3fdif->crnt->data[plane]; plane++) {
-            deinterlace_component(ctx, w3fdif->crnt, w3fdif->prev, w3fdif->filter, plane);
-        }
+        td.adj = w3fdif->prev;
+        ctx->execute(ctx, deinterlace_slice, &td, NULL, nb_jobs);
 
         /** prev is not neede after this point*/
         if (w3fdif->prev && w3fdif->prev != w3fdif->crnt) {
@@ -277,9 +315,8 @@ static void process_frame(AVFilterContext *ctx)
         w3fdif->next = NULL;
     } else {
         /** do the deinterlacing for field 1 */
-        for (plane = 0; plane < 4 && w3fdif->crnt->data[plane]; plane++) {
-            deinterlace_component(ctx, w3fdif->crnt, w3fdif->next, w3fdif->filter, plane);
-        }
+        td.adj = w3fdif->next;
+        ctx->execute(ctx, deinterlace_slice, &td, NULL, nb_jobs);
 
         /** at the end of the second field we _always_ copy current to previous
          *  and copy next to current */
@@ -287,8 +324,6 @@ static void process_frame(AVFilterContext *ctx)
         w3fdif->crnt = w3fdif->next;
     }
 
-    av_free(w3fdif->work_line);
-
     /** swap field */
     w3fdif->field = !w3fdif->field;
 }
@@ -299,17 +334,50 @@ static int config_input(AVFilterLink *link)
 {
     AVFilterContext *ctx = link->dst;
     W3FDIFContext *w3fdif = ctx->priv;
+    const AVPixFmtDescriptor *desc = &av_pix_fmt_descriptors[link->format];
+    W3FDIFDSPContext *dsp = &w3fdif->dsp;
+    int plane, bps;
 
-    int plane;
+    w3fdif->depth = desc->comp[0].depth_minus1 + 1;
+    bps = (w3fdif->depth + 7) >> 3;
 
-    /** full an array with the number of bytes that the video
+    /** full an array with the number of samples that the video
      *  data occupies per line for each plane of the input video */
     for (plane = 0; plane < 4; plane++) {
         w3fdif->line_size[plane] = av_image_get_linesize(
                 link->format,
                 link->w,
-                plane);
+                plane) / bps;
     }
+    w3fdif->plane_height[0] = w3fdif->plane_height[3] = link->h;
+    w3fdif->plane_height[1] = w3fdif->plane_height[2] =
+        -((-link->h) >> desc->log2_chroma_h);
+
+    if (w3fdif->depth > 8) {
+        dsp->filter_simple_low   = filter_simple_low_16;
+        dsp->filter_complex_low  = filter_complex_low_16;
+        dsp->filter_simple_high  = filter_simple_high_16;
+        dsp->filter_complex_high = filter_complex_high_16;
+        dsp->filter_scale        = filter_scale_16;
+    } else {
+        dsp->filter_simple_low   = filter_simple_low;
+        dsp->filter_complex_low  = filter_complex_low;
+        dsp->filter_simple_high  = filter_simple_high;
+        dsp->filter_complex_high = filter_complex_high;
+        dsp->filter_scale        = filter_scale;
+    }
+    if (HAVE_MMX)
+        ff_w3fdif_init_x86(dsp, w3fdif->depth);
+
+    /** one work line per job, the SIMD line filters may write up to
+     *  7 samples past the line */
+    w3fdif->work_line_size = FFALIGN(w3fdif->line_size[0], 8);
+    av_freep(&w3fdif->work_line);
+    w3fdif->work_line = av_malloc(w3fdif->work_line_size * sizeof(uint32_t) *
+                                  FFMIN(w3fdif->plane_height[1], ctx->thread_count));
+    if (!w3fdif->work_line)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
@@ -463,26 +531,18 @@ static av_cold void uninit(AVFilterContext *ctx)
     if (w3fdif->prev && (w3fdif->prev != w3fdif->crnt)) avfilter_unref_buffer(w3fdif->prev);
     if (w3fdif->next && (w3fdif->next != w3fdif->crnt)) avfilter_unref_buffer(w3fdif->next);
     if (w3fdif->crnt) avfilter_unref_buffer(w3fdif->crnt);
+    av_freep(&w3fdif->work_line);
 }
 
 static int query_formats(AVFilterContext *ctx)
 {
     static const enum PixelFormat pix_fmts[] = {
-//        PIX_FMT_YUV420P,
+        PIX_FMT_YUV420P,
         PIX_FMT_YUV422P,
-//        PIX_FMT_YUV444P,
-//        PIX_FMT_YUV410P,
-//        PIX_FMT_YUV411P,
-//        PIX_FMT_GRAY8,
-//        PIX_FMT_YUVJ420P,
-//        PIX_FMT_YUVJ422P,
-//        PIX_FMT_YUVJ444P,
-//        AV_NE( PIX_FMT_GRAY16BE, PIX_FMT_GRAY16LE ),
-//        PIX_FMT_YUV440P,
-//        PIX_FMT_YUVJ440P,
-//        AV_NE( PIX_FMT_YUV420P16BE, PIX_FMT_YUV420P16LE ),
-//        AV_NE( PIX_FMT_YUV422P16BE, PIX_FMT_YUV422P16LE ),
-//        AV_NE( PIX_FMT_YUV444P16BE, PIX_FMT_YUV444P16LE ),
+        PIX_FMT_YUV444P,
+        PIX_FMT_YUV420P10,
+        PIX_FMT_YUV422P10,
+        PIX_FMT_YUV444P10,
         PIX_FMT_NONE
     };
 
@@ -133,13 +133,21 @@ static void filter_line_c_16bit(uint16_t *dst,
     FILTER
 }
 
-static void filter(AVFilterContext *ctx, AVFilterBufferRef *dstpic,
-                   int parity, int tff)
+typedef struct ThreadData {
+    AVFilterBufferRef *dstpic;
+    int parity;
+    int tff;
+} ThreadData;
+
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     YADIFContext *yadif = ctx->priv;
+    ThreadData *td = arg;
+    AVFilterBufferRef *dstpic = td->dstpic;
     AVFilterBufferRef *p = yadif->prev;
     AVFilterBufferRef *c = yadif->cur;
     AVFilterBufferRef *n = yadif->next;
+    int parity = td->parity;
     int y, i;
 
     if (!p)
@@ -151,22 +159,25 @@ static void filter(AVFilterContext *ctx, AVFilterBufferRef *dstpic,
         int w = dstpic->video->w;
         int h = dstpic->video->h;
         int refs = c->linesize[i];
-        int df = (yadif->csp->comp[i].depth_minus1+1) / 8;
+        int df = (yadif->csp->comp[i].depth_minus1+8) / 8;
+        int slice_start, slice_end;
 
         if (i) {
         /* Why is this not part of the per-plane description thing? */
             w >>= yadif->csp->log2_chroma_w;
             h >>= yadif->csp->log2_chroma_h;
         }
+        slice_start = (h *  jobnr   ) / nb_jobs;
+        slice_end   = (h * (jobnr+1)) / nb_jobs;
 
-        for (y = 0; y < h; y++) {
+        for (y = slice_start; y < slice_end; y++) {
             if ((y ^ parity) & 1) {
                 uint8_t *prev = &p->data[i][y*refs];
                 uint8_t *cur  = &c->data[i][y*refs];
                 uint8_t *next = &n->data[i][y*refs];
                 uint8_t *dst  = &dstpic->data[i][y*dstpic->linesize[i]];
                 int     mode  = y==1 || y+2==h ? 2 : yadif->mode;
-                yadif->filter_line(dst, prev, cur, next, w, y+1<h ? refs : -refs, y ? -refs : refs, parity ^ tff, mode);
+                yadif->filter_line(dst, prev, cur, next, w, y+1<h ? refs : -refs, y ? -refs : refs, parity ^ td->tff, mode);
             } else {
                 memcpy(&dstpic->data[i][y*dstpic->linesize[i]],
                        &c->data[i][y*refs], w*df);
@@ -176,6 +187,16 @@ static void filter(AVFilterContext *ctx, AVFilterBufferRef *dstpic,
 #if HAVE_MMX
     __asm__ volatile("emms \n\t" : : : "memory");
 #endif
+    return 0;
+}
+
+static void filter(AVFilterContext *ctx, AVFilterBufferRef *dstpic,
+                   int parity, int tff)
+{
+    ThreadData td = { .dstpic = dstpic, .parity = parity, .tff = tff };
+
+    ctx->execute(ctx, filter_slice, &td, NULL,
+                 FFMIN(dstpic->video->h, ctx->thread_count));
 }
 
 static AVFilterBufferRef *get_video_buffer(AVFilterLink *link, int perms, int w, int h)
@@ -213,10 +234,20 @@ static void return_frame(AVFilterContext *ctx, int is_second)
         yadif->out = avfilter_get_video_buffer(link, AV_PERM_WRITE,
                                                link->w, link->h);
 
-    if (!yadif->csp)
+    if (!yadif->csp) {
+        av_unused int cpu_flags = av_get_cpu_flags();
+
         yadif->csp = &av_pix_fmt_descriptors[link->format];
-    if (yadif->csp->comp[0].depth_minus1 == 15)
-        yadif->filter_line = filter_line_c_16bit;
+        if (yadif->csp->comp[0].depth_minus1 > 7) {
+            yadif->filter_line = (void*)filter_line_c_16bit;
+            if (HAVE_SSE4 && cpu_flags & AV_CPU_FLAG_SSE4)
+                yadif->filter_line = ff_yadif_filter_line_16bit_sse4;
+            else if (HAVE_SSSE3 && cpu_flags & AV_CPU_FLAG_SSSE3)
+                yadif->filter_line = ff_yadif_filter_line_16bit_ssse3;
+            else if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2)
+                yadif->filter_line = ff_yadif_filter_line_16bit_sse2;
+        }
+    }
 
     filter(ctx, yadif->out, tff ^ !is_second, tff);
 
@@ -371,6 +402,9 @@ static int query_formats(AVFilterContext *ctx)
         AV_NE( PIX_FMT_YUV420P16BE, PIX_FMT_YUV420P16LE ),
         AV_NE( PIX_FMT_YUV422P16BE, PIX_FMT_YUV422P16LE ),
         AV_NE( PIX_FMT_YUV444P16BE, PIX_FMT_YUV444P16LE ),
+        PIX_FMT_YUV420P10,
+        PIX_FMT_YUV422P10,
+        PIX_FMT_YUV444P10,
         PIX_FMT_NONE
     };
 
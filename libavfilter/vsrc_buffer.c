@@ -104,6 +104,12 @@ int av_vsrc_buffer_add_video_buffer_ref(AVFilterContext *buffer_filter,
             return ret;
     }
 
+    if (flags & AV_VSRC_BUF_FLAG_NO_COPY) {
+        if (!(c->picref = avfilter_ref_buffer(picref, ~0)))
+            return AVERROR(ENOMEM);
+        return 0;
+    }
+
     c->picref = avfilter_get_video_buffer(outlink, AV_PERM_WRITE,
                                           picref->video->w, picref->video->h);
     av_image_copy(c->picref->data, c->picref->linesize,
@@ -125,7 +131,9 @@ int av_vsrc_buffer_add_frame(AVFilterContext *buffer_src,
         avfilter_get_video_buffer_ref_from_frame(frame, AV_PERM_WRITE);
     if (!picref)
         return AVERROR(ENOMEM);
-    ret = av_vsrc_buffer_add_video_buffer_ref(buffer_src, picref, flags);
+    /* the frame data is not refcounted, it must be copied */
+    ret = av_vsrc_buffer_add_video_buffer_ref(buffer_src, picref,
+                                              flags & ~AV_VSRC_BUF_FLAG_NO_COPY);
     picref->buf->data[0] = NULL;
     avfilter_unref_buffer(picref);
 
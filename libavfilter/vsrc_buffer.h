@@ -35,6 +35,13 @@
  */
 #define AV_VSRC_BUF_FLAG_OVERWRITE 1
 
+/**
+ * Tell av_vsrc_buffer_add_video_buffer_ref() to take a new reference to
+ * picref instead of copying its data. The permissions of picref are kept,
+ * the caller must not modify the buffer while it is referenced.
+ */
+#define AV_VSRC_BUF_FLAG_NO_COPY   2
+
 /**
  * Add video buffer data in picref to buffer_src.
  *
@@ -0,0 +1,54 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef AVFILTER_W3FDIF_H
+#define AVFILTER_W3FDIF_H
+
+#include <stdint.h>
+
+/**
+ * Line filters of the w3fdif deinterlacer.
+ *
+ * The low frequency functions set work_line to the sum of the current field
+ * lines, the high frequency functions add the sum of the current and the
+ * adjacent field lines to it, each line weighted by its coefficient. The
+ * coefficients are scaled by 256*128 and symmetric, coef[j] == coef[n-1-j].
+ * scale writes work_line back to out_pixel, scaled down and clipped to max.
+ *
+ * The _16 versions operate on 9 to 10 bits samples stored in uint16_t.
+ * linesize is the number of samples per line, the SIMD versions may process
+ * up to 7 samples past it.
+ */
+typedef struct W3FDIFDSPContext {
+    void (*filter_simple_low)(int32_t *work_line, uint8_t *in_lines_cur[2],
+                              const int16_t *coef, int linesize);
+    void (*filter_complex_low)(int32_t *work_line, uint8_t *in_lines_cur[4],
+                               const int16_t *coef, int linesize);
+    void (*filter_simple_high)(int32_t *work_line, uint8_t *in_lines_cur[3],
+                               uint8_t *in_lines_adj[3],
+                               const int16_t *coef, int linesize);
+    void (*filter_complex_high)(int32_t *work_line, uint8_t *in_lines_cur[5],
+                                uint8_t *in_lines_adj[5],
+                                const int16_t *coef, int linesize);
+    void (*filter_scale)(uint8_t *out_pixel, const int32_t *work_pixel,
+                         int linesize, int max);
+} W3FDIFDSPContext;
+
+void ff_w3fdif_init_x86(W3FDIFDSPContext *dsp, int depth);
+
+#endif /* AVFILTER_W3FDIF_H */
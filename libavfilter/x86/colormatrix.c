@@ -0,0 +1,266 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/x86_cpu.h"
+#include "libavfilter/colormatrix.h"
+
+/* number of chroma samples converted per pass, the luma corrections of a
+ * pass are kept in a buffer on the stack */
+#define CHUNK 256
+
+/* dst = (coeffs pair * src pairs + 32768) >> 16 for 8 (u, v) pairs in
+ * xmm0 and xmm2, packed to words */
+#define CORRECTION(row,tmp,dst) \
+        "movdqa        %%xmm0, "dst"             \n\t"\
+        "movdqa        %%xmm2, "tmp"             \n\t"\
+        "pmaddwd "#row"*16(%[c]), "dst"          \n\t"\
+        "pmaddwd "#row"*16(%[c]), "tmp"          \n\t"\
+        "paddd        80(%[c]), "dst"            \n\t"\
+        "paddd        80(%[c]), "tmp"            \n\t"\
+        "psrad            $16, "dst"             \n\t"\
+        "psrad            $16, "tmp"             \n\t"\
+        "packssdw       "tmp", "dst"             \n\t"
+
+#if HAVE_SSE
+/**
+ * Convert n chroma samples, n multiple of 8, and store the luma
+ * correction of each luma sample in dy.
+ */
+static void chroma_line_sse2(uint8_t *u, uint8_t *v, int16_t *dy, int n,
+                             const int16_t (*coeffs)[8])
+{
+    x86_reg x = -n;
+
+    __asm__ volatile(
+        "pxor          %%xmm7, %%xmm7            \n\t"
+        "1:                                      \n\t"
+        "movq   (%[u],%[x]), %%xmm0              \n\t"
+        "movq   (%[v],%[x]), %%xmm1              \n\t"
+        "punpcklbw     %%xmm7, %%xmm0            \n\t"
+        "punpcklbw     %%xmm7, %%xmm1            \n\t"
+        "psubw      48(%[c]), %%xmm0             \n\t"
+        "psubw      48(%[c]), %%xmm1             \n\t"
+        "movdqa        %%xmm0, %%xmm2            \n\t"
+        "punpcklwd     %%xmm1, %%xmm0            \n\t"
+        "punpckhwd     %%xmm1, %%xmm2            \n\t"
+        CORRECTION(0, "%%xmm3", "%%xmm1")
+        "movdqa        %%xmm1, %%xmm3            \n\t"
+        "punpcklwd     %%xmm1, %%xmm1            \n\t"
+        "punpckhwd     %%xmm3, %%xmm3            \n\t"
+        "movdqu        %%xmm1,   (%[dy],%[x],4)  \n\t"
+        "movdqu        %%xmm3, 16(%[dy],%[x],4)  \n\t"
+        CORRECTION(1, "%%xmm3", "%%xmm1")
+        CORRECTION(2, "%%xmm3", "%%xmm4")
+        "movq   (%[u],%[x]), %%xmm2              \n\t"
+        "movq   (%[v],%[x]), %%xmm3              \n\t"
+        "punpcklbw     %%xmm7, %%xmm2            \n\t"
+        "punpcklbw     %%xmm7, %%xmm3            \n\t"
+        "paddw         %%xmm1, %%xmm2            \n\t"
+        "paddw         %%xmm4, %%xmm3            \n\t"
+        "packuswb      %%xmm2, %%xmm2            \n\t"
+        "packuswb      %%xmm3, %%xmm3            \n\t"
+        "movq          %%xmm2, (%[u],%[x])       \n\t"
+        "movq          %%xmm3, (%[v],%[x])       \n\t"
+        "add               $8, %[x]              \n\t"
+        "jl                1b                    \n\t"
+        : [x]"+&r"(x)
+        : [u]"r"(u + n), [v]"r"(v + n), [dy]"r"(dy + 2*n), [c]"r"(coeffs)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm7",) "memory"
+    );
+}
+
+static void luma_line_sse2(uint8_t *y, const int16_t *dy, int n)
+{
+    x86_reg x = -n;
+
+    __asm__ volatile(
+        "pxor          %%xmm7, %%xmm7            \n\t"
+        "1:                                      \n\t"
+        "movdqu (%[y],%[x]), %%xmm0              \n\t"
+        "movdqu   (%[dy],%[x],2), %%xmm2         \n\t"
+        "movdqu 16(%[dy],%[x],2), %%xmm3         \n\t"
+        "movdqa        %%xmm0, %%xmm1            \n\t"
+        "punpcklbw     %%xmm7, %%xmm0            \n\t"
+        "punpckhbw     %%xmm7, %%xmm1            \n\t"
+        "paddw         %%xmm2, %%xmm0            \n\t"
+        "paddw         %%xmm3, %%xmm1            \n\t"
+        "packuswb      %%xmm1, %%xmm0            \n\t"
+        "movdqu        %%xmm0, (%[y],%[x])       \n\t"
+        "add              $16, %[x]              \n\t"
+        "jl                1b                    \n\t"
+        : [x]"+&r"(x)
+        : [y]"r"(y + n), [dy]"r"(dy + n)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm7",) "memory"
+    );
+}
+
+static void chroma_line_10_sse2(uint8_t *u, uint8_t *v, int16_t *dy, int n,
+                                const int16_t (*coeffs)[8])
+{
+    x86_reg x = -n;
+
+    __asm__ volatile(
+        "pxor          %%xmm7, %%xmm7            \n\t"
+        "1:                                      \n\t"
+        "movdqu (%[u],%[x],2), %%xmm0            \n\t"
+        "movdqu (%[v],%[x],2), %%xmm1            \n\t"
+        "psubw      48(%[c]), %%xmm0             \n\t"
+        "psubw      48(%[c]), %%xmm1             \n\t"
+        "movdqa        %%xmm0, %%xmm2            \n\t"
+        "punpcklwd     %%xmm1, %%xmm0            \n\t"
+        "punpckhwd     %%xmm1, %%xmm2            \n\t"
+        CORRECTION(0, "%%xmm3", "%%xmm1")
+        "movdqa        %%xmm1, %%xmm3            \n\t"
+        "punpcklwd     %%xmm1, %%xmm1            \n\t"
+        "punpckhwd     %%xmm3, %%xmm3            \n\t"
+        "movdqu        %%xmm1,   (%[dy],%[x],4)  \n\t"
+        "movdqu        %%xmm3, 16(%[dy],%[x],4)  \n\t"
+        CORRECTION(1, "%%xmm3", "%%xmm1")
+        CORRECTION(2, "%%xmm3", "%%xmm4")
+        "movdqu (%[u],%[x],2), %%xmm2            \n\t"
+        "movdqu (%[v],%[x],2), %%xmm3            \n\t"
+        "paddw         %%xmm1, %%xmm2            \n\t"
+        "paddw         %%xmm4, %%xmm3            \n\t"
+        "pmaxsw        %%xmm7, %%xmm2            \n\t"
+        "pmaxsw        %%xmm7, %%xmm3            \n\t"
+        "pminsw     64(%[c]), %%xmm2             \n\t"
+        "pminsw     64(%[c]), %%xmm3             \n\t"
+        "movdqu        %%xmm2, (%[u],%[x],2)     \n\t"
+        "movdqu        %%xmm3, (%[v],%[x],2)     \n\t"
+        "add               $8, %[x]              \n\t"
+        "jl                1b                    \n\t"
+        : [x]"+&r"(x)
+        : [u]"r"(u + 2*n), [v]"r"(v + 2*n), [dy]"r"(dy + 2*n), [c]"r"(coeffs)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm7",) "memory"
+    );
+}
+
+static void luma_line_10_sse2(uint8_t *y, const int16_t *dy, int n,
+                              const int16_t (*coeffs)[8])
+{
+    x86_reg x = -n;
+
+    __asm__ volatile(
+        "pxor          %%xmm7, %%xmm7            \n\t"
+        "1:                                      \n\t"
+        "movdqu (%[y],%[x],2), %%xmm0            \n\t"
+        "movdqu (%[dy],%[x],2), %%xmm1           \n\t"
+        "paddw         %%xmm1, %%xmm0            \n\t"
+        "pmaxsw        %%xmm7, %%xmm0            \n\t"
+        "pminsw     64(%[c]), %%xmm0             \n\t"
+        "movdqu        %%xmm0, (%[y],%[x],2)     \n\t"
+        "add               $8, %[x]              \n\t"
+        "jl                1b                    \n\t"
+        : [x]"+&r"(x)
+        : [y]"r"(y + 2*n), [dy]"r"(dy + n), [c]"r"(coeffs)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm7",) "memory"
+    );
+}
+#endif /* HAVE_SSE */
+
+void ff_colormatrix_line_planar_sse2(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                                     int width, const int16_t (*coeffs)[8])
+{
+#if HAVE_SSE
+    int16_t dy[2*CHUNK];
+    int x, n;
+
+    for (x = 0; x < (width & ~7); x += n) {
+        n = FFMIN((width & ~7) - x, CHUNK);
+        chroma_line_sse2(u + x, v + x, dy, n, coeffs);
+        luma_line_sse2(y0 + 2*x, dy, 2*n);
+        if (y1)
+            luma_line_sse2(y1 + 2*x, dy, 2*n);
+    }
+    if (width & 7)
+        ff_colormatrix_line_planar_c(y0 + 2*x, y1 ? y1 + 2*x : NULL, u + x, v + x,
+                                     width & 7, coeffs);
+#endif
+}
+
+void ff_colormatrix_line_planar_10_sse2(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                                        int width, const int16_t (*coeffs)[8])
+{
+#if HAVE_SSE
+    int16_t dy[2*CHUNK];
+    int x, n;
+
+    for (x = 0; x < (width & ~7); x += n) {
+        n = FFMIN((width & ~7) - x, CHUNK);
+        chroma_line_10_sse2(u + 2*x, v + 2*x, dy, n, coeffs);
+        luma_line_10_sse2(y0 + 4*x, dy, 2*n, coeffs);
+        if (y1)
+            luma_line_10_sse2(y1 + 4*x, dy, 2*n, coeffs);
+    }
+    if (width & 7)
+        ff_colormatrix_line_planar_10_c(y0 + 4*x, y1 ? y1 + 4*x : NULL, u + 2*x, v + 2*x,
+                                        width & 7, coeffs);
+#endif
+}
+
+void ff_colormatrix_line_uyvy_sse2(uint8_t *line, int width, const int16_t (*coeffs)[8])
+{
+#if HAVE_SSE
+    x86_reg x = -4 * (width & ~3);
+
+    if (width & 3)
+        ff_colormatrix_line_uyvy_c(line - x, width & 3, coeffs);
+    if (!x)
+        return;
+
+    __asm__ volatile(
+        "pcmpeqw       %%xmm6, %%xmm6            \n\t"
+        "psrlw             $8, %%xmm6            \n\t"
+        "1:                                      \n\t"
+        "movdqu (%[p],%[x]), %%xmm0              \n\t"
+        "movdqa        %%xmm0, %%xmm1            \n\t"
+        "pand          %%xmm6, %%xmm0            \n\t" // u0 v0 u1 v1 ...
+        "psrlw             $8, %%xmm1            \n\t" // y0 y1 y2 y3 ...
+        "movdqa        %%xmm0, %%xmm2            \n\t"
+        "psubw      48(%[c]), %%xmm2             \n\t"
+        "movdqa        %%xmm2, %%xmm3            \n\t"
+        "pmaddwd      (%[c]), %%xmm3             \n\t"
+        "paddd      80(%[c]), %%xmm3             \n\t"
+        "psrad            $16, %%xmm3            \n\t"
+        "packssdw      %%xmm3, %%xmm3            \n\t"
+        "punpcklwd     %%xmm3, %%xmm3            \n\t"
+        "paddw         %%xmm3, %%xmm1            \n\t"
+        "movdqa        %%xmm2, %%xmm3            \n\t"
+        "pmaddwd    16(%[c]), %%xmm3             \n\t"
+        "pmaddwd    32(%[c]), %%xmm2             \n\t"
+        "paddd      80(%[c]), %%xmm3             \n\t"
+        "paddd      80(%[c]), %%xmm2             \n\t"
+        "psrad            $16, %%xmm3            \n\t"
+        "psrad            $16, %%xmm2            \n\t"
+        "packssdw      %%xmm3, %%xmm3            \n\t"
+        "packssdw      %%xmm2, %%xmm2            \n\t"
+        "punpcklwd     %%xmm2, %%xmm3            \n\t"
+        "paddw         %%xmm3, %%xmm0            \n\t"
+        "packuswb      %%xmm0, %%xmm0            \n\t"
+        "packuswb      %%xmm1, %%xmm1            \n\t"
+        "punpcklbw     %%xmm1, %%xmm0            \n\t"
+        "movdqu        %%xmm0, (%[p],%[x])       \n\t"
+        "add              $16, %[x]              \n\t"
+        "jl                1b                    \n\t"
+        : [x]"+&r"(x)
+        : [p]"r"(line + 4 * (width & ~3)), [c]"r"(coeffs)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm6",) "memory"
+    );
+#endif
+}
@@ -0,0 +1,142 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavfilter/overlay.h"
+
+DECLARE_ALIGNED(16, static const uint16_t, pw_128)[8] = {128,128,128,128,128,128,128,128};
+DECLARE_ALIGNED(16, static const uint16_t, pw_255)[8] = {255,255,255,255,255,255,255,255};
+DECLARE_ALIGNED(16, static const uint16_t, pw_257)[8] = {257,257,257,257,257,257,257,257};
+DECLARE_ALIGNED(16, static const uint32_t, pd_128)[4] = {128,128,128,128};
+
+// d = ((d * (255 - a) + s * a + 128) * 257) >> 16, on words
+#define BLEND(a,d,s,t) \
+        "movdqa     %[pw_255], "t"      \n\t"\
+        "psubw           "a", "t"       \n\t"\
+        "pmullw          "t", "d"       \n\t"\
+        "pmullw          "a", "s"       \n\t"\
+        "paddw           "s", "d"       \n\t"\
+        "paddw      %[pw_128], "d"      \n\t"\
+        "pmulhuw    %[pw_257], "d"      \n\t"
+
+void ff_overlay_blend_line_sse2(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width)
+{
+#if HAVE_SSE
+    x86_reg x, mask;
+    if (width & 15) {
+        x = width & ~15;
+        ff_overlay_blend_line_c(dst + x, src + x, alpha + x, width - x);
+        width = x;
+    }
+    if (!width)
+        return;
+    x = -width;
+    __asm__ volatile(
+        "pxor          %%xmm7, %%xmm7   \n\t"
+        "1:                             \n\t"
+        "movdqu (%[a],%[x]), %%xmm0     \n\t"
+        "movdqa        %%xmm0, %%xmm1   \n\t"
+        "pcmpeqb       %%xmm7, %%xmm1   \n\t"
+        "pmovmskb      %%xmm1, %[mask]  \n\t"
+        "cmp          $0xffff, %[mask]  \n\t" // fully transparent block
+        "je                2f           \n\t"
+        "movdqu (%[d],%[x]), %%xmm1     \n\t"
+        "movdqu (%[s],%[x]), %%xmm2     \n\t"
+        "movdqa        %%xmm0, %%xmm3   \n\t"
+        "movdqa        %%xmm1, %%xmm4   \n\t"
+        "movdqa        %%xmm2, %%xmm5   \n\t"
+        "punpcklbw     %%xmm7, %%xmm3   \n\t"
+        "punpcklbw     %%xmm7, %%xmm4   \n\t"
+        "punpcklbw     %%xmm7, %%xmm5   \n\t"
+        "punpckhbw     %%xmm7, %%xmm0   \n\t"
+        "punpckhbw     %%xmm7, %%xmm1   \n\t"
+        "punpckhbw     %%xmm7, %%xmm2   \n\t"
+        BLEND("%%xmm3", "%%xmm4", "%%xmm5", "%%xmm6")
+        BLEND("%%xmm0", "%%xmm1", "%%xmm2", "%%xmm6")
+        "packuswb      %%xmm1, %%xmm4   \n\t"
+        "movdqu        %%xmm4, (%[d],%[x]) \n\t"
+        "2:                             \n\t"
+        "add              $16, %[x]     \n\t"
+        "jl                1b           \n\t"
+        : [x]"+&r"(x), [mask]"=&r"(mask)
+        : [d]"r"(dst + width), [s]"r"(src + width), [a]"r"(alpha + width),
+          [pw_128]"m"(*pw_128), [pw_255]"m"(*pw_255), [pw_257]"m"(*pw_257)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7",) "memory"
+    );
+#endif
+}
+
+void ff_overlay_blend_line_10_sse2(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width)
+{
+#if HAVE_SSE
+    x86_reg x, mask;
+    if (width & 7) {
+        x = width & ~7;
+        ff_overlay_blend_line_10_c(dst + 2*x, src + x, alpha + x, width - x);
+        width = x;
+    }
+    if (!width)
+        return;
+    x = -width;
+    __asm__ volatile(
+        "pxor          %%xmm7, %%xmm7   \n\t"
+        "1:                             \n\t"
+        "movq   (%[a],%[x]), %%xmm0     \n\t"
+        "movdqa        %%xmm0, %%xmm1   \n\t"
+        "pcmpeqb       %%xmm7, %%xmm1   \n\t"
+        "pmovmskb      %%xmm1, %[mask]  \n\t"
+        "cmp          $0xffff, %[mask]  \n\t" // fully transparent block
+        "je                2f           \n\t"
+        "punpcklbw     %%xmm7, %%xmm0   \n\t"
+        "movdqa     %[pw_255], %%xmm1   \n\t"
+        "psubw         %%xmm0, %%xmm1   \n\t"
+        "movdqa        %%xmm1, %%xmm2   \n\t"
+        "punpcklwd     %%xmm0, %%xmm1   \n\t" // 255 - a, a
+        "punpckhwd     %%xmm0, %%xmm2   \n\t"
+        "movdqu (%[d],%[x],2), %%xmm3   \n\t"
+        "movq   (%[s],%[x]), %%xmm4     \n\t"
+        "punpcklbw     %%xmm7, %%xmm4   \n\t"
+        "psllw             $2, %%xmm4   \n\t"
+        "movdqa        %%xmm3, %%xmm5   \n\t"
+        "punpcklwd     %%xmm4, %%xmm3   \n\t" // d, s << 2
+        "punpckhwd     %%xmm4, %%xmm5   \n\t"
+        "pmaddwd       %%xmm1, %%xmm3   \n\t"
+        "pmaddwd       %%xmm2, %%xmm5   \n\t"
+        "paddd      %[pd_128], %%xmm3   \n\t"
+        "paddd      %[pd_128], %%xmm5   \n\t"
+        "movdqa        %%xmm3, %%xmm1   \n\t" // x * 257 = (x << 8) + x
+        "movdqa        %%xmm5, %%xmm2   \n\t"
+        "pslld             $8, %%xmm1   \n\t"
+        "pslld             $8, %%xmm2   \n\t"
+        "paddd         %%xmm1, %%xmm3   \n\t"
+        "paddd         %%xmm2, %%xmm5   \n\t"
+        "psrld            $16, %%xmm3   \n\t"
+        "psrld            $16, %%xmm5   \n\t"
+        "packssdw      %%xmm5, %%xmm3   \n\t"
+        "movdqu        %%xmm3, (%[d],%[x],2) \n\t"
+        "2:                             \n\t"
+        "add               $8, %[x]     \n\t"
+        "jl                1b           \n\t"
+        : [x]"+&r"(x), [mask]"=&r"(mask)
+        : [d]"r"(dst + 2*width), [s]"r"(src + width), [a]"r"(alpha + width),
+          [pw_255]"m"(*pw_255), [pd_128]"m"(*pd_128)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm7",) "memory"
+    );
+#endif
+}
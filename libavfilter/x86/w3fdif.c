@@ -0,0 +1,54 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavfilter/w3fdif.h"
+
+#define BPS 1
+#undef RENAME
+#define RENAME(a) a ## _sse2
+#include "w3fdif_template.c"
+#undef BPS
+
+#define BPS 2
+#undef RENAME
+#define RENAME(a) a ## _16_sse2
+#include "w3fdif_template.c"
+#undef BPS
+
+void ff_w3fdif_init_x86(W3FDIFDSPContext *dsp, int depth)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2) {
+        if (depth <= 8) {
+            dsp->filter_simple_low   = ff_w3fdif_simple_low_sse2;
+            dsp->filter_complex_low  = ff_w3fdif_complex_low_sse2;
+            dsp->filter_simple_high  = ff_w3fdif_simple_high_sse2;
+            dsp->filter_complex_high = ff_w3fdif_complex_high_sse2;
+            dsp->filter_scale        = ff_w3fdif_scale_sse2;
+        } else if (depth <= 10) {
+            dsp->filter_simple_low   = ff_w3fdif_simple_low_16_sse2;
+            dsp->filter_complex_low  = ff_w3fdif_complex_low_16_sse2;
+            dsp->filter_simple_high  = ff_w3fdif_simple_high_16_sse2;
+            dsp->filter_complex_high = ff_w3fdif_complex_high_16_sse2;
+            dsp->filter_scale        = ff_w3fdif_scale_16_sse2;
+        }
+    }
+}
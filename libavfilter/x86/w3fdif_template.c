@@ -0,0 +1,260 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if BPS == 1
+#define SCALE ""
+#define LOAD(mem,dst) \
+            "movq      "mem", "dst" \n\t"\
+            "punpcklbw %%xmm7, "dst" \n\t"
+#else
+#define SCALE ",2"
+#define LOAD(mem,dst) \
+            "movdqu    "mem", "dst" \n\t"
+#endif
+
+/* the line pointers are kept in memory, only x and one pointer at a time
+ * are held in registers, which leaves enough of them on x86_32 */
+#define LOAD_LINE(line,dst) \
+            "mov       %["line"], %[tmp] \n\t"\
+            LOAD("(%[tmp],%[x]"SCALE")", dst)
+
+/* add a line of the current and of the adjacent field to dst */
+#define ADD_LINES(cur,adj,dst) \
+            LOAD_LINE(cur, "%%xmm1")\
+            "paddw     %%xmm1, "dst" \n\t"\
+            LOAD_LINE(adj, "%%xmm1")\
+            "paddw     %%xmm1, "dst" \n\t"
+
+/* multiply the interleaved words of xmm0 and xmm2 by the coefficient pair
+ * in xmm6, results in xmm0 and xmm1 */
+#define MADD_PAIR \
+            "movdqa    %%xmm0, %%xmm1 \n\t"\
+            "punpcklwd %%xmm2, %%xmm0 \n\t"\
+            "punpckhwd %%xmm2, %%xmm1 \n\t"\
+            "pmaddwd   %%xmm6, %%xmm0 \n\t"\
+            "pmaddwd   %%xmm6, %%xmm1 \n\t"
+
+#define ACCUMULATE \
+            "movdqu      (%[work],%[x],4), %%xmm2 \n\t"\
+            "movdqu    16(%[work],%[x],4), %%xmm3 \n\t"\
+            "paddd     %%xmm2, %%xmm0 \n\t"\
+            "paddd     %%xmm3, %%xmm1 \n\t"
+
+#define STORE \
+            "movdqu    %%xmm0,   (%[work],%[x],4) \n\t"\
+            "movdqu    %%xmm1, 16(%[work],%[x],4) \n\t"\
+            "add       $8, %[x]  \n\t"\
+            "jl        1b        \n\t"
+
+#define LOAD_COEFS \
+            "movd      %[coef01], %%xmm6 \n\t"\
+            "pxor      %%xmm7, %%xmm7 \n\t"\
+            "pshufd $0,%%xmm6, %%xmm6 \n\t"
+
+static void RENAME(ff_w3fdif_simple_low)(int32_t *work_line, uint8_t *in_lines_cur[2],
+                                  const int16_t *coef, int linesize)
+{
+#if HAVE_SSE
+    uint8_t *cur0 = in_lines_cur[0] + linesize * BPS;
+    uint8_t *cur1 = in_lines_cur[1] + linesize * BPS;
+    x86_reg x = -linesize, tmp;
+
+    __asm__ volatile(
+        LOAD_COEFS
+        "1:                  \n\t"
+        LOAD_LINE("cur0", "%%xmm0")
+        LOAD_LINE("cur1", "%%xmm2")
+        MADD_PAIR
+        STORE
+        : [x]"+&r"(x), [tmp]"=&r"(tmp)
+        : [work]"r"(work_line + linesize),
+          [cur0]"m"(cur0), [cur1]"m"(cur1),
+          [coef01]"m"(coef[0])
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm6", "%xmm7",) "memory"
+    );
+#endif
+}
+
+static void RENAME(ff_w3fdif_complex_low)(int32_t *work_line, uint8_t *in_lines_cur[4],
+                                   const int16_t *coef, int linesize)
+{
+#if HAVE_SSE
+    uint8_t *cur0 = in_lines_cur[0] + linesize * BPS;
+    uint8_t *cur1 = in_lines_cur[1] + linesize * BPS;
+    uint8_t *cur2 = in_lines_cur[2] + linesize * BPS;
+    uint8_t *cur3 = in_lines_cur[3] + linesize * BPS;
+    x86_reg x = -linesize, tmp;
+
+    __asm__ volatile(
+        LOAD_COEFS
+        "1:                  \n\t"
+        LOAD_LINE("cur0", "%%xmm0")
+        LOAD_LINE("cur3", "%%xmm1")
+        "paddw     %%xmm1, %%xmm0 \n\t"
+        LOAD_LINE("cur1", "%%xmm2")
+        LOAD_LINE("cur2", "%%xmm1")
+        "paddw     %%xmm1, %%xmm2 \n\t"
+        MADD_PAIR
+        STORE
+        : [x]"+&r"(x), [tmp]"=&r"(tmp)
+        : [work]"r"(work_line + linesize),
+          [cur0]"m"(cur0), [cur1]"m"(cur1), [cur2]"m"(cur2), [cur3]"m"(cur3),
+          [coef01]"m"(coef[0])
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm6", "%xmm7",) "memory"
+    );
+#endif
+}
+
+static void RENAME(ff_w3fdif_simple_high)(int32_t *work_line, uint8_t *in_lines_cur[3],
+                                   uint8_t *in_lines_adj[3],
+                                   const int16_t *coef, int linesize)
+{
+#if HAVE_SSE
+    uint8_t *cur0 = in_lines_cur[0] + linesize * BPS;
+    uint8_t *cur1 = in_lines_cur[1] + linesize * BPS;
+    uint8_t *cur2 = in_lines_cur[2] + linesize * BPS;
+    uint8_t *adj0 = in_lines_adj[0] + linesize * BPS;
+    uint8_t *adj1 = in_lines_adj[1] + linesize * BPS;
+    uint8_t *adj2 = in_lines_adj[2] + linesize * BPS;
+    x86_reg x = -linesize, tmp;
+
+    __asm__ volatile(
+        LOAD_COEFS
+        "1:                  \n\t"
+        LOAD_LINE("cur0", "%%xmm0")
+        ADD_LINES("adj0", "cur2", "%%xmm0")
+        LOAD_LINE("adj2", "%%xmm1")
+        "paddw     %%xmm1, %%xmm0 \n\t"
+        LOAD_LINE("cur1", "%%xmm2")
+        LOAD_LINE("adj1", "%%xmm1")
+        "paddw     %%xmm1, %%xmm2 \n\t"
+        MADD_PAIR
+        ACCUMULATE
+        STORE
+        : [x]"+&r"(x), [tmp]"=&r"(tmp)
+        : [work]"r"(work_line + linesize),
+          [cur0]"m"(cur0), [cur1]"m"(cur1), [cur2]"m"(cur2),
+          [adj0]"m"(adj0), [adj1]"m"(adj1), [adj2]"m"(adj2),
+          [coef01]"m"(coef[0])
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm6", "%xmm7",) "memory"
+    );
+#endif
+}
+
+static void RENAME(ff_w3fdif_complex_high)(int32_t *work_line, uint8_t *in_lines_cur[5],
+                                    uint8_t *in_lines_adj[5],
+                                    const int16_t *coef, int linesize)
+{
+#if HAVE_SSE
+    uint8_t *cur0 = in_lines_cur[0] + linesize * BPS;
+    uint8_t *cur1 = in_lines_cur[1] + linesize * BPS;
+    uint8_t *cur2 = in_lines_cur[2] + linesize * BPS;
+    uint8_t *cur3 = in_lines_cur[3] + linesize * BPS;
+    uint8_t *cur4 = in_lines_cur[4] + linesize * BPS;
+    uint8_t *adj0 = in_lines_adj[0] + linesize * BPS;
+    uint8_t *adj1 = in_lines_adj[1] + linesize * BPS;
+    uint8_t *adj2 = in_lines_adj[2] + linesize * BPS;
+    uint8_t *adj3 = in_lines_adj[3] + linesize * BPS;
+    uint8_t *adj4 = in_lines_adj[4] + linesize * BPS;
+    x86_reg x = -linesize, tmp;
+
+    __asm__ volatile(
+        LOAD_COEFS
+        "movd      %[coef23], %%xmm5 \n\t"
+        "pshufd $0,%%xmm5, %%xmm5 \n\t"
+        "1:                  \n\t"
+        LOAD_LINE("cur0", "%%xmm0")
+        ADD_LINES("adj0", "cur4", "%%xmm0")
+        LOAD_LINE("adj4", "%%xmm1")
+        "paddw     %%xmm1, %%xmm0 \n\t"
+        LOAD_LINE("cur1", "%%xmm2")
+        ADD_LINES("adj1", "cur3", "%%xmm2")
+        LOAD_LINE("adj3", "%%xmm1")
+        "paddw     %%xmm1, %%xmm2 \n\t"
+        LOAD_LINE("cur2", "%%xmm3")
+        LOAD_LINE("adj2", "%%xmm1")
+        "paddw     %%xmm1, %%xmm3 \n\t"
+        MADD_PAIR
+        /* the middle line pairs with zero, coef[3] is multiplied by 0 */
+        "movdqa    %%xmm3, %%xmm2 \n\t"
+        "punpcklwd %%xmm7, %%xmm3 \n\t"
+        "punpckhwd %%xmm7, %%xmm2 \n\t"
+        "pmaddwd   %%xmm5, %%xmm3 \n\t"
+        "pmaddwd   %%xmm5, %%xmm2 \n\t"
+        "paddd     %%xmm3, %%xmm0 \n\t"
+        "paddd     %%xmm2, %%xmm1 \n\t"
+        ACCUMULATE
+        STORE
+        : [x]"+&r"(x), [tmp]"=&r"(tmp)
+        : [work]"r"(work_line + linesize),
+          [cur0]"m"(cur0), [cur1]"m"(cur1), [cur2]"m"(cur2),
+          [cur3]"m"(cur3), [cur4]"m"(cur4),
+          [adj0]"m"(adj0), [adj1]"m"(adj1), [adj2]"m"(adj2),
+          [adj3]"m"(adj3), [adj4]"m"(adj4),
+          [coef01]"m"(coef[0]), [coef23]"m"(coef[2])
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm5", "%xmm6", "%xmm7",) "memory"
+    );
+#endif
+}
+
+static void RENAME(ff_w3fdif_scale)(uint8_t *out_pixel, const int32_t *work_pixel,
+                             int linesize, int max)
+{
+#if HAVE_SSE
+    x86_reg x = -linesize;
+
+    __asm__ volatile(
+#if BPS == 2
+        "movd      %[max], %%xmm6 \n\t"
+        "pxor      %%xmm7, %%xmm7 \n\t"
+        "pshuflw $0,%%xmm6, %%xmm6 \n\t"
+        "punpcklqdq %%xmm6, %%xmm6 \n\t"
+#endif
+        "1:                  \n\t"
+        "movdqu      (%[work],%[x],4), %%xmm0 \n\t"
+        "movdqu    16(%[work],%[x],4), %%xmm1 \n\t"
+        "psrad     $15, %%xmm0 \n\t"
+        "psrad     $15, %%xmm1 \n\t"
+        "packssdw  %%xmm1, %%xmm0 \n\t"
+#if BPS == 1
+        "packuswb  %%xmm0, %%xmm0 \n\t"
+        "movq      %%xmm0, (%[out],%[x]) \n\t"
+#else
+        "pmaxsw    %%xmm7, %%xmm0 \n\t"
+        "pminsw    %%xmm6, %%xmm0 \n\t"
+        "movdqu    %%xmm0, (%[out],%[x],2) \n\t"
+#endif
+        "add       $8, %[x]  \n\t"
+        "jl        1b        \n\t"
+        : [x]"+&r"(x)
+        : [work]"r"(work_pixel + linesize),
+          [out]"r"(out_pixel + linesize * BPS),
+          [max]"rm"(max)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm6", "%xmm7",) "memory"
+    );
+#endif
+}
+
+#undef SCALE
+#undef LOAD
+#undef LOAD_LINE
+#undef ADD_LINES
+#undef MADD_PAIR
+#undef ACCUMULATE
+#undef STORE
+#undef LOAD_COEFS
@@ -24,6 +24,31 @@
 
 DECLARE_ASM_CONST(16, const xmm_reg, pb_1) = {0x0101010101010101ULL, 0x0101010101010101ULL};
 DECLARE_ASM_CONST(16, const xmm_reg, pw_1) = {0x0001000100010001ULL, 0x0001000100010001ULL};
+DECLARE_ASM_CONST(16, const xmm_reg, pd_1) = {0x0000000100000001ULL, 0x0000000100000001ULL};
+
+#if HAVE_SSE4
+#define COMPILE_TEMPLATE_SSE4 1
+#define COMPILE_TEMPLATE_SSSE3 1
+#undef RENAME
+#define RENAME(a) a ## _sse4
+#include "yadif_16_template.c"
+#undef COMPILE_TEMPLATE_SSE4
+#undef COMPILE_TEMPLATE_SSSE3
+#endif
+
+#if HAVE_SSSE3
+#define COMPILE_TEMPLATE_SSSE3 1
+#undef RENAME
+#define RENAME(a) a ## _ssse3
+#include "yadif_16_template.c"
+#undef COMPILE_TEMPLATE_SSSE3
+#endif
+
+#if HAVE_SSE
+#undef RENAME
+#define RENAME(a) a ## _sse2
+#include "yadif_16_template.c"
+#endif
 
 #if HAVE_SSSE3
 #define COMPILE_TEMPLATE_SSE 1
@@ -0,0 +1,259 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* 16 bits samples do not leave room for the sums and differences in words,
+ * the samples are unpacked to dwords and processed 4 at a time. */
+
+#define MM "%%xmm"
+#define STEP 4
+#define LOAD(mem,dst) \
+            "movq      "mem", "dst" \n\t"\
+            "punpcklwd "MM"7, "dst" \n\t"
+
+#ifdef COMPILE_TEMPLATE_SSSE3
+#define PABS(tmp,dst) \
+            "pabsd     "dst", "dst" \n\t"
+#else
+#define PABS(tmp,dst) \
+            "movdqa    "dst", "tmp" \n\t"\
+            "psrad     $31,   "tmp" \n\t"\
+            "pxor      "tmp", "dst" \n\t"\
+            "psubd     "tmp", "dst" \n\t"
+#endif
+
+#ifdef COMPILE_TEMPLATE_SSE4
+#define PMAXSD(tmp,src,dst) \
+            "pmaxsd    "src", "dst" \n\t"
+#define PMINSD(tmp,src,dst) \
+            "pminsd    "src", "dst" \n\t"
+#define PACK(reg) \
+            "packusdw  "reg", "reg" \n\t"
+#else
+#define PMAXSD(tmp,src,dst) \
+            "movdqa    "dst", "tmp" \n\t"\
+            "pcmpgtd   "src", "tmp" \n\t"\
+            "pand      "tmp", "dst" \n\t"\
+            "pandn     "src", "tmp" \n\t"\
+            "por       "tmp", "dst" \n\t"
+#define PMINSD(tmp,src,dst) \
+            "movdqa    "src", "tmp" \n\t"\
+            "pcmpgtd   "dst", "tmp" \n\t"\
+            "pand      "tmp", "dst" \n\t"\
+            "pandn     "src", "tmp" \n\t"\
+            "por       "tmp", "dst" \n\t"
+/* the result is in the 0..65535 range, keep the low words */
+#define PACK(reg) \
+            "pslld     $16,   "reg" \n\t"\
+            "psrad     $16,   "reg" \n\t"\
+            "packssdw  "reg", "reg" \n\t"
+#endif
+
+#define CHECK(pj,mj) \
+            LOAD(#pj"(%[cur],%[mrefs])", MM"2")   /* cur[x-refs-1+j] */\
+            LOAD(#mj"(%[cur],%[prefs])", MM"3")   /* cur[x+refs-1-j] */\
+            "psubd     "MM"3, "MM"2 \n\t"\
+            PABS(      MM"4", MM"2")\
+            LOAD(#pj"+2(%[cur],%[mrefs])", MM"3") /* cur[x-refs+j] */\
+            LOAD(#mj"+2(%[cur],%[prefs])", MM"4") /* cur[x+refs-j] */\
+            "movdqa    "MM"3, "MM"5 \n\t"\
+            "paddd     "MM"4, "MM"5 \n\t"\
+            "psrld     $1,    "MM"5 \n\t" /* (cur[x-refs+j] + cur[x+refs-j])>>1 */\
+            "psubd     "MM"4, "MM"3 \n\t"\
+            PABS(      MM"4", MM"3")\
+            "paddd     "MM"3, "MM"2 \n\t"\
+            LOAD(#pj"+4(%[cur],%[mrefs])", MM"3") /* cur[x-refs+1+j] */\
+            LOAD(#mj"+4(%[cur],%[prefs])", MM"4") /* cur[x+refs+1-j] */\
+            "psubd     "MM"4, "MM"3 \n\t"\
+            PABS(      MM"4", MM"3")\
+            "paddd     "MM"3, "MM"2 \n\t" /* score */
+
+#define CHECK1 \
+            "movdqa    "MM"0, "MM"3 \n\t"\
+            "pcmpgtd   "MM"2, "MM"3 \n\t" /* if(score < spatial_score) */\
+            "movdqa    "MM"3, "MM"6 \n\t"\
+            "movdqa    "MM"3, "MM"4 \n\t"\
+            "pand      "MM"2, "MM"4 \n\t"\
+            "pandn     "MM"0, "MM"3 \n\t"\
+            "por       "MM"4, "MM"3 \n\t"\
+            "movdqa    "MM"3, "MM"0 \n\t" /* spatial_score= score; */\
+            "movdqa    "MM"6, "MM"3 \n\t"\
+            "pand      "MM"3, "MM"5 \n\t"\
+            "pandn     "MM"1, "MM"3 \n\t"\
+            "por       "MM"5, "MM"3 \n\t"\
+            "movdqa    "MM"3, "MM"1 \n\t" /* spatial_pred= (cur[x-refs+j] + cur[x+refs-j])>>1; */
+
+#define CHECK2 /* pretend not to have checked dir=2 if dir=1 was bad.\
+                  hurts both quality and speed, but matches the C version. */\
+            "paddd    "MANGLE(pd_1)", "MM"6 \n\t"\
+            "pslld     $30,   "MM"6 \n\t"\
+            "paddd     "MM"6, "MM"2 \n\t"\
+            CHECK1
+
+void RENAME(ff_yadif_filter_line_16bit)(uint8_t *dst,
+                                        uint8_t *prev, uint8_t *cur, uint8_t *next,
+                                        int w, int prefs, int mrefs, int parity, int mode)
+{
+    uint8_t tmp[5*16];
+    uint8_t *tmpA= (uint8_t*)(((uint64_t)(tmp+15)) & ~15);
+    int x;
+
+#define FILTER\
+    for(x=0; x<w; x+=STEP){\
+        __asm__ volatile(\
+            "pxor      "MM"7, "MM"7 \n\t"\
+            LOAD("(%[cur],%[mrefs])", MM"0") /* c = cur[x-refs] */\
+            LOAD("(%[cur],%[prefs])", MM"1") /* e = cur[x+refs] */\
+            LOAD("(%["prev2"])", MM"2") /* prev2[x] */\
+            LOAD("(%["next2"])", MM"3") /* next2[x] */\
+            "movdqa    "MM"3, "MM"4 \n\t"\
+            "paddd     "MM"2, "MM"3 \n\t"\
+            "psrad     $1,    "MM"3 \n\t" /* d = (prev2[x] + next2[x])>>1 */\
+            "movdqa    "MM"0, (%[tmpA]) \n\t" /* c */\
+            "movdqa    "MM"3, 16(%[tmpA]) \n\t" /* d */\
+            "movdqa    "MM"1, 32(%[tmpA]) \n\t" /* e */\
+            "psubd     "MM"4, "MM"2 \n\t"\
+            PABS(      MM"4", MM"2") /* temporal_diff0 */\
+            LOAD("(%[prev],%[mrefs])", MM"3") /* prev[x-refs] */\
+            LOAD("(%[prev],%[prefs])", MM"4") /* prev[x+refs] */\
+            "psubd     "MM"0, "MM"3 \n\t"\
+            "psubd     "MM"1, "MM"4 \n\t"\
+            PABS(      MM"5", MM"3")\
+            PABS(      MM"5", MM"4")\
+            "paddd     "MM"4, "MM"3 \n\t" /* temporal_diff1 */\
+            "psrld     $1,    "MM"2 \n\t"\
+            "psrld     $1,    "MM"3 \n\t"\
+            PMAXSD(    MM"5", MM"3", MM"2")\
+            LOAD("(%[next],%[mrefs])", MM"3") /* next[x-refs] */\
+            LOAD("(%[next],%[prefs])", MM"4") /* next[x+refs] */\
+            "psubd     "MM"0, "MM"3 \n\t"\
+            "psubd     "MM"1, "MM"4 \n\t"\
+            PABS(      MM"5", MM"3")\
+            PABS(      MM"5", MM"4")\
+            "paddd     "MM"4, "MM"3 \n\t" /* temporal_diff2 */\
+            "psrld     $1,    "MM"3 \n\t"\
+            PMAXSD(    MM"5", MM"3", MM"2")\
+            "movdqa    "MM"2, 48(%[tmpA]) \n\t" /* diff */\
+\
+            "paddd     "MM"0, "MM"1 \n\t"\
+            "paddd     "MM"0, "MM"0 \n\t"\
+            "psubd     "MM"1, "MM"0 \n\t"\
+            "psrld     $1,    "MM"1 \n\t" /* spatial_pred */\
+            PABS(      MM"2", MM"0")      /* ABS(c-e) */\
+\
+            LOAD("-2(%[cur],%[mrefs])", MM"2") /* cur[x-refs-1] */\
+            LOAD("-2(%[cur],%[prefs])", MM"3") /* cur[x+refs-1] */\
+            "psubd     "MM"3, "MM"2 \n\t"\
+            PABS(      MM"4", MM"2")\
+            "paddd     "MM"2, "MM"0 \n\t"\
+            LOAD("2(%[cur],%[mrefs])", MM"2") /* cur[x-refs+1] */\
+            LOAD("2(%[cur],%[prefs])", MM"3") /* cur[x+refs+1] */\
+            "psubd     "MM"3, "MM"2 \n\t"\
+            PABS(      MM"4", MM"2")\
+            "paddd     "MM"2, "MM"0 \n\t"\
+            "psubd    "MANGLE(pd_1)", "MM"0 \n\t" /* spatial_score */\
+\
+            CHECK(-4,0)\
+            CHECK1\
+            CHECK(-6,2)\
+            CHECK2\
+            CHECK(0,-4)\
+            CHECK1\
+            CHECK(2,-6)\
+            CHECK2\
+\
+            /* if(p->mode<2) ... */\
+            "movdqa  48(%[tmpA]), "MM"6 \n\t" /* diff */\
+            "cmpl      $2, %[mode] \n\t"\
+            "jge       1f \n\t"\
+            LOAD("(%["prev2"],%[mrefs],2)", MM"2") /* prev2[x-2*refs] */\
+            LOAD("(%["next2"],%[mrefs],2)", MM"4") /* next2[x-2*refs] */\
+            LOAD("(%["prev2"],%[prefs],2)", MM"3") /* prev2[x+2*refs] */\
+            LOAD("(%["next2"],%[prefs],2)", MM"5") /* next2[x+2*refs] */\
+            "paddd     "MM"4, "MM"2 \n\t"\
+            "paddd     "MM"5, "MM"3 \n\t"\
+            "psrld     $1,    "MM"2 \n\t" /* b */\
+            "psrld     $1,    "MM"3 \n\t" /* f */\
+            "movdqa  (%[tmpA]), "MM"4 \n\t" /* c */\
+            "movdqa  16(%[tmpA]), "MM"5 \n\t" /* d */\
+            "movdqa  32(%[tmpA]), "MM"7 \n\t" /* e */\
+            "psubd     "MM"4, "MM"2 \n\t" /* b-c */\
+            "psubd     "MM"7, "MM"3 \n\t" /* f-e */\
+            "movdqa    "MM"5, "MM"0 \n\t"\
+            "psubd     "MM"4, "MM"5 \n\t" /* d-c */\
+            "psubd     "MM"7, "MM"0 \n\t" /* d-e */\
+            "movdqa    "MM"2, "MM"4 \n\t"\
+            PMINSD(    MM"7", MM"3", MM"2")\
+            PMAXSD(    MM"7", MM"4", MM"3")\
+            PMAXSD(    MM"7", MM"5", MM"2")\
+            PMINSD(    MM"7", MM"5", MM"3")\
+            PMAXSD(    MM"7", MM"0", MM"2") /* max */\
+            PMINSD(    MM"7", MM"0", MM"3") /* min */\
+            "pxor      "MM"4, "MM"4 \n\t"\
+            PMAXSD(    MM"7", MM"3", MM"6")\
+            "psubd     "MM"2, "MM"4 \n\t" /* -max */\
+            PMAXSD(    MM"7", MM"4", MM"6") /* diff= MAX3(diff, min, -max); */\
+            "1: \n\t"\
+\
+            "movdqa  16(%[tmpA]), "MM"2 \n\t" /* d */\
+            "movdqa    "MM"2, "MM"3 \n\t"\
+            "psubd     "MM"6, "MM"2 \n\t" /* d-diff */\
+            "paddd     "MM"6, "MM"3 \n\t" /* d+diff */\
+            PMAXSD(    MM"4", MM"2", MM"1")\
+            PMINSD(    MM"4", MM"3", MM"1") /* d = clip(spatial_pred, d-diff, d+diff); */\
+            PACK(      MM"1")\
+\
+            :\
+            :[tmpA] "r"(tmpA),\
+             [prev] "r"(prev),\
+             [cur]  "r"(cur),\
+             [next] "r"(next),\
+             [prefs]"r"((x86_reg)prefs),\
+             [mrefs]"r"((x86_reg)mrefs),\
+             [mode] "g"(mode)\
+        );\
+        __asm__ volatile("movq "MM"1, %0" :"=m"(*(uint64_t*)dst));\
+        dst += 2*STEP;\
+        prev+= 2*STEP;\
+        cur += 2*STEP;\
+        next+= 2*STEP;\
+    }
+
+    if (parity) {
+#define prev2 "prev"
+#define next2 "cur"
+        FILTER
+#undef prev2
+#undef next2
+    } else {
+#define prev2 "cur"
+#define next2 "next"
+        FILTER
+#undef prev2
+#undef next2
+    }
+}
+#undef STEP
+#undef MM
+#undef LOAD
+#undef PABS
+#undef PMAXSD
+#undef PMINSD
+#undef PACK
+#undef CHECK
+#undef CHECK1
+#undef CHECK2
+#undef FILTER
@@ -32,4 +32,16 @@ void ff_yadif_filter_line_ssse3(uint8_t *dst,
                                 uint8_t *prev, uint8_t *cur, uint8_t *next,
                                 int w, int prefs, int mrefs, int parity, int mode);
 
+void ff_yadif_filter_line_16bit_sse2(uint8_t *dst,
+                                     uint8_t *prev, uint8_t *cur, uint8_t *next,
+                                     int w, int prefs, int mrefs, int parity, int mode);
+
+void ff_yadif_filter_line_16bit_ssse3(uint8_t *dst,
+                                      uint8_t *prev, uint8_t *cur, uint8_t *next,
+                                      int w, int prefs, int mrefs, int parity, int mode);
+
+void ff_yadif_filter_line_16bit_sse4(uint8_t *dst,
+                                     uint8_t *prev, uint8_t *cur, uint8_t *next,
+                                     int w, int prefs, int mrefs, int parity, int mode);
+
 #endif /* AVFILTER_YADIF_H */
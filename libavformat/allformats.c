@@ -245,6 +245,7 @@ void av_register_all(void)
     REGISTER_PROTOCOL (MMST, mmst);
     REGISTER_PROTOCOL (MD5,  md5);
     REGISTER_PROTOCOL (PIPE, pipe);
+    REGISTER_PROTOCOL (READAHEAD, readahead);
     REGISTER_PROTOCOL (RTMP, rtmp);
 #if CONFIG_LIBRTMP
     REGISTER_PROTOCOL (RTMP, rtmpt);
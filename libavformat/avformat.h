@@ -645,6 +645,12 @@ typedef struct AVStream {
      * NOT PART OF PUBLIC API
      */
     int request_probe;
+
+    /**
+     * first packet in the interleaving queue of this stream when muxing.
+     * used internally, NOT PART OF PUBLIC API, dont read or write from outside of libav*
+     */
+    struct AVPacketList *first_in_packet_buffer;
 } AVStream;
 
 #define AV_PROGRAM_RUNNING 1
@@ -724,6 +730,8 @@ typedef struct AVFormatContext {
      * seconds. Only set this value if you know none of the individual stream
      * durations and also dont set any of them. This is deduced from the
      * AVStream values if not set.
+     * Encoding: expected duration of the output, may be set by the caller
+     * before writing the header, 0 if unknown.
      */
     int64_t duration;
 
@@ -887,6 +895,30 @@ typedef struct AVFormatContext {
      * duration are known as FFmpeg can compute it automatically.
      */
     int64_t bit_rate;
+
+    /**
+     * Muxing: binary heap of the indexes of the streams that have packets
+     * queued for interleaving, ordered by their first queued packet.
+     * NOT PART OF PUBLIC API
+     */
+    int *interleave_heap;
+    int interleave_heap_size;
+    unsigned int interleave_heap_alloc;
+    int (*interleave_compare)(struct AVFormatContext *, AVPacket *, AVPacket *);
+
+    /**
+     * Muxing: unused packet list entries, reused for interleaving.
+     * NOT PART OF PUBLIC API
+     */
+    struct AVPacketList *packet_pool;
+
+    /**
+     * Size of the buffer filled by a background thread ahead of the
+     * demuxer, 0 to read synchronously.
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    int readahead_size;
 } AVFormatContext;
 
 typedef struct AVPacketList {
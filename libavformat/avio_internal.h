@@ -41,6 +41,16 @@ int ffio_init_context(AVIOContext *s,
  */
 int ffio_read_partial(AVIOContext *s, unsigned char *buf, int size);
 
+/**
+ * Read size bytes from AVIOContext, returning a pointer to the data.
+ * If the data is available in the AVIOContext buffer, *data points into it
+ * and no copy is made, otherwise the data is read into buf and *data is buf.
+ * *data is only valid until the next read from s.
+ * @return number of bytes read or AVERROR
+ */
+int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size,
+                       const unsigned char **data);
+
 /**
  * Rewind the AVIOContext using the specified buffer containing the first buf_size bytes of the file.
  * Used after probing to avoid seeking.
@@ -71,11 +71,26 @@ int ff_hex_to_data(uint8_t *data, const char *p);
 void ff_program_add_stream_index(AVFormatContext *ac, int progid, unsigned int idx);
 
 /**
- * Add packet to AVFormatContext->packet_buffer list, determining its
- * interleaved position using compare() function argument.
+ * Add packet to the interleaving queue of its stream. The queues are
+ * merged in the order given by the compare() function argument, which
+ * returns nonzero if pkt must be muxed before next.
+ * @return 0 on success, a negative AVERROR on error
  */
-void ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
-                              int (*compare)(AVFormatContext *, AVPacket *, AVPacket *));
+int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
+                             int (*compare)(AVFormatContext *, AVPacket *, AVPacket *));
+
+/**
+ * Return the next packet to be muxed from the interleaving queues without
+ * removing it, or NULL if no packet is queued.
+ */
+AVPacket *ff_interleave_peek_packet(AVFormatContext *s);
+
+/**
+ * Remove the next packet to be muxed from the interleaving queues.
+ * @param out the packet is returned here, it must be freed by the caller
+ * @return 1 if a packet was returned, 0 if no packet is queued
+ */
+int ff_interleave_get_packet(AVFormatContext *s, AVPacket *out);
 
 void ff_read_frame_flush(AVFormatContext *s);
 
@@ -94,6 +94,22 @@ typedef struct {
     unsigned flags;
 } MOVTrackExt;
 
+/**
+ * Run of consecutive samples whose positions and timestamps are evenly
+ * spaced, the index of a stream is a list of those.
+ */
+typedef struct MOVIndexRange {
+    int64_t pos;          ///< position of the first sample
+    int64_t timestamp;    ///< dts of the first sample
+    int first;            ///< number of the first sample in the stream
+    int count;            ///< number of samples
+    int size;             ///< size of each sample, if size_index < 0
+    int size_index;       ///< sample_sizes entry of the first sample, -1 if constant size
+    int duration;         ///< dts difference between the samples
+    int flags;            ///< AVINDEX_KEYFRAME if all samples are keyframes
+    AVIOContext *pb;      ///< data reference holding the samples
+} MOVIndexRange;
+
 typedef struct MOVStreamContext {
     int ffindex;          ///< AVStream index
     int next_chunk;
@@ -117,12 +133,25 @@ typedef struct MOVStreamContext {
     int time_scale;
     int64_t time_offset;  ///< time offset of the first edit list entry
     int current_sample;
+    int64_t next_dts;     ///< dts of current_sample in AV_TIME_BASE units
+    int64_t next_pos;     ///< file position of current_sample
+    int heap_index[2];    ///< position in the MOVContext sample heaps
+    struct MOVReadBuffer *read_buf; ///< buffer holding the last sample read
+    int run_sample;       ///< next sample while looking for contiguous samples
     unsigned int bytes_per_frame;
     unsigned int samples_per_frame;
     int dv_audio_container;
     int *dref_ids;
     int dref_ids_count;
-    AVIOContext **sample_dref;
+    MOVIndexRange *index_ranges;
+    unsigned int index_ranges_count;
+    unsigned int index_ranges_allocated_size;
+    int index_samples;    ///< number of samples in index_ranges
+    int index_range;      ///< range of the last sample looked up
+    int index_sizes;      ///< some ranges use sample_sizes
+    int64_t index_end_pos; ///< end position of the last range
+    int pos_cache_sample; ///< last variable size sample looked up, -1 if none
+    int64_t pos_cache;    ///< position of pos_cache_sample
     int16_t audio_cid;    ///< stsd audio compression id
     unsigned drefs_count;
     MOVDref *drefs;
@@ -155,6 +184,12 @@ typedef struct MOVContext {
     AVDictionary **metadata; ///< current metadata context (track or global)
     char **keys_data;        ///< metadata keys
     unsigned keys_count;     ///< metadata keys
+    int *sample_heap[2];     ///< streams with samples left, min-heaps on next dts and next position
+    int sample_heap_count;
+    int sample_heap_valid;   ///< heaps match the current_sample of every stream
+    int64_t sample_max_dts;  ///< largest next dts of the streams in the heaps
+    int sample_ext_drefs;    ///< some stream references samples outside of the main file
+    struct MOVReadBuffer *read_buf; ///< last run of contiguous samples read
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
@@ -42,6 +42,10 @@
 #include <zlib.h>
 #endif
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 /*
  * First version by Francois Revol revol@free.fr
  * Seek function by Gael Chardon gael.dev@4now.net
@@ -1807,6 +1811,125 @@ static void mov_compute_stream_time_offset(MOVContext *mov, AVStream *st)
                "a/v desync might occur, patch welcome\n");
 }
 
+/**
+ * Append count samples to the index, extending the last range when they
+ * continue it.
+ * @param size_index sample_sizes entry of the first sample, or -1 if all
+ *                   samples are size bytes
+ * @param bytes      total size of the samples
+ */
+static int mov_add_index_range(MOVStreamContext *sc, int64_t pos, int64_t timestamp,
+                               int count, int size, int size_index, int64_t bytes,
+                               int duration, int flags, AVIOContext *pb)
+{
+    MOVIndexRange *r = NULL;
+
+    if (count <= 0)
+        return 0;
+    if (count > INT_MAX - sc->index_samples)
+        return AVERROR_INVALIDDATA;
+
+    if (sc->index_ranges_count)
+        r = &sc->index_ranges[sc->index_ranges_count - 1];
+    if (r && r->pb == pb && r->flags == flags && pos == sc->index_end_pos &&
+        (size_index < 0 ? r->size_index < 0 && r->size == size :
+                          r->size_index >= 0 && size_index == r->size_index + r->count)) {
+        int64_t d = r->count == 1 ? timestamp - r->timestamp : r->duration;
+        if (d == (int)d && timestamp == r->timestamp + r->count * d &&
+            (count == 1 || duration == d)) {
+            r->duration = d;
+            r->count += count;
+            goto done;
+        }
+    }
+
+    if ((unsigned)sc->index_ranges_count + 1 >= UINT_MAX / sizeof(*r))
+        return AVERROR_INVALIDDATA;
+    r = av_fast_realloc(sc->index_ranges, &sc->index_ranges_allocated_size,
+                        (sc->index_ranges_count + 1) * sizeof(*r));
+    if (!r)
+        return AVERROR(ENOMEM);
+    sc->index_ranges = r;
+    r = &sc->index_ranges[sc->index_ranges_count++];
+    r->pos        = pos;
+    r->timestamp  = timestamp;
+    r->first      = sc->index_samples;
+    r->count      = count;
+    r->size       = size;
+    r->size_index = size_index;
+    r->duration   = duration;
+    r->flags      = flags;
+    r->pb         = pb;
+done:
+    sc->index_samples += count;
+    sc->index_end_pos  = pos + bytes;
+    return 0;
+}
+
+/**
+ * Find the range holding a sample, sample must be in [0, index_samples).
+ */
+static MOVIndexRange *mov_find_index_range(MOVStreamContext *sc, int sample)
+{
+    MOVIndexRange *r = &sc->index_ranges[sc->index_range];
+    int a, b;
+
+    if (sample >= r->first && sample - r->first < r->count)
+        return r;
+    if (sc->index_range + 1 < sc->index_ranges_count && sample >= r[1].first &&
+        sample - r[1].first < r[1].count)
+        return &sc->index_ranges[++sc->index_range];
+
+    a = 0;
+    b = sc->index_ranges_count;
+    while (b - a > 1) {
+        int m = (a + b) >> 1;
+        if (sc->index_ranges[m].first <= sample)
+            a = m;
+        else
+            b = m;
+    }
+    sc->index_range = a;
+    return &sc->index_ranges[a];
+}
+
+/**
+ * Expand one sample of the index, sample must be in [0, index_samples).
+ * @return the range holding the sample
+ */
+static MOVIndexRange *mov_get_sample(MOVStreamContext *sc, int sample, AVIndexEntry *e)
+{
+    MOVIndexRange *r = mov_find_index_range(sc, sample);
+    int k = sample - r->first;
+
+    e->timestamp    = r->timestamp + (int64_t)k * r->duration;
+    e->flags        = r->flags;
+    e->min_distance = 0;
+    if (r->size_index < 0) {
+        e->size = r->size;
+        e->pos  = r->pos + (int64_t)k * r->size;
+    } else {
+        const int *sizes = sc->sample_sizes + r->size_index;
+        int64_t pos = r->pos;
+        int i = 0;
+
+        /* walk from the last sample looked up if it is in the same range */
+        if (sc->pos_cache_sample >= r->first && sc->pos_cache_sample - r->first < r->count) {
+            i   = sc->pos_cache_sample - r->first;
+            pos = sc->pos_cache;
+        }
+        while (i < k)
+            pos += sizes[i++];
+        while (i > k)
+            pos -= sizes[--i];
+        sc->pos_cache_sample = sample;
+        sc->pos_cache        = pos;
+        e->size = sizes[k];
+        e->pos  = pos;
+    }
+    return r;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -1816,9 +1939,10 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     unsigned int stsc_index = 0;
     unsigned int stss_index = 0;
     unsigned int stps_index = 0;
-    unsigned int i, j;
+    unsigned int i, j, k;
     uint64_t stream_size = 0;
 
+    sc->pos_cache_sample = -1;
     mov_compute_stream_time_offset(mov, st);
     current_dts = -sc->time_offset;
     st->duration -= sc->time_offset;
@@ -1829,30 +1953,30 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         unsigned int current_sample = 0;
         unsigned int stts_sample = 0;
         unsigned int sample_size;
-        unsigned int distance = 0;
         int key_off = sc->keyframes && sc->keyframes[0] == 1;
 
         current_dts -= sc->dts_shift;
 
         if (!sc->sample_count)
             return;
-        if (sc->sample_count >= UINT_MAX / sizeof(*st->index_entries))
-            return;
-        st->index_entries = av_malloc(sc->sample_count*sizeof(*st->index_entries));
-        if (!st->index_entries)
-            return;
-        st->index_entries_allocated_size = sc->sample_count*sizeof(*st->index_entries);
-        sc->sample_dref = av_mallocz(sc->sample_count*sizeof(*sc->sample_dref));
-        if (!sc->sample_dref)
-            return;
 
         for (i = 0; i < sc->chunk_count; i++) {
+            AVIOContext *pb = NULL;
+            unsigned int chunk_samples, count;
+
             current_offset = sc->chunk_offsets[i];
             while (stsc_index + 1 < sc->stsc_count &&
                 i + 1 == sc->stsc_data[stsc_index + 1].first)
                 stsc_index++;
-            for (j = 0; j < sc->stsc_data[stsc_index].count; j++) {
+            if (sc->stsc_data[stsc_index].id - 1 < sc->dref_ids_count &&
+                sc->dref_ids[sc->stsc_data[stsc_index].id - 1] - 1 < sc->drefs_count)
+                pb = sc->drefs[sc->dref_ids[sc->stsc_data[stsc_index].id - 1] - 1].pb;
+            chunk_samples = sc->stsc_data[stsc_index].count;
+            for (j = 0; j < chunk_samples; j += count) {
                 int keyframe = 0;
+                int size_index = -1;
+                int64_t bytes;
+
                 if (current_sample >= sc->sample_count) {
                     av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
                     return;
@@ -1867,30 +1991,45 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
                     if (stps_index + 1 < sc->stps_count)
                         stps_index++;
                 }
-                if (keyframe)
-                    distance = 0;
-                sample_size = sc->sample_size > 0 ? sc->sample_size : sc->sample_sizes[current_sample];
-                if (sc->stsc_data[stsc_index].id - 1 < sc->dref_ids_count &&
-                    sc->dref_ids[sc->stsc_data[stsc_index].id - 1] - 1 < sc->drefs_count) {
-                    AVIndexEntry *e = &st->index_entries[st->nb_index_entries++];
-                    e->pos = current_offset;
-                    e->timestamp = current_dts;
-                    e->size = sample_size;
-                    e->min_distance = distance;
-                    e->flags = keyframe ? AVINDEX_KEYFRAME : 0;
+
+                /* without stss all samples are keyframes, take them up to
+                 * the end of the chunk or of the stts entry at once */
+                count = 1;
+                if (!sc->keyframe_count) {
+                    count = FFMIN(chunk_samples - j, sc->sample_count - current_sample);
+                    if (stts_index + 1 < sc->stts_count && stts_sample < sc->stts_data[stts_index].count)
+                        count = FFMIN(count, sc->stts_data[stts_index].count - stts_sample);
+                }
+                if (sc->sample_size > 0) {
+                    sample_size = sc->sample_size;
+                    bytes = (int64_t)count * sample_size;
+                } else {
+                    const int *sizes = sc->sample_sizes + current_sample;
+                    sample_size = sizes[0];
+                    bytes = 0;
+                    for (k = 0; k < count; k++) {
+                        bytes += sizes[k];
+                        if (sizes[k] != sample_size)
+                            size_index = current_sample;
+                    }
+                }
+                if (pb) {
+                    if (mov_add_index_range(sc, current_offset, current_dts, count, sample_size,
+                                            size_index, bytes, sc->stts_data[stts_index].duration,
+                                            keyframe ? AVINDEX_KEYFRAME : 0, pb) < 0)
+                        return;
+                    if (size_index >= 0)
+                        sc->index_sizes = 1;
                     av_dlog(mov->fc, "AVIndex stream %d, sample %d, offset %"PRIx64", dts %"PRId64", "
-                            "size %d, distance %d, keyframe %d\n", st->index, current_sample,
-                            current_offset, current_dts, sample_size, distance, keyframe);
-                    sc->sample_dref[current_sample] =
-                        sc->drefs[sc->dref_ids[sc->stsc_data[stsc_index].id - 1] - 1].pb;
+                            "size %d, count %d, keyframe %d\n", st->index, current_sample,
+                            current_offset, current_dts, sample_size, count, keyframe);
                 }
 
-                current_offset += sample_size;
-                stream_size += sample_size;
-                current_dts += sc->stts_data[stts_index].duration;
-                distance++;
-                stts_sample++;
-                current_sample++;
+                current_offset += bytes;
+                stream_size += bytes;
+                current_dts += (int64_t)count * sc->stts_data[stts_index].duration;
+                stts_sample += count;
+                current_sample += count;
                 if (stts_index + 1 < sc->stts_count && stts_sample == sc->stts_data[stts_index].count) {
                     stts_sample = 0;
                     stts_index++;
@@ -1900,46 +2039,16 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         if (st->duration > 0)
             st->codec->bit_rate = stream_size*8*sc->time_scale/st->duration;
     } else {
-        unsigned chunk_samples, total = 0;
+        unsigned chunk_samples;
 
-        // compute total chunk count
         for (i = 0; i < sc->stsc_count; i++) {
-            unsigned count, chunk_count;
-
-            chunk_samples = sc->stsc_data[i].count;
-            if (sc->samples_per_frame && chunk_samples % sc->samples_per_frame) {
+            if (sc->samples_per_frame && sc->stsc_data[i].count % sc->samples_per_frame) {
                 av_log(mov->fc, AV_LOG_ERROR, "error unaligned chunk\n");
                 return;
             }
-
-            if (sc->samples_per_frame >= 160) { // gsm
-                count = chunk_samples / sc->samples_per_frame;
-            } else if (sc->samples_per_frame > 1) {
-                unsigned samples = (1024/sc->samples_per_frame)*sc->samples_per_frame;
-                count = (chunk_samples+samples-1) / samples;
-            } else {
-                count = (chunk_samples+1023) / 1024;
-            }
-
-            if (i < sc->stsc_count - 1)
-                chunk_count = sc->stsc_data[i+1].first - sc->stsc_data[i].first;
-            else
-                chunk_count = sc->chunk_count - (sc->stsc_data[i].first - 1);
-            total += chunk_count * count;
         }
 
-        av_dlog(mov->fc, "chunk count %d\n", total);
-        if (total >= UINT_MAX / sizeof(*st->index_entries))
-            return;
-        st->index_entries = av_malloc(total*sizeof(*st->index_entries));
-        if (!st->index_entries)
-            return;
-        st->index_entries_allocated_size = total*sizeof(*st->index_entries);
-        sc->sample_dref = av_malloc(total*sizeof(*sc->sample_dref));
-        if (!sc->sample_dref)
-            return;
-
-        // populate index
+        // populate index, one range for the full entries of each chunk and one for the rest
         for (i = 0; i < sc->chunk_count; i++) {
             current_offset = sc->chunk_offsets[i];
             if (stsc_index + 1 < sc->stsc_count &&
@@ -1948,8 +2057,8 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             chunk_samples = sc->stsc_data[stsc_index].count;
 
             while (chunk_samples > 0) {
-                AVIndexEntry *e;
-                unsigned size, samples;
+                AVIOContext *pb;
+                unsigned size, samples, count;
 
                 if (sc->samples_per_frame >= 160) { // gsm
                     samples = sc->samples_per_frame;
@@ -1964,34 +2073,25 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
                         size = samples * sc->sample_size;
                     }
                 }
-
-                if (st->nb_index_entries >= total) {
-                    av_log(mov->fc, AV_LOG_ERROR, "wrong chunk count %d\n", total);
-                    return;
-                }
+                count = chunk_samples / samples;
 
                 if (sc->stsc_data[stsc_index].id - 1 >= sc->dref_ids_count ||
                     sc->dref_ids[sc->stsc_data[stsc_index].id - 1] - 1 >= sc->drefs_count) {
                     av_log(mov->fc, AV_LOG_ERROR, "wrong stsc id\n");
                     return;
                 }
+                pb = sc->drefs[sc->dref_ids[sc->stsc_data[stsc_index].id - 1] - 1].pb;
 
-                sc->sample_dref[st->nb_index_entries] =
-                    sc->drefs[sc->dref_ids[sc->stsc_data[stsc_index].id - 1] - 1].pb;
-
-                e = &st->index_entries[st->nb_index_entries++];
-                e->pos = current_offset;
-                e->timestamp = current_dts;
-                e->size = size;
-                e->min_distance = 0;
-                e->flags = AVINDEX_KEYFRAME;
+                if (mov_add_index_range(sc, current_offset, current_dts, count, size, -1,
+                                        (int64_t)count * size, samples, AVINDEX_KEYFRAME, pb) < 0)
+                    return;
                 av_dlog(mov->fc, "AVIndex stream %d, chunk %d, offset %"PRIx64", dts %"PRId64", "
-                        "size %d, duration %d\n", st->index, i, current_offset, current_dts,
-                        size, samples);
+                        "size %d, duration %d, count %d\n", st->index, i, current_offset,
+                        current_dts, size, samples, count);
 
-                current_offset += size;
-                current_dts += samples;
-                chunk_samples -= samples;
+                current_offset += (int64_t)count * size;
+                current_dts += (int64_t)count * samples;
+                chunk_samples -= count * samples;
             }
         }
     }
@@ -2148,7 +2248,8 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     /* Do not need those anymore. */
     av_freep(&sc->chunk_offsets);
     av_freep(&sc->stsc_data);
-    av_freep(&sc->sample_sizes);
+    if (!sc->index_sizes)
+        av_freep(&sc->sample_sizes);
     av_freep(&sc->keyframes);
     av_freep(&sc->stts_data);
     av_freep(&sc->stps_data);
@@ -2352,8 +2453,8 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     int64_t dts;
     int data_offset = 0;
     unsigned entries, first_sample_flags = frag->flags;
-    int flags, distance, i;
-    int nb_index_entries;
+    int flags, i, ret;
+    AVIOContext *dref_pb;
 
     for (i = 0; i < c->fc->nb_streams; i++) {
         if (c->fc->streams[i]->id == frag->track_id) {
@@ -2402,15 +2503,9 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     if (flags & 0x004) first_sample_flags = avio_rb32(pb);
     dts    = sc->stts_end - sc->time_offset;
     offset = frag->base_data_offset + data_offset;
-    distance = 0;
+    dref_pb = sc->drefs[sc->dref_ids[frag->stsd_id - 1] - 1].pb;
     av_dlog(c->fc, "first sample flags 0x%x\n", first_sample_flags);
 
-    nb_index_entries = st->nb_index_entries;
-    sc->sample_dref = av_realloc(sc->sample_dref,
-                                 (nb_index_entries+entries)*sizeof(*sc->sample_dref));
-    if (!sc->sample_dref)
-        return AVERROR(ENOMEM);
-
     for (i = 0; i < entries; i++) {
         unsigned sample_size = frag->size;
         int sample_flags = i ? frag->flags : first_sample_flags;
@@ -2423,17 +2518,15 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         sc->ctts_data[sc->ctts_count].count = 1;
         sc->ctts_data[sc->ctts_count].duration = (flags & 0x800) ? avio_rb32(pb) : 0;
         sc->ctts_count++;
-        if ((keyframe = st->codec->codec_type == AVMEDIA_TYPE_AUDIO ||
-             (flags & 0x004 && !i && !sample_flags) || sample_flags & 0x2000000))
-            distance = 0;
-        av_add_index_entry(st, offset, dts, sample_size, distance,
-                           keyframe ? AVINDEX_KEYFRAME : 0);
+        keyframe = st->codec->codec_type == AVMEDIA_TYPE_AUDIO ||
+                   (flags & 0x004 && !i && !sample_flags) || sample_flags & 0x2000000;
+        ret = mov_add_index_range(sc, offset, dts, 1, sample_size, -1, sample_size,
+                                  sample_duration, keyframe ? AVINDEX_KEYFRAME : 0, dref_pb);
+        if (ret < 0)
+            return ret;
         av_dlog(c->fc, "AVIndex stream %d, sample %d, offset %"PRIx64", dts %"PRId64", "
-                "size %d, distance %d, keyframe %d\n", st->index, sc->sample_count+i,
-                offset, dts, sample_size, distance, keyframe);
-        sc->sample_dref[nb_index_entries+i] =
-            sc->drefs[sc->dref_ids[frag->stsd_id - 1] - 1].pb;
-        distance++;
+                "size %d, keyframe %d\n", st->index, sc->sample_count+i,
+                offset, dts, sample_size, keyframe);
         dts += sample_duration;
         offset += sample_size;
     }
@@ -2680,13 +2773,19 @@ static void mov_read_chapters(AVFormatContext *s)
     sc = st->priv_data;
     cur_pos = avio_tell(s->pb);
 
-    for (i = 0; i < st->nb_index_entries; i++) {
-        AVIndexEntry *sample = &st->index_entries[i];
-        int64_t end = i+1 < st->nb_index_entries ? st->index_entries[i+1].timestamp : st->duration;
+    for (i = 0; i < sc->index_samples; i++) {
+        AVIndexEntry sample_entry, *sample = &sample_entry;
+        int64_t end = st->duration;
         uint8_t *title;
         uint16_t ch;
         int len, title_len;
-        AVIOContext *pb = sc->sample_dref[i];
+        AVIOContext *pb;
+
+        if (i+1 < sc->index_samples) {
+            mov_get_sample(sc, i+1, sample);
+            end = sample->timestamp;
+        }
+        pb = mov_get_sample(sc, i, sample)->pb;
 
         if (avio_seek(pb, sample->pos, SEEK_SET) != sample->pos) {
             av_log(s, AV_LOG_ERROR, "Chapter %d not found in file\n", i);
@@ -2723,15 +2822,16 @@ finish:
 
 static void mov_read_timecode(AVFormatContext *s, AVStream *st)
 {
+    MOVStreamContext *sc = st->priv_data;
     int64_t pos = avio_tell(s->pb);
-    AVIndexEntry *e;
+    AVIndexEntry e;
     int framenum;
     char timecode[16];
 
-    if (!st->nb_index_entries)
+    if (!sc->index_samples)
         return;
-    e = &st->index_entries[0];
-    avio_seek(s->pb, e->pos, SEEK_SET);
+    mov_get_sample(sc, 0, &e);
+    avio_seek(s->pb, e.pos, SEEK_SET);
     framenum = avio_rb32(s->pb);
     if (ff_framenum_to_timecode(timecode, framenum,
                                 st->codec->flags2 & CODEC_FLAG2_DROP_FRAME_TIMECODE,
@@ -2787,63 +2887,446 @@ static int mov_read_header(AVFormatContext *s, AVFormatParameters *ap)
     return 0;
 }
 
-static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
+#define HEAP_DTS 0
+#define HEAP_POS 1
+
+static int mov_heap_less(AVFormatContext *s, int k, int a, int b)
+{
+    MOVStreamContext *sa = s->streams[a]->priv_data;
+    MOVStreamContext *sb = s->streams[b]->priv_data;
+    int64_t ka = k == HEAP_DTS ? sa->next_dts : sa->next_pos;
+    int64_t kb = k == HEAP_DTS ? sb->next_dts : sb->next_pos;
+    return ka < kb || (ka == kb && a < b);
+}
+
+/**
+ * Move the heap entry at position i up or down to its place.
+ */
+static void mov_heap_fix(AVFormatContext *s, int k, int i)
+{
+    MOVContext *mov = s->priv_data;
+    int *heap = mov->sample_heap[k];
+    int n = mov->sample_heap_count;
+    int idx = heap[i];
+    MOVStreamContext *sc;
+
+    while (i > 0 && mov_heap_less(s, k, idx, heap[(i-1)>>1])) {
+        heap[i] = heap[(i-1)>>1];
+        sc = s->streams[heap[i]]->priv_data;
+        sc->heap_index[k] = i;
+        i = (i-1)>>1;
+    }
+    for (;;) {
+        int c = 2*i + 1;
+        if (c >= n)
+            break;
+        if (c + 1 < n && mov_heap_less(s, k, heap[c+1], heap[c]))
+            c++;
+        if (!mov_heap_less(s, k, heap[c], idx))
+            break;
+        heap[i] = heap[c];
+        sc = s->streams[heap[i]]->priv_data;
+        sc->heap_index[k] = i;
+        i = c;
+    }
+    heap[i] = idx;
+    sc = s->streams[idx]->priv_data;
+    sc->heap_index[k] = i;
+}
+
+static void mov_update_max_dts(AVFormatContext *s)
+{
+    MOVContext *mov = s->priv_data;
+    int i;
+
+    mov->sample_max_dts = INT64_MIN;
+    for (i = 0; i < mov->sample_heap_count; i++) {
+        MOVStreamContext *sc = s->streams[mov->sample_heap[HEAP_DTS][i]]->priv_data;
+        mov->sample_max_dts = FFMAX(mov->sample_max_dts, sc->next_dts);
+    }
+}
+
+static void mov_set_next_sample(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    AVIndexEntry e;
+
+    mov_get_sample(sc, sc->current_sample, &e);
+    sc->next_dts = av_rescale(e.timestamp, AV_TIME_BASE, sc->time_scale);
+    sc->next_pos = e.pos;
+}
+
+/**
+ * Rebuild the sample heaps from the current_sample of every stream,
+ * needed after seeking and after reading new fragments.
+ */
+static int mov_build_sample_heaps(AVFormatContext *s)
+{
+    MOVContext *mov = s->priv_data;
+    int i, j, k;
+
+    for (k = 0; k < 2; k++) {
+        int *heap = av_realloc(mov->sample_heap[k], s->nb_streams * sizeof(*heap));
+        if (!heap)
+            return AVERROR(ENOMEM);
+        mov->sample_heap[k] = heap;
+    }
+    mov->sample_heap_count = 0;
+    mov->sample_ext_drefs = 0;
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        MOVStreamContext *sc = st->priv_data;
+
+        for (j = 0; j < sc->drefs_count; j++)
+            if (sc->drefs[j].pb && sc->drefs[j].pb != s->pb)
+                mov->sample_ext_drefs = 1;
+        if (sc->current_sample >= sc->index_samples)
+            continue;
+        mov_set_next_sample(st);
+        for (k = 0; k < 2; k++) {
+            mov->sample_heap[k][mov->sample_heap_count] = i;
+            sc->heap_index[k] = mov->sample_heap_count;
+        }
+        mov->sample_heap_count++;
+        for (k = 0; k < 2; k++)
+            mov_heap_fix(s, k, mov->sample_heap_count - 1);
+    }
+    mov_update_max_dts(s);
+    mov->sample_heap_valid = 1;
+    return 0;
+}
+
+/**
+ * Update the heaps after current_sample of st has been advanced.
+ */
+static void mov_advance_sample_heaps(AVFormatContext *s, AVStream *st)
+{
+    MOVContext *mov = s->priv_data;
+    MOVStreamContext *sc = st->priv_data;
+    int64_t old_dts = sc->next_dts;
+    int k;
+
+    if (sc->current_sample < sc->index_samples) {
+        mov_set_next_sample(st);
+        for (k = 0; k < 2; k++)
+            mov_heap_fix(s, k, sc->heap_index[k]);
+        if (sc->next_dts > mov->sample_max_dts)
+            mov->sample_max_dts = sc->next_dts;
+        else if (sc->next_dts < old_dts && old_dts == mov->sample_max_dts)
+            mov_update_max_dts(s);
+    } else {
+        int n = --mov->sample_heap_count;
+        for (k = 0; k < 2; k++) {
+            int i = sc->heap_index[k];
+            if (i != n) {
+                mov->sample_heap[k][i] = mov->sample_heap[k][n];
+                mov_heap_fix(s, k, i);
+            }
+        }
+        if (old_dts == mov->sample_max_dts)
+            mov_update_max_dts(s);
+    }
+}
+
+/**
+ * Pick the stream whose sample is read next.
+ *
+ * Streams are compared on file position when the input is not seekable.
+ * Otherwise the earliest dts wins, but samples less than one second apart
+ * are read in file order. That comparison is not transitive, so the heaps
+ * only answer the common cases where the result does not depend on the
+ * stream order: a stream more than a second ahead of all others, or all
+ * streams within a second of the one with the lowest position. Anything
+ * else goes through the full scan on the cached dts.
+ */
+static AVStream *mov_find_next_sample(AVFormatContext *s)
+{
+    MOVContext *mov = s->priv_data;
+    AVStream *st = NULL;
+    MOVStreamContext *msc;
+    int64_t best_dts = INT64_MAX, best_pos = 0;
+    int i;
+
+    if (!mov->sample_heap_count)
+        return NULL;
+
+    if (!s->pb->seekable) {
+        i = mov->sample_heap[HEAP_POS][0];
+    } else {
+        int *heap = mov->sample_heap[HEAP_DTS];
+        MOVStreamContext *first = s->streams[heap[0]]->priv_data;
+        MOVStreamContext *lowest_pos = s->streams[mov->sample_heap[HEAP_POS][0]]->priv_data;
+        int64_t second_dts = INT64_MAX;
+
+        for (i = 1; i < 3 && i < mov->sample_heap_count; i++) {
+            msc = s->streams[heap[i]]->priv_data;
+            second_dts = FFMIN(second_dts, msc->next_dts);
+        }
+        if (second_dts == INT64_MAX || second_dts - first->next_dts > AV_TIME_BASE) {
+            i = heap[0];
+        } else if (!mov->sample_ext_drefs &&
+                   lowest_pos->next_dts - first->next_dts <= AV_TIME_BASE &&
+                   mov->sample_max_dts - lowest_pos->next_dts <= AV_TIME_BASE) {
+            i = mov->sample_heap[HEAP_POS][0];
+        } else {
+            for (i = 0; i < s->nb_streams; i++) {
+                AVStream *avst = s->streams[i];
+                msc = avst->priv_data;
+                if (msc->current_sample < msc->index_samples) {
+                    int64_t dts = msc->next_dts;
+                    AVIOContext *pb = mov_find_index_range(msc, msc->current_sample)->pb;
+                    av_dlog(s, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
+                    if (!st ||
+                        (pb != s->pb && dts < best_dts) || (pb == s->pb &&
+                        ((FFABS(best_dts - dts) <= AV_TIME_BASE && msc->next_pos < best_pos) ||
+                         (FFABS(best_dts - dts) > AV_TIME_BASE && dts < best_dts)))) {
+                        best_dts = dts;
+                        best_pos = msc->next_pos;
+                        st = avst;
+                    }
+                }
+            }
+            return st;
+        }
+    }
+
+    st = s->streams[i];
+    msc = st->priv_data;
+    av_dlog(s, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, msc->next_dts);
+    return st;
+}
+
+/** largest run of contiguous samples read at once */
+#define MOV_MAX_RUN_SIZE (1 << 20)
+
+/**
+ * Run of contiguous samples, possibly from several tracks, read with a
+ * single avio_read(). Freed when the demuxer and all the packets
+ * pointing into it have dropped their reference.
+ */
+typedef struct MOVReadBuffer {
+    uint8_t *data;
+    int64_t pos;          ///< file position of data[0]
+    int size;
+    int refcount;
+#if HAVE_PTHREADS
+    /* packets may be freed in another thread than the one reading them,
+       possibly after the demuxer has been closed */
+    pthread_mutex_t lock;
+#endif
+} MOVReadBuffer;
+
+static MOVReadBuffer *mov_ref_buffer(MOVReadBuffer *buf)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&buf->lock);
+#endif
+    buf->refcount++;
+#if HAVE_PTHREADS
+    pthread_mutex_unlock(&buf->lock);
+#endif
+    return buf;
+}
+
+static void mov_unref_buffer(MOVReadBuffer **pbuf)
 {
-    AVIndexEntry *sample = NULL;
-    int64_t best_dts = INT64_MAX;
+    MOVReadBuffer *buf = *pbuf;
+    int refcount;
+
+    *pbuf = NULL;
+    if (!buf)
+        return;
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&buf->lock);
+#endif
+    refcount = --buf->refcount;
+#if HAVE_PTHREADS
+    pthread_mutex_unlock(&buf->lock);
+#endif
+    if (!refcount) {
+#if HAVE_PTHREADS
+        pthread_mutex_destroy(&buf->lock);
+#endif
+        av_free(buf->data);
+        av_free(buf);
+    }
+}
+
+static void mov_destruct_packet(AVPacket *pkt)
+{
+    MOVReadBuffer *buf = pkt->priv;
     int i;
+
+    mov_unref_buffer(&buf);
+    pkt->data = NULL; pkt->size = 0;
+
+    for (i = 0; i < pkt->side_data_elems; i++)
+        av_free(pkt->side_data[i].data);
+    av_freep(&pkt->side_data);
+    pkt->side_data_elems = 0;
+}
+
+static int mov_buffer_covers(MOVReadBuffer *buf, AVIndexEntry *sample)
+{
+    return buf && sample->pos >= buf->pos &&
+           sample->pos + sample->size <= buf->pos + buf->size;
+}
+
+/**
+ * Read the samples of all tracks stored contiguously from the given one
+ * on, in one go.
+ * @return the buffer, or NULL if the sample is not followed by any other
+ *         or on error, in which case the sample must be read alone
+ */
+static MOVReadBuffer *mov_read_run(AVFormatContext *s, AVStream *st, AVIndexEntry *sample)
+{
+    MOVReadBuffer *buf;
+    int64_t end = sample->pos + sample->size;
+    int i, size, progress;
+
     for (i = 0; i < s->nb_streams; i++) {
-        AVStream *avst = s->streams[i];
-        MOVStreamContext *msc = avst->priv_data;
-        if (msc->current_sample < avst->nb_index_entries) {
-            AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
-            int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
-            AVIOContext *pb = msc->sample_dref[msc->current_sample];
-            av_dlog(s, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
-            if (!sample || (!s->pb->seekable && current_sample->pos < sample->pos) ||
-                (s->pb->seekable &&
-                 ((pb != s->pb && dts < best_dts) || (pb == s->pb &&
-                 ((FFABS(best_dts - dts) <= AV_TIME_BASE && current_sample->pos < sample->pos) ||
-                  (FFABS(best_dts - dts) > AV_TIME_BASE && dts < best_dts)))))) {
-                sample = current_sample;
-                best_dts = dts;
-                *st = avst;
+        MOVStreamContext *sc = s->streams[i]->priv_data;
+        sc->run_sample = sc->current_sample;
+    }
+    do {
+        progress = 0;
+        for (i = 0; i < s->nb_streams; i++) {
+            AVStream *avst = s->streams[i];
+            MOVStreamContext *sc = avst->priv_data;
+            while (sc->run_sample < sc->index_samples) {
+                AVIndexEntry e;
+                if (mov_get_sample(sc, sc->run_sample, &e)->pb != s->pb || e.pos != end ||
+                    end + e.size - sample->pos > MOV_MAX_RUN_SIZE)
+                    break;
+                end += e.size;
+                sc->run_sample++;
+                progress = 1;
             }
         }
+    } while (progress);
+
+    if (end == sample->pos + sample->size)
+        return NULL;
+    size = end - sample->pos;
+
+    buf = av_mallocz(sizeof(*buf));
+    if (!buf)
+        return NULL;
+    buf->data = av_malloc(size + FF_INPUT_BUFFER_PADDING_SIZE);
+    if (!buf->data)
+        goto fail;
+    if (avio_seek(s->pb, sample->pos, SEEK_SET) != sample->pos)
+        goto fail;
+    buf->size = avio_read(s->pb, buf->data, size);
+    buf->pos  = sample->pos;
+    if (!mov_buffer_covers(buf, sample))
+        goto fail;
+    memset(buf->data + buf->size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    buf->refcount = 1;
+#if HAVE_PTHREADS
+    pthread_mutex_init(&buf->lock, NULL);
+#endif
+    av_dlog(s, "stream %d, read run of %d bytes at 0x%"PRIx64"\n",
+            st->index, buf->size, buf->pos);
+    return buf;
+fail:
+    av_free(buf->data);
+    av_free(buf);
+    return NULL;
+}
+
+/**
+ * Find a buffer holding the sample, reading the run it starts if needed.
+ */
+static MOVReadBuffer *mov_get_run_buffer(AVFormatContext *s, AVStream *st, AVIndexEntry *sample)
+{
+    MOVContext *mov = s->priv_data;
+    MOVStreamContext *sc = st->priv_data;
+    MOVReadBuffer *buf;
+
+    if (mov_buffer_covers(sc->read_buf, sample))
+        return sc->read_buf;
+    if (mov_buffer_covers(mov->read_buf, sample)) {
+        buf = mov->read_buf;
+    } else {
+        if (!(buf = mov_read_run(s, st, sample)))
+            return NULL;
+        mov_unref_buffer(&mov->read_buf);
+        mov->read_buf = buf;
+    }
+    /* each stream keeps its last buffer, so that tracks stored in
+     * separate areas of the file do not evict each other's run */
+    mov_unref_buffer(&sc->read_buf);
+    sc->read_buf = mov_ref_buffer(buf);
+    return buf;
+}
+
+static int mov_get_packet_from_run(AVStream *st, AVPacket *pkt,
+                                   MOVReadBuffer *buf, AVIndexEntry *sample)
+{
+    uint8_t *data = buf->data + (sample->pos - buf->pos);
+
+    /* raw PCM does not care about the padding being zeroed,
+     * other codecs get their own copy */
+    if (st->codec->codec_id >= CODEC_ID_PCM_S16LE &&
+        st->codec->codec_id <  CODEC_ID_ADPCM_IMA_QT) {
+        av_init_packet(pkt);
+        pkt->data     = data;
+        pkt->size     = sample->size;
+        pkt->destruct = mov_destruct_packet;
+        pkt->priv     = mov_ref_buffer(buf);
+    } else {
+        if (av_new_packet(pkt, sample->size) < 0)
+            return AVERROR(ENOMEM);
+        memcpy(pkt->data, data, sample->size);
     }
-    return sample;
+    pkt->pos = sample->pos;
+    return sample->size;
 }
 
 static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
     MOVStreamContext *sc;
-    AVIndexEntry *sample;
-    AVStream *st = NULL;
+    AVIndexEntry sample_entry, *sample = &sample_entry;
+    AVIOContext *pb;
+    AVStream *st;
     int ret;
  retry:
-    sample = mov_find_next_sample(s, &st);
-    if (!sample) {
+    if (!mov->sample_heap_valid && (ret = mov_build_sample_heaps(s)) < 0)
+        return ret;
+    st = mov_find_next_sample(s);
+    if (!st) {
         mov->found_mdat = 0;
         if (s->pb->seekable||
             mov_read_default(mov, s->pb, (MOVAtom){ AV_RL32("root"), INT64_MAX }) < 0 ||
             url_feof(s->pb))
             return AVERROR_EOF;
         av_dlog(s, "read fragments, offset 0x%"PRIx64"\n", avio_tell(s->pb));
+        mov->sample_heap_valid = 0;
         goto retry;
     }
     sc = st->priv_data;
+    pb = mov_get_sample(sc, sc->current_sample, sample)->pb;
     /* must be done just before reading, to avoid infinite loop on sample */
     sc->current_sample++;
+    mov_advance_sample_heaps(s, st);
 
     if (st->discard != AVDISCARD_ALL) {
-        AVIOContext *pb = sc->sample_dref[sc->current_sample - 1];
-        if (avio_seek(pb, sample->pos, SEEK_SET) != sample->pos) {
-            av_log(mov->fc, AV_LOG_ERROR, "stream %d, offset 0x%"PRIx64": partial file\n",
-                   sc->ffindex, sample->pos);
-            return -1;
+        MOVReadBuffer *buf = NULL;
+
+        if (pb == s->pb && !sc->dv_audio_container)
+            buf = mov_get_run_buffer(s, st, sample);
+        if (buf) {
+            ret = mov_get_packet_from_run(st, pkt, buf, sample);
+        } else {
+            if (avio_seek(pb, sample->pos, SEEK_SET) != sample->pos) {
+                av_log(mov->fc, AV_LOG_ERROR, "stream %d, offset 0x%"PRIx64": partial file\n",
+                       sc->ffindex, sample->pos);
+                return -1;
+            }
+            ret = av_get_packet(pb, pkt, sample->size);
         }
-        ret = av_get_packet(pb, pkt, sample->size);
         if (ret < 0)
             return ret;
         if (sc->has_palette) {
@@ -2892,8 +3375,12 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < st->nb_index_entries) ?
-            st->index_entries[sc->current_sample].timestamp : st->duration;
+        AVIndexEntry next;
+        int64_t next_dts = st->duration;
+        if (sc->current_sample < sc->index_samples) {
+            mov_get_sample(sc, sc->current_sample, &next);
+            next_dts = next.timestamp;
+        }
         pkt->duration = next_dts - pkt->dts;
         pkt->pts = pkt->dts;
     }
@@ -2906,15 +3393,60 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
     return 0;
 }
 
+/**
+ * Same as av_index_search_timestamp(), on the index ranges.
+ */
+static int mov_search_sample(MOVStreamContext *sc, int64_t wanted_timestamp, int flags)
+{
+    MOVIndexRange *r;
+    AVIndexEntry e;
+    int a, b, m;
+
+    /* last range starting at or before the wanted timestamp */
+    a = -1;
+    b = sc->index_ranges_count;
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+        if (sc->index_ranges[m].timestamp <= wanted_timestamp)
+            a = m;
+        else
+            b = m;
+    }
+    if (a < 0) {
+        b = 0;
+    } else {
+        r = &sc->index_ranges[a];
+        a = r->first + r->count - 1;
+        if (r->duration > 0)
+            a = r->first + FFMIN((wanted_timestamp - r->timestamp) / r->duration, r->count - 1);
+        mov_get_sample(sc, a, &e);
+        b = e.timestamp == wanted_timestamp ? a : a + 1;
+    }
+    m = (flags & AVSEEK_FLAG_BACKWARD) ? a : b;
+
+    if (!(flags & AVSEEK_FLAG_ANY)) {
+        while (m >= 0 && m < sc->index_samples) {
+            r = mov_find_index_range(sc, m);
+            if (r->flags & AVINDEX_KEYFRAME)
+                break;
+            m = (flags & AVSEEK_FLAG_BACKWARD) ? r->first - 1 : r->first + r->count;
+        }
+    }
+
+    if (m == sc->index_samples)
+        return -1;
+    return m;
+}
+
 static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp, int flags)
 {
     MOVStreamContext *sc = st->priv_data;
     int sample, time_sample;
     int i;
 
-    sample = av_index_search_timestamp(st, timestamp, flags);
+    sample = mov_search_sample(sc, timestamp, flags);
     av_dlog(s, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
-    if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
+    if (sample < 0 && sc->index_samples && timestamp < sc->index_ranges[0].timestamp)
         sample = 0;
     if (sample < 0) /* not sure what to do */
         return -1;
@@ -2938,7 +3470,9 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
 
 static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_time, int flags)
 {
+    MOVContext *mov = s->priv_data;
     AVStream *st;
+    AVIndexEntry e;
     int64_t seek_timestamp, timestamp;
     int sample;
     int i;
@@ -2949,12 +3483,14 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
         sample_time = 0;
 
     st = s->streams[stream_index];
+    mov->sample_heap_valid = 0;
     sample = mov_seek_stream(s, st, sample_time, flags);
     if (sample < 0)
         return -1;
 
     /* adjust seek timestamp to found sample timestamp */
-    seek_timestamp = st->index_entries[sample].timestamp;
+    mov_get_sample(st->priv_data, sample, &e);
+    seek_timestamp = e.timestamp;
 
     for (i = 0; i < s->nb_streams; i++) {
         st = s->streams[i];
@@ -2983,9 +3519,11 @@ static int mov_read_close(AVFormatContext *s)
             av_freep(&sc->drefs[j].path);
             av_freep(&sc->drefs[j].dir);
         }
-        av_freep(&sc->sample_dref);
+        av_freep(&sc->index_ranges);
+        av_freep(&sc->sample_sizes);
         av_freep(&sc->dref_ids);
         av_freep(&sc->drefs);
+        mov_unref_buffer(&sc->read_buf);
         av_freep(&st->codec->palctrl);
     }
 
@@ -2999,6 +3537,9 @@ static int mov_read_close(AVFormatContext *s)
     }
 
     av_freep(&mov->trex_data);
+    av_freep(&mov->sample_heap[HEAP_DTS]);
+    av_freep(&mov->sample_heap[HEAP_POS]);
+    mov_unref_buffer(&mov->read_buf);
 
     return 0;
 }
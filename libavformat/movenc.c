@@ -48,8 +48,9 @@
                      tag == AV_RL32("mx5p") || tag == AV_RL32("mx5n"))
 
 #define FAST_START_OPTION \
-    { "faststart", "Pre-allocate space for the header in front of the file: <size or 'auto' or 'no'>\n" \
-      "Files are automatically rewritten if size is < 20MB unless 'no' is specified.\n", \
+    { "faststart", "Pre-allocate space for the header in front of the file: <size or 'auto' or 'estimate' or 'no'>\n" \
+      "Files are automatically rewritten if size is < 20MB unless 'no' is specified.\n" \
+      "'estimate' reserves space computed from the expected duration and shifts the data in place if it is too small.\n", \
       offsetof(MOVMuxContext, faststart), FF_OPT_TYPE_STRING, {.dbl = 0}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM} \
 
 static const AVOption options[] = {
@@ -2582,6 +2583,81 @@ static void mov_create_chapter_track(AVFormatContext *s, int tracknum)
     }
 }
 
+/**
+ * Estimate the size of the moov atom from the track layout and the
+ * expected duration of the file. Sample tables are sized for the worst
+ * case of the interleaving done at write time, so the result is an upper
+ * bound for constant frame rate content.
+ */
+static int64_t mov_estimate_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    AVDictionaryEntry *t = NULL;
+    double duration = s->duration / (double)AV_TIME_BASE;
+    double video_rate = 0, size = 4096;
+    int i;
+
+    /* chunks are interleaved at most at the video frame rate */
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        if (st->codec->codec_type != AVMEDIA_TYPE_VIDEO)
+            continue;
+        if (st->avg_frame_rate.num && st->avg_frame_rate.den)
+            video_rate = FFMAX(video_rate, av_q2d(st->avg_frame_rate));
+        else if (st->r_frame_rate.num && st->r_frame_rate.den)
+            video_rate = FFMAX(video_rate, av_q2d(st->r_frame_rate));
+        else if (st->codec->time_base.num)
+            video_rate = FFMAX(video_rate, 1 / (av_q2d(st->codec->time_base) *
+                                                FFMAX(st->codec->ticks_per_frame, 1)));
+    }
+
+    while ((t = av_dict_get(s->metadata, "", t, AV_DICT_IGNORE_SUFFIX)))
+        size += strlen(t->key) + strlen(t->value) + 32;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        MOVTrack *track = &mov->tracks[i];
+        AVStream *st = s->streams[i];
+        AVCodecContext *enc = st->codec;
+        double samples, chunks;
+
+        size += 1024 + enc->extradata_size;
+
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
+            double rate = av_q2d(st->avg_frame_rate);
+            if (!st->avg_frame_rate.den || rate <= 0)
+                rate = video_rate;
+            samples = duration * rate;
+            chunks  = samples;
+            size += samples * 4; /* stsz */
+            if (enc->gop_size > 1)
+                size += samples * 4 / enc->gop_size; /* stss */
+            if (enc->has_b_frames || enc->max_b_frames)
+                size += samples * 9; /* ctts, sdtp */
+        } else if (enc->codec_type == AVMEDIA_TYPE_AUDIO) {
+            if (track->audio_vbr)
+                samples = duration * enc->sample_rate / enc->frame_size;
+            else /* one pcm packet per video frame, or 1024 samples */
+                samples = duration * (video_rate > 0 ? video_rate :
+                                      enc->sample_rate / 1024.0);
+            chunks = video_rate > 0 ? FFMIN(samples, duration * video_rate) : samples;
+            if (track->audio_vbr)
+                size += samples * 4; /* stsz */
+            size += chunks * 12; /* stsc */
+        } else {
+            samples = chunks = duration;
+            size += samples * 12; /* stsz, stts */
+        }
+        size += chunks * 8; /* co64 */
+    }
+
+    size += (mov->nb_streams - s->nb_streams) * 1024;
+
+    /* leave some headroom for variable frame durations */
+    size *= 1.05;
+
+    return FFALIGN((int64_t)size, 4096);
+}
+
 static int mov_write_header(AVFormatContext *s)
 {
     AVIOContext *pb = s->pb;
@@ -2730,7 +2806,13 @@ static int mov_write_header(AVFormatContext *s)
             mov->overwrite = 1;
         else if (!strcmp(mov->faststart, "no"))
             mov->overwrite = -1;
-        else
+        else if (!strcmp(mov->faststart, "estimate")) {
+            if (s->duration <= 0)
+                av_log(s, AV_LOG_WARNING, "duration is unknown, "
+                       "header will be inserted by shifting the data\n");
+            mov->estimate = 1;
+            mov->overwrite = FFMIN(mov_estimate_moov_size(s), INT_MAX/2);
+        } else
             mov->overwrite = atoi(mov->faststart);
         if (mov->overwrite > 1) {
             av_log(s, AV_LOG_INFO, "writing free atom of %d bytes\n", mov->overwrite);
@@ -2877,6 +2959,108 @@ static int mov_overwrite_file(AVFormatContext *s)
     return 0;
 }
 
+#define MOV_SHIFT_BUFFER_SIZE (8<<20)
+
+/**
+ * Make room for the moov atom in front of the mdat atom by moving the
+ * mdat atom towards the end of the file in place. Blocks are copied from
+ * the end so that no data is overwritten before having been read, and
+ * are aligned on the buffer size in the source, the shift itself being
+ * a multiple of 4096 bytes. The gap left after the moov atom is filled
+ * with a free atom.
+ * @return 0 on success, 1 if nothing was written and the moov atom must
+ *         be written at the end of the file instead, a negative error code
+ *         if the file could not be completed once data has been moved
+ */
+static int mov_shift_data(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    AVIOContext *rpb, *pb = s->pb;
+    int64_t pos = mov->mdat_pos + mov->mdat_size;
+    int64_t start, moov_pos, start_time, prev_time;
+    int moov_size, size, shift;
+    uint8_t *buf;
+
+    if (avio_open(&rpb, s->filename, URL_RDONLY) < 0) {
+        av_log(s, AV_LOG_ERROR, "error reopening file '%s' for read\n", s->filename);
+        return 1;
+    }
+    if (avio_size(rpb) < pos) {
+        av_log(s, AV_LOG_ERROR, "file '%s' is shorter than the written data\n", s->filename);
+        avio_close(rpb);
+        return 1;
+    }
+
+    buf = av_malloc(MOV_SHIFT_BUFFER_SIZE);
+    if (!buf) {
+        avio_close(rpb);
+        return 1;
+    }
+
+    /* chunk offsets grow with the shift, which may need co64 atoms */
+    moov_size = mov_compute_moov_size(s);
+    for (;;) {
+        shift = FFALIGN(moov_size + 8 - mov->free_size, 4096);
+        mov->stco_offset = shift;
+        size = mov_compute_moov_size(s);
+        if (size <= moov_size)
+            break;
+        moov_size = size;
+    }
+
+    av_log(s, AV_LOG_INFO, "header is %d bytes bigger than estimated, "
+           "shifting %5.2fMB\n", moov_size + 8 - mov->free_size,
+           mov->mdat_size/(1024.0*1024));
+
+    prev_time = start_time = av_gettime();
+    while (pos > mov->mdat_pos) {
+        start = FFMAX(mov->mdat_pos, (pos - 1) & ~(int64_t)(MOV_SHIFT_BUFFER_SIZE - 1));
+        size = pos - start;
+        if (avio_seek(rpb, start, SEEK_SET) != start ||
+            avio_read(rpb, buf, size) != size) {
+            av_log(s, AV_LOG_ERROR, "error reading back data at %"PRId64"\n", start);
+            goto fail;
+        }
+        if (avio_seek(pb, start + shift, SEEK_SET) < 0) {
+            av_log(s, AV_LOG_ERROR, "error seeking to %"PRId64"\n", start + shift);
+            goto fail;
+        }
+        avio_write(pb, buf, size);
+        pos = start;
+        if (pb->error < 0) {
+            av_log(s, AV_LOG_ERROR, "error writing data at %"PRId64"\n", start + shift);
+            goto fail;
+        }
+        if (av_gettime() - prev_time > 300000) {
+            double speed;
+            prev_time = av_gettime();
+            speed = (double)(mov->mdat_pos + mov->mdat_size - pos) / (prev_time - start_time);
+            av_log(s, AV_LOG_INFO, "left=%8.2fMB speed=%7.2fMB/s\r",
+                   (pos - mov->mdat_pos)/(1024.0*1024), speed);
+        }
+    }
+
+    avio_close(rpb);
+    av_free(buf);
+
+    if (avio_seek(pb, mov->free_pos, SEEK_SET) < 0)
+        return AVERROR(EIO);
+    mov_write_moov_tag(pb, mov, s);
+    moov_pos = avio_tell(pb);
+    mov_write_free_tag(pb, mov, mov->free_pos + mov->free_size + shift - moov_pos);
+    avio_flush(pb);
+
+    return pb->error < 0 ? pb->error : 0;
+ fail:
+    avio_close(rpb);
+    av_free(buf);
+    /* some blocks may have been moved already, the file is broken */
+    if (pos < mov->mdat_pos + mov->mdat_size)
+        return pb->error < 0 ? pb->error : AVERROR(EIO);
+    mov->stco_offset = 0;
+    return 1;
+}
+
 static int mov_write_trailer(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -2905,7 +3089,11 @@ static int mov_write_trailer(AVFormatContext *s)
 
     if (mov->free_size > 8) {
         int moov_size = mov_compute_moov_size(s);
-        if (moov_size > mov->free_size) {
+        /* the space left after the moov atom must hold a free atom */
+        if (moov_size != mov->free_size && moov_size + 8 > mov->free_size) {
+            if (mov->estimate && (res = mov_shift_data(s)) <= 0)
+                goto end;
+            res = 0;
             av_log(s, AV_LOG_ERROR, "moov size is bigger than available space\n");
             goto write_end;
         }
@@ -2922,6 +3110,7 @@ static int mov_write_trailer(AVFormatContext *s)
         mov_write_moov_tag(pb, mov, s);
     }
 
+ end:
     if (mov->chapter_track)
         av_freep(&mov->tracks[mov->chapter_track].enc);
 
@@ -73,6 +73,7 @@ typedef struct MpegTSSectionFilter {
 struct MpegTSFilter {
     int pid;
     int last_cc; /* last cc code (-1 if first packet) */
+    int discard; /* discard_pid() result, updated at each payload unit start */
     enum MpegTSFilterType type;
     union {
         MpegTSPESFilter pes_filter;
@@ -1274,8 +1275,6 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
     int64_t pos;
 
     pid = AV_RB16(packet + 1) & 0x1fff;
-    if(pid && discard_pid(ts, pid))
-        return 0;
     is_start = packet[1] & 0x40;
     tss = ts->pids[pid];
     if (ts->auto_guess && tss == NULL && is_start) {
@@ -1284,6 +1283,11 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
     }
     if (!tss)
         return 0;
+    /* the program selection can only change between payload units */
+    if (is_start)
+        tss->discard = pid && discard_pid(ts, pid);
+    if (tss->discard)
+        return 0;
 
     /* continuity check (currently not used) */
     cc = (packet[3] & 0xf);
@@ -1291,6 +1295,11 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
     cc_ok = (tss->last_cc < 0) || (expected_cc == cc);
     tss->last_cc = cc;
 
+    /* PES of discarded streams and padding are skipped until the next unit */
+    if (tss->type == MPEGTS_PES && !is_start &&
+        ((PESContext *)tss->u.pes_filter.opaque)->state == MPEGTS_SKIP)
+        return 0;
+
     /* skip adaptation field */
     afc = (packet[3] >> 4) & 3;
     p = packet + 4;
@@ -1367,18 +1376,24 @@ static int mpegts_resync(AVFormatContext *s)
     return -1;
 }
 
-/* return -1 if error or EOF. Return 0 if OK. */
-static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size)
+/**
+ * Read one TS packet, *data points to it until the next read from s->pb.
+ * The packet is returned from the AVIOContext buffer without copying
+ * whenever possible, buf is used otherwise.
+ * @return -1 if error or EOF. Return 0 if OK.
+ */
+static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size,
+                       const uint8_t **data)
 {
     AVIOContext *pb = s->pb;
     int skip, len;
 
     for(;;) {
-        len = avio_read(pb, buf, TS_PACKET_SIZE);
+        len = ffio_read_indirect(pb, buf, TS_PACKET_SIZE, data);
         if (len != TS_PACKET_SIZE)
             return len < 0 ? len : AVERROR_EOF;
         /* check paquet sync byte */
-        if (buf[0] != 0x47) {
+        if ((*data)[0] != 0x47) {
             /* find a new packet start */
             avio_seek(pb, -TS_PACKET_SIZE, SEEK_CUR);
             if (mpegts_resync(s) < 0)
@@ -1387,8 +1402,14 @@ static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size)
                 continue;
         } else {
             skip = raw_packet_size - TS_PACKET_SIZE;
-            if (skip > 0)
+            if (skip > 0) {
+                /* skipping past the buffer end may refill it */
+                if (*data != buf && pb->buf_end - pb->buf_ptr < skip) {
+                    memcpy(buf, *data, TS_PACKET_SIZE);
+                    *data = buf;
+                }
                 avio_skip(pb, skip);
+            }
             break;
         }
     }
@@ -1399,6 +1420,7 @@ static int handle_packets(MpegTSContext *ts, int nb_packets)
 {
     AVFormatContext *s = ts->stream;
     uint8_t packet[TS_PACKET_SIZE];
+    const uint8_t *data;
     int packet_num, ret;
 
     ts->stop_parse = 0;
@@ -1409,10 +1431,10 @@ static int handle_packets(MpegTSContext *ts, int nb_packets)
         packet_num++;
         if (nb_packets != 0 && packet_num >= nb_packets)
             break;
-        ret = read_packet(s, packet, ts->raw_packet_size);
+        ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             return ret;
-        ret = handle_packet(ts, packet);
+        ret = handle_packet(ts, data);
         if (ret != 0)
             return ret;
     }
@@ -1536,6 +1558,7 @@ static int mpegts_read_header(AVFormatContext *s,
         int64_t pcrs[2], pcr_h;
         int packet_count[2];
         uint8_t packet[TS_PACKET_SIZE];
+        const uint8_t *data;
 
         /* only read packets */
 
@@ -1551,12 +1574,12 @@ static int mpegts_read_header(AVFormatContext *s,
         nb_pcrs = 0;
         nb_packets = 0;
         for(;;) {
-            ret = read_packet(s, packet, ts->raw_packet_size);
+            ret = read_packet(s, packet, ts->raw_packet_size, &data);
             if (ret < 0)
                 return -1;
-            pid = AV_RB16(packet + 1) & 0x1fff;
+            pid = AV_RB16(data + 1) & 0x1fff;
             if ((pcr_pid == -1 || pcr_pid == pid) &&
-                parse_pcr(&pcr_h, &pcr_l, packet) == 0) {
+                parse_pcr(&pcr_h, &pcr_l, data) == 0) {
                 pcr_pid = pid;
                 packet_count[nb_pcrs] = nb_packets;
                 pcrs[nb_pcrs] = pcr_h * 300 + pcr_l;
@@ -1594,15 +1617,18 @@ static int mpegts_raw_read_packet(AVFormatContext *s,
     int64_t pcr_h, next_pcr_h, pos;
     int pcr_l, next_pcr_l;
     uint8_t pcr_buf[12];
+    const uint8_t *data;
 
     if (av_new_packet(pkt, TS_PACKET_SIZE) < 0)
         return AVERROR(ENOMEM);
     pkt->pos= avio_tell(s->pb);
-    ret = read_packet(s, pkt->data, ts->raw_packet_size);
+    ret = read_packet(s, pkt->data, ts->raw_packet_size, &data);
     if (ret < 0) {
         av_free_packet(pkt);
         return ret;
     }
+    if (data != pkt->data)
+        memcpy(pkt->data, data, TS_PACKET_SIZE);
     if (ts->mpeg2ts_compute_pcr) {
         /* compute exact PCR for each packet */
         if (parse_pcr(&pcr_h, &pcr_l, pkt->data) == 0) {
@@ -131,8 +131,23 @@ typedef struct {
     unsigned index_sid;
     uint64_t start;
     uint64_t duration;
+    AVRational index_edit_rate;
+    int slice_count;
+    int pos_table_count;
+    int nb_index_entries;
+    uint64_t *stream_offset_entries; ///< IndexEntryArray stream offsets
+    uint8_t *flag_entries;           ///< IndexEntryArray flags
 } MXFIndexTableSegment;
 
+typedef struct {
+    uint64_t this_partition;
+    uint64_t previous_partition;
+    uint64_t body_offset;
+    unsigned index_sid;
+    unsigned body_sid;
+    int64_t essence_offset; ///< absolute file offset of the first essence klv, 0 if none
+} MXFPartition;
+
 typedef struct {
     UID uid;
     enum MXFMetadataSetType type;
@@ -188,6 +203,14 @@ typedef struct {
     int local_tags_count;
     uint64_t footer_partition; ///< offset of footer partition
     MXFOpValue op; ///< operational pattern
+    int64_t run_in; ///< size of the run-in sequence, partition offsets are relative to it
+    MXFPartition *partitions;
+    int partitions_count;
+    MXFIndexTableSegment **index_segments; ///< sorted and deduplicated, same index sid
+    int index_segments_count;
+    int essence_partitions; ///< first partition holding essence of the indexed body sid
+    int essence_partitions_count;
+    int index_stream; ///< stream holding the index entries, -1 if none
 } MXFContext;
 
 enum MXFWrappingScheme {
@@ -205,6 +228,7 @@ typedef struct {
 } MXFMetadataReadTableEntry;
 
 /* partial keys to match */
+static const uint8_t mxf_partition_pack_key[]              = { 0x06,0x0e,0x2b,0x34,0x02,0x05,0x01,0x01,0x0d,0x01,0x02,0x01,0x01 };
 static const uint8_t mxf_header_partition_pack_key[]       = { 0x06,0x0e,0x2b,0x34,0x02,0x05,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x02 };
 static const uint8_t mxf_footer_partition_key[]            = { 0x06,0x0e,0x2b,0x34,0x02,0x05,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x04 };
 static const uint8_t mxf_essence_element_key[]             = { 0x06,0x0e,0x2b,0x34,0x01,0x02,0x01,0x01,0x0d,0x01,0x03,0x01 };
@@ -213,6 +237,7 @@ static const uint8_t mxf_avid_essence_element_key[]        = { 0x06,0x0e,0x2b,0x
 static const uint8_t mxf_klv_key[]                         = { 0x06,0x0e,0x2b,0x34 };
 /* complete keys to match */
 static const uint8_t mxf_random_index_pack_key[]           = { 0x06,0x0e,0x2b,0x34,0x02,0x05,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x11,0x01,0x00 };
+static const uint8_t mxf_index_table_segment_key[]         = { 0x06,0x0e,0x2b,0x34,0x02,0x53,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x10,0x01,0x00 };
 static const uint8_t mxf_crypto_source_container_ul[]      = { 0x06,0x0e,0x2b,0x34,0x01,0x01,0x01,0x09,0x06,0x01,0x01,0x02,0x02,0x00,0x00,0x00 };
 static const uint8_t mxf_encrypted_triplet_key[]           = { 0x06,0x0e,0x2b,0x34,0x02,0x04,0x01,0x07,0x0d,0x01,0x03,0x01,0x02,0x7e,0x01,0x00 };
 static const uint8_t mxf_encrypted_essence_container[]     = { 0x06,0x0e,0x2b,0x34,0x04,0x01,0x01,0x07,0x0d,0x01,0x03,0x01,0x02,0x0b,0x01,0x00 };
@@ -221,6 +246,8 @@ static const uint8_t mxf_avid_padding_size_uid[]           = { 0xa0,0x24,0x00,0x
 static const uint8_t mxf_avid_edit_unit_size_uid[]         = { 0xa0,0x24,0x00,0x60,0x94,0xeb,0x75,0xcb,0xce,0x2a,0xca,0x50,0x51,0xab,0x11,0xd3 };
 
 #define IS_KLV_KEY(x, y) (!memcmp(x, y, sizeof(y)))
+/* header, body or footer partition pack */
+#define IS_PARTITION_PACK_KEY(x) (IS_KLV_KEY(x, mxf_partition_pack_key) && (x)[13] >= 0x02 && (x)[13] <= 0x04)
 
 static int64_t klv_decode_ber_length(AVIOContext *pb)
 {
@@ -583,52 +610,68 @@ static int mxf_read_primer_pack(AVFormatContext *s, void *arg, int tag, int size
     return 0;
 }
 
-static int mxf_read_partition(AVFormatContext *s, void *arg, int tag, int size, UID uid)
+static int mxf_read_partition(AVFormatContext *s, KLVPacket *klv)
 {
-    MXFContext *mxf = arg;
-    unsigned count;
+    MXFContext *mxf = s->priv_data;
+    MXFPartition *partition;
+    int header = klv->key[13] == 0x02;
+    int64_t klv_end = avio_tell(s->pb) + klv->length;
     UID op;
 
+    if (mxf->partitions_count+1 >= UINT_MAX / sizeof(*mxf->partitions))
+        return AVERROR(ENOMEM);
+    partition = av_realloc(mxf->partitions, (mxf->partitions_count + 1) * sizeof(*mxf->partitions));
+    if (!partition)
+        return AVERROR(ENOMEM);
+    mxf->partitions = partition;
+    partition = &mxf->partitions[mxf->partitions_count++];
+    memset(partition, 0, sizeof(*partition));
+
     avio_rb16(s->pb); // major version;
     avio_rb16(s->pb); // minor version;
 
     avio_rb32(s->pb); // kag size
-    avio_rb64(s->pb); // offset of this partition
-    avio_rb64(s->pb); // offset of previous partition
-    mxf->footer_partition = avio_rb64(s->pb); // offset of footer partition
+    partition->this_partition = avio_rb64(s->pb);
+    partition->previous_partition = avio_rb64(s->pb);
+    if (header)
+        mxf->footer_partition = avio_rb64(s->pb); // offset of footer partition
+    else
+        avio_rb64(s->pb);
 
     avio_rb64(s->pb); // header byte count
     avio_rb64(s->pb); // index byte count
+    partition->index_sid = avio_rb32(s->pb);
+    partition->body_offset = avio_rb64(s->pb);
+    partition->body_sid = avio_rb32(s->pb);
 
-    avio_rb32(s->pb); // index sid
-
-    avio_rb64(s->pb); // body offset
-
-    avio_rb32(s->pb); // body sid
+    av_dlog(s, "partition %#"PRIx64" prev %#"PRIx64" index sid %d body sid %d "
+            "body offset %#"PRIx64"\n", partition->this_partition,
+            partition->previous_partition, partition->index_sid,
+            partition->body_sid, partition->body_offset);
 
     avio_read(s->pb, op, 16);
 
-    if      (op[12] == 1 && op[13] == 1) mxf->op = Op1a;
-    else if (op[12] == 1 && op[13] == 2) mxf->op = Op1b;
-    else if (op[12] == 1 && op[13] == 3) mxf->op = Op1c;
-    else if (op[12] == 2 && op[13] == 1) mxf->op = Op2a;
-    else if (op[12] == 2 && op[13] == 2) mxf->op = Op2b;
-    else if (op[12] == 2 && op[13] == 3) mxf->op = Op2c;
-    else if (op[12] == 3 && op[13] == 1) mxf->op = Op3a;
-    else if (op[12] == 3 && op[13] == 2) mxf->op = Op3b;
-    else if (op[12] == 3 && op[13] == 3) mxf->op = Op3c;
-    else if (op[12] == 0x10)             mxf->op = OpAtom;
-    else {
-        av_log(mxf->fc, AV_LOG_ERROR, "unknown operational pattern: "
-               "%02xh %02xh - assuming Op1a\n", op[12], op[13]);
-        mxf->op = Op1a;
-    }
+    if (header) {
+        if      (op[12] == 1 && op[13] == 1) mxf->op = Op1a;
+        else if (op[12] == 1 && op[13] == 2) mxf->op = Op1b;
+        else if (op[12] == 1 && op[13] == 3) mxf->op = Op1c;
+        else if (op[12] == 2 && op[13] == 1) mxf->op = Op2a;
+        else if (op[12] == 2 && op[13] == 2) mxf->op = Op2b;
+        else if (op[12] == 2 && op[13] == 3) mxf->op = Op2c;
+        else if (op[12] == 3 && op[13] == 1) mxf->op = Op3a;
+        else if (op[12] == 3 && op[13] == 2) mxf->op = Op3b;
+        else if (op[12] == 3 && op[13] == 3) mxf->op = Op3c;
+        else if (op[12] == 0x10)             mxf->op = OpAtom;
+        else {
+            av_log(mxf->fc, AV_LOG_ERROR, "unknown operational pattern: "
+                   "%02xh %02xh - assuming Op1a\n", op[12], op[13]);
+            mxf->op = Op1a;
+        }
 
-    av_dict_set(&s->metadata, "operational_pattern", mxf_operational_patterns[mxf->op].str, 0);
+        av_dict_set(&s->metadata, "operational_pattern", mxf_operational_patterns[mxf->op].str, 0);
+    }
 
-    count = avio_rb32(s->pb);
-    avio_skip(s->pb, 4); /* useless size of objects, always 16 according to specs */
-    avio_skip(s->pb, count*16);
+    avio_seek(s->pb, klv_end, SEEK_SET); /* skip essence container batch */
 
     return 0;
 }
@@ -801,6 +844,41 @@ static int mxf_read_source_package(AVFormatContext *s, void *arg, int tag, int s
     return 0;
 }
 
+static int mxf_read_index_entry_array(AVFormatContext *s, MXFIndexTableSegment *segment, int size)
+{
+    int i, length;
+    unsigned count = avio_rb32(s->pb);
+
+    length = avio_rb32(s->pb);
+    if (size < 8 || length < 11 + 4*segment->slice_count + 8*segment->pos_table_count ||
+        count > (size - 8) / length) {
+        av_log(s, AV_LOG_ERROR, "invalid index entry array\n");
+        return -1;
+    }
+
+    av_freep(&segment->stream_offset_entries);
+    av_freep(&segment->flag_entries);
+    segment->nb_index_entries = 0;
+    segment->stream_offset_entries = av_malloc(count * sizeof(*segment->stream_offset_entries));
+    segment->flag_entries = av_malloc(count);
+    if (!segment->stream_offset_entries || !segment->flag_entries) {
+        av_freep(&segment->stream_offset_entries);
+        av_freep(&segment->flag_entries);
+        return AVERROR(ENOMEM);
+    }
+
+    for (i = 0; i < count; i++) {
+        avio_r8(s->pb); // temporal offset
+        avio_r8(s->pb); // key frame offset
+        segment->flag_entries[i] = avio_r8(s->pb);
+        segment->stream_offset_entries[i] = avio_rb64(s->pb);
+        avio_skip(s->pb, length - 11); // slice offsets and pos table
+    }
+    segment->nb_index_entries = count;
+    av_dlog(s, "%d index entries\n", count);
+    return 0;
+}
+
 static int mxf_read_index_table_segment(AVFormatContext *s, void *arg, int tag, int size, UID uid)
 {
     MXFIndexTableSegment *index_segment = arg;
@@ -817,7 +895,18 @@ static int mxf_read_index_table_segment(AVFormatContext *s, void *arg, int tag,
         index_segment->body_sid = avio_rb32(s->pb);
         av_dlog(s, "body sid %d\n", index_segment->body_sid);
         break;
-        //case 0x3F0B: av_dlog(s, "IndexEditRate %d/%d\n", avio_rb32(s->pb), avio_rb32(s->pb)); break;
+    case 0x3F08:
+        index_segment->slice_count = avio_r8(s->pb);
+        av_dlog(s, "slice count %d\n", index_segment->slice_count);
+        break;
+    case 0x3F0A:
+        return mxf_read_index_entry_array(s, index_segment, size);
+    case 0x3F0B:
+        index_segment->index_edit_rate.num = avio_rb32(s->pb);
+        index_segment->index_edit_rate.den = avio_rb32(s->pb);
+        av_dlog(s, "index edit rate %d/%d\n", index_segment->index_edit_rate.num,
+                index_segment->index_edit_rate.den);
+        break;
     case 0x3F0C:
         index_segment->start = avio_rb64(s->pb);
         av_dlog(s, "start %"PRId64"\n", index_segment->start);
@@ -826,6 +915,10 @@ static int mxf_read_index_table_segment(AVFormatContext *s, void *arg, int tag,
         index_segment->duration = avio_rb64(s->pb);
         av_dlog(s, "duration %"PRId64"\n", index_segment->duration);
         break;
+    case 0x3F0E:
+        index_segment->pos_table_count = avio_r8(s->pb);
+        av_dlog(s, "pos table count %d\n", index_segment->pos_table_count);
+        break;
     }
     return 0;
 }
@@ -1218,7 +1311,6 @@ static int mxf_parse_structural_metadata(MXFContext *mxf)
 }
 
 static const MXFMetadataReadTableEntry mxf_metadata_read_table[] = {
-    { { 0x06,0x0e,0x2B,0x34,0x02,0x05,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x02,0x04,0x00 }, mxf_read_partition }, // closed complete
     { { 0x06,0x0E,0x2B,0x34,0x02,0x05,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x05,0x01,0x00 }, mxf_read_primer_pack },
     { { 0x06,0x0E,0x2B,0x34,0x02,0x53,0x01,0x01,0x0d,0x01,0x01,0x01,0x01,0x01,0x18,0x00 }, mxf_read_content_storage, 0, AnyType },
     { { 0x06,0x0E,0x2B,0x34,0x02,0x53,0x01,0x01,0x0d,0x01,0x01,0x01,0x01,0x01,0x37,0x00 }, mxf_read_source_package, sizeof(MXFPackage), SourcePackage },
@@ -1283,33 +1375,302 @@ static int mxf_read_local_tags(MXFContext *mxf, KLVPacket *klv, MXFMetadataReadF
     return ctx_size ? mxf_add_metadata_set(mxf, ctx) : 0;
 }
 
-static int mxf_read_random_index_pack(AVFormatContext *s)
+static int mxf_read_rip(AVFormatContext *s, uint64_t **offsets)
 {
+    int64_t file_size = avio_size(s->pb);
+    int64_t len;
+    unsigned size;
+    int i, count;
     UID key;
-    int size;
 
-    avio_seek(s->pb, avio_size(s->pb) - 4, SEEK_SET);
+    avio_seek(s->pb, file_size - 4, SEEK_SET);
     size = avio_rb32(s->pb);
-    avio_seek(s->pb, avio_size(s->pb) -size, SEEK_SET);
+    if (size > file_size)
+        return -1;
+    avio_seek(s->pb, file_size - size, SEEK_SET);
     avio_read(s->pb, key, 16);
-    if (IS_KLV_KEY(key, mxf_random_index_pack_key)) {
-        int len = klv_decode_ber_length(s->pb);
-        uint64_t offset = 0;
-        for (; len >= 12; len -= 12) {
-            avio_rb32(s->pb); // BodySID
-            offset = avio_rb64(s->pb);
-        }
-        if (!offset)
-            return -1;
-        avio_seek(s->pb, offset, SEEK_SET);
-        avio_read(s->pb, key, 16);
-        PRINT_KEY(s, "rip key", key);
-        if (IS_KLV_KEY(key, mxf_footer_partition_key)) {
-            avio_seek(s->pb, offset, SEEK_SET);
+    if (!IS_KLV_KEY(key, mxf_random_index_pack_key))
+        return -1;
+    len = klv_decode_ber_length(s->pb);
+    if (len < 4 || len > size)
+        return -1;
+    count = (len - 4) / 12; // overall length at the end
+    if (!count)
+        return 0;
+    *offsets = av_malloc(count * sizeof(**offsets));
+    if (!*offsets)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < count; i++) {
+        avio_rb32(s->pb); // BodySID
+        (*offsets)[i] = avio_rb64(s->pb);
+    }
+    return count;
+}
+
+static int mxf_read_random_index_pack(AVFormatContext *s)
+{
+    MXFContext *mxf = s->priv_data;
+    uint64_t *offsets = NULL, offset;
+    UID key;
+    int count = mxf_read_rip(s, &offsets);
+
+    if (count < 0)
+        return -1;
+    offset = count ? offsets[count-1] : 0;
+    av_free(offsets);
+    if (!offset)
+        return -1;
+    avio_seek(s->pb, mxf->run_in + offset, SEEK_SET);
+    avio_read(s->pb, key, 16);
+    PRINT_KEY(s, "rip key", key);
+    if (IS_KLV_KEY(key, mxf_footer_partition_key)) {
+        avio_seek(s->pb, mxf->run_in + offset, SEEK_SET);
+        return 0;
+    }
+    return -1;
+}
+
+static void mxf_set_essence_offset(MXFContext *mxf, int64_t offset)
+{
+    if (mxf->partitions_count && !mxf->partitions[mxf->partitions_count-1].essence_offset)
+        mxf->partitions[mxf->partitions_count-1].essence_offset = offset;
+}
+
+/**
+ * Read the partition pack at offset and the index table segments following it,
+ * stopping at its first essence element.
+ * @return 1 if the partition was read, 0 if it was already known, <0 on error
+ */
+static int mxf_read_partition_index(AVFormatContext *s, uint64_t offset)
+{
+    MXFContext *mxf = s->priv_data;
+    KLVPacket klv;
+    int64_t next;
+    int i;
+
+    for (i = 0; i < mxf->partitions_count; i++)
+        if (mxf->partitions[i].this_partition == offset)
             return 0;
+
+    if (avio_seek(s->pb, mxf->run_in + offset, SEEK_SET) < 0 ||
+        klv_read_packet(&klv, s->pb) < 0 ||
+        !IS_PARTITION_PACK_KEY(klv.key) ||
+        mxf_read_partition(s, &klv) < 0) {
+        av_log(s, AV_LOG_WARNING, "could not read partition at %#"PRIx64"\n", offset);
+        return -1;
+    }
+
+    while (!url_feof(s->pb)) {
+        if (klv_read_packet(&klv, s->pb) < 0)
+            break;
+        next = avio_tell(s->pb) + klv.length;
+        if (IS_KLV_KEY(klv.key, mxf_index_table_segment_key)) {
+            if (mxf_read_local_tags(mxf, &klv, mxf_read_index_table_segment,
+                                    sizeof(MXFIndexTableSegment), IndexTableSegment) < 0)
+                av_log(s, AV_LOG_WARNING, "error reading index table segment\n");
+        } else if (IS_KLV_KEY(klv.key, mxf_system_metadata_pack_key) ||
+                   IS_KLV_KEY(klv.key, mxf_encrypted_triplet_key)    ||
+                   IS_KLV_KEY(klv.key, mxf_essence_element_key)      ||
+                   IS_KLV_KEY(klv.key, mxf_avid_essence_element_key)) {
+            mxf_set_essence_offset(mxf, klv.offset);
+            break;
+        } else if (IS_PARTITION_PACK_KEY(klv.key) ||
+                   IS_KLV_KEY(klv.key, mxf_random_index_pack_key)) {
+            break;
         }
+        avio_seek(s->pb, next, SEEK_SET);
     }
-    return -1;
+    return 1;
+}
+
+/**
+ * Read the index table segments of all partitions listed in the RIP,
+ * or reachable from the last known partition when there is none.
+ */
+static void mxf_read_index_tables(AVFormatContext *s)
+{
+    MXFContext *mxf = s->priv_data;
+    uint64_t *offsets = NULL, offset;
+    int i, count = mxf_read_rip(s, &offsets);
+
+    if (count > 0) {
+        for (i = 0; i < count; i++)
+            mxf_read_partition_index(s, offsets[i]);
+    } else if (mxf->partitions_count) {
+        offset = mxf->partitions[mxf->partitions_count-1].previous_partition;
+        while (offset && mxf_read_partition_index(s, offset) > 0)
+            offset = mxf->partitions[mxf->partitions_count-1].previous_partition;
+    }
+    av_free(offsets);
+}
+
+static int mxf_compare_index_segments(const void *a, const void *b)
+{
+    const MXFIndexTableSegment *s1 = *(MXFIndexTableSegment * const *)a;
+    const MXFIndexTableSegment *s2 = *(MXFIndexTableSegment * const *)b;
+
+    if (s1->index_sid != s2->index_sid)
+        return s1->index_sid < s2->index_sid ? -1 : 1;
+    if (s1->start != s2->start)
+        return s1->start < s2->start ? -1 : 1;
+    return s2->nb_index_entries - s1->nb_index_entries; // most complete first
+}
+
+static int mxf_compare_partitions(const void *a, const void *b)
+{
+    const MXFPartition *p1 = a, *p2 = b;
+
+    if (!p1->essence_offset != !p2->essence_offset)
+        return !p1->essence_offset - !p2->essence_offset;
+    if (p1->body_sid != p2->body_sid)
+        return p1->body_sid < p2->body_sid ? -1 : 1;
+    if (p1->body_offset != p2->body_offset)
+        return p1->body_offset < p2->body_offset ? -1 : 1;
+    return 0;
+}
+
+/**
+ * Convert an essence container stream offset to a file offset.
+ * @return file offset or -1 if it is not covered by any partition
+ */
+static int64_t mxf_absolute_offset(MXFContext *mxf, uint64_t stream_offset)
+{
+    const MXFPartition *p = mxf->partitions + mxf->essence_partitions;
+    int lo = 0, hi = mxf->essence_partitions_count - 1;
+
+    if (hi < 0 || stream_offset < p[0].body_offset)
+        return -1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) >> 1;
+        if (p[mid].body_offset <= stream_offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return p[lo].essence_offset + stream_offset - p[lo].body_offset;
+}
+
+static AVRational mxf_index_time_base(MXFIndexTableSegment *segment, AVStream *st)
+{
+    if (segment->index_edit_rate.num > 0 && segment->index_edit_rate.den > 0)
+        return (AVRational){ segment->index_edit_rate.den, segment->index_edit_rate.num };
+    return st->time_base;
+}
+
+/**
+ * Build the stream index from the VBR index table segments.
+ * Entries point to the start of the edit unit, they are added to the
+ * first video stream only since all tracks are interleaved per edit unit.
+ */
+static void mxf_build_index(AVFormatContext *s)
+{
+    MXFContext *mxf = s->priv_data;
+    MXFIndexTableSegment **segments;
+    AVStream *st = NULL;
+    int i, j, count = 0;
+
+    if (!s->nb_streams || !mxf->partitions_count)
+        return;
+
+    segments = av_malloc(mxf->metadata_sets_count * sizeof(*segments));
+    if (!segments)
+        return;
+    for (i = 0; i < mxf->metadata_sets_count; i++)
+        if (mxf->metadata_sets[i]->type == IndexTableSegment)
+            segments[count++] = (MXFIndexTableSegment *)mxf->metadata_sets[i];
+    if (!count) {
+        av_free(segments);
+        return;
+    }
+    qsort(segments, count, sizeof(*segments), mxf_compare_index_segments);
+
+    /* keep segments of the first index sid, drop repeated ones */
+    for (i = 1, j = 1; i < count; i++) {
+        if (segments[i]->index_sid != segments[0]->index_sid)
+            break;
+        if (segments[i]->start != segments[j-1]->start)
+            segments[j++] = segments[i];
+    }
+    mxf->index_segments = segments;
+    mxf->index_segments_count = j;
+
+    qsort(mxf->partitions, mxf->partitions_count, sizeof(*mxf->partitions), mxf_compare_partitions);
+    for (i = 0; i < mxf->partitions_count && mxf->partitions[i].essence_offset; i++) {
+        if (mxf->partitions[i].body_sid == segments[0]->body_sid) {
+            if (!mxf->essence_partitions_count)
+                mxf->essence_partitions = i;
+            mxf->essence_partitions_count++;
+        }
+    }
+    av_dlog(s, "%d index segments, %d essence partitions\n",
+            mxf->index_segments_count, mxf->essence_partitions_count);
+
+    for (i = 0; i < s->nb_streams; i++) {
+        if (s->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO) {
+            st = s->streams[i];
+            break;
+        }
+    }
+    if (!st)
+        st = s->streams[0];
+
+    for (i = 0; i < mxf->index_segments_count; i++) {
+        MXFIndexTableSegment *segment = segments[i];
+        AVRational time_base = mxf_index_time_base(segment, st);
+
+        for (j = 0; j < segment->nb_index_entries; j++) {
+            int64_t pos = mxf_absolute_offset(mxf, segment->stream_offset_entries[j]);
+            int flags = segment->flag_entries[j];
+            if (pos < 0)
+                continue;
+            av_add_index_entry(st, pos,
+                               av_rescale_q(segment->start + j, time_base, st->time_base),
+                               0, 0, flags & 0x80 || !(flags & 0x30) ? AVINDEX_KEYFRAME : 0);
+        }
+        av_freep(&segment->stream_offset_entries);
+        av_freep(&segment->flag_entries);
+        segment->nb_index_entries = 0;
+    }
+
+    if (st->nb_index_entries)
+        mxf->index_stream = st->index;
+}
+
+/**
+ * Compute the file offset of an edit unit from constant bytes per edit unit
+ * index table segments, sample_time is rounded down to that edit unit.
+ * @return file offset or -1
+ */
+static int64_t mxf_cbr_offset(MXFContext *mxf, AVStream *st, int64_t *sample_time)
+{
+    MXFIndexTableSegment *segment;
+    AVRational time_base;
+    uint64_t stream_offset = 0;
+    int64_t edit_unit, offset;
+    int i;
+
+    if (!mxf->index_segments_count)
+        return -1;
+    segment = mxf->index_segments[0];
+    time_base = mxf_index_time_base(segment, st);
+    edit_unit = av_rescale_rnd(*sample_time, (int64_t)st->time_base.num * time_base.den,
+                               (int64_t)st->time_base.den * time_base.num, AV_ROUND_DOWN);
+    edit_unit = FFMAX(edit_unit, segment->start);
+
+    for (i = 0; i < mxf->index_segments_count; i++) {
+        segment = mxf->index_segments[i];
+        if (!segment->edit_unit_bytecount)
+            return -1;
+        if (i+1 == mxf->index_segments_count || edit_unit < mxf->index_segments[i+1]->start)
+            break;
+        stream_offset += (mxf->index_segments[i+1]->start - segment->start) *
+            segment->edit_unit_bytecount;
+    }
+    stream_offset += (edit_unit - segment->start) * segment->edit_unit_bytecount;
+    offset = mxf_absolute_offset(mxf, stream_offset);
+    if (offset >= 0)
+        *sample_time = av_rescale_q(edit_unit, time_base, st->time_base);
+    return offset;
 }
 
 static int mxf_read_header(AVFormatContext *s, AVFormatParameters *ap)
@@ -1325,6 +1686,8 @@ static int mxf_read_header(AVFormatContext *s, AVFormatParameters *ap)
     }
     avio_seek(s->pb, -14, SEEK_CUR);
     mxf->fc = s;
+    mxf->run_in = avio_tell(s->pb);
+    mxf->index_stream = -1;
     while (!url_feof(s->pb)) {
         const MXFMetadataReadTableEntry *metadata;
 
@@ -1332,7 +1695,15 @@ static int mxf_read_header(AVFormatContext *s, AVFormatParameters *ap)
             break;
         PRINT_KEY(s, "read header", klv.key);
         av_dlog(s, "size %"PRIu64" offset %#"PRIx64"\n", klv.length, klv.offset);
+        if (IS_PARTITION_PACK_KEY(klv.key)) {
+            if (mxf_read_partition(s, &klv) < 0) {
+                av_log(s, AV_LOG_ERROR, "error reading partition pack\n");
+                return -1;
+            }
+            continue;
+        }
         if (IS_KLV_KEY(klv.key, mxf_system_metadata_pack_key)) {
+            mxf_set_essence_offset(mxf, klv.offset);
             mxf_parse_system_metadata_pack(s, &klv);
             continue;
         }
@@ -1340,10 +1711,11 @@ static int mxf_read_header(AVFormatContext *s, AVFormatParameters *ap)
             IS_KLV_KEY(klv.key, mxf_essence_element_key)   ||
             IS_KLV_KEY(klv.key, mxf_avid_essence_element_key)) {
             essence_klv_offset = klv.offset;
+            mxf_set_essence_offset(mxf, klv.offset);
 
             if (s->pb->seekable) {
                 if (mxf->footer_partition) {
-                    avio_seek(s->pb, mxf->footer_partition, SEEK_SET);
+                    avio_seek(s->pb, mxf->run_in + mxf->footer_partition, SEEK_SET);
                     mxf->footer_partition = 0;
                     continue;
                 } else { // try scanning RIP
@@ -1382,6 +1754,11 @@ static int mxf_read_header(AVFormatContext *s, AVFormatParameters *ap)
         return -1;
     }
 
+    if (s->pb->seekable) {
+        mxf_read_index_tables(s);
+        mxf_build_index(s);
+    }
+
     avio_seek(s->pb, essence_klv_offset, SEEK_SET);
     return 0;
 }
@@ -1408,6 +1785,10 @@ static int mxf_read_close(AVFormatContext *s)
         case MaterialPackage:
             av_freep(&((MXFPackage *)mxf->metadata_sets[i])->tracks_refs);
             break;
+        case IndexTableSegment:
+            av_freep(&((MXFIndexTableSegment *)mxf->metadata_sets[i])->stream_offset_entries);
+            av_freep(&((MXFIndexTableSegment *)mxf->metadata_sets[i])->flag_entries);
+            break;
         default:
             break;
         }
@@ -1416,6 +1797,8 @@ static int mxf_read_close(AVFormatContext *s)
     av_freep(&mxf->metadata_sets);
     av_freep(&mxf->aesc);
     av_freep(&mxf->local_tags);
+    av_freep(&mxf->partitions);
+    av_freep(&mxf->index_segments);
     return 0;
 }
 
@@ -1435,8 +1818,7 @@ static int mxf_probe(AVProbeData *p) {
     return 0;
 }
 
-/* rudimentary byte seek */
-/* XXX: use MXF Index */
+/* seek using the index table segments, rudimentary byte seek otherwise */
 static int mxf_read_seek(AVFormatContext *s, int stream_index, int64_t sample_time, int flags)
 {
     MXFContext *mxf = s->priv_data;
@@ -1449,11 +1831,25 @@ static int mxf_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 
     if (mxf->op == OpAtom && s->nb_streams == 1 && track->edit_unit_bytecount) {
         offset = s->data_offset + track->edit_unit_bytecount * sample_time;
-    } else {
-        if (!s->bit_rate)
+    } else if (mxf->index_stream >= 0) {
+        AVStream *ist = s->streams[mxf->index_stream];
+        int64_t timestamp = av_rescale_q(sample_time, st->time_base, ist->time_base);
+        int index = av_index_search_timestamp(ist, timestamp, flags);
+        if (index < 0)
+            index = av_index_search_timestamp(ist, timestamp, flags ^ AVSEEK_FLAG_BACKWARD);
+        if (index < 0)
             return -1;
-        seconds = av_rescale(sample_time, st->time_base.num, st->time_base.den);
-        offset = (s->bit_rate * seconds) >> 3;
+        st = ist;
+        offset = ist->index_entries[index].pos;
+        sample_time = ist->index_entries[index].timestamp;
+    } else {
+        offset = mxf_cbr_offset(mxf, st, &sample_time);
+        if (offset < 0) {
+            if (!s->bit_rate)
+                return -1;
+            seconds = av_rescale(sample_time, st->time_base.num, st->time_base.den);
+            offset = (s->bit_rate * seconds) >> 3;
+        }
     }
 
     avio_seek(s->pb, offset, SEEK_SET);
@@ -2249,23 +2249,16 @@ static int mxf_compare_timestamps(AVFormatContext *s, AVPacket *next, AVPacket *
 static int mxf_interleave_get_packet(AVFormatContext *s, AVPacket *out, AVPacket *pkt, int flush)
 {
     MXFContext *mxf = s->priv_data;
-    int i, stream_count = 0;
+    int i, stream_count = s->interleave_heap_size;
     int64_t duration = mxf->last_indexed_edit_unit + mxf->edit_units_count;
 
-    for (i = 0; i < s->nb_streams; i++)
-        stream_count += !!s->streams[i]->last_in_packet_buffer;
-
     if (s->nb_streams == stream_count || flush) {
-        AVPacketList *pktl = s->packet_buffer;
+        AVPacket *next = ff_interleave_peek_packet(s);
         if (s->nb_streams != stream_count) {
             // extra audio at the end
-            if (pktl && pktl->pkt.stream_index > 0 && pktl->pkt.dts >= duration) {
-                AVStream *st = s->streams[pktl->pkt.stream_index];
-                s->packet_buffer = pktl->next;
-                if (st->last_in_packet_buffer == pktl)
-                    st->last_in_packet_buffer = NULL;
-                av_free_packet(&pktl->pkt);
-                av_freep(&pktl);
+            if (next && next->stream_index > 0 && next->dts >= duration) {
+                ff_interleave_get_packet(s, out);
+                av_free_packet(out);
                 goto out;
             }
 
@@ -2278,20 +2271,12 @@ static int mxf_interleave_get_packet(AVFormatContext *s, AVPacket *out, AVPacket
                         ff_interleave_add_packet(s, &new_pkt, mxf_compare_timestamps);
                 }
             }
-            pktl = s->packet_buffer;
         }
 
-        if (!pktl)
+        if (!ff_interleave_get_packet(s, out))
             goto out;
 
-        *out = pktl->pkt;
         //av_log(s, AV_LOG_DEBUG, "out st:%d dts:%lld\n", (*out).stream_index, (*out).dts);
-        s->packet_buffer = pktl->next;
-        if (s->streams[pktl->pkt.stream_index]->last_in_packet_buffer == pktl)
-            s->streams[pktl->pkt.stream_index]->last_in_packet_buffer = NULL;
-        if (!s->packet_buffer)
-            s->packet_buffer_end = NULL;
-        av_freep(&pktl);
         return 1;
     } else {
     out:
@@ -90,6 +90,7 @@ static const AVOption options[]={
 {"ts", NULL, 0, FF_OPT_TYPE_CONST, {.dbl = FF_FDEBUG_TS }, INT_MIN, INT_MAX, E|D, "fdebug"},
 {"max_delay", "maximum muxing or demuxing delay in microseconds", OFFSET(max_delay), FF_OPT_TYPE_INT, {.dbl = DEFAULT }, 0, INT_MAX, E|D},
 {"fpsprobesize", "number of frames used to probe fps", OFFSET(fps_probe_size), FF_OPT_TYPE_INT, {.dbl = -1}, -1, INT_MAX-1, D},
+{"readahead", "size of the buffer read ahead in a separate thread", OFFSET(readahead_size), FF_OPT_TYPE_INT, {.dbl = 0 }, 0, INT_MAX, D},
 {NULL},
 };
 
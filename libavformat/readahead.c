@@ -0,0 +1,288 @@
+/*
+ * Read-ahead protocol handler
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Read the nested url in a background thread into a ring buffer, ahead of
+ * the reader. Seeks inside the buffered window are served from memory.
+ *
+ * readahead:file.mxf
+ * readahead+http://host/file.mov
+ */
+
+#include <pthread.h>
+#include <time.h>
+
+#include "avformat.h"
+#include "libavutil/avstring.h"
+#include "libavutil/opt.h"
+#include "url.h"
+
+#define READAHEAD_BLOCK_SIZE (1 << 20) ///< largest single read from the nested url
+
+typedef struct {
+    const AVClass *class;
+    int size;                    ///< size of the ring buffer
+    URLContext *hd;
+    uint8_t *buf;
+    int64_t start_pos;           ///< position of the oldest byte still in the buffer
+    int64_t read_pos;            ///< position of the reader
+    int64_t fill_pos;            ///< position of the end of the buffered data
+    int64_t file_size;
+    int64_t seek_pos;            ///< position requested from the thread
+    int64_t seek_ret;
+    int seek_request;
+    int eof;
+    int error;
+    int abort_request;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;         ///< signaled when any of the above changes
+} ReadAheadContext;
+
+#define OFFSET(x) offsetof(ReadAheadContext, x)
+static const AVOption options[] = {
+    {"readahead_size", "size of the read-ahead buffer", OFFSET(size), FF_OPT_TYPE_INT, {.dbl = 8 << 20}, READAHEAD_BLOCK_SIZE, INT_MAX },
+    { NULL }
+};
+
+static const AVClass readahead_class = {
+    .class_name     = "readahead",
+    .item_name      = av_default_item_name,
+    .option         = options,
+    .version        = LIBAVUTIL_VERSION_INT,
+};
+
+static void *readahead_task(void *arg)
+{
+    URLContext *h = arg;
+    ReadAheadContext *c = h->priv_data;
+
+    pthread_mutex_lock(&c->mutex);
+    while (!c->abort_request) {
+        int64_t pos;
+        int index, len, ret;
+
+        if (c->seek_request) {
+            c->seek_ret = ffurl_seek(c->hd, c->seek_pos, SEEK_SET);
+            if (c->seek_ret >= 0) {
+                c->start_pos = c->read_pos = c->fill_pos = c->seek_pos;
+                c->eof = c->error = 0;
+            } else if (ffurl_seek(c->hd, c->fill_pos, SEEK_SET) < 0) {
+                // the buffered data may no longer be followed by the nested url
+                c->error = c->seek_ret;
+            }
+            c->seek_request = 0;
+            pthread_cond_broadcast(&c->cond);
+            continue;
+        }
+
+        if (c->eof || c->error || c->fill_pos - c->read_pos >= c->size) {
+            pthread_cond_wait(&c->cond, &c->mutex);
+            continue;
+        }
+
+        pos   = c->fill_pos;
+        index = pos % c->size;
+        len   = FFMIN(c->size - index, c->size - (pos - c->read_pos));
+        len   = FFMIN(len, READAHEAD_BLOCK_SIZE);
+        // the bytes about to be overwritten can no longer be seeked to
+        c->start_pos = FFMAX(c->start_pos, pos + len - c->size);
+
+        pthread_mutex_unlock(&c->mutex);
+        ret = ffurl_read(c->hd, c->buf + index, len);
+        pthread_mutex_lock(&c->mutex);
+
+        // keep the data even if a seek was requested meanwhile, so that
+        // the buffer still matches the nested url if the seek fails
+        if (ret > 0)
+            c->fill_pos += ret;
+        else if (ret == 0 || ret == AVERROR_EOF)
+            c->eof = 1;
+        else
+            c->error = ret;
+        pthread_cond_broadcast(&c->cond);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
+
+static int readahead_open(URLContext *h, const char *uri, int flags)
+{
+    ReadAheadContext *c = h->priv_data;
+    const char *nested_url;
+    int ret;
+
+    if (!av_strstart(uri, "readahead+", &nested_url) &&
+        !av_strstart(uri, "readahead:", &nested_url)) {
+        av_log(h, AV_LOG_ERROR, "Unsupported url %s\n", uri);
+        return AVERROR(EINVAL);
+    }
+    if (flags & AVIO_FLAG_WRITE) {
+        av_log(h, AV_LOG_ERROR, "Only reading is supported\n");
+        return AVERROR(ENOSYS);
+    }
+
+    if ((ret = ffurl_open(&c->hd, nested_url, AVIO_FLAG_READ)) < 0) {
+        av_log(h, AV_LOG_ERROR, "Unable to open input\n");
+        return ret;
+    }
+    h->is_streamed = c->hd->is_streamed;
+    c->file_size = ffurl_size(c->hd);
+
+    c->buf = av_malloc(c->size);
+    if (!c->buf) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    pthread_mutex_init(&c->mutex, NULL);
+    pthread_cond_init(&c->cond, NULL);
+    if (pthread_create(&c->thread, NULL, readahead_task, h)) {
+        av_log(h, AV_LOG_ERROR, "pthread_create failed\n");
+        pthread_cond_destroy(&c->cond);
+        pthread_mutex_destroy(&c->mutex);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    return 0;
+ fail:
+    av_freep(&c->buf);
+    ffurl_close(c->hd);
+    return ret;
+}
+
+/**
+ * Wait for the thread with the mutex held, waking up regularly to poll
+ * the interrupt callback since the nested url may block indefinitely.
+ */
+static int readahead_wait(ReadAheadContext *c)
+{
+    int64_t t = av_gettime() + 100000;
+    struct timespec ts = { t / 1000000, (t % 1000000) * 1000 };
+
+    if (url_interrupt_cb())
+        return AVERROR_EXIT;
+    pthread_cond_timedwait(&c->cond, &c->mutex, &ts);
+    return 0;
+}
+
+static int readahead_read(URLContext *h, uint8_t *buf, int size)
+{
+    ReadAheadContext *c = h->priv_data;
+    int index, len, ret;
+
+    pthread_mutex_lock(&c->mutex);
+    while (c->fill_pos == c->read_pos && !c->eof && !c->error) {
+        if ((ret = readahead_wait(c)) < 0) {
+            pthread_mutex_unlock(&c->mutex);
+            return ret;
+        }
+    }
+
+    if (c->fill_pos > c->read_pos) {
+        index = c->read_pos % c->size;
+        len   = FFMIN(size, c->fill_pos - c->read_pos);
+        len   = FFMIN(len, c->size - index);
+        memcpy(buf, c->buf + index, len);
+        c->read_pos += len;
+        pthread_cond_broadcast(&c->cond);
+        ret = len;
+    } else {
+        ret = c->error;
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
+static int64_t readahead_seek(URLContext *h, int64_t pos, int whence)
+{
+    ReadAheadContext *c = h->priv_data;
+    int64_t ret;
+
+    if (whence == AVSEEK_SIZE)
+        return c->file_size;
+
+    pthread_mutex_lock(&c->mutex);
+    if (whence == SEEK_CUR) {
+        pos += c->read_pos;
+    } else if (whence == SEEK_END) {
+        if (c->file_size < 0) {
+            pthread_mutex_unlock(&c->mutex);
+            return AVERROR(ENOSYS);
+        }
+        pos += c->file_size;
+    } else if (whence != SEEK_SET) {
+        pthread_mutex_unlock(&c->mutex);
+        return AVERROR(EINVAL);
+    }
+
+    if (pos >= c->start_pos && pos <= c->fill_pos) {
+        c->read_pos = pos;
+        pthread_cond_broadcast(&c->cond);
+        ret = pos;
+    } else if (h->is_streamed) {
+        ret = AVERROR(ENOSYS);
+    } else {
+        // outside of the buffered window, restart reading at pos
+        c->seek_pos     = pos;
+        c->seek_request = 1;
+        pthread_cond_broadcast(&c->cond);
+        ret = 0;
+        while (c->seek_request && ret >= 0)
+            ret = readahead_wait(c);
+        if (ret >= 0)
+            ret = c->seek_ret < 0 ? c->seek_ret : pos;
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
+static int readahead_close(URLContext *h)
+{
+    ReadAheadContext *c = h->priv_data;
+
+    pthread_mutex_lock(&c->mutex);
+    c->abort_request = 1;
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->mutex);
+
+    pthread_join(c->thread, NULL);
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->mutex);
+
+    av_freep(&c->buf);
+    return ffurl_close(c->hd);
+}
+
+URLProtocol ff_readahead_protocol = {
+    .name            = "readahead",
+    .url_open        = readahead_open,
+    .url_read        = readahead_read,
+    .url_seek        = readahead_seek,
+    .url_close       = readahead_close,
+    .priv_data_size  = sizeof(ReadAheadContext),
+    .priv_data_class = &readahead_class,
+    .flags           = URL_PROTOCOL_FLAG_NESTED_SCHEME,
+};
@@ -588,6 +588,36 @@ int av_open_input_file(AVFormatContext **ic_ptr, const char *filename,
 }
 #endif
 
+#if CONFIG_READAHEAD_PROTOCOL
+static int open_readahead(AVFormatContext *s, const char *filename)
+{
+    URLContext *h;
+    const AVOption *o;
+    char url[1024];
+    int ret;
+
+    if (strstr(filename, "://"))
+        snprintf(url, sizeof(url), "readahead+%s", filename);
+    else
+        snprintf(url, sizeof(url), "readahead:%s", filename);
+    if ((ret = ffurl_alloc(&h, url, AVIO_FLAG_READ)) < 0)
+        return ret;
+    o = av_opt_find(h->priv_data, "readahead_size", NULL, 0, 0);
+    if (s->readahead_size < o->min) {
+        av_log(s, AV_LOG_WARNING, "readahead size %d is too small, using %d\n",
+               s->readahead_size, (int)o->min);
+        s->readahead_size = o->min;
+    }
+    av_set_int(h->priv_data, "readahead_size", s->readahead_size);
+    if ((ret = ffurl_connect(h)) < 0 ||
+        (ret = ffio_fdopen(&s->pb, h)) < 0) {
+        ffurl_close(h);
+        return ret;
+    }
+    return 0;
+}
+#endif
+
 /* open input file and probe the format if necessary */
 static int init_input(AVFormatContext *s, const char *filename)
 {
@@ -608,6 +638,12 @@ static int init_input(AVFormatContext *s, const char *filename)
         (!s->iformat && (s->iformat = av_probe_input_format(&pd, 0))))
         return 0;
 
+#if CONFIG_READAHEAD_PROTOCOL
+    if (s->readahead_size > 0) {
+        if ((ret = open_readahead(s, filename)) < 0)
+            return ret;
+    } else
+#endif
     if ((ret = avio_open(&s->pb, filename, AVIO_FLAG_READ)) < 0)
        return ret;
     if (s->iformat)
@@ -2610,6 +2646,7 @@ void avformat_free_context(AVFormatContext *s)
 {
     int i;
     AVStream *st;
+    AVPacketList *pktl;
 
     av_opt_free(s);
     if (s->iformat && s->iformat->priv_class && s->priv_data)
@@ -2618,6 +2655,11 @@ void avformat_free_context(AVFormatContext *s)
     for(i=0;i<s->nb_streams;i++) {
         /* free all data in a stream component */
         st = s->streams[i];
+        while ((pktl = st->first_in_packet_buffer)) {
+            st->first_in_packet_buffer = pktl->next;
+            av_free_packet(&pktl->pkt);
+            av_free(pktl);
+        }
         if (st->parser) {
             av_parser_close(st->parser);
             av_free_packet(&st->cur_pkt);
@@ -2638,6 +2680,11 @@ void avformat_free_context(AVFormatContext *s)
     }
     av_freep(&s->programs);
     av_freep(&s->priv_data);
+    while ((pktl = s->packet_pool)) {
+        s->packet_pool = pktl->next;
+        av_free(pktl);
+    }
+    av_freep(&s->interleave_heap);
     while(s->nb_chapters--) {
         av_dict_free(&s->chapters[s->nb_chapters]->metadata);
         av_free(s->chapters[s->nb_chapters]);
@@ -3137,40 +3184,116 @@ int av_write_frame(AVFormatContext *s, AVPacket *pkt)
     return ret;
 }
 
-void ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
-                              int (*compare)(AVFormatContext *, AVPacket *, AVPacket *))
+/**
+ * Return nonzero if the first packet queued for stream a must be muxed
+ * before the first packet queued for stream b.
+ */
+static int interleave_before(AVFormatContext *s, int a, int b)
+{
+    return s->interleave_compare(s, &s->streams[b]->first_in_packet_buffer->pkt,
+                                    &s->streams[a]->first_in_packet_buffer->pkt);
+}
+
+static void interleave_heap_up(AVFormatContext *s, int i)
 {
-    AVPacketList **next_point, *this_pktl;
+    int *heap = s->interleave_heap;
+
+    while (i > 0) {
+        int parent = (i - 1) >> 1;
+        if (!interleave_before(s, heap[i], heap[parent]))
+            break;
+        FFSWAP(int, heap[i], heap[parent]);
+        i = parent;
+    }
+}
+
+static void interleave_heap_down(AVFormatContext *s, int i)
+{
+    int *heap = s->interleave_heap;
+
+    for (;;) {
+        int child = 2*i + 1;
+        if (child >= s->interleave_heap_size)
+            break;
+        if (child + 1 < s->interleave_heap_size &&
+            interleave_before(s, heap[child + 1], heap[child]))
+            child++;
+        if (!interleave_before(s, heap[child], heap[i]))
+            break;
+        FFSWAP(int, heap[i], heap[child]);
+        i = child;
+    }
+}
 
-    this_pktl = av_mallocz(sizeof(AVPacketList));
-    this_pktl->pkt= *pkt;
+int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
+                             int (*compare)(AVFormatContext *, AVPacket *, AVPacket *))
+{
+    AVStream *st = s->streams[pkt->stream_index];
+    AVPacketList *this_pktl;
+
+    if (!st->first_in_packet_buffer) {
+        int *heap = av_fast_realloc(s->interleave_heap, &s->interleave_heap_alloc,
+                                    s->nb_streams * sizeof(*s->interleave_heap));
+        if (!heap)
+            return AVERROR(ENOMEM);
+        s->interleave_heap = heap;
+    }
+
+    this_pktl = s->packet_pool;
+    if (this_pktl)
+        s->packet_pool = this_pktl->next;
+    else if (!(this_pktl = av_malloc(sizeof(AVPacketList))))
+        return AVERROR(ENOMEM);
+
+    this_pktl->pkt = *pkt;
+    this_pktl->next = NULL;
     pkt->destruct= NULL;             // do not free original but only the copy
     av_dup_packet(&this_pktl->pkt);  // duplicate the packet if it uses non-alloced memory
 
-    if(s->streams[pkt->stream_index]->last_in_packet_buffer){
-        next_point = &(s->streams[pkt->stream_index]->last_in_packet_buffer->next);
-    }else
-        next_point = &s->packet_buffer;
+    s->interleave_compare = compare;
 
-    if(*next_point){
-        if(compare(s, &s->packet_buffer_end->pkt, pkt)){
-            while(!compare(s, &(*next_point)->pkt, pkt)){
-                next_point= &(*next_point)->next;
-            }
-            goto next_non_null;
-        }else{
-            next_point = &(s->packet_buffer_end->next);
-        }
+    // packets of one stream are queued in order, only a new head moves in the heap
+    if (st->last_in_packet_buffer) {
+        st->last_in_packet_buffer->next = this_pktl;
+    } else {
+        st->first_in_packet_buffer = this_pktl;
+        s->interleave_heap[s->interleave_heap_size] = pkt->stream_index;
+        interleave_heap_up(s, s->interleave_heap_size++);
     }
-    assert(!*next_point);
+    st->last_in_packet_buffer = this_pktl;
+
+    return 0;
+}
+
+AVPacket *ff_interleave_peek_packet(AVFormatContext *s)
+{
+    if (!s->interleave_heap_size)
+        return NULL;
+    return &s->streams[s->interleave_heap[0]]->first_in_packet_buffer->pkt;
+}
 
-    s->packet_buffer_end= this_pktl;
-next_non_null:
+int ff_interleave_get_packet(AVFormatContext *s, AVPacket *out)
+{
+    AVStream *st;
+    AVPacketList *pktl;
 
-    this_pktl->next= *next_point;
+    if (!s->interleave_heap_size)
+        return 0;
+
+    st   = s->streams[s->interleave_heap[0]];
+    pktl = st->first_in_packet_buffer;
+    *out = pktl->pkt;
+
+    st->first_in_packet_buffer = pktl->next;
+    if (!pktl->next) {
+        st->last_in_packet_buffer = NULL;
+        s->interleave_heap[0] = s->interleave_heap[--s->interleave_heap_size];
+    }
+    interleave_heap_down(s, 0);
 
-    s->streams[pkt->stream_index]->last_in_packet_buffer=
-    *next_point= this_pktl;
+    pktl->next = s->packet_pool;
+    s->packet_pool = pktl;
+    return 1;
 }
 
 static int ff_interleave_compare_dts(AVFormatContext *s, AVPacket *next, AVPacket *pkt)
@@ -3186,29 +3309,18 @@ static int ff_interleave_compare_dts(AVFormatContext *s, AVPacket *next, AVPacke
 }
 
 int av_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out, AVPacket *pkt, int flush){
-    AVPacketList *pktl;
-    int stream_count=0;
-    int i;
+    int stream_count;
 
     if(pkt){
-        ff_interleave_add_packet(s, pkt, ff_interleave_compare_dts);
+        int ret = ff_interleave_add_packet(s, pkt, ff_interleave_compare_dts);
+        if (ret < 0)
+            return ret;
     }
 
-    for(i=0; i < s->nb_streams; i++)
-        stream_count+= !!s->streams[i]->last_in_packet_buffer;
+    stream_count = s->interleave_heap_size;
 
     if(stream_count && (s->nb_streams == stream_count || flush)){
-        pktl= s->packet_buffer;
-        *out= pktl->pkt;
-
-        s->packet_buffer= pktl->next;
-        if(!s->packet_buffer)
-            s->packet_buffer_end= NULL;
-
-        if(s->streams[out->stream_index]->last_in_packet_buffer == pktl)
-            s->streams[out->stream_index]->last_in_packet_buffer= NULL;
-        av_freep(&pktl);
-        return 1;
+        return ff_interleave_get_packet(s, out);
     }else{
         av_init_packet(out);
         return 0;